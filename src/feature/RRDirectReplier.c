@@ -22,16 +22,25 @@
 #include "common.h"
 #include "RRcommon.h"
 
+/* The worker threads serving requests, when there are any (-j). */
+static common_replier_t replier_s;
+static BOOL     useWorkers_s = FALSE;
+
 /*****************************************************************************
- * Received message handling code
+ * Request handling code
+ *
+ * Compute the result of a request and send the reply. This runs on the
+ * Context thread, or on a worker thread when there are workers.
  *****************************************************************************/
-static          solClient_rxMsgCallback_returnCode_t
-requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+static void
+serveRequest ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p )
 {
     solClient_returnCode_t rc = SOLCLIENT_OK;
     solClient_opaqueMsg_pt replyMsg_p;
     solClient_opaqueContainer_pt stream_p;
     solClient_opaqueContainer_pt replyStream_p;
+    solClient_field_t field;
+    solClient_uint32_t numOps = 0;
     solClient_bool_t resultOk = FALSE;
     solClient_int8_t operation = -1;
     solClient_int32_t operand1 = -1;
@@ -46,11 +55,23 @@ requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClien
         common_handleError ( rc, "solClient_msg_getBinaryAttachmentStream()" );
         goto createReply;
     }
-    /* Get the operation, operand1 and operand2 from the stream. */
-    if ( ( rc = solClient_container_getInt8 ( stream_p, &operation, NULL ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_container_getInt8() for operation" );
+    /*
+     * Get the operation, operand1 and operand2 from the stream. A batched
+     * request starts with its number of operations instead (see RRcommon.h).
+     */
+    if ( ( rc = solClient_container_getField ( stream_p, &field, sizeof ( field ), NULL ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_container_getField() for operation" );
         goto createReply;
     }
+    if ( field.type == SOLCLIENT_UINT32 ) {
+        numOps = field.value.uint32;
+        goto createReply;
+    }
+    if ( field.type != SOLCLIENT_INT8 ) {
+        solClient_log ( SOLCLIENT_LOG_WARNING, "Request starts with a field of type %d", ( int ) field.type );
+        goto createReply;
+    }
+    operation = field.value.int8;
     if ( ( rc = solClient_container_getInt32 ( stream_p, &operand1, NULL ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_container_getInt32() for operand1" );
         goto createReply;
@@ -60,36 +81,20 @@ requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClien
         goto createReply;
     }
     /* Do the requested calculation. */
-    switch ( operation ) {
-        case plusOperation:
-            result = (double)operand1 + (double)operand2;
-            resultOk = TRUE;
-            break;
-        case minusOperation:
-            result = (double)operand1 - (double)operand2;
-            resultOk = TRUE;
-            break;
-        case timesOperation:
-            result = (double)operand1 * (double)operand2;
-            resultOk = TRUE;
-            break;
-        case divideOperation:
-            if (operand2 != 0) {
-                result = (double)operand1 / (double)operand2;
-                resultOk = TRUE;
-            }
-            break;
-        default:
-            break;
-    }
+    resultOk = RR_calculate ( ( RR_operation_t ) operation, operand1, operand2, &result );
 
   createReply:
-    if ( resultOk ) {
-        printf( "  Received request for %d %s %d, sending reply with result %f. \n",
-                operand1, RR_operationToString ( operation ), operand2, result );
-    } else {
-        printf( "  Received request for %d %s %d, sending reply with a failure status.\n",
-                operand1, RR_operationToString ( operation ), operand2  );
+    /* With workers, requests are only counted, as printing each would limit the throughput. */
+    if ( !useWorkers_s ) {
+        if ( numOps > 0 ) {
+            printf( "  Received batched request for %u operations, sending a batched reply.\n", numOps );
+        } else if ( resultOk ) {
+            printf( "  Received request for %d %s %d, sending reply with result %f. \n",
+                    operand1, RR_operationToString ( operation ), operand2, result );
+        } else {
+            printf( "  Received request for %d %s %d, sending reply with a failure status.\n",
+                    operand1, RR_operationToString ( operation ), operand2  );
+        }
     }
     /*
      * Allocate a message to construct the reply, and put in the status and result in a
@@ -97,21 +102,27 @@ requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClien
      */
     if ( ( rc = solClient_msg_alloc ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_msg_alloc()" );
-        return SOLCLIENT_CALLBACK_OK;
-    }
-    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( replyMsg_p, &replyStream_p, 32 ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
-        goto freeMsg;
+        return;
     }
-    if ( ( rc = solClient_container_addBoolean ( replyStream_p, resultOk, NULL ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_container_addBoolean()" );
-        goto freeMsg;
-    }
-    if ( resultOk ) {
-        if ( ( rc = solClient_container_addDouble ( replyStream_p, result, NULL ) ) != SOLCLIENT_OK ) {
-            common_handleError ( rc, "solClient_container_addDouble()" );
+    if ( numOps > 0 ) {
+        if ( RR_batchReply ( stream_p, numOps, replyMsg_p ) != SOLCLIENT_OK ) {
             goto freeMsg;
         }
+    } else {
+        if ( ( rc = solClient_msg_createBinaryAttachmentStream ( replyMsg_p, &replyStream_p, 32 ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+            goto freeMsg;
+        }
+        if ( ( rc = solClient_container_addBoolean ( replyStream_p, resultOk, NULL ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_container_addBoolean()" );
+            goto freeMsg;
+        }
+        if ( resultOk ) {
+            if ( ( rc = solClient_container_addDouble ( replyStream_p, result, NULL ) ) != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_container_addDouble()" );
+                goto freeMsg;
+            }
+        }
     }
     if ( ( rc = solClient_session_sendReply ( opaqueSession_p, msg_p, replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_session_sendReply()" );
@@ -122,6 +133,36 @@ requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClien
     if ( ( rc = solClient_msg_free ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_msg_free()" );
     }
+}
+
+/*****************************************************************************
+ * Worker request handling code
+ *
+ * The replier calls this on a worker thread, which owns the request.
+ *****************************************************************************/
+static void
+workerServeRequest ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p )
+{
+    solClient_returnCode_t rc;
+
+    serveRequest ( ( solClient_opaqueSession_pt ) user_p, msg_p );
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+/*****************************************************************************
+ * Received message handling code
+ *****************************************************************************/
+static          solClient_rxMsgCallback_returnCode_t
+requestMsgReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    if ( useWorkers_s ) {
+        /* The worker replies and frees the request. */
+        common_replierPush ( &replier_s, msg_p, NULL );
+        return SOLCLIENT_CALLBACK_TAKE_MSG;
+    }
+    serveRequest ( opaqueSession_p, msg_p );
     return SOLCLIENT_CALLBACK_OK;
 }
 
@@ -166,7 +207,8 @@ main ( int argc, char *argv[] )
                                 PASS_PARAM_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                WORKERS_MASK));                         /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, NULL ) == 0 ) {
         exit (1);
     }
@@ -303,6 +345,18 @@ main ( int argc, char *argv[] )
          goto cleanup;
     }
 
+    /*************************************************************************
+     * Start the worker threads, if any
+     *************************************************************************/
+    if ( commandOpts.numWorkers > 0 ) {
+        if ( common_replierStart ( &replier_s, commandOpts.numWorkers, commandOpts.workerQueueDepth,
+                                   workerServeRequest, session_p ) != SOLCLIENT_OK ) {
+            goto sessionConnected;
+        }
+        useWorkers_s = TRUE;
+        printf ( "Serving requests on %d worker threads\n", commandOpts.numWorkers );
+    }
+
     /*************************************************************************
      * Subscribe to the request topic
      *************************************************************************/
@@ -326,12 +380,20 @@ main ( int argc, char *argv[] )
      * CLEANUP
      *************************************************************************/
   sessionConnected:
+    /* Requests still arriving are served on the Context thread. */
+    if ( useWorkers_s ) {
+        common_replierStop ( &replier_s );
+        common_replierPrint ( &replier_s );
+    }
+
     /* Disconnect the Session. */
     if ( ( rc = solClient_session_disconnect ( session_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_session_disconnect()" );
     }
 
   cleanup:
+    common_replierDestroy ( &replier_s );
+
     /* Cleanup solClient. */
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );
@@ -13,6 +13,21 @@
  *  | RRDirectRequester |                      | RRDirectReplier  |
  *  |-------------------|  <--ReplyToTopic---- |------------------|
  *
+ * With a window size (-w) the Requester instead sends the number of requests
+ * given by -n asynchronously, keeping up to that many in flight and matching
+ * each reply to its request by correlation ID, and reports the completed
+ * requests per second and the round-trip latency.
+ *
+ * With a batch size (-x) the Requester instead gathers the operations given
+ * by -n into batched requests (see RRcommon.h), sending each batch when it is
+ * full or when its oldest operation has waited out the latency budget, and
+ * reports the completed operations per second. Small requests cost about the
+ * same to send whether they carry one operation or many, so batching raises
+ * the operations per second by about the batch size until the payload
+ * dominates. With --arrival, operations arrive at the Message Rate rather than
+ * all at once, and the round-trip latency is measured from the arrival of the
+ * oldest operation of each batch, so it includes the time spent batching.
+ *
  * Copyright 2013-2018 Solace Corporation. All rights reserved.
  *
  */
@@ -27,6 +42,19 @@
 #include "common.h"
 #include "RRcommon.h"
 
+/* How long to wait for each reply, in milliseconds. */
+#define REQUEST_TIMEOUT_MS 5000
+
+/* The requests in flight when sending asynchronously. */
+static common_requester_t requester_s;
+
+/* Replies with a failed status, counted on the Context thread. */
+static int      numFailedReplies_s = 0;
+
+/* Operations of batched requests, counted on the Context thread. */
+static UINT64   numOpsReplied_s = 0;
+static UINT64   numOpsFailed_s = 0;
+
 
 /********************** Send Blocking  Requests********************************
  * Send a blocking request message for each of the four operation types, and
@@ -88,7 +116,7 @@ sendRequests ( solClient_opaqueSession_pt opaqueSession_p, const char *destinati
         }
         /* Send a blocking request. */
         if ( ( rc = solClient_session_sendRequest ( opaqueSession_p,
-                                                    msg_p, &replyMsg_p, 5000 /* timeout in milliseconds */  ) ) == SOLCLIENT_OK ) {
+                                                    msg_p, &replyMsg_p, REQUEST_TIMEOUT_MS ) ) == SOLCLIENT_OK ) {
 
             /* Get the result status and result (if OK) from the reply message. */
             if ( ( rc = solClient_msg_getBinaryAttachmentStream ( replyMsg_p, &replyStream_p ) ) != SOLCLIENT_OK ) {
@@ -131,6 +159,252 @@ sendRequests ( solClient_opaqueSession_pt opaqueSession_p, const char *destinati
 }
 
 
+/*****************************************************************************
+ * replyReceived
+ *
+ * The requester's function, called on the Context thread when a reply arrives
+ * or a request times out. Timeouts are counted by the requester.
+ *****************************************************************************/
+static void
+replyReceived ( solClient_opaqueMsg_pt replyMsg_p, void *reqUser_p, void *user_p )
+{
+    solClient_opaqueContainer_pt replyStream_p;
+    solClient_bool_t resultOk = FALSE;
+
+    if ( replyMsg_p == NULL ) {
+        return;
+    }
+    if ( ( solClient_msg_getBinaryAttachmentStream ( replyMsg_p, &replyStream_p ) != SOLCLIENT_OK ) ||
+         ( solClient_container_getBoolean ( replyStream_p, &resultOk, NULL ) != SOLCLIENT_OK ) || !resultOk ) {
+        numFailedReplies_s++;
+    }
+}
+
+/*****************************************************************************
+ * requesterRxCallback
+ *
+ * Replies to asynchronous requests are matched to their requests; anything
+ * else is printed.
+ *****************************************************************************/
+static          solClient_rxMsgCallback_returnCode_t
+requesterRxCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    if ( ( user_p != NULL ) && common_requesterReceive ( ( common_requester_pt ) user_p, msg_p ) ) {
+        return SOLCLIENT_CALLBACK_OK;
+    }
+    return common_messageReceivePrintMsgCallback ( opaqueSession_p, msg_p, user_p );
+}
+
+/********************** Send Asynchronous Requests ****************************
+ * Send numRequests requests without waiting for each reply, keeping up to
+ * maxInFlight of them in flight, then wait for the last replies and print the
+ * completed requests per second and the round-trip latency.
+ ******************************************************************************/
+static void
+sendAsyncRequests ( solClient_opaqueContext_pt context_p, solClient_opaqueSession_pt opaqueSession_p,
+                    const char *destinationName, int numRequests, int maxInFlight, const char *histFile_p )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueMsg_pt msg_p;
+    solClient_destination_t destination;
+    solClient_opaqueContainer_pt stream_p;
+    int             loop;
+
+    /*
+     * Every request is the same, so one message is built and sent each time;
+     * only its correlation ID changes.
+     */
+    if ( ( rc = solClient_msg_alloc ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_alloc()" );
+        return;
+    }
+    destination.destType = SOLCLIENT_TOPIC_DESTINATION;
+    destination.dest = destinationName;
+    if ( ( rc = solClient_msg_setDestination ( msg_p, &destination, sizeof ( destination ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setDestination()" );
+        goto freeMsg;
+    }
+    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( msg_p, &stream_p, 100 ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+        goto freeMsg;
+    }
+    if ( ( ( rc = solClient_container_addInt8 ( stream_p, ( solClient_int8_t ) plusOperation, NULL ) ) != SOLCLIENT_OK ) ||
+         ( ( rc = solClient_container_addInt32 ( stream_p, 9, NULL ) ) != SOLCLIENT_OK ) ||
+         ( ( rc = solClient_container_addInt32 ( stream_p, 5, NULL ) ) != SOLCLIENT_OK ) ) {
+        common_handleError ( rc, "solClient_container_add()" );
+        goto freeMsg;
+    }
+
+    if ( common_requesterInit ( &requester_s, context_p, opaqueSession_p, FALSE, maxInFlight, REQUEST_TIMEOUT_MS,
+                                replyReceived, NULL ) != SOLCLIENT_OK ) {
+        goto freeMsg;
+    }
+    printf ( "Sending %d requests for 9 %s 5, up to %d in flight\n", numRequests,
+             RR_operationToString ( plusOperation ), maxInFlight );
+    for ( loop = 0; loop < numRequests; loop++ ) {
+        if ( common_requesterSend ( &requester_s, msg_p, NULL ) != SOLCLIENT_OK ) {
+            break;
+        }
+    }
+    common_requesterDrain ( &requester_s );
+
+    common_requesterPrint ( &requester_s );
+    if ( numFailedReplies_s != 0 ) {
+        printf ( "%d replies had a failed status\n", numFailedReplies_s );
+    }
+    if ( ( histFile_p[0] != ( char ) 0 ) && common_histogramDump ( &requester_s.latency, histFile_p ) ) {
+        printf ( "Round-trip latency histogram written to '%s'\n", histFile_p );
+    }
+
+  freeMsg:
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+
+/*****************************************************************************
+ * batchReplyReceived
+ *
+ * The requester's function for batched requests: count the operations of
+ * each batched reply, and those that failed.
+ *****************************************************************************/
+static void
+batchReplyReceived ( solClient_opaqueMsg_pt replyMsg_p, void *reqUser_p, void *user_p )
+{
+    solClient_opaqueContainer_pt replyStream_p;
+    solClient_uint32_t numOps;
+    solClient_uint32_t loop;
+    solClient_bool_t resultOk;
+    double          result;
+
+    if ( replyMsg_p == NULL ) {
+        return;
+    }
+    if ( ( solClient_msg_getBinaryAttachmentStream ( replyMsg_p, &replyStream_p ) != SOLCLIENT_OK ) ||
+         ( solClient_container_getUint32 ( replyStream_p, &numOps, NULL ) != SOLCLIENT_OK ) ) {
+        numFailedReplies_s++;
+        return;
+    }
+    for ( loop = 0; loop < numOps; loop++ ) {
+        if ( ( solClient_container_getBoolean ( replyStream_p, &resultOk, NULL ) != SOLCLIENT_OK ) ||
+             ( solClient_container_getDouble ( replyStream_p, &result, NULL ) != SOLCLIENT_OK ) ) {
+            numFailedReplies_s++;
+            break;
+        }
+        numOpsReplied_s++;
+        if ( !resultOk ) {
+            numOpsFailed_s++;
+        }
+    }
+}
+
+/*****************************************************************************
+ * sendBatch
+ *
+ * Send the operations gathered so far as one batched request, with its
+ * round-trip latency measured from the arrival of its oldest operation.
+ *****************************************************************************/
+static          solClient_returnCode_t
+sendBatch ( RR_batcher_pt batcher_p, solClient_opaqueMsg_pt msg_p, solClient_destination_t * destination_p )
+{
+    solClient_returnCode_t rc;
+    UINT64          firstNs;
+
+    /* Reset the request, so the next batch is written into an empty binary attachment. */
+    if ( ( rc = solClient_msg_reset ( msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_reset()" );
+        return rc;
+    }
+    if ( ( rc = solClient_msg_setDestination ( msg_p, destination_p, sizeof ( *destination_p ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setDestination()" );
+        return rc;
+    }
+    if ( ( rc = RR_batcherEncode ( batcher_p, msg_p, &firstNs ) ) != SOLCLIENT_OK ) {
+        return rc;
+    }
+    return common_requesterSendAt ( &requester_s, msg_p, NULL, firstNs );
+}
+
+/********************** Send Batched Requests *********************************
+ * Send numOps operations in batched requests of up to maxOps, keeping up to
+ * maxInFlight requests in flight, then wait for the last replies and print
+ * the completed requests and operations per second and the round-trip latency.
+ ******************************************************************************/
+static void
+sendBatchedRequests ( solClient_opaqueContext_pt context_p, solClient_opaqueSession_pt opaqueSession_p,
+                      const char *destinationName, int numOps, int maxInFlight, struct commonOptions *commandOpts_p )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueMsg_pt msg_p;
+    solClient_destination_t destination;
+    RR_batcher_t    batcher;
+    common_schedule_t schedule;
+    BOOL            paced = ( commandOpts_p->arrivalMode != COMMON_ARRIVAL_CLOSED );
+    UINT64          arrivalNs;
+    UINT64          elapsedNs;
+    int             loop;
+
+    if ( ( rc = solClient_msg_alloc ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_alloc()" );
+        return;
+    }
+    destination.destType = SOLCLIENT_TOPIC_DESTINATION;
+    destination.dest = destinationName;
+
+    if ( common_requesterInit ( &requester_s, context_p, opaqueSession_p, FALSE, maxInFlight, REQUEST_TIMEOUT_MS,
+                                batchReplyReceived, NULL ) != SOLCLIENT_OK ) {
+        goto freeMsg;
+    }
+    RR_batcherInit ( &batcher, commandOpts_p->rrBatchOps, commandOpts_p->rrBatchUs );
+    if ( paced ) {
+        common_scheduleInit ( &schedule, ( unsigned int ) commandOpts_p->msgRate, commandOpts_p->arrivalMode, 1,
+                              commandOpts_p->spinBudgetUs );
+    }
+    printf ( "Sending %d operations in batches of up to %d within %d us, up to %d requests in flight\n",
+             numOps, batcher.maxOps, commandOpts_p->rrBatchUs, maxInFlight );
+    for ( loop = 0; loop < numOps; loop++ ) {
+        if ( paced ) {
+            /* Send a partial batch rather than hold its oldest operation past the budget. */
+            if ( RR_batcherDue ( &batcher, schedule.nextTimeNs ) &&
+                 ( sendBatch ( &batcher, msg_p, &destination ) != SOLCLIENT_OK ) ) {
+                break;
+            }
+            arrivalNs = common_scheduleWait ( &schedule );
+        } else {
+            arrivalNs = getTimeInNs (  );
+        }
+        if ( RR_batcherAdd ( &batcher, ( RR_operation_t ) ( firstOperation + loop % lastOperation ), loop, 5, arrivalNs ) &&
+             ( sendBatch ( &batcher, msg_p, &destination ) != SOLCLIENT_OK ) ) {
+            break;
+        }
+    }
+    if ( batcher.numOps > 0 ) {
+        sendBatch ( &batcher, msg_p, &destination );
+    }
+    common_requesterDrain ( &requester_s );
+
+    common_requesterPrint ( &requester_s );
+    elapsedNs = requester_s.lastReplyNs - requester_s.firstSendNs;
+    printf ( "Operations: %llu replied, %llu failed\n", ( unsigned long long ) numOpsReplied_s,
+             ( unsigned long long ) numOpsFailed_s );
+    if ( ( numOpsReplied_s > 0 ) && ( elapsedNs > 0 ) ) {
+        printf ( "Completed %.0f operations/sec\n", ( double ) numOpsReplied_s * 1e9 / ( double ) elapsedNs );
+    }
+    if ( numFailedReplies_s != 0 ) {
+        printf ( "%d replies could not be read\n", numFailedReplies_s );
+    }
+    if ( ( commandOpts_p->histFile[0] != ( char ) 0 ) && common_histogramDump ( &requester_s.latency, commandOpts_p->histFile ) ) {
+        printf ( "Round-trip latency histogram written to '%s'\n", commandOpts_p->histFile );
+    }
+
+  freeMsg:
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+
 /*
  * fn main() 
  * param appliance_ip The message backbone IP address.
@@ -168,10 +442,23 @@ main ( int argc, char *argv[] )
                                 PASS_PARAM_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                NUM_MSGS_MASK |
+                                WINDOW_SIZE_MASK |
+                                HIST_FILE_MASK |
+                                MSG_RATE_MASK |
+                                ARRIVAL_MASK |
+                                SPIN_BUDGET_MASK |
+                                RR_BATCH_MASK));                        /* optional parameters */
+    /* No default rate, so an open-loop run without --mr is caught below. */
+    commandOpts.msgRate = 0;
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, NULL ) == 0 ) {
         exit (1);
     }
+    if ( ( commandOpts.arrivalMode != COMMON_ARRIVAL_CLOSED ) && ( commandOpts.msgRate <= 0 ) ) {
+        printf ( "Error: an open-loop run needs a Message Rate\n" );
+        exit (1);
+    }
 
 
     /*************************************************************************
@@ -213,8 +500,12 @@ main ( int argc, char *argv[] )
      *************************************************************************/
     solClient_log ( SOLCLIENT_LOG_INFO, "Creating solClient sessions." );
 
-    sessionFuncInfo.rxMsgInfo.callback_p = common_messageReceivePrintMsgCallback;
-    sessionFuncInfo.rxMsgInfo.user_p = NULL;
+    /*
+     * With a window size (-w) requests are sent asynchronously, up to that many
+     * in flight, and their replies arrive in the receive callback.
+     */
+    sessionFuncInfo.rxMsgInfo.callback_p = requesterRxCallback;
+    sessionFuncInfo.rxMsgInfo.user_p = ( ( commandOpts.gdWindow > 0 ) || ( commandOpts.rrBatchOps > 0 ) ) ? &requester_s : NULL;
     sessionFuncInfo.eventInfo.callback_p = common_eventCallback;
     sessionFuncInfo.eventInfo.user_p = NULL;;
 
@@ -308,7 +599,15 @@ main ( int argc, char *argv[] )
 
 
     /* Send the requests and wait for the responses. */
-    sendRequests ( session_p,  commandOpts.destinationName);
+    if ( commandOpts.rrBatchOps > 0 ) {
+        sendBatchedRequests ( context_p, session_p, commandOpts.destinationName, commandOpts.numMsgsToSend,
+                              ( commandOpts.gdWindow > 0 ) ? commandOpts.gdWindow : 1, &commandOpts );
+    } else if ( commandOpts.gdWindow > 0 ) {
+        sendAsyncRequests ( context_p, session_p, commandOpts.destinationName, commandOpts.numMsgsToSend,
+                            commandOpts.gdWindow, commandOpts.histFile );
+    } else {
+        sendRequests ( session_p,  commandOpts.destinationName);
+    }
 
     /*************************************************************************
      * CLEANUP
@@ -323,6 +622,8 @@ main ( int argc, char *argv[] )
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );
     }
+    /* The Context is gone, so no reply or timer callback can reach the requester. */
+    common_requesterDestroy ( &requester_s );
     goto notInitialized;
 
   notInitialized:
@@ -28,31 +28,37 @@
 #include "common.h"
 #include "RRcommon.h"
 
+/* The worker threads serving requests, when there are any (-j). */
+static common_replier_t replier_s;
+static BOOL     useWorkers_s = FALSE;
+
 
 /*
- * Received request message handling code
+ * Request handling code: compute the result of a request and send the reply.
+ * This runs on the Context thread, or on a worker thread when there are workers.
  */
-static          solClient_rxMsgCallback_returnCode_t
-flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+static void
+serveRequest ( solClient_opaqueSession_pt session_p, solClient_opaqueMsg_pt msg_p )
 {
     solClient_returnCode_t  rc;
     solClient_destination_t replyTo;
     solClient_opaqueMsg_pt  replyMsg_p = NULL;
+    const char             *correlationId_p;
     solClient_opaqueContainer_pt stream_p;
     solClient_opaqueContainer_pt replyStream_p;
+    solClient_field_t field;
+    solClient_uint32_t numOps = 0;
     solClient_bool_t resultOk = FALSE;
-    solClient_int8_t operation;
-    solClient_int32_t operand1;
-    solClient_int32_t operand2;
+    solClient_int8_t operation = -1;
+    solClient_int32_t operand1 = -1;
+    solClient_int32_t operand2 = -1;
     double result;
 
-    solClient_opaqueSession_pt  session_p = (solClient_opaqueSession_pt)user_p;
-
     /* Get reply queue address. */
     rc = solClient_msg_getReplyTo(  msg_p, &replyTo, sizeof(replyTo));
     if ( rc != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_msg_getReplyTo()");
-        return SOLCLIENT_CALLBACK_OK;
+        return;
     }
 
     /*
@@ -63,11 +69,23 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
         common_handleError ( rc, "solClient_msg_getBinaryAttachmentStream()" );
         goto createReply;
     }
-    /* Get the operator, operand1 and operand2 from the stream. */
-    if ( ( rc = solClient_container_getInt8 ( stream_p, &operation, NULL ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_container_getInt8() for operation" );
+    /*
+     * Get the operation, operand1 and operand2 from the stream. A batched
+     * request starts with its number of operations instead (see RRcommon.h).
+     */
+    if ( ( rc = solClient_container_getField ( stream_p, &field, sizeof ( field ), NULL ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_container_getField() for operation" );
         goto createReply;
     }
+    if ( field.type == SOLCLIENT_UINT32 ) {
+        numOps = field.value.uint32;
+        goto createReply;
+    }
+    if ( field.type != SOLCLIENT_INT8 ) {
+        solClient_log ( SOLCLIENT_LOG_WARNING, "Request starts with a field of type %d", ( int ) field.type );
+        goto createReply;
+    }
+    operation = field.value.int8;
     if ( ( rc = solClient_container_getInt32 ( stream_p, &operand1, NULL ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_container_getInt32() for operand1" );
         goto createReply;
@@ -78,36 +96,20 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
     }
 
     /* Do the requested calculation. */
-    switch ( operation ) {
-        case plusOperation:
-            result = (double)operand1 + (double)operand2;
-            resultOk = TRUE;
-            break;
-        case minusOperation:
-            result = (double)operand1 - (double)operand2;
-            resultOk = TRUE;
-            break;
-        case timesOperation:
-            result = (double)operand1 * (double)operand2;
-            resultOk = TRUE;
-            break;
-        case divideOperation:
-            if (operand2 != 0) {
-                result = (double)operand1 / (double)operand2;
-                resultOk = TRUE;
-            }
-            break;
-        default:
-            break;
-    }
+    resultOk = RR_calculate ( ( RR_operation_t ) operation, operand1, operand2, &result );
 
   createReply:
-    if ( resultOk ) {
-        printf( "  Received request for %d %s %d, sending reply with result %f. \n",
-                operand1, RR_operationToString ( operation ), operand2, result );
-    } else {
-        printf( "  Received request for %d %s %d, sending reply with a failure status. \n",
-                operand1, RR_operationToString ( operation ), operand2 );
+    /* With workers, requests are only counted, as printing each would limit the throughput. */
+    if ( !useWorkers_s ) {
+        if ( numOps > 0 ) {
+            printf( "  Received batched request for %u operations, sending a batched reply. \n", numOps );
+        } else if ( resultOk ) {
+            printf( "  Received request for %d %s %d, sending reply with result %f. \n",
+                    operand1, RR_operationToString ( operation ), operand2, result );
+        } else {
+            printf( "  Received request for %d %s %d, sending reply with a failure status. \n",
+                    operand1, RR_operationToString ( operation ), operand2 );
+        }
     }
 
     /*
@@ -116,21 +118,27 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
      */
     if ( ( rc = solClient_msg_alloc ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_msg_alloc()" );
-        return SOLCLIENT_CALLBACK_OK;
+        return;
     }
-    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( replyMsg_p, &replyStream_p, 32 ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
-        goto freeMsg;
-    }
-    if ( ( rc = solClient_container_addBoolean ( replyStream_p, resultOk, NULL ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_container_addBoolean()" );
-        goto freeMsg;
-    }
-    if ( resultOk ) {
-        if ( ( rc = solClient_container_addDouble ( replyStream_p, result, NULL ) ) != SOLCLIENT_OK ) {
-            common_handleError ( rc, "solClient_container_addDouble()" );
+    if ( numOps > 0 ) {
+        if ( RR_batchReply ( stream_p, numOps, replyMsg_p ) != SOLCLIENT_OK ) {
             goto freeMsg;
         }
+    } else {
+        if ( ( rc = solClient_msg_createBinaryAttachmentStream ( replyMsg_p, &replyStream_p, 32 ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+            goto freeMsg;
+        }
+        if ( ( rc = solClient_container_addBoolean ( replyStream_p, resultOk, NULL ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_container_addBoolean()" );
+            goto freeMsg;
+        }
+        if ( resultOk ) {
+            if ( ( rc = solClient_container_addDouble ( replyStream_p, result, NULL ) ) != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_container_addDouble()" );
+                goto freeMsg;
+            }
+        }
     }
 
     /* Set the delivery mode for the reply message. */
@@ -145,6 +153,14 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
         goto freeMsg;
     }
 
+    /* Copy the request's correlation ID, so a requester with several requests in flight can match the reply. */
+    if ( solClient_msg_getCorrelationId ( msg_p, &correlationId_p ) == SOLCLIENT_OK ) {
+        if ( ( rc = solClient_msg_setCorrelationId ( replyMsg_p, correlationId_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setCorrelationId()" );
+            goto freeMsg;
+        }
+    }
+
     /* Send the reply message. */ 
     if ( ( rc = solClient_session_sendMsg ( session_p, replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_session_send" );
@@ -155,6 +171,44 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
     if ( ( rc = solClient_msg_free ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_msg_free()" );
     }
+}
+
+
+/*
+ * Worker request handling code. The replier calls this on a worker thread,
+ * which owns the request. The Flow uses client acknowledgement when there are
+ * workers, so a request is only acknowledged once its reply has been sent.
+ */
+static void
+workerServeRequest ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p )
+{
+    solClient_returnCode_t rc;
+    solClient_msgId_t msgId;
+
+    serveRequest ( ( solClient_opaqueSession_pt ) user_p, msg_p );
+    if ( ( rc = solClient_msg_getMsgId ( msg_p, &msgId ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_getMsgId()" );
+    } else if ( ( rc = solClient_flow_sendAck ( opaqueFlow_p, msgId ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_flow_sendAck()" );
+    }
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+
+/*
+ * Received request message handling code
+ */
+static          solClient_rxMsgCallback_returnCode_t
+flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    if ( useWorkers_s ) {
+        /* The worker replies, acknowledges and frees the request. */
+        common_replierPush ( &replier_s, msg_p, opaqueFlow_p );
+        return SOLCLIENT_CALLBACK_TAKE_MSG;
+    }
+    serveRequest ( ( solClient_opaqueSession_pt ) user_p, msg_p );
     return SOLCLIENT_CALLBACK_OK;
 }
 
@@ -209,7 +263,8 @@ main ( int argc, char *argv[] )
                                 PASS_PARAM_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                WORKERS_MASK));                         /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
         exit (1);
     }
@@ -414,6 +469,18 @@ main ( int argc, char *argv[] )
 
     endpointProvisioned = TRUE;
 
+    /*************************************************************************
+     * Start the worker threads, if any
+     *************************************************************************/
+    if ( commandOpts.numWorkers > 0 ) {
+        if ( common_replierStart ( &replier_s, commandOpts.numWorkers, commandOpts.workerQueueDepth,
+                                   workerServeRequest, session_p ) != SOLCLIENT_OK ) {
+            goto sessionConnected;
+        }
+        useWorkers_s = TRUE;
+        printf ( "Serving requests on %d worker threads\n", commandOpts.numWorkers );
+    }
+
     /*************************************************************************
      * Create a Flow
      *************************************************************************/
@@ -442,6 +509,11 @@ main ( int argc, char *argv[] )
     }
     flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_DURABLE;
     flowProps[propIndex++] = SOLCLIENT_PROP_ENABLE_VAL;
+
+    if ( useWorkers_s ) {
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE;
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE_CLIENT;
+    }
     flowProps[propIndex] = NULL;
 
     if ( ( rc = solClient_session_createFlow ( flowProps,
@@ -467,9 +539,16 @@ main ( int argc, char *argv[] )
 
 
     /************* Cleanup *************/
+    /* Serve the queued requests before the Flow they are acknowledged on is destroyed. */
+    if ( useWorkers_s ) {
+        common_replierStop ( &replier_s );
+    }
     if ( ( rc = solClient_flow_destroy ( &flow_p ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_flow_destroy()" );
     }
+    if ( useWorkers_s ) {
+        common_replierPrint ( &replier_s );
+    }
 
   sessionConnected:
     if (endpointProvisioned) {
@@ -494,6 +573,8 @@ main ( int argc, char *argv[] )
     }
 
   cleanup:
+    common_replierDestroy ( &replier_s );
+
     /* Cleanup solClient. */
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );
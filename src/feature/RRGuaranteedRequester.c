@@ -15,6 +15,12 @@
  *
  * Notes: the RRGuaranteedReplier supports request queue or topic formats, but not both at the same time.
  *
+ * With a window size (-w) the Requester instead pipelines its requests: for
+ * each window of 1, 2, 4, ... up to the window size, it sends the number of
+ * requests given by -n, keeping up to that many in flight and matching each
+ * reply to its request by correlation ID, and prints the request throughput
+ * and round-trip latency for each window, to show where throughput saturates.
+ *
  * Copyright 2013-2018 Solace Corporation. All rights reserved.
  */
 
@@ -34,6 +40,15 @@ typedef struct requestMessageInfo
     BOOL                           replyReceived;
 } requestMessageInfo_t, *requestMessageInfo_pt; 
 
+/* How long to wait for each reply of a pipelined request, in milliseconds. */
+#define REQUEST_TIMEOUT_MS 10000
+
+/* The requests in flight when pipelining. */
+static common_requester_t requester_s;
+
+/* Pipelined replies with a failed status, counted on the Context thread. */
+static int      numFailedReplies_s = 0;
+
 
 /*
  * Received reply message handling code
@@ -79,6 +94,124 @@ flowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_
 }
 
 
+/*
+ * The requester's function, called on the Context thread when a pipelined
+ * reply arrives or a request times out. Timeouts are counted by the requester.
+ */
+static void
+pipelinedReplyReceived ( solClient_opaqueMsg_pt replyMsg_p, void *reqUser_p, void *user_p )
+{
+    solClient_opaqueContainer_pt stream_p;
+    solClient_bool_t resultOk = FALSE;
+
+    if ( replyMsg_p == NULL ) {
+        return;
+    }
+    if ( ( solClient_msg_getBinaryAttachmentStream ( replyMsg_p, &stream_p ) != SOLCLIENT_OK ) ||
+         ( solClient_container_getBoolean ( stream_p, &resultOk, NULL ) != SOLCLIENT_OK ) || !resultOk ) {
+        numFailedReplies_s++;
+    }
+}
+
+/*
+ * Received pipelined reply message handling code
+ */
+static solClient_rxMsgCallback_returnCode_t
+pipelinedFlowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    common_requesterReceive ( ( common_requester_pt ) user_p, msg_p );
+    return SOLCLIENT_CALLBACK_OK;
+}
+
+/*
+ * Send pipelined requests with each window size from 1, doubling up to
+ * maxWindow, and print the throughput and latency measured with each.
+ */
+static void
+sendPipelinedRequests ( solClient_opaqueContext_pt context_p, solClient_opaqueSession_pt session_p,
+                        solClient_opaqueFlow_pt flow_p, solClient_destination_t *destination_p,
+                        int numRequests, int maxWindow )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueMsg_pt msg_p = NULL;
+    solClient_destination_t replyToAddr;
+    solClient_opaqueContainer_pt stream_p;
+    common_histogram_pt hist_p = &requester_s.latency;
+    int             window;
+    int             loop;
+
+    /*
+     * Every request is the same, so one message is built and sent each time;
+     * only its correlation ID changes.
+     */
+    if ( ( rc = solClient_msg_alloc ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_alloc()" );
+        return;
+    }
+    if ( ( rc = solClient_msg_setDeliveryMode ( msg_p, SOLCLIENT_DELIVERY_MODE_PERSISTENT ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setDeliveryMode()" );
+        goto freeMsg;
+    }
+    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( msg_p, &stream_p, 100 ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+        goto freeMsg;
+    }
+    if ( ( ( rc = solClient_container_addInt8 ( stream_p, ( solClient_int8_t ) plusOperation, NULL ) ) != SOLCLIENT_OK ) ||
+         ( ( rc = solClient_container_addInt32 ( stream_p, 9, NULL ) ) != SOLCLIENT_OK ) ||
+         ( ( rc = solClient_container_addInt32 ( stream_p, 5, NULL ) ) != SOLCLIENT_OK ) ) {
+        common_handleError ( rc, "solClient_container_add()" );
+        goto freeMsg;
+    }
+    if ( ( rc = solClient_msg_setDestination ( msg_p, destination_p, sizeof ( *destination_p ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setDestination()" );
+        goto freeMsg;
+    }
+    if ( ( rc = solClient_flow_getDestination ( flow_p, &replyToAddr, sizeof ( replyToAddr ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_flow_getDestination()" );
+        goto freeMsg;
+    }
+    if ( ( rc = solClient_msg_setReplyTo ( msg_p, &replyToAddr, sizeof ( replyToAddr ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setReplyTo()" );
+        goto freeMsg;
+    }
+
+    if ( common_requesterInit ( &requester_s, context_p, session_p, TRUE, maxWindow, REQUEST_TIMEOUT_MS,
+                                pipelinedReplyReceived, NULL ) != SOLCLIENT_OK ) {
+        goto freeMsg;
+    }
+    printf ( "Sending %d requests for 9 %s 5 with each window size\n", numRequests, RR_operationToString ( plusOperation ) );
+    printf ( "%8s %12s %10s %10s %10s %10s %9s\n", "Window", "Requests/s", "p50 us", "p99 us", "p99.9 us", "max us",
+             "Timeouts" );
+    for ( window = 1; !gotCtlC; window = ( window * 2 < maxWindow ) ? window * 2 : maxWindow ) {
+        common_requesterSetWindow ( &requester_s, window );
+        for ( loop = 0; ( loop < numRequests ) && !gotCtlC; loop++ ) {
+            if ( common_requesterSend ( &requester_s, msg_p, NULL ) != SOLCLIENT_OK ) {
+                break;
+            }
+        }
+        common_requesterDrain ( &requester_s );
+        printf ( "%8d %12.0f %10.1f %10.1f %10.1f %10.1f %9llu\n", window,
+                 ( requester_s.lastReplyNs > requester_s.firstSendNs ) ?
+                 ( double ) requester_s.numReplies * 1e9 / ( double ) ( requester_s.lastReplyNs - requester_s.firstSendNs ) : 0.0,
+                 ( double ) common_histogramValueAtPercentile ( hist_p, 50.0 ) / 1000.0,
+                 ( double ) common_histogramValueAtPercentile ( hist_p, 99.0 ) / 1000.0,
+                 ( double ) common_histogramValueAtPercentile ( hist_p, 99.9 ) / 1000.0,
+                 ( double ) hist_p->maxValue / 1000.0, ( unsigned long long ) requester_s.numTimedOut );
+        if ( window == maxWindow ) {
+            break;
+        }
+    }
+    if ( numFailedReplies_s != 0 ) {
+        printf ( "%d replies had a failed status\n", numFailedReplies_s );
+    }
+
+  freeMsg:
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+
 /*
  * fn main() 
  * param appliance ip address
@@ -135,7 +268,9 @@ main ( int argc, char *argv[] )
                                 PASS_PARAM_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                NUM_MSGS_MASK |
+                                WINDOW_SIZE_MASK));                     /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
         exit (1);
     }
@@ -294,8 +429,13 @@ main ( int argc, char *argv[] )
     /*************************************************************************
      * Create a Flow and a temporary reply Queue
      *************************************************************************/
-    flowFuncInfo.rxMsgInfo.callback_p = flowMsgCallbackFunc;
-    flowFuncInfo.rxMsgInfo.user_p = &requestInfo;
+    if ( commandOpts.gdWindow > 0 ) {
+        flowFuncInfo.rxMsgInfo.callback_p = pipelinedFlowMsgCallbackFunc;
+        flowFuncInfo.rxMsgInfo.user_p = &requester_s;
+    } else {
+        flowFuncInfo.rxMsgInfo.callback_p = flowMsgCallbackFunc;
+        flowFuncInfo.rxMsgInfo.user_p = &requestInfo;
+    }
     flowFuncInfo.eventInfo.callback_p = common_flowEventCallback;
 
     propIndex = 0;
@@ -327,6 +467,20 @@ main ( int argc, char *argv[] )
         printf ( "Send request messages to topic '%s', Ctrl-C to stop.....\n", commandOpts.destinationName );
     }
 
+    if ( commandOpts.gdWindow > 0 ) {
+        if (commandOpts.destinationName[0] == '\0') {
+            destination.destType = SOLCLIENT_QUEUE_DESTINATION;
+            destination.dest = requestQueue_a;
+        }
+        else {
+            destination.destType = SOLCLIENT_TOPIC_DESTINATION;
+            destination.dest = commandOpts.destinationName;
+        }
+        sendPipelinedRequests ( context_p, session_p, flow_p, &destination, commandOpts.numMsgsToSend,
+                                commandOpts.gdWindow );
+        goto cleanupFlow;
+    }
+
     /* Allocate a message. */
     if ( ( rc = solClient_msg_alloc ( &msg_p ) ) != SOLCLIENT_OK ) {
       common_handleError ( rc, "solClient_msg_alloc()" );
@@ -460,6 +614,8 @@ main ( int argc, char *argv[] )
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );
     }
+    /* The Context is gone, so no reply or timer callback can reach the requester. */
+    common_requesterDestroy ( &requester_s );
     goto notInitialized;
 
   notInitialized:
@@ -33,4 +33,113 @@ typedef enum RR_operation
 
 const char *RR_operationToString ( RR_operation_t operation );
 
+/**
+ * Calculate the result of an operation.
+ * @param operation The operation.
+ * @param operand1 The first operand.
+ * @param operand2 The second operand.
+ * @param result_p Returns the result.
+ * @return TRUE, or FALSE if the operation is not known or divides by zero.
+ */
+BOOL RR_calculate ( RR_operation_t operation, solClient_int32_t operand1, solClient_int32_t operand2,
+                    double *result_p );
+
+
+/*
+ * Batched requests
+ *
+ * A request normally carries one operation, as a stream of its operation
+ * (int8), operand1 (int32) and operand2 (int32), and its reply a stream of the
+ * status (boolean) and, if the status is TRUE, the result (double).
+ *
+ * A batched request carries many operations: a stream of the number of
+ * operations (uint32) followed by the operation, operand1 and operand2 of each.
+ * Its reply is a stream of the number of operations (uint32) followed by the
+ * status and result of each, in the same order; the result of a failed
+ * operation is 0, so every operation has both fields. A replier tells the two
+ * apart by the type of the first field.
+ */
+
+/** The most operations in one batched request. */
+#define RR_BATCH_MAX_OPS           1024
+
+/** How long an operation waits for its batch to fill by default, in microseconds. */
+#define RR_BATCH_DEFAULT_BUDGET_US 1000
+
+/**
+ * One operation of a batched request.
+ */
+typedef struct RR_op
+{
+    solClient_int8_t  operation;
+    solClient_int32_t operand1;
+    solClient_int32_t operand2;
+} RR_op_t;
+
+/**
+ * A batch of operations being gathered by a requester. A batch is sent when it
+ * is full, or when its oldest operation would otherwise wait longer than the
+ * latency budget for it to fill. It is not thread safe.
+ */
+typedef struct RR_batcher
+{
+    RR_op_t         ops[RR_BATCH_MAX_OPS];  /**< the operations gathered */
+    int             numOps;                 /**< operations gathered */
+    int             maxOps;                 /**< operations in a full batch */
+    UINT64          budgetNs;               /**< the longest an operation waits for its batch to fill */
+    UINT64          firstNs;                /**< getTimeInNs() when the oldest operation was added */
+} RR_batcher_t, *RR_batcher_pt;
+
+/**
+ * Initialize an empty batch.
+ * @param batcher_p A pointer to the batch.
+ * @param maxOps The operations in a full batch, 1 to RR_BATCH_MAX_OPS.
+ * @param budgetUs The longest an operation waits for its batch to fill, in microseconds.
+ */
+void RR_batcherInit ( RR_batcher_pt batcher_p, int maxOps, int budgetUs );
+
+/**
+ * Add an operation to the batch.
+ * @param batcher_p A pointer to the batch.
+ * @param operation The operation.
+ * @param operand1 The first operand.
+ * @param operand2 The second operand.
+ * @param nowNs getTimeInNs() when the operation arrived.
+ * @return TRUE if the batch is now to be sent, because it is full or its
+ *         oldest operation has used up the latency budget.
+ */
+BOOL RR_batcherAdd ( RR_batcher_pt batcher_p, RR_operation_t operation, solClient_int32_t operand1,
+                     solClient_int32_t operand2, UINT64 nowNs );
+
+/**
+ * Whether a partial batch is to be sent rather than held until a time, because
+ * its oldest operation would wait past the latency budget. A requester whose
+ * operations arrive on a schedule checks this before waiting for the next one.
+ * @param batcher_p A pointer to the batch.
+ * @param untilNs getTimeInNs() when the next operation is expected.
+ * @return TRUE if the batch is not empty and is to be sent now.
+ */
+BOOL RR_batcherDue ( RR_batcher_pt batcher_p, UINT64 untilNs );
+
+/**
+ * Write the batch into the binary attachment of a request as a batched
+ * request stream, and empty it.
+ * @param batcher_p A pointer to the batch.
+ * @param msg_p The request, with no binary attachment.
+ * @param firstNs_p Returns getTimeInNs() when the oldest operation was added.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t RR_batcherEncode ( RR_batcher_pt batcher_p, solClient_opaqueMsg_pt msg_p, UINT64 * firstNs_p );
+
+/**
+ * Calculate the operations of a batched request and write the batched reply
+ * into the binary attachment of the reply.
+ * @param stream_p The request stream, read up to the number of operations.
+ * @param numOps The number of operations the request carries.
+ * @param replyMsg_p The reply, with no binary attachment.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t RR_batchReply ( solClient_opaqueContainer_pt stream_p, solClient_uint32_t numOps,
+                                       solClient_opaqueMsg_pt replyMsg_p );
+
 #endif
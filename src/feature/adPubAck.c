@@ -13,13 +13,18 @@
  * SOLCLIENT_SESSION_EVENT_REJECTED_MSG_ERROR to determine if the 
  * appliance accepted the Guaranteed message.
  *
- * In this specific sample, the publisher maintains a linked list of
- * outstanding messages not yet acknowledged by the appliance. After sending,
- * the publisher checks to see if any of the messages have been 
- * acknowledged, and, if so, it frees the resources.
+ * In this specific sample, the publisher tracks the outstanding messages not
+ * yet acknowledged by the appliance in a common_pubTracker_t, a fixed ring of
+ * correlation slots indexed by the publish sequence number, so nothing is
+ * allocated or searched per message. After sending, the publisher releases
+ * the oldest messages that have been acknowledged, and frees them.
  *
- * In the event callback, the original pointer to the correlation structure
- * is passed in as an argument, and the event callback updates the information 
+ * With '--ack=windowed' the Session uses windowed acknowledgement events: one
+ * event acknowledges its message and every earlier message still pending, and
+ * the tracker marks them all accepted.
+ *
+ * In the event callback, the original pointer to the correlation slot
+ * is passed in as an argument, and the event callback marks the slot
  * to indicate if the message has been acknowledged and whether it was 
  * accepted or rejected.  
  * 
@@ -50,24 +55,33 @@
 #include "solclient/solClientMsg.h"
 #include "common.h"
 
-/**
- * @struct messageCorrelationStruct
- *
- * A structure that is used to handle message acknowledgement.
+/*
+ * The most messages outstanding at once. It covers the default publish window
+ * size of 255.
  */
-typedef struct messageCorrelationStruct
-{
-    struct messageCorrelationStruct *next_p;
-
-    int             msgId;                  /**< The message ID. */
-
-    solClient_opaqueMsg_pt msg_p;           /**< The message pointer. */
-
-    BOOL            isAcked;                /**< A flag indicating if the message has been acknowledged by the appliance (either success or rejection). */
+#define MAX_OUTSTANDING_MSGS (256)
 
-    BOOL            isAccepted;             /**< A flag indicating if the message is accepted or rejected by the appliance when acknowledged.*/
+/* TRUE if the Session uses windowed acknowledgement events. */
+static BOOL     windowedAcks_s = FALSE;
 
-} messageCorrelationStruct_t, *messageCorrelationStruct_pt; /**< A pointer to ::messageCorrelationStruct structure of information. */
+/*
+ * fn slotStateToString()
+ * The name of a COMMON_PUB_SLOT_ state, for printing.
+ */
+static const char *
+slotStateToString ( UINT64 state )
+{
+    switch ( state ) {
+        case COMMON_PUB_SLOT_PENDING:
+            return "Pending";
+        case COMMON_PUB_SLOT_ACCEPTED:
+            return "Accepted";
+        case COMMON_PUB_SLOT_REJECTED:
+            return "Rejected";
+        default:
+            return "Free";
+    }
+}
 
 
 void
@@ -75,7 +89,8 @@ adPubAck_eventCallback ( solClient_opaqueSession_pt opaqueSession_p,
                          solClient_session_eventCallbackInfo_pt eventInfo_p, void *user_p )
 {
     solClient_errorInfo_pt errorInfo_p;
-    messageCorrelationStruct_pt correlationInfo = ( messageCorrelationStruct_pt ) eventInfo_p->correlation_p;
+    common_pubTracker_pt tracker_p = ( common_pubTracker_pt ) user_p;
+    common_pubSlot_pt slot_p = ( common_pubSlot_pt ) eventInfo_p->correlation_p;
 
     switch ( eventInfo_p->sessionEvent ) {
         case SOLCLIENT_SESSION_EVENT_ACKNOWLEDGEMENT:
@@ -85,10 +100,10 @@ adPubAck_eventCallback ( solClient_opaqueSession_pt opaqueSession_p,
                             solClient_session_eventToString ( eventInfo_p->sessionEvent ));
 
 
-            printf ( "adPubAck_eventCallback() correlation info - ID: %i\n", correlationInfo->msgId );
+            printf ( "adPubAck_eventCallback() correlation info - ID: %i%s\n", ( int ) slot_p->seq,
+                     ( windowedAcks_s ) ? " and every earlier pending message" : "" );
 
-            correlationInfo->isAcked = TRUE;
-            correlationInfo->isAccepted = TRUE;
+            common_pubTrackerAck ( tracker_p, slot_p, windowedAcks_s );
             break;
 
         case SOLCLIENT_SESSION_EVENT_REJECTED_MSG_ERROR:
@@ -100,10 +115,9 @@ adPubAck_eventCallback ( solClient_opaqueSession_pt opaqueSession_p,
                      solClient_subCodeToString ( errorInfo_p->subCode ), errorInfo_p->responseCode, errorInfo_p->errorStr );
 
 
-            printf ( "adPubAck_eventCallback() correlation info - ID: %i\n", correlationInfo->msgId );
+            printf ( "adPubAck_eventCallback() correlation info - ID: %i\n", ( int ) slot_p->seq );
 
-            correlationInfo->isAcked = TRUE;
-            correlationInfo->isAccepted = FALSE;
+            common_pubTrackerReject ( tracker_p, slot_p );
             break;
 
         case SOLCLIENT_SESSION_EVENT_UP_NOTICE:
@@ -172,9 +186,8 @@ main ( int argc, char *argv[] )
     solClient_opaqueMsg_pt msg_p = NULL;
     solClient_destination_t destination;
 
-    messageCorrelationStruct_pt msgMemoryItem_p = NULL;
-    messageCorrelationStruct_pt msgMemoryListHead_p = NULL;
-    messageCorrelationStruct_pt msgMemoryListTail_p = NULL;
+    common_pubTracker_t tracker;
+    common_pubSlot_pt slot_p;
 
 
     printf ( "\nadPubAck.c (Copyright 2010-2018 Solace Corporation. All rights reserved.)\n" );
@@ -189,10 +202,18 @@ main ( int argc, char *argv[] )
                                 NUM_MSGS_MASK  |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
+                                ACK_LATENCY_MASK |
                                 ZIP_LEVEL_MASK));                       /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, NULL ) == 0 ) {
         exit(1);
     }
+    /* common_createAndConnectSession() sets the acknowledgement event mode. */
+    windowedAcks_s = ( commandOpts.ackEventMode == COMMON_ACK_EVENT_WINDOWED );
+
+    /* Allocate the correlation slots once, for all messages. */
+    if ( common_pubTrackerInit ( &tracker, MAX_OUTSTANDING_MSGS ) != SOLCLIENT_OK ) {
+        exit(1);
+    }
 
     /*************************************************************************
      * Initialize the API (and setup logging level)
@@ -239,7 +260,7 @@ main ( int argc, char *argv[] )
     if ( ( rc = common_createAndConnectSession ( context_p,
                                                  &session_p,
                                                  common_messageReceivePrintMsgCallback,
-                                                 adPubAck_eventCallback, NULL, &commandOpts ) ) != SOLCLIENT_OK ) {
+                                                 adPubAck_eventCallback, &tracker, &commandOpts ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "common_createAndConnectSession()" );
         goto cleanup;
     }
@@ -281,30 +302,22 @@ main ( int argc, char *argv[] )
          * MSG ACK correlation
          *************************************************************************/
 
-        msgMemoryItem_p = ( messageCorrelationStruct_pt ) malloc ( sizeof ( messageCorrelationStruct_t ) );
-
-        /* Store the message information in message memory array. */
-        msgMemoryItem_p->next_p = NULL;
-        msgMemoryItem_p->msgId = loop;
-        msgMemoryItem_p->msg_p = msg_p;
-        msgMemoryItem_p->isAcked = FALSE;
-        msgMemoryItem_p->isAccepted = FALSE;
-
-        if ( msgMemoryListTail_p != NULL ) {
-            msgMemoryListTail_p->next_p = msgMemoryItem_p;
-        }
-
-        if ( msgMemoryListHead_p == NULL ) {
-            msgMemoryListHead_p = msgMemoryItem_p;
+        /*
+         * Track the message in the next correlation slot; its ID is the
+         * slot's sequence number. The tracker holds more messages than the
+         * publish window, so it is never full while the send blocks.
+         */
+        if ( ( slot_p = common_pubTrackerTrack ( &tracker, msg_p, NULL ) ) == NULL ) {
+            printf ( "Too many messages outstanding\n" );
+            solClient_msg_free ( &msg_p );
+            goto sessionConnected;
         }
 
-        msgMemoryListTail_p = msgMemoryItem_p;
-
         /*
          * For correlation to take effect, it must be set on the message prior to 
          * calling send. Note: the size parameter is ignored in the API.
          */
-        if ( ( rc = solClient_msg_setCorrelationTagPtr ( msg_p, msgMemoryItem_p, sizeof ( *msgMemoryItem_p ) ) ) != SOLCLIENT_OK ) {
+        if ( ( rc = solClient_msg_setCorrelationTagPtr ( msg_p, slot_p, sizeof ( *slot_p ) ) ) != SOLCLIENT_OK ) {
             common_handleError ( rc, "solClient_msg_setCorrelationTag()" );
             goto sessionConnected;
         }
@@ -324,18 +337,10 @@ main ( int argc, char *argv[] )
         /*************************************************************************
          * MSG cleanup by processing ACKs
          *************************************************************************/
-        while ( ( msgMemoryListHead_p != NULL ) && msgMemoryListHead_p->isAcked ) {
-            printf ( "Freeing memory for message %i, Result: Acked (%i), Accepted (%i)\n",
-                     msgMemoryListHead_p->msgId, msgMemoryListHead_p->isAcked, msgMemoryListHead_p->isAccepted );
-            msgMemoryItem_p = msgMemoryListHead_p;
-
-            if ( ( msgMemoryListHead_p = msgMemoryListHead_p->next_p ) == NULL ) {
-                /* list is now empty */
-                msgMemoryListTail_p = NULL;
-            }
-
-            solClient_msg_free ( &( msgMemoryItem_p->msg_p ) );
-            free ( msgMemoryItem_p );
+        while ( ( slot_p = common_pubTrackerRelease ( &tracker, FALSE ) ) != NULL ) {
+            printf ( "Freeing memory for message %i, Result: %s\n",
+                     ( int ) slot_p->seq, slotStateToString ( atomicLoadAcquire ( &slot_p->state ) ) );
+            solClient_msg_free ( &slot_p->msg_p );
         }
     }
 
@@ -357,18 +362,10 @@ main ( int argc, char *argv[] )
 
   cleanup:
     /* Cleanup any messages that are still left. */
-    while ( msgMemoryListHead_p != NULL ) {
-        printf ( "Freeing memory for message %i, Result: Acked (%i), Accepted (%i)\n",
-                 msgMemoryListHead_p->msgId, msgMemoryListHead_p->isAcked, msgMemoryListHead_p->isAccepted );
-        msgMemoryItem_p = msgMemoryListHead_p;
-
-        if ( ( msgMemoryListHead_p = msgMemoryListHead_p->next_p ) == NULL ) {
-            /* list is now empty */
-            msgMemoryListTail_p = NULL;
-        }
-
-        solClient_msg_free ( &( msgMemoryItem_p->msg_p ) );
-        free ( msgMemoryItem_p );
+    while ( ( slot_p = common_pubTrackerRelease ( &tracker, TRUE ) ) != NULL ) {
+        printf ( "Freeing memory for message %i, Result: %s\n",
+                 ( int ) slot_p->seq, slotStateToString ( atomicLoadAcquire ( &slot_p->state ) ) );
+        solClient_msg_free ( &slot_p->msg_p );
     }
 
     /* Cleanup solClient. */
@@ -378,7 +375,7 @@ main ( int argc, char *argv[] )
     goto notInitialized;
 
   notInitialized:
-    /* Nothing to do - just exit. */
+    common_pubTrackerDestroy ( &tracker );
 
     return 0;
 }                               //End main()
@@ -87,8 +87,8 @@ common_parseUsernameAndVpn ( const char *inName, char *outUsername, size_t usern
  *****************************************************************************/
 void
 common_initCommandOptions ( struct commonOptions *commonOpt, 
-                            int requiredParams,
-                            int optionals)
+                            unsigned int requiredParams,
+                            unsigned int optionals)
 {
     if (commonOpt != NULL) {
         commonOpt->username[0] = ( char ) 0;
@@ -97,12 +97,40 @@ common_initCommandOptions ( struct commonOptions *commonOpt,
         commonOpt->targetHost[0] = ( char ) 0;
         commonOpt->cacheName[0] = ( char ) 0;
         commonOpt->replayStartLocation[0] = ( char ) 0;
+        commonOpt->histFile[0] = ( char ) 0;
         commonOpt->usingTopic = TRUE;       /* TRUE pub/sub to/from Topic */
         commonOpt->usingAD = FALSE; /* FALSE pub/sub direct */
         commonOpt->destinationName[0] = ( char ) 0;
         commonOpt->numMsgsToSend = 1;
         commonOpt->msgRate = 1;
         commonOpt->gdWindow = 0;
+        commonOpt->numContexts = 1;
+        commonOpt->numSessions = 1;
+        commonOpt->arrivalMode = COMMON_ARRIVAL_CLOSED;
+        commonOpt->spinBudgetUs = 50;
+        commonOpt->useTsc = FALSE;
+        commonOpt->sampleIntervalMs = 0;
+        commonOpt->sampleFile[0] = ( char ) 0;
+        commonOpt->sweepSpec[0] = ( char ) 0;
+        commonOpt->sweepFile[0] = ( char ) 0;
+        commonOpt->payloadType = COMMON_PAYLOAD_ZERO;
+        commonOpt->payloadFile[0] = ( char ) 0;
+        commonOpt->ringSize = 64;
+        commonOpt->nonBlocking = FALSE;
+        commonOpt->ackEventMode = COMMON_ACK_EVENT_OFF;
+        commonOpt->autotuneSpec[0] = ( char ) 0;
+        commonOpt->shardSpec[0] = ( char ) 0;
+        commonOpt->durationSec = 0;
+        commonOpt->warmupSec = 0;
+        commonOpt->cooldownSec = 0;
+        commonOpt->ackBatchMsgs = 1;
+        commonOpt->ackBatchUs = 0;
+        commonOpt->numWorkers = 0;
+        commonOpt->workerQueueDepth = 0;        /* not given; common_replierStart() uses its default */
+        commonOpt->flowSpec[0] = ( char ) 0;
+        commonOpt->latencySource = COMMON_LATENCY_OFF;
+        commonOpt->rrBatchOps = 0;
+        commonOpt->rrBatchUs = RR_BATCH_DEFAULT_BUDGET_US;
         commonOpt->logLevel = SOLCLIENT_LOG_DEFAULT_FILTER;
         commonOpt->usingDurable = FALSE;
         commonOpt->enableCompression = FALSE;
@@ -118,7 +146,7 @@ common_initCommandOptions ( struct commonOptions *commonOpt,
 int
 common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *commonOpt, const char *positionalDesc )
 {
-    static char    *optstring = "a:c:dgl:m:n:p:r:s:t:u:w:zR:";
+    static char    *optstring = "a:b:c:de:gi:j:k:l:m:n:o:p:r:s:t:u:w:x:y:zA:B:C:D:E:F:H:K:L:NO:P:R:S:TU:W:";
     static struct option longopts[] = {
         {"cache", 1, NULL, 'a'},
         {"cip", 1, NULL, 'c'},
@@ -133,6 +161,30 @@ common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *co
         {"win", 1, NULL, 'w'},
         {"zip", 0, NULL, 'z'},
         {"replay", 1, NULL, 'R'},
+        {"hist", 1, NULL, 'H'},
+        {"contexts", 1, NULL, 'C'},
+        {"sessions", 1, NULL, 'S'},
+        {"arrival", 1, NULL, 'A'},
+        {"spin", 1, NULL, 'B'},
+        {"tsc", 0, NULL, 'T'},
+        {"sample", 1, NULL, 'i'},
+        {"sample-file", 1, NULL, 'F'},
+        {"sweep", 1, NULL, 'W'},
+        {"sweep-file", 1, NULL, 'O'},
+        {"payload", 1, NULL, 'P'},
+        {"ring", 1, NULL, 'k'},
+        {"nonblock", 0, NULL, 'N'},
+        {"ack", 1, NULL, 'K'},
+        {"autotune", 1, NULL, 'U'},
+        {"shards", 1, NULL, 'E'},
+        {"duration", 1, NULL, 'D'},
+        {"warmup", 1, NULL, 'e'},
+        {"cooldown", 1, NULL, 'o'},
+        {"ack-batch", 1, NULL, 'b'},
+        {"workers", 1, NULL, 'j'},
+        {"flows", 1, NULL, 'L'},
+        {"latency", 1, NULL, 'y'},
+        {"batch", 1, NULL, 'x'},
         {0, 0, 0, 0}
     };
     int             c;
@@ -159,9 +211,121 @@ common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *co
             case 'z':
                 commonOpt->enableCompression = TRUE;
                 break;
+            case 'T':
+                commonOpt->useTsc = TRUE;
+                break;
+            case 'N':
+                commonOpt->nonBlocking = TRUE;
+                break;
+            case 'U':
+                strncpy ( commonOpt->autotuneSpec, optarg, sizeof ( commonOpt->autotuneSpec ) );
+                commonOpt->autotuneSpec[sizeof ( commonOpt->autotuneSpec ) - 1] = ( char ) 0;
+                break;
+            case 'D':
+                commonOpt->durationSec = atoi ( optarg );
+                if ( commonOpt->durationSec <= 0 )
+                    rc = 0;
+                break;
+            case 'e':
+                commonOpt->warmupSec = atoi ( optarg );
+                if ( commonOpt->warmupSec < 0 )
+                    rc = 0;
+                break;
+            case 'o':
+                commonOpt->cooldownSec = atoi ( optarg );
+                if ( commonOpt->cooldownSec < 0 )
+                    rc = 0;
+                break;
+            case 'b':
+                commonOpt->ackBatchMsgs = ( int ) strtol ( optarg, &end_p, 10 );
+                if ( *end_p == ',' ) {
+                    commonOpt->ackBatchUs = ( int ) strtol ( end_p + 1, &end_p, 10 );
+                }
+                if ( ( *end_p != ( char ) 0 ) || ( commonOpt->ackBatchMsgs < 1 ) ||
+                     ( commonOpt->ackBatchMsgs > COMMON_ACK_COALESCE_MAX ) || ( commonOpt->ackBatchUs < 0 ) )
+                    rc = 0;
+                break;
+            case 'j':
+                commonOpt->numWorkers = ( int ) strtol ( optarg, &end_p, 10 );
+                if ( *end_p == ',' ) {
+                    commonOpt->workerQueueDepth = ( int ) strtol ( end_p + 1, &end_p, 10 );
+                    if ( commonOpt->workerQueueDepth < 1 )
+                        rc = 0;
+                }
+                if ( ( *end_p != ( char ) 0 ) || ( commonOpt->numWorkers < 0 ) ||
+                     ( commonOpt->numWorkers > COMMON_HANDOFF_MAX_WORKERS ) )
+                    rc = 0;
+                break;
+            case 'x':
+                commonOpt->rrBatchOps = ( int ) strtol ( optarg, &end_p, 10 );
+                if ( *end_p == ',' ) {
+                    commonOpt->rrBatchUs = ( int ) strtol ( end_p + 1, &end_p, 10 );
+                }
+                if ( ( *end_p != ( char ) 0 ) || ( commonOpt->rrBatchOps < 1 ) ||
+                     ( commonOpt->rrBatchOps > RR_BATCH_MAX_OPS ) || ( commonOpt->rrBatchUs < 0 ) )
+                    rc = 0;
+                break;
+            case 'L':
+                strncpy ( commonOpt->flowSpec, optarg, sizeof ( commonOpt->flowSpec ) );
+                commonOpt->flowSpec[sizeof ( commonOpt->flowSpec ) - 1] = ( char ) 0;
+                break;
+            case 'E':
+                strncpy ( commonOpt->shardSpec, optarg, sizeof ( commonOpt->shardSpec ) );
+                commonOpt->shardSpec[sizeof ( commonOpt->shardSpec ) - 1] = ( char ) 0;
+                break;
+            case 'y':
+                if ( strcasecmp ( optarg, "stamp" ) == 0 ) {
+                    commonOpt->latencySource = COMMON_LATENCY_STAMP;
+                } else if ( strcasecmp ( optarg, "sender" ) == 0 ) {
+                    commonOpt->latencySource = COMMON_LATENCY_SENDER;
+                } else {
+                    rc = 0;
+                }
+                break;
+            case 'K':
+                if ( strcasecmp ( optarg, "per-msg" ) == 0 ) {
+                    commonOpt->ackEventMode = COMMON_ACK_EVENT_PER_MSG;
+                } else if ( strcasecmp ( optarg, "windowed" ) == 0 ) {
+                    commonOpt->ackEventMode = COMMON_ACK_EVENT_WINDOWED;
+                } else {
+                    rc = 0;
+                }
+                break;
+            case 'i':
+                commonOpt->sampleIntervalMs = atoi ( optarg );
+                if ( commonOpt->sampleIntervalMs <= 0 )
+                    rc = 0;
+                break;
+            case 'F':
+                strncpy ( commonOpt->sampleFile, optarg, sizeof ( commonOpt->sampleFile ) );
+                commonOpt->sampleFile[sizeof ( commonOpt->sampleFile ) - 1] = ( char ) 0;
+                break;
+            case 'W':
+                strncpy ( commonOpt->sweepSpec, optarg, sizeof ( commonOpt->sweepSpec ) );
+                commonOpt->sweepSpec[sizeof ( commonOpt->sweepSpec ) - 1] = ( char ) 0;
+                break;
+            case 'O':
+                strncpy ( commonOpt->sweepFile, optarg, sizeof ( commonOpt->sweepFile ) );
+                commonOpt->sweepFile[sizeof ( commonOpt->sweepFile ) - 1] = ( char ) 0;
+                break;
+            case 'P':
+                commonOpt->payloadType = common_payloadParseType ( optarg, commonOpt->payloadFile,
+                                                                   sizeof ( commonOpt->payloadFile ) );
+                if ( commonOpt->payloadType < 0 )
+                    rc = 0;
+                break;
+            case 'k':
+                commonOpt->ringSize = atoi ( optarg );
+                if ( commonOpt->ringSize <= 0 )
+                    rc = 0;
+                break;
             case 'R':
                 strncpy ( commonOpt->replayStartLocation, optarg, sizeof ( commonOpt->replayStartLocation ) );
                 break;
+            case 'H':
+                strncpy ( commonOpt->histFile, optarg, sizeof ( commonOpt->histFile ) );
+                commonOpt->histFile[sizeof ( commonOpt->histFile ) - 1] = ( char ) 0;
+                break;
             case 'l':
                 commonOpt->logLevel = ( solClient_log_level_t ) strtol ( optarg, &end_p, 0 );
                 if ( ( commonOpt->logLevel > SOLCLIENT_LOG_DEBUG ) || ( *end_p != ( char ) 0 ) ) {
@@ -209,6 +373,26 @@ common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *co
                 if ( commonOpt->gdWindow <= 0 )
                     rc = 0;
                 break;
+            case 'C':
+                commonOpt->numContexts = atoi ( optarg );
+                if ( commonOpt->numContexts <= 0 )
+                    rc = 0;
+                break;
+            case 'S':
+                commonOpt->numSessions = atoi ( optarg );
+                if ( commonOpt->numSessions <= 0 )
+                    rc = 0;
+                break;
+            case 'A':
+                commonOpt->arrivalMode = common_scheduleParseArrivalMode ( optarg );
+                if ( commonOpt->arrivalMode < 0 )
+                    rc = 0;
+                break;
+            case 'B':
+                commonOpt->spinBudgetUs = atoi ( optarg );
+                if ( commonOpt->spinBudgetUs < 0 )
+                    rc = 0;
+                break;
             default:
                 rc = 0;
                 break;
@@ -247,7 +431,7 @@ common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *co
         }
         printf (
             "Where PARAMETERS are:\n%s%s%s%s%s"
-            "Where OPTIONS are:\n%s%s%s%s%s%s%s%s%s%s%s%s\n",
+            "Where OPTIONS are:\n%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n",
             ( commonOpt->requiredFields & HOST_PARAM_MASK ) ? HOST_PARAM_STRING : "",
             ( commonOpt->requiredFields & USER_PARAM_MASK ) ? USER_PARAM_STRING : "",
             ( commonOpt->requiredFields & DEST_PARAM_MASK ) ? DEST_PARAM_STRING : "",
@@ -265,7 +449,26 @@ common_parseCommandOptions ( int argc, charPtr32 *argv, struct commonOptions *co
             ( commonOpt->optionalFields & LOG_LEVEL_MASK ) ? LOG_LEVEL_STRING : "",
             ( commonOpt->optionalFields & USE_GSS_MASK ) ? USE_GSS_STRING : "",
             ( commonOpt->optionalFields & ZIP_LEVEL_MASK ) ? ZIP_LEVEL_STRING : "",
-            ( commonOpt->optionalFields & REPLAY_START_MASK ) ? REPLAY_START_STRING : ""
+            ( commonOpt->optionalFields & REPLAY_START_MASK ) ? REPLAY_START_STRING : "",
+            ( commonOpt->optionalFields & HIST_FILE_MASK ) ? HIST_FILE_STRING : "",
+            ( commonOpt->optionalFields & NUM_CONTEXTS_MASK ) ? NUM_CONTEXTS_STRING : "",
+            ( commonOpt->optionalFields & NUM_SESSIONS_MASK ) ? NUM_SESSIONS_STRING : "",
+            ( commonOpt->optionalFields & ARRIVAL_MASK ) ? ARRIVAL_STRING : "",
+            ( commonOpt->optionalFields & SPIN_BUDGET_MASK ) ? SPIN_BUDGET_STRING : "",
+            ( commonOpt->optionalFields & USE_TSC_MASK ) ? USE_TSC_STRING : "",
+            ( commonOpt->optionalFields & STATS_SAMPLE_MASK ) ? STATS_SAMPLE_STRING : "",
+            ( commonOpt->optionalFields & SWEEP_MASK ) ? SWEEP_STRING : "",
+            ( commonOpt->optionalFields & PAYLOAD_MASK ) ? PAYLOAD_STRING : "",
+            ( commonOpt->optionalFields & NON_BLOCKING_MASK ) ? NON_BLOCKING_STRING : "",
+            ( commonOpt->optionalFields & ACK_LATENCY_MASK ) ? ACK_LATENCY_STRING : "",
+            ( commonOpt->optionalFields & AUTOTUNE_MASK ) ? AUTOTUNE_STRING : "",
+            ( commonOpt->optionalFields & SHARDS_MASK ) ? SHARDS_STRING : "",
+            ( commonOpt->optionalFields & RUN_CONTROL_MASK ) ? RUN_CONTROL_STRING : "",
+            ( commonOpt->optionalFields & ACK_BATCH_MASK ) ? ACK_BATCH_STRING : "",
+            ( commonOpt->optionalFields & WORKERS_MASK ) ? WORKERS_STRING : "",
+            ( commonOpt->optionalFields & FLOWS_MASK ) ? FLOWS_STRING : "",
+            ( commonOpt->optionalFields & LATENCY_MASK ) ? LATENCY_STRING : "",
+            ( commonOpt->optionalFields & RR_BATCH_MASK ) ? RR_BATCH_STRING : ""
            );
         if (positionalDesc != NULL) {
             printf (
@@ -358,6 +561,11 @@ common_createAndConnectSession ( solClient_opaqueContext_pt context_p,
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_VPN_NAME;
         sessionProps[propIndex++] = commonOpts->vpn;
     }
+
+    if ( commonOpts->ackEventMode == COMMON_ACK_EVENT_WINDOWED ) {
+        sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE;
+        sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_WINDOWED;
+    }
     
     /*
      * The certificate validation property is ignored on non-SSL sessions.
@@ -690,6 +898,55 @@ common_flowMessageReceiveAckCallback ( solClient_opaqueFlow_pt opaqueFlow_p, sol
     return SOLCLIENT_CALLBACK_OK;
 }
 
+/*****************************************************************************
+ * common_flowMessageReceiveCoalescedAckCallback
+ *****************************************************************************/
+solClient_rxMsgCallback_returnCode_t
+common_flowMessageReceiveCoalescedAckCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    solClient_msgId_t msgId;
+
+    if ( solClient_msg_getMsgId ( msg_p, &msgId ) == SOLCLIENT_OK ) {
+        common_ackCoalescerAdd ( ( common_ackCoalescer_pt ) user_p, opaqueFlow_p, msgId );
+    }
+
+    /* 
+     * Returning SOLCLIENT_CALLBACK_OK causes the API to free the memory 
+     * used by the message. This is important to avoid leaks.
+     */
+    return SOLCLIENT_CALLBACK_OK;
+}
+
+/*****************************************************************************
+ * common_flowCoalescedAckEventCallback
+ *****************************************************************************/
+void
+common_flowCoalescedAckEventCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_flow_eventCallbackInfo_pt eventInfo_p, void *user_p )
+{
+    /*
+     * Acknowledge what is held before the Flow changes state; messages whose
+     * acknowledgement fails because the Flow went down are redelivered.
+     */
+    common_ackCoalescerFlush ( ( common_ackCoalescer_pt ) user_p );
+    common_flowEventCallback ( opaqueFlow_p, eventInfo_p, NULL );
+}
+
+/*****************************************************************************
+ * common_flowMessageReceiveHandoffCallback
+ *****************************************************************************/
+solClient_rxMsgCallback_returnCode_t
+common_flowMessageReceiveHandoffCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    common_handoff_pt handoff_p = ( common_handoff_pt ) user_p;
+
+    /* Published to the workers with the message. */
+    handoff_p->flow_p = opaqueFlow_p;
+    common_handoffPush ( handoff_p, msg_p );
+
+    /* The worker frees the message. */
+    return SOLCLIENT_CALLBACK_TAKE_MSG;
+}
+
 /*****************************************************************************
  * common_flowMessageReceivePrintMsgCallback
  *****************************************************************************/
@@ -794,6 +1051,18 @@ common_messageReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solC
 }
 
 
+/*****************************************************************************
+ * common_messageReceiveHandoffCallback
+ *****************************************************************************/
+solClient_rxMsgCallback_returnCode_t
+common_messageReceiveHandoffCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    common_handoffPush ( ( common_handoff_pt ) user_p, msg_p );
+
+    /* The worker frees the message. */
+    return SOLCLIENT_CALLBACK_TAKE_MSG;
+}
+
 /*****************************************************************************
  * common_messageReceivePrintMsgCallback
  *****************************************************************************/
@@ -1006,28 +1275,2430 @@ common_stopThread ( threadInfo_t * info_p )
 
 
 /*****************************************************************************
- * Request-Reply: Convert operator type to string
- ******************************************************************************/
-const char *
-RR_operationToString ( RR_operation_t operation )
+ * common_histogramIndex
+ *
+ * Map a value to its histogram bucket. Values are kept to
+ * COMMON_HISTOGRAM_SUB_BUCKET_BITS + 1 significant bits, so each power of two
+ * above the exact range is split into 2^COMMON_HISTOGRAM_SUB_BUCKET_BITS buckets.
+ *****************************************************************************/
+static int
+common_histogramIndex ( UINT64 value )
 {
-    static char    *plusString = "PLUS";
-    static char    *minusString = "MINUS";
-    static char    *timesString = "TIMES";
-    static char    *divideString = "DIVIDED_BY";
-    static char    *unknownString = "UNKNOWN";
+    int             shift = 0;
 
-    switch ( operation ) {
-        case plusOperation:
-            return plusString;
-        case minusOperation:
-            return minusString;
-        case timesOperation:
-            return timesString;
-        case divideOperation:
-            return divideString;
-        default:
-            return unknownString;
+#if defined(__GNUC__)
+    if ( ( value >> ( COMMON_HISTOGRAM_SUB_BUCKET_BITS + 1 ) ) != 0 ) {
+        shift = ( 63 - __builtin_clzll ( value ) ) - COMMON_HISTOGRAM_SUB_BUCKET_BITS;
+    }
+#else
+    while ( ( value >> shift ) >> ( COMMON_HISTOGRAM_SUB_BUCKET_BITS + 1 ) ) {
+        shift++;
+    }
+#endif
+    return ( shift << COMMON_HISTOGRAM_SUB_BUCKET_BITS ) + ( int ) ( value >> shift );
+}
+
+/*****************************************************************************
+ * common_histogramHighestEquivalentValue
+ *
+ * The largest value that maps to the given bucket.
+ *****************************************************************************/
+static UINT64
+common_histogramHighestEquivalentValue ( int index )
+{
+    int             shift = 0;
+    UINT64          mantissa;
+
+    if ( index >= ( 2 << COMMON_HISTOGRAM_SUB_BUCKET_BITS ) ) {
+        shift = ( index >> COMMON_HISTOGRAM_SUB_BUCKET_BITS ) - 1;
+    }
+    mantissa = ( UINT64 ) ( index - ( shift << COMMON_HISTOGRAM_SUB_BUCKET_BITS ) );
+    return ( mantissa << shift ) + ( ( ( UINT64 ) 1 << shift ) - 1 );
+}
+
+/*****************************************************************************
+ * common_histogramInit
+ *****************************************************************************/
+void
+common_histogramInit ( common_histogram_pt hist_p )
+{
+    memset ( hist_p, 0, sizeof ( *hist_p ) );
+    hist_p->minValue = ( UINT64 ) - 1;
+}
+
+/*****************************************************************************
+ * common_histogramRecord
+ *****************************************************************************/
+void
+common_histogramRecord ( common_histogram_pt hist_p, UINT64 value )
+{
+    hist_p->counts[common_histogramIndex ( value )]++;
+    hist_p->totalCount++;
+    hist_p->sum += ( long double ) value;
+    if ( value < hist_p->minValue ) {
+        hist_p->minValue = value;
+    }
+    if ( value > hist_p->maxValue ) {
+        hist_p->maxValue = value;
+    }
+}
+
+/*****************************************************************************
+ * common_histogramAdd
+ *****************************************************************************/
+void
+common_histogramAdd ( common_histogram_pt hist_p, common_histogram_pt from_p )
+{
+    int             loop;
+
+    if ( from_p->totalCount == 0 ) {
+        return;
+    }
+    for ( loop = 0; loop < COMMON_HISTOGRAM_NUM_BUCKETS; loop++ ) {
+        hist_p->counts[loop] += from_p->counts[loop];
+    }
+    hist_p->totalCount += from_p->totalCount;
+    hist_p->sum += from_p->sum;
+    if ( from_p->minValue < hist_p->minValue ) {
+        hist_p->minValue = from_p->minValue;
+    }
+    if ( from_p->maxValue > hist_p->maxValue ) {
+        hist_p->maxValue = from_p->maxValue;
+    }
+}
+
+/*****************************************************************************
+ * common_histogramValueAtPercentile
+ *****************************************************************************/
+UINT64
+common_histogramValueAtPercentile ( common_histogram_pt hist_p, double percentile )
+{
+    UINT64          countAtPercentile;
+    UINT64          count = 0;
+    UINT64          value;
+    int             loop;
+
+    if ( hist_p->totalCount == 0 ) {
+        return 0;
+    }
+    if ( percentile > 100.0 ) {
+        percentile = 100.0;
+    }
+    countAtPercentile = ( UINT64 ) ( ( percentile / 100.0 ) * ( double ) hist_p->totalCount + 0.5 );
+    if ( countAtPercentile == 0 ) {
+        countAtPercentile = 1;
+    }
+    for ( loop = 0; loop < COMMON_HISTOGRAM_NUM_BUCKETS; loop++ ) {
+        count += hist_p->counts[loop];
+        if ( count >= countAtPercentile ) {
+            value = common_histogramHighestEquivalentValue ( loop );
+            return ( value > hist_p->maxValue ) ? hist_p->maxValue : value;
+        }
+    }
+    return hist_p->maxValue;
+}
+
+/*****************************************************************************
+ * common_histogramPrint
+ *****************************************************************************/
+void
+common_histogramPrint ( common_histogram_pt hist_p, const char *title_p )
+{
+    if ( hist_p->totalCount == 0 ) {
+        printf ( "%s: no values recorded\n", title_p );
+        return;
+    }
+    printf ( "%s (usec, %llu values):\n"
+             "\tmin %.3f, mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, p99.99 %.3f, max %.3f\n",
+             title_p, hist_p->totalCount,
+             ( double ) hist_p->minValue / 1000.0,
+             ( double ) ( hist_p->sum / ( long double ) hist_p->totalCount ) / 1000.0,
+             ( double ) common_histogramValueAtPercentile ( hist_p, 50.0 ) / 1000.0,
+             ( double ) common_histogramValueAtPercentile ( hist_p, 90.0 ) / 1000.0,
+             ( double ) common_histogramValueAtPercentile ( hist_p, 99.0 ) / 1000.0,
+             ( double ) common_histogramValueAtPercentile ( hist_p, 99.9 ) / 1000.0,
+             ( double ) common_histogramValueAtPercentile ( hist_p, 99.99 ) / 1000.0,
+             ( double ) hist_p->maxValue / 1000.0 );
+}
+
+/*****************************************************************************
+ * common_histogramDump
+ *****************************************************************************/
+int
+common_histogramDump ( common_histogram_pt hist_p, const char *fileName_p )
+{
+    FILE           *file_p;
+    UINT64          count = 0;
+    UINT64          value;
+    double          percentile;
+    int             loop;
+
+    FOPEN ( file_p, fileName_p, "w" );
+    if ( file_p == NULL ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not open histogram file '%s'", fileName_p );
+        return 0;
+    }
+
+    fprintf ( file_p, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)" );
+    for ( loop = 0; loop < COMMON_HISTOGRAM_NUM_BUCKETS; loop++ ) {
+        if ( hist_p->counts[loop] == 0 ) {
+            continue;
+        }
+        count += hist_p->counts[loop];
+        value = common_histogramHighestEquivalentValue ( loop );
+        if ( value > hist_p->maxValue ) {
+            value = hist_p->maxValue;
+        }
+        percentile = ( double ) count / ( double ) hist_p->totalCount;
+        if ( count < hist_p->totalCount ) {
+            fprintf ( file_p, "%12.3f %2.12f %10llu %14.2f\n",
+                      ( double ) value / 1000.0, percentile, count, 1.0 / ( 1.0 - percentile ) );
+        } else {
+            fprintf ( file_p, "%12.3f %2.12f %10llu\n", ( double ) value / 1000.0, percentile, count );
+        }
+    }
+    fprintf ( file_p, "#[Mean    = %12.3f, Min            = %12.3f]\n"
+              "#[Max     = %12.3f, Total count    = %12llu]\n"
+              "#[Buckets = %12d, SubBuckets     = %12d]\n",
+              ( hist_p->totalCount != 0 ) ? ( double ) ( hist_p->sum / ( long double ) hist_p->totalCount ) / 1000.0 : 0.0,
+              ( hist_p->totalCount != 0 ) ? ( double ) hist_p->minValue / 1000.0 : 0.0,
+              ( double ) hist_p->maxValue / 1000.0, hist_p->totalCount,
+              COMMON_HISTOGRAM_NUM_BUCKETS >> COMMON_HISTOGRAM_SUB_BUCKET_BITS, 1 << COMMON_HISTOGRAM_SUB_BUCKET_BITS );
+    fclose ( file_p );
+    return 1;
+}
+
+
+/*****************************************************************************
+ * common_scheduleLog
+ *
+ * Natural logarithm of x, for 0 < x <= 1. The samples are not linked with the
+ * math library, so this scales x into [0.5, 1) and uses the atanh series.
+ *****************************************************************************/
+static double
+common_scheduleLog ( double x )
+{
+    double          z;
+    double          z2;
+    double          term;
+    double          sum = 0.0;
+    int             exponent = 0;
+    int             loop;
+
+    while ( x < 0.5 ) {
+        x *= 2.0;
+        exponent++;
+    }
+    z = ( x - 1.0 ) / ( x + 1.0 );
+    z2 = z * z;
+    term = z;
+    for ( loop = 1; loop < 40; loop += 2 ) {
+        sum += term / ( double ) loop;
+        term *= z2;
+    }
+    return 2.0 * sum - ( double ) exponent * 0.69314718055994530942;
+}
+
+/*****************************************************************************
+ * common_scheduleAdvance
+ *
+ * Move the schedule on to the intended send time of the following message.
+ *****************************************************************************/
+static void
+common_scheduleAdvance ( common_schedule_pt schedule_p )
+{
+    double          intervalNs = schedule_p->intervalNs;
+    double          uniform;
+
+    if ( schedule_p->arrivalMode == COMMON_ARRIVAL_POISSON ) {
+        /* xorshift64*, then the top 53 bits as a uniform value in (0, 1]. */
+        schedule_p->randState ^= schedule_p->randState >> 12;
+        schedule_p->randState ^= schedule_p->randState << 25;
+        schedule_p->randState ^= schedule_p->randState >> 27;
+        uniform = ( double ) ( ( ( schedule_p->randState * 2685821657736338717ULL ) >> 11 ) + 1 ) / 9007199254740992.0;
+        intervalNs = -common_scheduleLog ( uniform ) * schedule_p->intervalNs;
+    }
+    intervalNs += schedule_p->remainderNs;
+    schedule_p->nextTimeNs += ( UINT64 ) intervalNs;
+    schedule_p->remainderNs = intervalNs - ( double ) ( UINT64 ) intervalNs;
+}
+
+/*****************************************************************************
+ * common_scheduleInit
+ *****************************************************************************/
+void
+common_scheduleInit ( common_schedule_pt schedule_p, unsigned int rate, int arrivalMode, UINT64 seed,
+                      int spinBudgetUs )
+{
+    schedule_p->intervalNs = 1000000000.0 / ( double ) ( ( rate != 0 ) ? rate : 1 );
+    schedule_p->remainderNs = 0.0;
+    schedule_p->arrivalMode = arrivalMode;
+    /* The xorshift state must not be zero. */
+    schedule_p->randState = ( seed * 0x9E3779B97F4A7C15ULL ) | 1;
+    schedule_p->nextTimeNs = getTimeInNs (  );
+    common_histogramInit ( &schedule_p->lagHist );
+    pacerInit ( &schedule_p->pacer, spinBudgetUs );
+}
+
+/*****************************************************************************
+ * common_scheduleWait
+ *****************************************************************************/
+UINT64
+common_scheduleWait ( common_schedule_pt schedule_p )
+{
+    UINT64          intendedTime = schedule_p->nextTimeNs;
+    UINT64          currentTime = pacerWaitUntil ( &schedule_p->pacer, intendedTime );
+
+    /* A sleep-only pacer can return slightly early; that is not lag. */
+    common_histogramRecord ( &schedule_p->lagHist, ( currentTime > intendedTime ) ? currentTime - intendedTime : 0 );
+    common_scheduleAdvance ( schedule_p );
+    return intendedTime;
+}
+
+/*****************************************************************************
+ * common_scheduleTake
+ *****************************************************************************/
+int
+common_scheduleTake ( common_schedule_pt schedule_p, UINT64 *intendedTime_p )
+{
+    UINT64          currentTime = getTimeInNs (  );
+
+    if ( currentTime < schedule_p->nextTimeNs ) {
+        return 0;
+    }
+    *intendedTime_p = schedule_p->nextTimeNs;
+    common_histogramRecord ( &schedule_p->lagHist, currentTime - schedule_p->nextTimeNs );
+    common_scheduleAdvance ( schedule_p );
+    return 1;
+}
+
+/*****************************************************************************
+ * common_scheduleParseArrivalMode
+ *****************************************************************************/
+int
+common_scheduleParseArrivalMode ( const char *mode_p )
+{
+    if ( strcasecmp ( mode_p, "constant" ) == 0 ) {
+        return COMMON_ARRIVAL_CONSTANT;
+    } else if ( strcasecmp ( mode_p, "poisson" ) == 0 ) {
+        return COMMON_ARRIVAL_POISSON;
+    }
+    return -1;
+}
+
+
+/*****************************************************************************
+ * common_statsSamplerRead
+ *
+ * Read and sum the statistics of all the sampler's Sessions.
+ *****************************************************************************/
+static void
+common_statsSamplerRead ( common_statsSampler_pt sampler_p, solClient_stats_t * rxStats_p, solClient_stats_t * txStats_p )
+{
+    solClient_stats_t rxStats[SOLCLIENT_STATS_RX_NUM_STATS];
+    solClient_stats_t txStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    solClient_returnCode_t rc;
+    int             session;
+    int             loop;
+
+    memset ( rxStats_p, 0, sizeof ( solClient_stats_t ) * SOLCLIENT_STATS_RX_NUM_STATS );
+    memset ( txStats_p, 0, sizeof ( solClient_stats_t ) * SOLCLIENT_STATS_TX_NUM_STATS );
+    for ( session = 0; session < sampler_p->numSessions; session++ ) {
+        if ( ( rc = solClient_session_getRxStats ( sampler_p->sessions_p[session], rxStats,
+                                                   SOLCLIENT_STATS_RX_NUM_STATS ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_getRxStats()" );
+            continue;
+        }
+        if ( ( rc = solClient_session_getTxStats ( sampler_p->sessions_p[session], txStats,
+                                                   SOLCLIENT_STATS_TX_NUM_STATS ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_getTxStats()" );
+            continue;
+        }
+        for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+            rxStats_p[loop] += rxStats[loop];
+        }
+        for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+            txStats_p[loop] += txStats[loop];
+        }
+    }
+}
+
+/*****************************************************************************
+ * common_statsSamplerSample
+ *
+ * Take one sample and write it. Called with the sampler's mutex held.
+ *****************************************************************************/
+static void
+common_statsSamplerSample ( common_statsSampler_pt sampler_p )
+{
+    solClient_stats_t rxStats[SOLCLIENT_STATS_RX_NUM_STATS];
+    solClient_stats_t txStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    solClient_stats_t rxDelta[SOLCLIENT_STATS_RX_NUM_STATS];
+    solClient_stats_t txDelta[SOLCLIENT_STATS_TX_NUM_STATS];
+    UINT64          currentTime;
+    double          interval;
+    double          elapsed;
+    int             loop;
+
+    common_statsSamplerRead ( sampler_p, rxStats, txStats );
+    currentTime = getTimeInNs (  );
+    interval = ( double ) ( currentTime - sampler_p->lastTimeNs ) / 1000000000.0;
+    elapsed = ( double ) ( currentTime - sampler_p->startTimeNs ) / 1000000000.0;
+    if ( interval <= 0.0 ) {
+        return;
+    }
+
+    /* A counter that went down was cleared; count from zero. */
+    for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+        rxDelta[loop] = ( rxStats[loop] >= sampler_p->lastRxStats[loop] ) ?
+                rxStats[loop] - sampler_p->lastRxStats[loop] : rxStats[loop];
+    }
+    for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+        txDelta[loop] = ( txStats[loop] >= sampler_p->lastTxStats[loop] ) ?
+                txStats[loop] - sampler_p->lastTxStats[loop] : txStats[loop];
+    }
+
+    if ( sampler_p->json ) {
+        fprintf ( sampler_p->file_p, "{\"time\": %.3f, \"interval\": %.3f, \"rates\": {"
+                  "\"rxMsgsPerSec\": %.1f, \"rxBytesPerSec\": %.1f, \"txMsgsPerSec\": %.1f, \"txBytesPerSec\": %.1f, "
+                  "\"txWouldBlockPerSec\": %.1f, \"txSocketFullPerSec\": %.1f}, \"rx\": {",
+                  elapsed, interval,
+                  ( double ) rxDelta[SOLCLIENT_STATS_RX_TOTAL_DATA_MSGS] / interval,
+                  ( double ) rxDelta[SOLCLIENT_STATS_RX_TOTAL_DATA_BYTES] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_TOTAL_DATA_MSGS] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_TOTAL_DATA_BYTES] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_WOULD_BLOCK] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_SOCKET_FULL] / interval );
+        for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, "%s\"%s\": %llu", ( loop == 0 ) ? "" : ", ",
+                      solClient_rxStatToString ( ( solClient_stats_rx_t ) loop ), ( unsigned long long ) rxDelta[loop] );
+        }
+        fprintf ( sampler_p->file_p, "}, \"tx\": {" );
+        for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, "%s\"%s\": %llu", ( loop == 0 ) ? "" : ", ",
+                      solClient_txStatToString ( ( solClient_stats_tx_t ) loop ), ( unsigned long long ) txDelta[loop] );
+        }
+        fprintf ( sampler_p->file_p, "}}\n" );
+    } else {
+        fprintf ( sampler_p->file_p, "%.3f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f",
+                  elapsed, interval,
+                  ( double ) rxDelta[SOLCLIENT_STATS_RX_TOTAL_DATA_MSGS] / interval,
+                  ( double ) rxDelta[SOLCLIENT_STATS_RX_TOTAL_DATA_BYTES] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_TOTAL_DATA_MSGS] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_TOTAL_DATA_BYTES] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_WOULD_BLOCK] / interval,
+                  ( double ) txDelta[SOLCLIENT_STATS_TX_SOCKET_FULL] / interval );
+        for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, ",%llu", ( unsigned long long ) rxDelta[loop] );
+        }
+        for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, ",%llu", ( unsigned long long ) txDelta[loop] );
+        }
+        fprintf ( sampler_p->file_p, "\n" );
+    }
+    fflush ( sampler_p->file_p );
+
+    memcpy ( sampler_p->lastRxStats, rxStats, sizeof ( rxStats ) );
+    memcpy ( sampler_p->lastTxStats, txStats, sizeof ( txStats ) );
+    sampler_p->lastTimeNs = currentTime;
+}
+
+/*****************************************************************************
+ * common_statsSamplerTimerCallback
+ *****************************************************************************/
+static void
+common_statsSamplerTimerCallback ( solClient_opaqueContext_pt opaqueContext_p, void *user_p )
+{
+    common_statsSampler_pt sampler_p = ( common_statsSampler_pt ) user_p;
+
+    mutexLock ( &sampler_p->mutex );
+    if ( sampler_p->file_p != NULL ) {
+        common_statsSamplerSample ( sampler_p );
     }
+    mutexUnlock ( &sampler_p->mutex );
+}
+
+/*****************************************************************************
+ * common_statsSamplerStart
+ *****************************************************************************/
+solClient_returnCode_t
+common_statsSamplerStart ( common_statsSampler_pt sampler_p, solClient_opaqueContext_pt context_p,
+                           solClient_opaqueSession_pt * sessions_p, int numSessions, int intervalMs,
+                           const char *fileName_p )
+{
+    solClient_returnCode_t rc;
+    size_t          nameLen;
+    int             loop;
+
+    memset ( sampler_p, 0, sizeof ( *sampler_p ) );
+    sampler_p->context_p = context_p;
+    sampler_p->timerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+    sampler_p->sessions_p = sessions_p;
+    sampler_p->numSessions = numSessions;
+
+    if ( ( fileName_p == NULL ) || ( fileName_p[0] == ( char ) 0 ) ) {
+        sampler_p->file_p = stdout;
+    } else {
+        nameLen = strlen ( fileName_p );
+        sampler_p->json = ( ( nameLen > 5 ) && ( strcasecmp ( fileName_p + nameLen - 5, ".json" ) == 0 ) );
+        FOPEN ( sampler_p->file_p, fileName_p, "w" );
+        if ( sampler_p->file_p == NULL ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not open statistics sample file '%s'", fileName_p );
+            return SOLCLIENT_FAIL;
+        }
+    }
+
+    if ( !sampler_p->json ) {
+        fprintf ( sampler_p->file_p, "time,interval,rxMsgsPerSec,rxBytesPerSec,txMsgsPerSec,txBytesPerSec,"
+                  "txWouldBlockPerSec,txSocketFullPerSec" );
+        for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, ",\"%s\"", solClient_rxStatToString ( ( solClient_stats_rx_t ) loop ) );
+        }
+        for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+            fprintf ( sampler_p->file_p, ",\"%s\"", solClient_txStatToString ( ( solClient_stats_tx_t ) loop ) );
+        }
+        fprintf ( sampler_p->file_p, "\n" );
+    }
+
+    common_statsSamplerRead ( sampler_p, sampler_p->lastRxStats, sampler_p->lastTxStats );
+    sampler_p->startTimeNs = getTimeInNs (  );
+    sampler_p->lastTimeNs = sampler_p->startTimeNs;
+
+    mutexInit ( &sampler_p->mutex );
+    if ( ( rc = solClient_context_startTimer ( context_p, SOLCLIENT_CONTEXT_TIMER_REPEAT, ( solClient_uint32_t ) intervalMs,
+                                               common_statsSamplerTimerCallback, sampler_p,
+                                               &sampler_p->timerId ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_context_startTimer()" );
+        /* The timer never ran, so the mutex can go now. */
+        mutexDestroy ( &sampler_p->mutex );
+        if ( sampler_p->file_p != stdout ) {
+            fclose ( sampler_p->file_p );
+        }
+        sampler_p->file_p = NULL;
+        return rc;
+    }
+    sampler_p->initialized = TRUE;
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * common_statsSamplerStop
+ *****************************************************************************/
+void
+common_statsSamplerStop ( common_statsSampler_pt sampler_p )
+{
+    solClient_returnCode_t rc;
+
+    /* Never started: there is nothing to sample. */
+    if ( !sampler_p->initialized ) {
+        return;
+    }
+    if ( sampler_p->timerId != SOLCLIENT_CONTEXT_TIMER_ID_INVALID ) {
+        if ( ( rc = solClient_context_stopTimer ( sampler_p->context_p, &sampler_p->timerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_stopTimer()" );
+        }
+    }
+
+    /*
+     * A timer callback that already started finds file_p NULL and returns. On
+     * a second Stop, file_p is already NULL and the final sample is not
+     * written again.
+     */
+    mutexLock ( &sampler_p->mutex );
+    if ( sampler_p->file_p != NULL ) {
+        common_statsSamplerSample ( sampler_p );
+        if ( sampler_p->file_p != stdout ) {
+            fclose ( sampler_p->file_p );
+        }
+        sampler_p->file_p = NULL;
+    }
+    mutexUnlock ( &sampler_p->mutex );
+}
+
+/*****************************************************************************
+ * common_statsSamplerDestroy
+ *****************************************************************************/
+void
+common_statsSamplerDestroy ( common_statsSampler_pt sampler_p )
+{
+    if ( !sampler_p->initialized ) {
+        return;
+    }
+    mutexDestroy ( &sampler_p->mutex );
+    sampler_p->initialized = FALSE;
+}
+
+
+/*****************************************************************************
+ * common_seqWindowInit
+ *****************************************************************************/
+void
+common_seqWindowInit ( common_seqWindow_pt window_p )
+{
+    memset ( window_p, 0, sizeof ( *window_p ) );
+    /* Everything before the first message counts as received. */
+    memset ( window_p->bits, 0xff, sizeof ( window_p->bits ) );
+}
+
+/*****************************************************************************
+ * common_seqWindowEvict
+ *
+ * Account for a sequence number leaving the window, given whether it had
+ * been received.
+ *****************************************************************************/
+static void
+common_seqWindowEvict ( common_seqWindow_pt window_p, BOOL received )
+{
+    if ( !received ) {
+        window_p->numLost++;
+        window_p->curBurst++;
+    } else if ( window_p->curBurst > 0 ) {
+        window_p->numBursts++;
+        if ( window_p->curBurst > window_p->maxBurst ) {
+            window_p->maxBurst = window_p->curBurst;
+        }
+        window_p->curBurst = 0;
+    }
+}
+
+/*****************************************************************************
+ * common_seqWindowRecord
+ *****************************************************************************/
+void
+common_seqWindowRecord ( common_seqWindow_pt window_p, solClient_uint32_t seqNum, BOOL discardInd )
+{
+    solClient_int32_t diff;
+    solClient_uint32_t seq;
+    solClient_uint32_t slot;
+    UINT64          mask;
+
+    window_p->numRx++;
+    if ( discardInd ) {
+        window_p->numDiscardInd++;
+    }
+    if ( !window_p->started ) {
+        window_p->started = TRUE;
+        window_p->highSeq = seqNum;
+        window_p->lowSeq = seqNum;
+        return;
+    }
+
+    diff = ( solClient_int32_t ) ( seqNum - window_p->highSeq );
+    if ( diff > 0 ) {
+        if ( diff > 1 ) {
+            window_p->numGaps++;
+        }
+        if ( diff > COMMON_SEQ_WINDOW_SIZE ) {
+            /* Every slot is evicted, and what lies between is lost outright. */
+            for ( seq = window_p->highSeq + 1; seq != window_p->highSeq + 1 + COMMON_SEQ_WINDOW_SIZE; seq++ ) {
+                slot = seq & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+                common_seqWindowEvict ( window_p, ( window_p->bits[slot / 64] >> ( slot % 64 ) ) & 1 );
+            }
+            window_p->numLost += ( UINT64 ) ( diff - COMMON_SEQ_WINDOW_SIZE );
+            window_p->curBurst += ( UINT64 ) ( diff - COMMON_SEQ_WINDOW_SIZE );
+            memset ( window_p->bits, 0, sizeof ( window_p->bits ) );
+        } else {
+            /* Each new sequence number takes the slot of the one 'size' older. */
+            for ( seq = window_p->highSeq + 1; seq != seqNum; seq++ ) {
+                slot = seq & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+                mask = ( UINT64 ) 1 << ( slot % 64 );
+                common_seqWindowEvict ( window_p, ( window_p->bits[slot / 64] & mask ) != 0 );
+                window_p->bits[slot / 64] &= ~mask;
+            }
+            slot = seqNum & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+            common_seqWindowEvict ( window_p, ( ( window_p->bits[slot / 64] >> ( slot % 64 ) ) & 1 ) != 0 );
+        }
+        slot = seqNum & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+        window_p->bits[slot / 64] |= ( UINT64 ) 1 << ( slot % 64 );
+        window_p->highSeq = seqNum;
+    } else if ( ( solClient_int32_t ) ( seqNum - window_p->lowSeq ) < 0 ) {
+        /* Sent before the first message received, so not a duplicate. */
+        window_p->lowSeq = seqNum;
+        window_p->numReorder++;
+    } else if ( -diff < COMMON_SEQ_WINDOW_SIZE ) {
+        slot = seqNum & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+        mask = ( UINT64 ) 1 << ( slot % 64 );
+        if ( window_p->bits[slot / 64] & mask ) {
+            window_p->numDup++;
+        } else {
+            window_p->bits[slot / 64] |= mask;
+            window_p->numReorder++;
+        }
+    } else {
+        window_p->numLate++;
+    }
+}
+
+/*****************************************************************************
+ * common_seqWindowReport
+ *****************************************************************************/
+void
+common_seqWindowReport ( const common_seqWindow_t * window_p, common_seqReport_pt report_p )
+{
+    solClient_uint32_t seq;
+    solClient_uint32_t slot;
+    UINT64          curBurst = window_p->curBurst;
+
+    report_p->numRx = window_p->numRx;
+    report_p->numDup = window_p->numDup;
+    report_p->numReorder = window_p->numReorder;
+    report_p->numLate = window_p->numLate;
+    report_p->numGaps = window_p->numGaps;
+    report_p->numMissing = window_p->numLost;
+    report_p->numBursts = window_p->numBursts;
+    report_p->maxBurst = window_p->maxBurst;
+    report_p->numDiscardInd = window_p->numDiscardInd;
+
+    /* Continue the burst accounting through the window, oldest first. */
+    for ( seq = window_p->highSeq + 1; seq != window_p->highSeq + 1 + COMMON_SEQ_WINDOW_SIZE; seq++ ) {
+        slot = seq & ( COMMON_SEQ_WINDOW_SIZE - 1 );
+        if ( ( ( window_p->bits[slot / 64] >> ( slot % 64 ) ) & 1 ) == 0 ) {
+            report_p->numMissing++;
+            curBurst++;
+        } else if ( curBurst > 0 ) {
+            report_p->numBursts++;
+            if ( curBurst > report_p->maxBurst ) {
+                report_p->maxBurst = curBurst;
+            }
+            curBurst = 0;
+        }
+    }
+    /* The highest sequence number was received, so no burst is left open. */
+}
+
+
+/*****************************************************************************
+ * common_payloadFill
+ *
+ * Fill a buffer from a payload generator. Returns FALSE if the file for
+ * COMMON_PAYLOAD_FILE cannot be read.
+ *****************************************************************************/
+static BOOL
+common_payloadFill ( char *buf_p, size_t size, int payloadType, const char *fileName_p, UINT64 seed )
+{
+    static const char *words[] = {
+        "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "with", "was", "on", "be", "by",
+        "message", "order", "price", "quantity", "account", "status", "time", "symbol", "value", "market",
+        "update", "client", "request", "event", "id", "name", "true", "false", "null", "0", "1", "100"
+    };
+    UINT64          randState = seed * 2685821657736338717ULL + 1;
+    size_t          offset = 0;
+    size_t          length;
+    const char     *word_p;
+    char           *file_p;
+    size_t          fileSize;
+
+    switch ( payloadType ) {
+        case COMMON_PAYLOAD_RANDOM:
+        case COMMON_PAYLOAD_TEXT:
+            while ( offset < size ) {
+                /* xorshift64* */
+                randState ^= randState >> 12;
+                randState ^= randState << 25;
+                randState ^= randState >> 27;
+                if ( payloadType == COMMON_PAYLOAD_RANDOM ) {
+                    length = ( size - offset < sizeof ( randState ) ) ? size - offset : sizeof ( randState );
+                    memcpy ( buf_p + offset, &randState, length );
+                    offset += length;
+                    continue;
+                }
+                word_p = words[( randState >> 32 ) % ( sizeof ( words ) / sizeof ( words[0] ) )];
+                for ( length = 0; ( word_p[length] != ( char ) 0 ) && ( offset < size ); length++ ) {
+                    buf_p[offset++] = word_p[length];
+                }
+                if ( offset < size ) {
+                    buf_p[offset++] = ( ( randState & 0xf ) == 0 ) ? '\n' : ( ( randState & 0xf ) == 1 ) ? ',' : ' ';
+                }
+            }
+            break;
+        case COMMON_PAYLOAD_FILE:
+            if ( ( file_p = ( char * ) mapFile ( fileName_p, &fileSize ) ) == NULL ) {
+                solClient_log ( SOLCLIENT_LOG_ERROR, "Could not map payload file '%s'", fileName_p );
+                return FALSE;
+            }
+            /* Start each ring at a different place in the file. */
+            offset = ( size_t ) ( seed % fileSize );
+            for ( length = 0; length < size; length++ ) {
+                buf_p[length] = file_p[offset++];
+                if ( offset == fileSize ) {
+                    offset = 0;
+                }
+            }
+            unmapFile ( file_p, fileSize );
+            break;
+        default:
+            memset ( buf_p, 0, size );
+            break;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************
+ * common_msgRingCreate
+ *****************************************************************************/
+solClient_returnCode_t
+common_msgRingCreate ( common_msgRing_pt ring_p, int numMsgs, int payloadSize, int payloadType,
+                       const char *fileName_p, UINT64 seed )
+{
+    size_t          arenaSize = ( size_t ) numMsgs * ( size_t ) payloadSize;
+    solClient_returnCode_t rc;
+    int             loop;
+
+    memset ( ring_p, 0, sizeof ( *ring_p ) );
+    ring_p->payloadSize = payloadSize;
+    ring_p->msgs_p = ( solClient_opaqueMsg_pt * ) calloc ( ( size_t ) numMsgs, sizeof ( solClient_opaqueMsg_pt ) );
+    ring_p->arena_p = ( char * ) malloc ( ( arenaSize > 0 ) ? arenaSize : 1 );
+    if ( ( ring_p->msgs_p == NULL ) || ( ring_p->arena_p == NULL ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not malloc a ring of %d messages of %d bytes", numMsgs, payloadSize );
+        common_msgRingDestroy ( ring_p );
+        return SOLCLIENT_FAIL;
+    }
+    if ( !common_payloadFill ( ring_p->arena_p, arenaSize, payloadType, fileName_p, seed ) ) {
+        common_msgRingDestroy ( ring_p );
+        return SOLCLIENT_FAIL;
+    }
+
+    for ( loop = 0; loop < numMsgs; loop++ ) {
+        if ( ( rc = solClient_msg_alloc ( &ring_p->msgs_p[loop] ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_alloc()" );
+            common_msgRingDestroy ( ring_p );
+            return rc;
+        }
+        ring_p->numMsgs++;
+        if ( ( rc = solClient_msg_setBinaryAttachmentPtr ( ring_p->msgs_p[loop], common_msgRingPayload ( ring_p, loop ),
+                                                           ( solClient_uint32_t ) payloadSize ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setBinaryAttachmentPtr()" );
+            common_msgRingDestroy ( ring_p );
+            return rc;
+        }
+    }
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * common_msgRingDestroy
+ *****************************************************************************/
+void
+common_msgRingDestroy ( common_msgRing_pt ring_p )
+{
+    solClient_returnCode_t rc;
+    int             loop;
+
+    for ( loop = 0; loop < ring_p->numMsgs; loop++ ) {
+        if ( ( rc = solClient_msg_free ( &ring_p->msgs_p[loop] ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_free()" );
+        }
+    }
+    ring_p->numMsgs = 0;
+    if ( ring_p->msgs_p != NULL ) {
+        free ( ring_p->msgs_p );
+        ring_p->msgs_p = NULL;
+    }
+    if ( ring_p->arena_p != NULL ) {
+        free ( ring_p->arena_p );
+        ring_p->arena_p = NULL;
+    }
+}
+
+/*****************************************************************************
+ * common_payloadParseType
+ *****************************************************************************/
+int
+common_payloadParseType ( const char *type_p, char *fileName_p, size_t fileNameSize )
+{
+    if ( strcasecmp ( type_p, "zero" ) == 0 ) {
+        return COMMON_PAYLOAD_ZERO;
+    } else if ( strcasecmp ( type_p, "random" ) == 0 ) {
+        return COMMON_PAYLOAD_RANDOM;
+    } else if ( strcasecmp ( type_p, "text" ) == 0 ) {
+        return COMMON_PAYLOAD_TEXT;
+    } else if ( ( strncasecmp ( type_p, "file:", 5 ) == 0 ) && ( type_p[5] != ( char ) 0 ) ) {
+        strncpy ( fileName_p, type_p + 5, fileNameSize );
+        return COMMON_PAYLOAD_FILE;
+    }
+    return -1;
+}
+
+
+/*****************************************************************************
+ * common_latencyStamp
+ *****************************************************************************/
+solClient_returnCode_t
+common_latencyStamp ( solClient_opaqueMsg_pt msg_p, UINT64 nowNs )
+{
+    common_latencyStamp_t stamp;
+
+    stamp.magic = COMMON_LATENCY_STAMP_MAGIC;
+    stamp.reserved = 0;
+    stamp.sendTimeNs = nowNs;
+    return solClient_msg_setUserData ( msg_p, ( void * ) &stamp, sizeof ( stamp ) );
+}
+
+/*****************************************************************************
+ * common_latencyOneWay
+ *****************************************************************************/
+int
+common_latencyOneWay ( solClient_opaqueMsg_pt msg_p, int latencySource, UINT64 nowNs, UINT64 * latencyNs_p )
+{
+    common_latencyStamp_t stamp;
+    void           *userData_p;
+    solClient_uint32_t userDataSize;
+    solClient_int64_t sendMs;
+    solClient_int64_t rcvMs;
+
+    if ( latencySource == COMMON_LATENCY_STAMP ) {
+        if ( ( solClient_msg_getUserDataPtr ( msg_p, &userData_p, &userDataSize ) != SOLCLIENT_OK ) ||
+             ( userDataSize != sizeof ( stamp ) ) ) {
+            return 0;
+        }
+        memcpy ( &stamp, userData_p, sizeof ( stamp ) );
+        if ( stamp.magic != COMMON_LATENCY_STAMP_MAGIC ) {
+            return 0;
+        }
+        *latencyNs_p = ( nowNs > stamp.sendTimeNs ) ? nowNs - stamp.sendTimeNs : 0;
+        return 1;
+    }
+    if ( latencySource == COMMON_LATENCY_SENDER ) {
+        if ( ( solClient_msg_getSenderTimestamp ( msg_p, &sendMs ) != SOLCLIENT_OK ) ||
+             ( solClient_msg_getRcvTimestamp ( msg_p, &rcvMs ) != SOLCLIENT_OK ) ) {
+            return 0;
+        }
+        *latencyNs_p = ( rcvMs > sendMs ) ? ( UINT64 ) ( rcvMs - sendMs ) * 1000000ULL : 0;
+        return 1;
+    }
+    return 0;
+}
+
+
+/*****************************************************************************
+ * common_runControlInit
+ *****************************************************************************/
+void
+common_runControlInit ( common_runControl_pt runControl_p, int durationSec, int warmupSec, int cooldownSec )
+{
+    memset ( runControl_p, 0, sizeof ( *runControl_p ) );
+    if ( durationSec > 0 ) {
+        runControl_p->durationNs = ( UINT64 ) durationSec * 1000000000ULL;
+        runControl_p->warmupNs = ( UINT64 ) warmupSec * 1000000000ULL;
+        runControl_p->cooldownNs = ( UINT64 ) cooldownSec * 1000000000ULL;
+    }
+    mutexInit ( &runControl_p->mutex );
+}
+
+/*****************************************************************************
+ * common_runControlDestroy
+ *****************************************************************************/
+void
+common_runControlDestroy ( common_runControl_pt runControl_p )
+{
+    mutexDestroy ( &runControl_p->mutex );
+}
+
+/*****************************************************************************
+ * common_runControlStart
+ *****************************************************************************/
+void
+common_runControlStart ( common_runControl_pt runControl_p, UINT64 nowNs )
+{
+    if ( common_runControlStartNs ( runControl_p ) != 0 ) {
+        return;
+    }
+    mutexLock ( &runControl_p->mutex );
+    if ( runControl_p->startNs == 0 ) {
+        runControl_p->measureStartNs = nowNs + runControl_p->warmupNs;
+        runControl_p->measureEndNs = runControl_p->measureStartNs + runControl_p->durationNs;
+        runControl_p->endNs = runControl_p->measureEndNs + runControl_p->cooldownNs;
+        /* Publish last; a non-zero start means the window is valid. */
+        atomicStoreRelease ( &runControl_p->startNs, nowNs );
+        if ( common_runControlTimed ( runControl_p ) ) {
+            printf ( "Measuring for %llu s after a %llu s warm-up, then cooling down for %llu s\n",
+                     ( unsigned long long ) ( runControl_p->durationNs / 1000000000ULL ),
+                     ( unsigned long long ) ( runControl_p->warmupNs / 1000000000ULL ),
+                     ( unsigned long long ) ( runControl_p->cooldownNs / 1000000000ULL ) );
+        }
+    }
+    mutexUnlock ( &runControl_p->mutex );
+}
+
+/*****************************************************************************
+ * common_runControlPhase
+ *****************************************************************************/
+int
+common_runControlPhase ( common_runControl_pt runControl_p, UINT64 nowNs )
+{
+    if ( !common_runControlTimed ( runControl_p ) ) {
+        return COMMON_RUN_MEASURE;
+    }
+    if ( ( common_runControlStartNs ( runControl_p ) == 0 ) || ( nowNs < runControl_p->measureStartNs ) ) {
+        return COMMON_RUN_WARMUP;
+    }
+    if ( nowNs < runControl_p->measureEndNs ) {
+        return COMMON_RUN_MEASURE;
+    }
+    if ( nowNs < runControl_p->endNs ) {
+        return COMMON_RUN_COOLDOWN;
+    }
+    return COMMON_RUN_DONE;
+}
+
+/*****************************************************************************
+ * common_runControlWindowNs
+ *****************************************************************************/
+UINT64
+common_runControlWindowNs ( common_runControl_pt runControl_p, UINT64 nowNs )
+{
+    UINT64          startNs = common_runControlStartNs ( runControl_p );
+
+    if ( startNs == 0 ) {
+        return 0;
+    }
+    if ( !common_runControlTimed ( runControl_p ) ) {
+        return ( nowNs > startNs ) ? nowNs - startNs : 0;
+    }
+    if ( nowNs > runControl_p->measureEndNs ) {
+        nowNs = runControl_p->measureEndNs;
+    }
+    return ( nowNs > runControl_p->measureStartNs ) ? nowNs - runControl_p->measureStartNs : 0;
+}
+
+
+/*****************************************************************************
+ * common_ackCoalescerSend
+ *
+ * Acknowledge every held message. Called with the coalescer's mutex held.
+ *****************************************************************************/
+static void
+common_ackCoalescerSend ( common_ackCoalescer_pt coalescer_p )
+{
+    UINT64          startNs;
+    int             loop;
+
+    if ( coalescer_p->numMsgs == 0 ) {
+        return;
+    }
+    startNs = getTimeInNs (  );
+    for ( loop = 0; loop < coalescer_p->numMsgs; loop++ ) {
+        if ( solClient_flow_sendAck ( coalescer_p->flow_p, coalescer_p->msgIds[loop] ) != SOLCLIENT_OK ) {
+            coalescer_p->numFailed++;
+        }
+    }
+    coalescer_p->ackNs += getTimeInNs (  ) - startNs;
+    coalescer_p->numAcked += ( UINT64 ) coalescer_p->numMsgs;
+    coalescer_p->numBatches++;
+    coalescer_p->numMsgs = 0;
+}
+
+/*****************************************************************************
+ * common_ackCoalescerTimerCallback
+ *****************************************************************************/
+static void
+common_ackCoalescerTimerCallback ( solClient_opaqueContext_pt opaqueContext_p, void *user_p )
+{
+    common_ackCoalescer_pt coalescer_p = ( common_ackCoalescer_pt ) user_p;
+
+    mutexLock ( &coalescer_p->mutex );
+    if ( ( coalescer_p->numMsgs > 0 ) && ( getTimeInNs (  ) - coalescer_p->oldestNs >= coalescer_p->maxDelayNs ) ) {
+        common_ackCoalescerSend ( coalescer_p );
+    }
+    mutexUnlock ( &coalescer_p->mutex );
+}
+
+/*****************************************************************************
+ * common_ackCoalescerInit
+ *****************************************************************************/
+solClient_returnCode_t
+common_ackCoalescerInit ( common_ackCoalescer_pt coalescer_p, solClient_opaqueContext_pt context_p,
+                          int maxMsgs, int maxDelayUs )
+{
+    solClient_returnCode_t rc;
+    solClient_uint32_t periodMs;
+
+    memset ( coalescer_p, 0, sizeof ( *coalescer_p ) );
+    coalescer_p->context_p = context_p;
+    coalescer_p->timerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+    coalescer_p->maxMsgs = ( maxMsgs < 1 ) ? 1 : ( maxMsgs > COMMON_ACK_COALESCE_MAX ) ? COMMON_ACK_COALESCE_MAX : maxMsgs;
+    coalescer_p->maxDelayNs = ( maxDelayUs > 0 ) ? ( UINT64 ) maxDelayUs * 1000ULL : 0;
+    mutexInit ( &coalescer_p->mutex );
+
+    /* With a batch of 1 nothing is ever held, so no timer is needed. */
+    if ( ( context_p == NULL ) || ( coalescer_p->maxMsgs == 1 ) || ( coalescer_p->maxDelayNs == 0 ) ) {
+        return SOLCLIENT_OK;
+    }
+    periodMs = ( solClient_uint32_t ) ( maxDelayUs / 1000 );
+    if ( periodMs < 1 ) {
+        periodMs = 1;
+    }
+    if ( ( rc = solClient_context_startTimer ( context_p, SOLCLIENT_CONTEXT_TIMER_REPEAT, periodMs,
+                                               common_ackCoalescerTimerCallback, coalescer_p,
+                                               &coalescer_p->timerId ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_context_startTimer()" );
+        mutexDestroy ( &coalescer_p->mutex );
+        return rc;
+    }
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * common_ackCoalescerAdd
+ *****************************************************************************/
+void
+common_ackCoalescerAdd ( common_ackCoalescer_pt coalescer_p, solClient_opaqueFlow_pt opaqueFlow_p,
+                         solClient_msgId_t msgId )
+{
+    UINT64          nowNs = 0;
+
+    if ( coalescer_p->maxDelayNs != 0 ) {
+        nowNs = getTimeInNs (  );
+    }
+    mutexLock ( &coalescer_p->mutex );
+    coalescer_p->flow_p = opaqueFlow_p;
+    if ( coalescer_p->numMsgs == 0 ) {
+        coalescer_p->oldestNs = nowNs;
+    }
+    coalescer_p->msgIds[coalescer_p->numMsgs++] = msgId;
+    if ( ( coalescer_p->numMsgs >= coalescer_p->maxMsgs ) ||
+         ( ( coalescer_p->maxDelayNs != 0 ) && ( nowNs - coalescer_p->oldestNs >= coalescer_p->maxDelayNs ) ) ) {
+        common_ackCoalescerSend ( coalescer_p );
+    }
+    mutexUnlock ( &coalescer_p->mutex );
+}
+
+/*****************************************************************************
+ * common_ackCoalescerFlush
+ *****************************************************************************/
+void
+common_ackCoalescerFlush ( common_ackCoalescer_pt coalescer_p )
+{
+    mutexLock ( &coalescer_p->mutex );
+    common_ackCoalescerSend ( coalescer_p );
+    mutexUnlock ( &coalescer_p->mutex );
+}
+
+/*****************************************************************************
+ * common_ackCoalescerClose
+ *****************************************************************************/
+void
+common_ackCoalescerClose ( common_ackCoalescer_pt coalescer_p )
+{
+    solClient_returnCode_t rc;
+
+    if ( coalescer_p->timerId != SOLCLIENT_CONTEXT_TIMER_ID_INVALID ) {
+        if ( ( rc = solClient_context_stopTimer ( coalescer_p->context_p, &coalescer_p->timerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_stopTimer()" );
+        }
+    }
+    mutexLock ( &coalescer_p->mutex );
+    common_ackCoalescerSend ( coalescer_p );
+    coalescer_p->maxMsgs = 1;
+    coalescer_p->maxDelayNs = 0;
+    mutexUnlock ( &coalescer_p->mutex );
+}
+
+/*****************************************************************************
+ * common_ackCoalescerDestroy
+ *****************************************************************************/
+void
+common_ackCoalescerDestroy ( common_ackCoalescer_pt coalescer_p )
+{
+    mutexDestroy ( &coalescer_p->mutex );
+}
+
+/*****************************************************************************
+ * common_ackCoalescerPrint
+ *****************************************************************************/
+void
+common_ackCoalescerPrint ( common_ackCoalescer_pt coalescer_p )
+{
+    printf ( "Acknowledged %llu msgs in %llu batches (%.1f on average), %llu failed; "
+             "%llu usec in solClient_flow_sendAck(), %.0f nsec per msg\n",
+             ( unsigned long long ) coalescer_p->numAcked, ( unsigned long long ) coalescer_p->numBatches,
+             ( coalescer_p->numBatches > 0 ) ? ( double ) coalescer_p->numAcked / ( double ) coalescer_p->numBatches : 0.0,
+             ( unsigned long long ) coalescer_p->numFailed, ( unsigned long long ) ( coalescer_p->ackNs / 1000 ),
+             ( coalescer_p->numAcked > 0 ) ? ( double ) coalescer_p->ackNs / ( double ) coalescer_p->numAcked : 0.0 );
+}
+
+
+/*****************************************************************************
+ * common_handoffRingInit
+ *****************************************************************************/
+solClient_returnCode_t
+common_handoffRingInit ( common_handoffRing_pt ring_p, int size, BOOL multiProducer )
+{
+    int             loop;
+
+    memset ( ring_p, 0, sizeof ( *ring_p ) );
+    if ( ( size < 2 ) || ( ( size & ( size - 1 ) ) != 0 ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Hand-off ring size %d is not a power of 2", size );
+        return SOLCLIENT_FAIL;
+    }
+    if ( ( ring_p->slots_p = ( common_handoffSlot_t * ) malloc ( ( size_t ) size * sizeof ( common_handoffSlot_t ) ) ) == NULL ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate a hand-off ring of %d slots", size );
+        return SOLCLIENT_FAIL;
+    }
+    /* Slot i is free for the producer of position i. */
+    for ( loop = 0; loop < size; loop++ ) {
+        ring_p->slots_p[loop].seq = ( UINT64 ) loop;
+        ring_p->slots_p[loop].item_p = NULL;
+    }
+    ring_p->mask = ( UINT64 ) ( size - 1 );
+    ring_p->multiProducer = multiProducer;
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * common_handoffRingDestroy
+ *****************************************************************************/
+void
+common_handoffRingDestroy ( common_handoffRing_pt ring_p )
+{
+    if ( ring_p->slots_p != NULL ) {
+        free ( ring_p->slots_p );
+        ring_p->slots_p = NULL;
+    }
+}
+
+/*****************************************************************************
+ * common_handoffRingPush
+ *****************************************************************************/
+BOOL
+common_handoffRingPush ( common_handoffRing_pt ring_p, void *item_p )
+{
+    common_handoffSlot_t *slot_p;
+    UINT64          pos;
+    UINT64          seq;
+
+    for ( ;; ) {
+        pos = ring_p->tail;
+        slot_p = &ring_p->slots_p[pos & ring_p->mask];
+        seq = atomicLoadAcquire ( &slot_p->seq );
+        if ( seq == pos ) {
+            /* The slot is free; claim the position. */
+            if ( !ring_p->multiProducer ) {
+                ring_p->tail = pos + 1;
+                break;
+            }
+            if ( atomicCompareAndSwap ( &ring_p->tail, pos, pos + 1 ) ) {
+                break;
+            }
+        } else if ( seq < pos ) {
+            /* The consumer has not taken the item a lap ago. */
+            return FALSE;
+        }
+        /* Otherwise another producer claimed the position first. */
+    }
+    slot_p->item_p = item_p;
+    atomicStoreRelease ( &slot_p->seq, pos + 1 );
+    return TRUE;
+}
+
+/*****************************************************************************
+ * common_handoffRingPop
+ *****************************************************************************/
+int
+common_handoffRingPop ( common_handoffRing_pt ring_p, void **items_p, int maxItems )
+{
+    common_handoffSlot_t *slot_p;
+    int             numItems = 0;
+
+    while ( numItems < maxItems ) {
+        slot_p = &ring_p->slots_p[ring_p->head & ring_p->mask];
+        if ( atomicLoadAcquire ( &slot_p->seq ) != ring_p->head + 1 ) {
+            break;
+        }
+        items_p[numItems++] = slot_p->item_p;
+        /* Free the slot for the producer one lap on. */
+        atomicStoreRelease ( &slot_p->seq, ring_p->head + ring_p->mask + 1 );
+        ring_p->head++;
+    }
+    return numItems;
+}
+
+/* Empty polls a worker spins through before it starts sleeping between polls. */
+#define HANDOFF_IDLE_SPINS  (1000)
+/* Microseconds an idle worker sleeps between polls. */
+#define HANDOFF_IDLE_SLEEP_US  (50)
+
+/*****************************************************************************
+ * common_handoffWorkerThread
+ *****************************************************************************/
+static          threadRetType
+common_handoffWorkerThread ( void *user_p )
+{
+    common_handoffWorker_t *worker_p = ( common_handoffWorker_t * ) user_p;
+    common_handoff_pt handoff_p = worker_p->handoff_p;
+    void           *items[COMMON_HANDOFF_BATCH];
+    UINT64          exiting;
+    int             numItems;
+    int             idle = 0;
+    int             loop;
+
+    for ( ;; ) {
+        /*
+         * Read before polling. exiting is only set once every push has
+         * finished, so a ring found empty after it is set stays empty.
+         */
+        exiting = atomicLoadAcquire ( &handoff_p->exiting );
+        numItems = common_handoffRingPop ( &worker_p->ring, items, COMMON_HANDOFF_BATCH );
+        if ( numItems > 0 ) {
+            for ( loop = 0; loop < numItems; loop++ ) {
+                handoff_p->func_p ( ( solClient_opaqueMsg_pt ) items[loop], handoff_p->flow_p, handoff_p->user_p );
+            }
+            worker_p->numProcessed += ( UINT64 ) numItems;
+            worker_p->numBatches++;
+            idle = 0;
+            continue;
+        }
+        if ( exiting ) {
+            break;
+        }
+        if ( ++idle < HANDOFF_IDLE_SPINS ) {
+            cpuRelax (  );
+        } else {
+            sleepInUs ( HANDOFF_IDLE_SLEEP_US );
+            worker_p->numSleeps++;
+        }
+    }
+    return DEFAULT_THREAD_RETURN_ARG;
+}
+
+/*****************************************************************************
+ * common_handoffStart
+ *****************************************************************************/
+solClient_returnCode_t
+common_handoffStart ( common_handoff_pt handoff_p, int numWorkers, BOOL multiProducer,
+                      common_handoffFunc_t func_p, void *user_p )
+{
+    int             loop;
+
+    memset ( handoff_p, 0, sizeof ( *handoff_p ) );
+    if ( ( numWorkers < 1 ) || ( numWorkers > COMMON_HANDOFF_MAX_WORKERS ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Number of hand-off workers %d must be 1 to %d",
+                        numWorkers, COMMON_HANDOFF_MAX_WORKERS );
+        return SOLCLIENT_FAIL;
+    }
+    handoff_p->func_p = func_p;
+    handoff_p->user_p = user_p;
+    for ( loop = 0; loop < numWorkers; loop++ ) {
+        if ( common_handoffRingInit ( &handoff_p->worker[loop].ring, COMMON_HANDOFF_RING_SIZE,
+                                      multiProducer ) != SOLCLIENT_OK ) {
+            goto startFailed;
+        }
+        handoff_p->worker[loop].handoff_p = handoff_p;
+        handoff_p->numWorkers = loop + 1;
+        if ( ( handoff_p->worker[loop].thread = startThread ( common_handoffWorkerThread,
+                                                              &handoff_p->worker[loop] ) ) == _NULL_THREAD_ID ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not start hand-off worker thread %d", loop );
+            common_handoffRingDestroy ( &handoff_p->worker[loop].ring );
+            handoff_p->numWorkers = loop;
+            goto startFailed;
+        }
+    }
+    return SOLCLIENT_OK;
+
+  startFailed:
+    common_handoffStop ( handoff_p );
+    return SOLCLIENT_FAIL;
+}
+
+/*****************************************************************************
+ * common_handoffPush
+ *****************************************************************************/
+void
+common_handoffPush ( common_handoff_pt handoff_p, solClient_opaqueMsg_pt msg_p )
+{
+    common_handoffRing_pt ring_p;
+    int             spins = 0;
+
+    /*
+     * Either common_handoffStop() sees this thread in numPushing and waits for
+     * it, or this thread sees stopping and keeps the message.
+     */
+    atomicAddFetch ( &handoff_p->numPushing, 1 );
+    if ( atomicLoad ( &handoff_p->stopping ) ) {
+        atomicAddFetch ( &handoff_p->numPushing, ( UINT64 ) -1 );
+        atomicAddFetch ( &handoff_p->numInline, 1 );
+        handoff_p->func_p ( msg_p, handoff_p->flow_p, handoff_p->user_p );
+        return;
+    }
+    ring_p = &handoff_p->worker[handoff_p->nextWorker++ % ( UINT64 ) handoff_p->numWorkers].ring;
+    if ( !common_handoffRingPush ( ring_p, msg_p ) ) {
+        ring_p->numFull++;
+        while ( !common_handoffRingPush ( ring_p, msg_p ) ) {
+            if ( ++spins < HANDOFF_IDLE_SPINS ) {
+                cpuRelax (  );
+            } else {
+                sleepInUs ( HANDOFF_IDLE_SLEEP_US );
+            }
+        }
+    }
+    atomicAddFetch ( &handoff_p->numPushing, ( UINT64 ) -1 );
+}
+
+/*****************************************************************************
+ * common_handoffStop
+ *****************************************************************************/
+void
+common_handoffStop ( common_handoff_pt handoff_p )
+{
+    int             loop;
+
+    atomicAddFetch ( &handoff_p->stopping, 1 );
+    /*
+     * Let pushes already past the check finish; the workers keep draining
+     * meanwhile, so a push waiting on a full ring completes. Only then are
+     * the workers told to exit, so nothing is pushed after they stop.
+     */
+    while ( atomicLoad ( &handoff_p->numPushing ) != 0 ) {
+        sleepInUs ( HANDOFF_IDLE_SLEEP_US );
+    }
+    atomicStoreRelease ( &handoff_p->exiting, 1 );
+    for ( loop = 0; loop < handoff_p->numWorkers; loop++ ) {
+        waitOnThread ( handoff_p->worker[loop].thread );
+        common_handoffRingDestroy ( &handoff_p->worker[loop].ring );
+    }
+}
+
+/*****************************************************************************
+ * common_handoffPrint
+ *****************************************************************************/
+void
+common_handoffPrint ( common_handoff_pt handoff_p )
+{
+    common_handoffWorker_t *worker_p;
+    int             loop;
+
+    for ( loop = 0; loop < handoff_p->numWorkers; loop++ ) {
+        worker_p = &handoff_p->worker[loop];
+        printf ( "Worker %d: processed %llu msgs in %llu batches (%.1f on average), slept %llu times, ring full %llu times\n",
+                 loop, ( unsigned long long ) worker_p->numProcessed, ( unsigned long long ) worker_p->numBatches,
+                 ( worker_p->numBatches > 0 ) ? ( double ) worker_p->numProcessed / ( double ) worker_p->numBatches : 0.0,
+                 ( unsigned long long ) worker_p->numSleeps, ( unsigned long long ) worker_p->ring.numFull );
+    }
+    if ( atomicLoad ( &handoff_p->numInline ) != 0 ) {
+        printf ( "Processed %llu msgs on the receiving thread after the workers stopped\n",
+                 ( unsigned long long ) atomicLoad ( &handoff_p->numInline ) );
+    }
+}
+
+
+/*****************************************************************************
+ * common_pubTrackerInit
+ *****************************************************************************/
+solClient_returnCode_t
+common_pubTrackerInit ( common_pubTracker_pt tracker_p, int capacity )
+{
+    UINT64          size = 2;
+
+    memset ( tracker_p, 0, sizeof ( *tracker_p ) );
+    while ( size < ( UINT64 ) capacity ) {
+        size <<= 1;
+    }
+    if ( ( tracker_p->slots_p = ( common_pubSlot_pt ) calloc ( ( size_t ) size, sizeof ( common_pubSlot_t ) ) ) == NULL ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate a publish tracker of %llu slots",
+                        ( unsigned long long ) size );
+        return SOLCLIENT_FAIL;
+    }
+    tracker_p->mask = size - 1;
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * common_pubTrackerDestroy
+ *****************************************************************************/
+void
+common_pubTrackerDestroy ( common_pubTracker_pt tracker_p )
+{
+    if ( tracker_p->slots_p != NULL ) {
+        free ( tracker_p->slots_p );
+        tracker_p->slots_p = NULL;
+    }
+}
+
+/*****************************************************************************
+ * common_pubTrackerTrack
+ *****************************************************************************/
+common_pubSlot_pt
+common_pubTrackerTrack ( common_pubTracker_pt tracker_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    common_pubSlot_pt slot_p;
+
+    if ( tracker_p->nextSeq - tracker_p->oldestSeq > tracker_p->mask ) {
+        return NULL;
+    }
+    slot_p = &tracker_p->slots_p[tracker_p->nextSeq & tracker_p->mask];
+    slot_p->seq = tracker_p->nextSeq++;
+    slot_p->msg_p = msg_p;
+    slot_p->user_p = user_p;
+    /* Published to the Context thread by the send. */
+    atomicStoreRelease ( &slot_p->state, COMMON_PUB_SLOT_PENDING );
+    return slot_p;
+}
+
+/*****************************************************************************
+ * common_pubTrackerAck
+ *****************************************************************************/
+void
+common_pubTrackerAck ( common_pubTracker_pt tracker_p, common_pubSlot_pt slot_p, BOOL windowed )
+{
+    common_pubSlot_pt pending_p;
+    UINT64          seq;
+
+    if ( !windowed ) {
+        if ( atomicLoadAcquire ( &slot_p->state ) == COMMON_PUB_SLOT_PENDING ) {
+            tracker_p->numAccepted++;
+            atomicStoreRelease ( &slot_p->state, COMMON_PUB_SLOT_ACCEPTED );
+        }
+        if ( slot_p->seq >= tracker_p->ackedSeq ) {
+            tracker_p->ackedSeq = slot_p->seq + 1;
+        }
+        return;
+    }
+    /*
+     * Every message from the last windowed acknowledgement up to this one is
+     * acknowledged, except those already rejected. Each is visited once, so
+     * the cost per message stays constant whatever the window size. None can
+     * have been released and reused, as only acknowledged or rejected
+     * messages are released; the sequence check skips a reused slot anyway.
+     */
+    for ( seq = tracker_p->ackedSeq; seq <= slot_p->seq; seq++ ) {
+        pending_p = &tracker_p->slots_p[seq & tracker_p->mask];
+        if ( ( atomicLoadAcquire ( &pending_p->state ) == COMMON_PUB_SLOT_PENDING ) && ( pending_p->seq == seq ) ) {
+            tracker_p->numAccepted++;
+            atomicStoreRelease ( &pending_p->state, COMMON_PUB_SLOT_ACCEPTED );
+        }
+    }
+    if ( slot_p->seq >= tracker_p->ackedSeq ) {
+        tracker_p->ackedSeq = slot_p->seq + 1;
+    }
+}
+
+/*****************************************************************************
+ * common_pubTrackerReject
+ *****************************************************************************/
+void
+common_pubTrackerReject ( common_pubTracker_pt tracker_p, common_pubSlot_pt slot_p )
+{
+    if ( atomicLoadAcquire ( &slot_p->state ) == COMMON_PUB_SLOT_PENDING ) {
+        tracker_p->numRejected++;
+        atomicStoreRelease ( &slot_p->state, COMMON_PUB_SLOT_REJECTED );
+    }
+}
+
+/*****************************************************************************
+ * common_pubTrackerRelease
+ *****************************************************************************/
+common_pubSlot_pt
+common_pubTrackerRelease ( common_pubTracker_pt tracker_p, BOOL force )
+{
+    common_pubSlot_pt slot_p;
+    UINT64          state;
+
+    if ( tracker_p->oldestSeq == tracker_p->nextSeq ) {
+        return NULL;
+    }
+    slot_p = &tracker_p->slots_p[tracker_p->oldestSeq & tracker_p->mask];
+    state = atomicLoadAcquire ( &slot_p->state );
+    if ( ( state == COMMON_PUB_SLOT_PENDING ) && !force ) {
+        return NULL;
+    }
+    /* The state is left for the caller; the slot is reused once tracked again. */
+    tracker_p->oldestSeq++;
+    return slot_p;
+}
+
+
+/*****************************************************************************
+ * common_requesterHome
+ *
+ * The hash table entry a request ID belongs in. Fibonacci hashing spreads the
+ * sequential IDs over the whole table.
+ *****************************************************************************/
+static UINT64
+common_requesterHome ( common_requester_pt requester_p, UINT64 id )
+{
+    return ( id * 0x9E3779B97F4A7C15ULL ) >> requester_p->tableShift;
+}
+
+/*****************************************************************************
+ * common_requesterFind
+ *
+ * The hash table entry holding a request ID, or the empty entry ending its
+ * probe sequence if it is not in flight.
+ *****************************************************************************/
+static UINT64
+common_requesterFind ( common_requester_pt requester_p, UINT64 id )
+{
+    UINT64          entry = common_requesterHome ( requester_p, id );
+    solClient_uint32_t index;
+
+    while ( ( index = requester_p->table_p[entry] ) != 0 ) {
+        if ( requester_p->requests_p[index - 1].id == id ) {
+            break;
+        }
+        entry = ( entry + 1 ) & requester_p->tableMask;
+    }
+    return entry;
+}
+
+/*****************************************************************************
+ * common_requesterUnhash
+ *
+ * Empty a hash table entry by shifting back the entries after it that
+ * probed past it, so no tombstones are needed and lookups stay short.
+ *****************************************************************************/
+static void
+common_requesterUnhash ( common_requester_pt requester_p, UINT64 entry )
+{
+    UINT64          next = entry;
+    UINT64          home;
+    solClient_uint32_t index;
+
+    requester_p->table_p[entry] = 0;
+    for ( ;; ) {
+        next = ( next + 1 ) & requester_p->tableMask;
+        if ( ( index = requester_p->table_p[next] ) == 0 ) {
+            return;
+        }
+        home = common_requesterHome ( requester_p, requester_p->requests_p[index - 1].id );
+        /* Move it back unless its home lies cyclically in (entry, next]. */
+        if ( ( ( next - home ) & requester_p->tableMask ) >= ( ( next - entry ) & requester_p->tableMask ) ) {
+            requester_p->table_p[entry] = index;
+            requester_p->table_p[next] = 0;
+            entry = next;
+        }
+    }
+}
+
+/*****************************************************************************
+ * common_requesterWheelAdd
+ *
+ * Link a request into the wheel slot for its expiry tick: the lowest level
+ * whose span covers the time left. When the wheel reaches a higher level slot
+ * its requests cascade down to the lower levels.
+ *****************************************************************************/
+static void
+common_requesterWheelAdd ( common_requester_pt requester_p, common_request_pt request_p )
+{
+    UINT64          delta = request_p->expiryTick - requester_p->nowTick;
+    int             level = 0;
+    common_request_pt *slot_pp;
+
+    if ( delta >= ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * COMMON_REQUESTER_WHEEL_LEVELS ) ) ) {
+        delta = ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * COMMON_REQUESTER_WHEEL_LEVELS ) ) - 1;
+        request_p->expiryTick = requester_p->nowTick + delta;
+    }
+    while ( ( level < COMMON_REQUESTER_WHEEL_LEVELS - 1 ) &&
+            ( delta >= ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * ( level + 1 ) ) ) ) ) {
+        level++;
+    }
+    slot_pp = &requester_p->wheel[level][( request_p->expiryTick >> ( COMMON_REQUESTER_WHEEL_BITS * level ) ) &
+                                         ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )];
+    request_p->prev_p = NULL;
+    request_p->next_p = *slot_pp;
+    if ( *slot_pp != NULL ) {
+        ( *slot_pp )->prev_p = request_p;
+    }
+    *slot_pp = request_p;
+}
+
+/*****************************************************************************
+ * common_requesterWheelRemove
+ *****************************************************************************/
+static void
+common_requesterWheelRemove ( common_requester_pt requester_p, common_request_pt request_p )
+{
+    common_request_pt *slot_pp;
+    int             level;
+
+    if ( request_p->prev_p != NULL ) {
+        request_p->prev_p->next_p = request_p->next_p;
+    } else {
+        /*
+         * The head of its slot. It may not have cascaded down yet, so look at
+         * the slot of its expiry tick on each level.
+         */
+        for ( level = 0; level < COMMON_REQUESTER_WHEEL_LEVELS; level++ ) {
+            slot_pp = &requester_p->wheel[level][( request_p->expiryTick >> ( COMMON_REQUESTER_WHEEL_BITS * level ) ) &
+                                                 ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )];
+            if ( *slot_pp == request_p ) {
+                *slot_pp = request_p->next_p;
+                break;
+            }
+        }
+    }
+    if ( request_p->next_p != NULL ) {
+        request_p->next_p->prev_p = request_p->prev_p;
+    }
+}
+
+/*****************************************************************************
+ * common_requesterComplete
+ *
+ * Hand a request to the requester's function and return it to the free list.
+ *****************************************************************************/
+static void
+common_requesterComplete ( common_requester_pt requester_p, common_request_pt request_p, UINT64 entry,
+                           solClient_opaqueMsg_pt replyMsg_p )
+{
+    common_requesterUnhash ( requester_p, entry );
+    if ( requester_p->func_p != NULL ) {
+        requester_p->func_p ( replyMsg_p, request_p->user_p, requester_p->user_p );
+    }
+    request_p->id = 0;
+    request_p->user_p = NULL;
+    request_p->next_p = requester_p->free_p;
+    requester_p->free_p = request_p;
+    requester_p->numInFlight--;
+    if ( requester_p->waiting ) {
+        condSignal ( &requester_p->cond );
+    }
+}
+
+/*****************************************************************************
+ * common_requesterTimerCallback
+ *
+ * Advance the wheel to the current tick, cascading higher level slots down as
+ * the wheel reaches them and timing out the requests of each level 0 slot.
+ *****************************************************************************/
+static void
+common_requesterTimerCallback ( solClient_opaqueContext_pt opaqueContext_p, void *user_p )
+{
+    common_requester_pt requester_p = ( common_requester_pt ) user_p;
+    common_request_pt request_p;
+    common_request_pt next_p;
+    UINT64          targetTick;
+    UINT64          tick;
+    int             level;
+
+    mutexLock ( &requester_p->mutex );
+    targetTick = ( getTimeInNs (  ) - requester_p->startNs ) / COMMON_REQUESTER_TICK_NS;
+    while ( requester_p->nowTick < targetTick ) {
+        tick = ++requester_p->nowTick;
+        for ( level = 1; level < COMMON_REQUESTER_WHEEL_LEVELS; level++ ) {
+            if ( ( tick & ( ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * level ) ) - 1 ) ) != 0 ) {
+                break;
+            }
+            request_p = requester_p->wheel[level][( tick >> ( COMMON_REQUESTER_WHEEL_BITS * level ) ) &
+                                                  ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )];
+            requester_p->wheel[level][( tick >> ( COMMON_REQUESTER_WHEEL_BITS * level ) ) &
+                                      ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )] = NULL;
+            for ( ; request_p != NULL; request_p = next_p ) {
+                next_p = request_p->next_p;
+                common_requesterWheelAdd ( requester_p, request_p );
+            }
+        }
+        request_p = requester_p->wheel[0][tick & ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )];
+        requester_p->wheel[0][tick & ( COMMON_REQUESTER_WHEEL_SLOTS - 1 )] = NULL;
+        for ( ; request_p != NULL; request_p = next_p ) {
+            next_p = request_p->next_p;
+            requester_p->numTimedOut++;
+            common_requesterComplete ( requester_p, request_p, common_requesterFind ( requester_p, request_p->id ), NULL );
+        }
+    }
+    mutexUnlock ( &requester_p->mutex );
+}
+
+/*****************************************************************************
+ * common_requesterInit
+ *****************************************************************************/
+solClient_returnCode_t
+common_requesterInit ( common_requester_pt requester_p, solClient_opaqueContext_pt context_p,
+                       solClient_opaqueSession_pt session_p, BOOL guaranteed, int maxInFlight, int timeoutMs,
+                       common_requesterFunc_t func_p, void *user_p )
+{
+    solClient_returnCode_t rc;
+    UINT64          tableSize = 2;
+    int             loop;
+
+    memset ( requester_p, 0, sizeof ( *requester_p ) );
+    requester_p->session_p = session_p;
+    requester_p->context_p = context_p;
+    requester_p->timerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+    requester_p->func_p = func_p;
+    requester_p->user_p = user_p;
+    requester_p->guaranteed = guaranteed;
+    requester_p->maxInFlight = ( maxInFlight < 1 ) ? 1 : maxInFlight;
+    requester_p->window = requester_p->maxInFlight;
+    requester_p->timeoutTicks = ( timeoutMs < 1 ) ? 1 : ( UINT64 ) timeoutMs * 1000000ULL / COMMON_REQUESTER_TICK_NS;
+    if ( requester_p->timeoutTicks >= ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * COMMON_REQUESTER_WHEEL_LEVELS ) ) ) {
+        requester_p->timeoutTicks = ( 1ULL << ( COMMON_REQUESTER_WHEEL_BITS * COMMON_REQUESTER_WHEEL_LEVELS ) ) - 1;
+    }
+    common_histogramInit ( &requester_p->latency );
+
+    /* At most half full, so probe sequences stay short. */
+    requester_p->tableShift = 63;
+    while ( tableSize < ( UINT64 ) requester_p->maxInFlight * 2 ) {
+        tableSize <<= 1;
+        requester_p->tableShift--;
+    }
+    requester_p->tableMask = tableSize - 1;
+    requester_p->requests_p = ( common_request_pt ) calloc ( ( size_t ) requester_p->maxInFlight, sizeof ( common_request_t ) );
+    requester_p->table_p = ( solClient_uint32_t * ) calloc ( ( size_t ) tableSize, sizeof ( solClient_uint32_t ) );
+    if ( ( requester_p->requests_p == NULL ) || ( requester_p->table_p == NULL ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate a requester for %d requests in flight",
+                        requester_p->maxInFlight );
+        rc = SOLCLIENT_FAIL;
+        goto freeTables;
+    }
+    for ( loop = requester_p->maxInFlight - 1; loop >= 0; loop-- ) {
+        requester_p->requests_p[loop].next_p = requester_p->free_p;
+        requester_p->free_p = &requester_p->requests_p[loop];
+    }
+    mutexInit ( &requester_p->mutex );
+    condInit ( &requester_p->cond );
+    requester_p->startNs = getTimeInNs (  );
+
+    if ( ( rc = solClient_context_startTimer ( context_p, SOLCLIENT_CONTEXT_TIMER_REPEAT, COMMON_REQUESTER_TIMER_MS,
+                                               common_requesterTimerCallback, requester_p,
+                                               &requester_p->timerId ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_context_startTimer()" );
+        condDestroy ( &requester_p->cond );
+        mutexDestroy ( &requester_p->mutex );
+        goto freeTables;
+    }
+    return SOLCLIENT_OK;
+
+  freeTables:
+    if ( requester_p->requests_p != NULL ) {
+        free ( requester_p->requests_p );
+        requester_p->requests_p = NULL;
+    }
+    if ( requester_p->table_p != NULL ) {
+        free ( requester_p->table_p );
+        requester_p->table_p = NULL;
+    }
+    return rc;
+}
+
+/*****************************************************************************
+ * common_requesterSetWindow
+ *****************************************************************************/
+void
+common_requesterSetWindow ( common_requester_pt requester_p, int window )
+{
+    mutexLock ( &requester_p->mutex );
+    requester_p->window = ( window < 1 ) ? 1 : ( window > requester_p->maxInFlight ) ? requester_p->maxInFlight : window;
+    requester_p->numSent = 0;
+    requester_p->numReplies = 0;
+    requester_p->numTimedOut = 0;
+    requester_p->numUnmatched = 0;
+    requester_p->firstSendNs = 0;
+    requester_p->lastReplyNs = 0;
+    common_histogramInit ( &requester_p->latency );
+    mutexUnlock ( &requester_p->mutex );
+}
+
+/*****************************************************************************
+ * common_requesterSend
+ *****************************************************************************/
+solClient_returnCode_t
+common_requesterSend ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p, void *reqUser_p )
+{
+    return common_requesterSendAt ( requester_p, msg_p, reqUser_p, 0 );
+}
+
+/*****************************************************************************
+ * common_requesterSendAt
+ *****************************************************************************/
+solClient_returnCode_t
+common_requesterSendAt ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p, void *reqUser_p,
+                         UINT64 intendedNs )
+{
+    solClient_returnCode_t rc;
+    common_request_pt request_p;
+    char            correlationId[20];
+    char           *char_p = &correlationId[sizeof ( correlationId ) - 1];
+    UINT64          reqId;
+    UINT64          id;
+    UINT64          entry;
+    UINT64          nowNs;
+
+    mutexLock ( &requester_p->mutex );
+    while ( requester_p->numInFlight >= requester_p->window ) {
+        requester_p->waiting = TRUE;
+        condWait ( &requester_p->cond, &requester_p->mutex );
+        requester_p->waiting = FALSE;
+    }
+    request_p = requester_p->free_p;
+    requester_p->free_p = request_p->next_p;
+    nowNs = getTimeInNs (  );
+    reqId = ++requester_p->nextId;
+    request_p->id = reqId;
+    request_p->sendNs = ( ( intendedNs != 0 ) && ( intendedNs < nowNs ) ) ? intendedNs : nowNs;
+    request_p->user_p = reqUser_p;
+    /* Rounded up a tick, so no request times out early. */
+    request_p->expiryTick = ( nowNs - requester_p->startNs ) / COMMON_REQUESTER_TICK_NS + requester_p->timeoutTicks + 1;
+    if ( request_p->expiryTick <= requester_p->nowTick ) {
+        request_p->expiryTick = requester_p->nowTick + 1;
+    }
+    requester_p->table_p[common_requesterFind ( requester_p, reqId )] = ( solClient_uint32_t ) ( request_p - requester_p->requests_p ) + 1;
+    common_requesterWheelAdd ( requester_p, request_p );
+    requester_p->numInFlight++;
+    if ( requester_p->numSent++ == 0 ) {
+        requester_p->firstSendNs = nowNs;
+    }
+    mutexUnlock ( &requester_p->mutex );
+
+    /* The request ID in hexadecimal, as the correlation ID. */
+    id = reqId;
+    *char_p = ( char ) 0;
+    do {
+        *--char_p = "0123456789abcdef"[id & 0xf];
+        id >>= 4;
+    } while ( id != 0 );
+    if ( ( rc = solClient_msg_setCorrelationId ( msg_p, char_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_setCorrelationId()" );
+        goto cancel;
+    }
+    if ( requester_p->guaranteed ) {
+        if ( ( rc = solClient_session_sendMsg ( requester_p->session_p, msg_p ) ) == SOLCLIENT_OK ) {
+            return SOLCLIENT_OK;
+        }
+        common_handleError ( rc, "solClient_session_sendMsg()" );
+        goto cancel;
+    }
+    /* With no timeout the send returns once the request is buffered. */
+    rc = solClient_session_sendRequest ( requester_p->session_p, msg_p, NULL, 0 );
+    if ( ( rc == SOLCLIENT_OK ) || ( rc == SOLCLIENT_IN_PROGRESS ) ) {
+        return SOLCLIENT_OK;
+    }
+    common_handleError ( rc, "solClient_session_sendRequest()" );
+
+  cancel:
+    mutexLock ( &requester_p->mutex );
+    /* Unless it already timed out, take it back out of flight unsent. */
+    entry = common_requesterFind ( requester_p, reqId );
+    if ( requester_p->table_p[entry] != 0 ) {
+        common_requesterWheelRemove ( requester_p, request_p );
+        common_requesterUnhash ( requester_p, entry );
+        request_p->id = 0;
+        request_p->user_p = NULL;
+        request_p->next_p = requester_p->free_p;
+        requester_p->free_p = request_p;
+        requester_p->numInFlight--;
+        requester_p->numSent--;
+    }
+    mutexUnlock ( &requester_p->mutex );
+    return rc;
+}
+
+/*****************************************************************************
+ * common_requesterReceive
+ *****************************************************************************/
+BOOL
+common_requesterReceive ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p )
+{
+    const char     *correlationId_p;
+    const char     *char_p;
+    common_request_pt request_p;
+    UINT64          id = 0;
+    UINT64          entry;
+    UINT64          nowNs;
+    solClient_uint32_t index;
+
+    if ( !requester_p->guaranteed && !solClient_msg_isReplyMsg ( msg_p ) ) {
+        return FALSE;
+    }
+    nowNs = getTimeInNs (  );
+    if ( solClient_msg_getCorrelationId ( msg_p, &correlationId_p ) != SOLCLIENT_OK ) {
+        correlationId_p = "";
+    }
+    for ( char_p = correlationId_p; *char_p != ( char ) 0; char_p++ ) {
+        if ( ( *char_p >= '0' ) && ( *char_p <= '9' ) ) {
+            id = ( id << 4 ) | ( UINT64 ) ( *char_p - '0' );
+        } else if ( ( *char_p >= 'a' ) && ( *char_p <= 'f' ) ) {
+            id = ( id << 4 ) | ( UINT64 ) ( *char_p - 'a' + 10 );
+        } else {
+            id = 0;
+            break;
+        }
+    }
+
+    mutexLock ( &requester_p->mutex );
+    if ( ( id == 0 ) || ( ( index = requester_p->table_p[entry = common_requesterFind ( requester_p, id )] ) == 0 ) ) {
+        requester_p->numUnmatched++;
+        mutexUnlock ( &requester_p->mutex );
+        return TRUE;
+    }
+    request_p = &requester_p->requests_p[index - 1];
+    common_histogramRecord ( &requester_p->latency, nowNs - request_p->sendNs );
+    requester_p->numReplies++;
+    requester_p->lastReplyNs = nowNs;
+    common_requesterWheelRemove ( requester_p, request_p );
+    common_requesterComplete ( requester_p, request_p, entry, msg_p );
+    mutexUnlock ( &requester_p->mutex );
+    return TRUE;
+}
+
+/*****************************************************************************
+ * common_requesterDrain
+ *****************************************************************************/
+void
+common_requesterDrain ( common_requester_pt requester_p )
+{
+    mutexLock ( &requester_p->mutex );
+    while ( requester_p->numInFlight > 0 ) {
+        requester_p->waiting = TRUE;
+        condWait ( &requester_p->cond, &requester_p->mutex );
+        requester_p->waiting = FALSE;
+    }
+    mutexUnlock ( &requester_p->mutex );
+}
+
+/*****************************************************************************
+ * common_requesterDestroy
+ *****************************************************************************/
+void
+common_requesterDestroy ( common_requester_pt requester_p )
+{
+    if ( requester_p->requests_p == NULL ) {
+        return;
+    }
+    /*
+     * Stopping the timer here would not wait for a callback already running
+     * on the Context thread. Destroying the Context stops the timer and joins
+     * that thread, so nothing can hold the mutex any more.
+     */
+    condDestroy ( &requester_p->cond );
+    mutexDestroy ( &requester_p->mutex );
+    free ( requester_p->requests_p );
+    requester_p->requests_p = NULL;
+    free ( requester_p->table_p );
+    requester_p->table_p = NULL;
+}
+
+/*****************************************************************************
+ * common_requesterPrint
+ *****************************************************************************/
+void
+common_requesterPrint ( common_requester_pt requester_p )
+{
+    UINT64          elapsedNs = requester_p->lastReplyNs - requester_p->firstSendNs;
+
+    printf ( "Requests: %llu sent, %llu replied, %llu timed out, %llu unmatched replies, up to %d in flight\n",
+             ( unsigned long long ) requester_p->numSent, ( unsigned long long ) requester_p->numReplies,
+             ( unsigned long long ) requester_p->numTimedOut, ( unsigned long long ) requester_p->numUnmatched,
+             requester_p->window );
+    if ( ( requester_p->numReplies > 0 ) && ( elapsedNs > 0 ) ) {
+        printf ( "Completed %.0f requests/sec\n", ( double ) requester_p->numReplies * 1e9 / ( double ) elapsedNs );
+    }
+    common_histogramPrint ( &requester_p->latency, "Request round-trip latency" );
+}
+
+
+/*****************************************************************************
+ * common_replierServe
+ *
+ * Serve one request and measure how long it waited and how long it took.
+ *****************************************************************************/
+static void
+common_replierServe ( common_replierWorker_t *worker_p, common_replierRequest_t *request_p )
+{
+    common_replier_pt replier_p = worker_p->replier_p;
+    UINT64          startNs = getTimeInNs (  );
+    UINT64          endNs;
+
+    replier_p->func_p ( request_p->msg_p, request_p->flow_p, replier_p->user_p );
+    endNs = getTimeInNs (  );
+    common_histogramRecord ( worker_p->queueWait_p, startNs - request_p->rxNs );
+    common_histogramRecord ( worker_p->service_p, endNs - startNs );
+    worker_p->numReplies++;
+    worker_p->lastReplyNs = endNs;
+}
+
+/*****************************************************************************
+ * common_replierWorkerThread
+ *****************************************************************************/
+static          threadRetType
+common_replierWorkerThread ( void *user_p )
+{
+    common_replierWorker_t *worker_p = ( common_replierWorker_t * ) user_p;
+    common_replier_pt replier_p = worker_p->replier_p;
+    common_replierRequest_t request;
+
+    mutexLock ( &replier_p->mutex );
+    for ( ;; ) {
+        while ( ( replier_p->depth == 0 ) && !replier_p->stopping ) {
+            replier_p->numIdle++;
+            condWait ( &replier_p->notEmpty, &replier_p->mutex );
+            replier_p->numIdle--;
+        }
+        if ( replier_p->depth == 0 ) {
+            /* Stopping: pass the wake-up on to the next idle worker. */
+            condSignal ( &replier_p->notEmpty );
+            break;
+        }
+        request = replier_p->queue_p[replier_p->head];
+        replier_p->head = ( replier_p->head + 1 ) % replier_p->maxDepth;
+        replier_p->depth--;
+        if ( replier_p->pushWaiting ) {
+            condSignal ( &replier_p->notFull );
+        }
+        mutexUnlock ( &replier_p->mutex );
+
+        common_replierServe ( worker_p, &request );
+
+        mutexLock ( &replier_p->mutex );
+    }
+    mutexUnlock ( &replier_p->mutex );
+    return DEFAULT_THREAD_RETURN_ARG;
+}
+
+/*****************************************************************************
+ * common_replierStart
+ *****************************************************************************/
+solClient_returnCode_t
+common_replierStart ( common_replier_pt replier_p, int numWorkers, int maxDepth,
+                      common_replierFunc_t func_p, void *user_p )
+{
+    common_replierWorker_t *worker_p;
+    int             loop;
+
+    memset ( replier_p, 0, sizeof ( *replier_p ) );
+    if ( ( numWorkers < 1 ) || ( numWorkers > COMMON_REPLIER_MAX_WORKERS ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Number of replier workers %d must be 1 to %d",
+                        numWorkers, COMMON_REPLIER_MAX_WORKERS );
+        return SOLCLIENT_FAIL;
+    }
+    replier_p->func_p = func_p;
+    replier_p->user_p = user_p;
+    replier_p->maxDepth = ( maxDepth > 0 ) ? maxDepth : COMMON_REPLIER_DEFAULT_DEPTH;
+    if ( ( replier_p->queue_p = ( common_replierRequest_t * ) calloc ( ( size_t ) replier_p->maxDepth,
+                                                                       sizeof ( common_replierRequest_t ) ) ) == NULL ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate a replier queue of %d requests", replier_p->maxDepth );
+        return SOLCLIENT_FAIL;
+    }
+    mutexInit ( &replier_p->mutex );
+    condInit ( &replier_p->notEmpty );
+    condInit ( &replier_p->notFull );
+    for ( loop = 0; loop < numWorkers; loop++ ) {
+        worker_p = &replier_p->worker[loop];
+        worker_p->replier_p = replier_p;
+        worker_p->queueWait_p = ( common_histogram_pt ) malloc ( sizeof ( common_histogram_t ) );
+        worker_p->service_p = ( common_histogram_pt ) malloc ( sizeof ( common_histogram_t ) );
+        if ( ( worker_p->queueWait_p == NULL ) || ( worker_p->service_p == NULL ) ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate the histograms of replier worker %d", loop );
+            goto startFailed;
+        }
+        common_histogramInit ( worker_p->queueWait_p );
+        common_histogramInit ( worker_p->service_p );
+        if ( ( worker_p->thread = startThread ( common_replierWorkerThread, worker_p ) ) == _NULL_THREAD_ID ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not start replier worker thread %d", loop );
+            goto startFailed;
+        }
+        replier_p->numWorkers = loop + 1;
+    }
+    return SOLCLIENT_OK;
+
+  startFailed:
+    common_replierStop ( replier_p );
+    common_replierDestroy ( replier_p );
+    return SOLCLIENT_FAIL;
+}
+
+/*****************************************************************************
+ * common_replierPush
+ *****************************************************************************/
+void
+common_replierPush ( common_replier_pt replier_p, solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p )
+{
+    common_replierRequest_t *request_p;
+    UINT64          nowNs = getTimeInNs (  );
+
+    mutexLock ( &replier_p->mutex );
+    if ( replier_p->stopping ) {
+        replier_p->numInline++;
+        mutexUnlock ( &replier_p->mutex );
+        replier_p->func_p ( msg_p, opaqueFlow_p, replier_p->user_p );
+        return;
+    }
+    if ( replier_p->depth == replier_p->maxDepth ) {
+        replier_p->numFull++;
+        do {
+            replier_p->pushWaiting = TRUE;
+            condWait ( &replier_p->notFull, &replier_p->mutex );
+            replier_p->pushWaiting = FALSE;
+        } while ( replier_p->depth == replier_p->maxDepth );
+    }
+    request_p = &replier_p->queue_p[( replier_p->head + replier_p->depth ) % replier_p->maxDepth];
+    request_p->msg_p = msg_p;
+    request_p->flow_p = opaqueFlow_p;
+    request_p->rxNs = nowNs;
+    if ( ++replier_p->depth > replier_p->deepest ) {
+        replier_p->deepest = replier_p->depth;
+    }
+    if ( replier_p->numQueued++ == 0 ) {
+        replier_p->firstRxNs = nowNs;
+    }
+    if ( replier_p->numIdle > 0 ) {
+        condSignal ( &replier_p->notEmpty );
+    }
+    mutexUnlock ( &replier_p->mutex );
+}
+
+/*****************************************************************************
+ * common_replierStop
+ *****************************************************************************/
+void
+common_replierStop ( common_replier_pt replier_p )
+{
+    int             loop;
+
+    mutexLock ( &replier_p->mutex );
+    replier_p->stopping = TRUE;
+    condSignal ( &replier_p->notEmpty );
+    mutexUnlock ( &replier_p->mutex );
+    for ( loop = 0; loop < replier_p->numWorkers; loop++ ) {
+        waitOnThread ( replier_p->worker[loop].thread );
+    }
+}
+
+/*****************************************************************************
+ * common_replierPrint
+ *****************************************************************************/
+void
+common_replierPrint ( common_replier_pt replier_p )
+{
+    common_replierWorker_t *worker_p;
+    common_histogram_pt queueWait_p;
+    common_histogram_pt service_p;
+    UINT64          numReplies = 0;
+    UINT64          lastReplyNs = 0;
+    int             loop;
+
+    for ( loop = 0; loop < replier_p->numWorkers; loop++ ) {
+        worker_p = &replier_p->worker[loop];
+        printf ( "Worker %d: served %llu requests\n", loop, ( unsigned long long ) worker_p->numReplies );
+        numReplies += worker_p->numReplies;
+        if ( worker_p->lastReplyNs > lastReplyNs ) {
+            lastReplyNs = worker_p->lastReplyNs;
+        }
+    }
+    printf ( "Served %llu requests", ( unsigned long long ) numReplies );
+    if ( ( numReplies > 0 ) && ( lastReplyNs > replier_p->firstRxNs ) ) {
+        printf ( " at %.0f replies/sec", ( double ) numReplies * 1e9 / ( double ) ( lastReplyNs - replier_p->firstRxNs ) );
+    }
+    printf ( ", queue of %d full %llu times, at most %d queued\n", replier_p->maxDepth,
+             ( unsigned long long ) replier_p->numFull, replier_p->deepest );
+    if ( replier_p->numInline != 0 ) {
+        printf ( "Served %llu requests on the receiving thread after the workers stopped\n",
+                 ( unsigned long long ) replier_p->numInline );
+    }
+
+    /* The workers' histograms are combined into the first worker's. */
+    queueWait_p = replier_p->worker[0].queueWait_p;
+    service_p = replier_p->worker[0].service_p;
+    if ( ( queueWait_p == NULL ) || ( service_p == NULL ) ) {
+        return;
+    }
+    for ( loop = 1; loop < replier_p->numWorkers; loop++ ) {
+        common_histogramAdd ( queueWait_p, replier_p->worker[loop].queueWait_p );
+        common_histogramInit ( replier_p->worker[loop].queueWait_p );
+        common_histogramAdd ( service_p, replier_p->worker[loop].service_p );
+        common_histogramInit ( replier_p->worker[loop].service_p );
+    }
+    common_histogramPrint ( queueWait_p, "Queue wait" );
+    common_histogramPrint ( service_p, "Service time" );
+}
+
+/*****************************************************************************
+ * common_replierDestroy
+ *****************************************************************************/
+void
+common_replierDestroy ( common_replier_pt replier_p )
+{
+    int             loop;
+
+    if ( replier_p->queue_p == NULL ) {
+        return;
+    }
+    for ( loop = 0; loop < COMMON_REPLIER_MAX_WORKERS; loop++ ) {
+        if ( replier_p->worker[loop].queueWait_p != NULL ) {
+            free ( replier_p->worker[loop].queueWait_p );
+            replier_p->worker[loop].queueWait_p = NULL;
+        }
+        if ( replier_p->worker[loop].service_p != NULL ) {
+            free ( replier_p->worker[loop].service_p );
+            replier_p->worker[loop].service_p = NULL;
+        }
+    }
+    condDestroy ( &replier_p->notFull );
+    condDestroy ( &replier_p->notEmpty );
+    mutexDestroy ( &replier_p->mutex );
+    free ( replier_p->queue_p );
+    replier_p->queue_p = NULL;
+}
+
+
+/*****************************************************************************
+ * Request-Reply: Convert operator type to string
+ ******************************************************************************/
+const char *
+RR_operationToString ( RR_operation_t operation )
+{
+    static char    *plusString = "PLUS";
+    static char    *minusString = "MINUS";
+    static char    *timesString = "TIMES";
+    static char    *divideString = "DIVIDED_BY";
+    static char    *unknownString = "UNKNOWN";
+
+    switch ( operation ) {
+        case plusOperation:
+            return plusString;
+        case minusOperation:
+            return minusString;
+        case timesOperation:
+            return timesString;
+        case divideOperation:
+            return divideString;
+        default:
+            return unknownString;
+    }
+}
+
+/*****************************************************************************
+ * Request-Reply: Calculate the result of an operation
+ ******************************************************************************/
+BOOL
+RR_calculate ( RR_operation_t operation, solClient_int32_t operand1, solClient_int32_t operand2, double *result_p )
+{
+    switch ( operation ) {
+        case plusOperation:
+            *result_p = ( double ) operand1 + ( double ) operand2;
+            return TRUE;
+        case minusOperation:
+            *result_p = ( double ) operand1 - ( double ) operand2;
+            return TRUE;
+        case timesOperation:
+            *result_p = ( double ) operand1 * ( double ) operand2;
+            return TRUE;
+        case divideOperation:
+            if ( operand2 != 0 ) {
+                *result_p = ( double ) operand1 / ( double ) operand2;
+                return TRUE;
+            }
+            return FALSE;
+        default:
+            return FALSE;
+    }
+}
+
+/*****************************************************************************
+ * RR_batcherInit
+ *****************************************************************************/
+void
+RR_batcherInit ( RR_batcher_pt batcher_p, int maxOps, int budgetUs )
+{
+    batcher_p->numOps = 0;
+    batcher_p->maxOps = ( maxOps < 1 ) ? 1 : ( maxOps > RR_BATCH_MAX_OPS ) ? RR_BATCH_MAX_OPS : maxOps;
+    batcher_p->budgetNs = ( UINT64 ) budgetUs * 1000;
+    batcher_p->firstNs = 0;
+}
+
+/*****************************************************************************
+ * RR_batcherAdd
+ *****************************************************************************/
+BOOL
+RR_batcherAdd ( RR_batcher_pt batcher_p, RR_operation_t operation, solClient_int32_t operand1,
+                solClient_int32_t operand2, UINT64 nowNs )
+{
+    RR_op_t        *op_p = &batcher_p->ops[batcher_p->numOps];
+
+    if ( batcher_p->numOps++ == 0 ) {
+        batcher_p->firstNs = nowNs;
+    }
+    op_p->operation = ( solClient_int8_t ) operation;
+    op_p->operand1 = operand1;
+    op_p->operand2 = operand2;
+    return ( batcher_p->numOps >= batcher_p->maxOps ) || ( nowNs - batcher_p->firstNs >= batcher_p->budgetNs );
+}
+
+/*****************************************************************************
+ * RR_batcherDue
+ *****************************************************************************/
+BOOL
+RR_batcherDue ( RR_batcher_pt batcher_p, UINT64 untilNs )
+{
+    return ( batcher_p->numOps > 0 ) && ( untilNs >= batcher_p->firstNs + batcher_p->budgetNs );
+}
+
+/*****************************************************************************
+ * RR_batcherEncode
+ *****************************************************************************/
+solClient_returnCode_t
+RR_batcherEncode ( RR_batcher_pt batcher_p, solClient_opaqueMsg_pt msg_p, UINT64 * firstNs_p )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueContainer_pt stream_p;
+    RR_op_t        *op_p;
+    int             numOps = batcher_p->numOps;
+
+    *firstNs_p = batcher_p->firstNs;
+    batcher_p->numOps = 0;
+    /* Each operation takes 13 bytes encoded; size the stream so it is not reallocated. */
+    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( msg_p, &stream_p, 16 + 13 * numOps ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+        return rc;
+    }
+    if ( ( rc = solClient_container_addUint32 ( stream_p, ( solClient_uint32_t ) numOps, NULL ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_container_addUint32()" );
+        return rc;
+    }
+    for ( op_p = batcher_p->ops; op_p < &batcher_p->ops[numOps]; op_p++ ) {
+        if ( ( ( rc = solClient_container_addInt8 ( stream_p, op_p->operation, NULL ) ) != SOLCLIENT_OK ) ||
+             ( ( rc = solClient_container_addInt32 ( stream_p, op_p->operand1, NULL ) ) != SOLCLIENT_OK ) ||
+             ( ( rc = solClient_container_addInt32 ( stream_p, op_p->operand2, NULL ) ) != SOLCLIENT_OK ) ) {
+            common_handleError ( rc, "solClient_container_add()" );
+            return rc;
+        }
+    }
+    return SOLCLIENT_OK;
+}
+
+/*****************************************************************************
+ * RR_batchReply
+ *****************************************************************************/
+solClient_returnCode_t
+RR_batchReply ( solClient_opaqueContainer_pt stream_p, solClient_uint32_t numOps, solClient_opaqueMsg_pt replyMsg_p )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueContainer_pt replyStream_p;
+    solClient_int8_t operation;
+    solClient_int32_t operand1;
+    solClient_int32_t operand2;
+    BOOL            readOk = TRUE;
+    solClient_bool_t resultOk;
+    double          result = 0.0;
+    solClient_uint32_t loop;
+
+    if ( numOps > RR_BATCH_MAX_OPS ) {
+        numOps = RR_BATCH_MAX_OPS;
+    }
+    /* Each status and result takes 11 bytes encoded. */
+    if ( ( rc = solClient_msg_createBinaryAttachmentStream ( replyMsg_p, &replyStream_p, 16 + 11 * numOps ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_createBinaryAttachmentStream()" );
+        return rc;
+    }
+    if ( ( rc = solClient_container_addUint32 ( replyStream_p, numOps, NULL ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_container_addUint32()" );
+        return rc;
+    }
+    for ( loop = 0; loop < numOps; loop++ ) {
+        /* Once the request is found to be short, the rest of its operations fail. */
+        if ( readOk &&
+             ( ( solClient_container_getInt8 ( stream_p, &operation, NULL ) != SOLCLIENT_OK ) ||
+               ( solClient_container_getInt32 ( stream_p, &operand1, NULL ) != SOLCLIENT_OK ) ||
+               ( solClient_container_getInt32 ( stream_p, &operand2, NULL ) != SOLCLIENT_OK ) ) ) {
+            solClient_log ( SOLCLIENT_LOG_WARNING, "Batched request holds fewer than %u operations", numOps );
+            readOk = FALSE;
+        }
+        resultOk = readOk && RR_calculate ( ( RR_operation_t ) operation, operand1, operand2, &result );
+        if ( ( ( rc = solClient_container_addBoolean ( replyStream_p, resultOk, NULL ) ) != SOLCLIENT_OK ) ||
+             ( ( rc = solClient_container_addDouble ( replyStream_p, resultOk ? result : 0.0, NULL ) ) != SOLCLIENT_OK ) ) {
+            common_handleError ( rc, "solClient_container_add()" );
+            return rc;
+        }
+    }
+    return SOLCLIENT_OK;
 }
 
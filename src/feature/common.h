@@ -84,6 +84,25 @@ enum flowMode
 #define USE_GSS_MASK           0x0400      /**< Enable Kerberos option. */
 #define ZIP_LEVEL_MASK         0x0800      /**< Zip Compression Level option. */
 #define REPLAY_START_MASK      0x1000      /**< Replay Start Location option. */
+#define HIST_FILE_MASK         0x2000      /**< Latency Histogram File option. */
+#define NUM_CONTEXTS_MASK      0x4000      /**< Number of Contexts option. */
+#define NUM_SESSIONS_MASK      0x8000      /**< Number of Sessions per Context option. */
+#define ARRIVAL_MASK           0x10000     /**< Open-loop Arrival Mode option. */
+#define SPIN_BUDGET_MASK       0x20000     /**< Pacer Spin Budget option. */
+#define USE_TSC_MASK           0x40000     /**< Time Stamp Counter Clock option. */
+#define STATS_SAMPLE_MASK      0x80000     /**< Statistics Sampler options. */
+#define SWEEP_MASK             0x100000    /**< Parameter Sweep options. */
+#define PAYLOAD_MASK           0x200000    /**< Payload Generator and Message Ring options. */
+#define NON_BLOCKING_MASK      0x400000    /**< Non-blocking Send option. */
+#define ACK_LATENCY_MASK       0x800000    /**< Acknowledgement Latency option. */
+#define AUTOTUNE_MASK          0x1000000   /**< Publish Window Autotune option. */
+#define SHARDS_MASK            0x2000000   /**< Sharded Destinations option. */
+#define RUN_CONTROL_MASK       0x4000000   /**< Duration, Warm-up and Cool-down options. */
+#define ACK_BATCH_MASK         0x8000000   /**< Coalesced Flow Acknowledgement option. */
+#define WORKERS_MASK           0x10000000  /**< Worker Thread Hand-off option. */
+#define FLOWS_MASK             0x20000000  /**< Multiple Flows option. */
+#define LATENCY_MASK           0x40000000  /**< One-way Latency option. */
+#define RR_BATCH_MASK          0x80000000  /**< Batched Request-Reply Operations option. */
 
 /*@}*/
 
@@ -110,6 +129,56 @@ enum flowMode
 #define USE_GSS_STRING           "\t-g, --gss           Use GSS (Kerberos) authentication. When specified the '--cu' option is ignored.\n"
 #define ZIP_LEVEL_STRING         "\t-z, --zip           Enable compression (set compress level=9 for SolOS-TR appliances only).\n"
 #define REPLAY_START_STRING      "\t-R, --replay=replay Replay Start Location String (BEGINNING or RFC3339 time stamtp).\n"
+#define HIST_FILE_STRING         "\t-H, --hist=file     Latency histogram output file.\n"
+#define NUM_CONTEXTS_STRING      "\t-C, --contexts=n    Number of Contexts, each with its own Context thread (default 1).\n"
+#define NUM_SESSIONS_STRING      "\t-S, --sessions=n    Number of Sessions per Context (default 1).\n"
+#define ARRIVAL_STRING           "\t-A, --arrival=mode  Open-loop send schedule, 'constant' or 'poisson' arrivals at the Message Rate\n"\
+                                 "\t                    (default: closed-loop pacing).\n"
+#define SPIN_BUDGET_STRING       "\t-B, --spin=us       Microseconds at the end of each send wait to spin rather than sleep;\n"\
+                                 "\t                    0 to only sleep (default 50).\n"
+#define USE_TSC_STRING           "\t-T, --tsc           Time with the calibrated CPU time stamp counter when it is invariant.\n"
+#define STATS_SAMPLE_STRING      "\t-i, --sample=ms     Sample Session statistics every 'ms' milliseconds.\n"\
+                                 "\t-F, --sample-file=file Write statistics samples to a file, as JSON lines if the name\n"\
+                                 "\t                    ends in '.json', otherwise as CSV (default: CSV to stdout).\n"
+#define SWEEP_STRING             "\t-W, --sweep=spec    Run a grid of tests in one process. 'spec' is a ':' separated list of\n"\
+                                 "\t                    'name=value,value...' where name is size, rate, threads, nodelay,\n"\
+                                 "\t                    multi or warmup (e.g. 'size=100,1000:rate=10000,50000:multi=false,true').\n"\
+                                 "\t-O, --sweep-file=file CSV file for the sweep results (default: perfTest_sweep.csv).\n"
+#define PAYLOAD_STRING           "\t-P, --payload=type  Payload content, 'zero', 'random', 'text' or 'file:name' to repeat\n"\
+                                 "\t                    the contents of a file (default: zero).\n"\
+                                 "\t-k, --ring=n        Number of pre-built messages each publisher cycles through (default 64).\n"
+#define NON_BLOCKING_STRING      "\t-N, --nonblock      Send without blocking; park the publisher only when every Session's\n"\
+                                 "\t                    publish window is closed and resume on the CAN_SEND event.\n"
+#define ACK_LATENCY_STRING       "\t-K, --ack=mode      Use 'per-msg' or 'windowed' acknowledgement events. The perf\n"\
+                                 "\t                    publishers record send to acknowledgement latency with them.\n"
+#define AUTOTUNE_STRING          "\t-U, --autotune=spec Step through publish window sizes, acknowledgement event modes and\n"\
+                                 "\t                    payload sizes and report the fastest configuration within an\n"\
+                                 "\t                    acknowledgement latency budget. 'spec' is a ':' separated list of\n"\
+                                 "\t                    'name=value,value...' where name is window, ack, size, budget (p99 usec)\n"\
+                                 "\t                    or msgs (per round) (e.g. 'window=16,64,255:size=100,1024:budget=5000').\n"
+#define SHARDS_STRING            "\t-E, --shards=n[,hash][,threads] Spread messages over n destinations named\n"\
+                                 "\t                    'Topic/0' to 'Topic/n-1', round-robin or by the hash of a synthetic\n"\
+                                 "\t                    message key. With 'threads' each destination gets its own Session\n"\
+                                 "\t                    and publisher thread, which share the messages and the Message Rate.\n"
+#define RUN_CONTROL_STRING       "\t-D, --duration=s    Run for a time rather than a Number of Messages, and report rates and\n"\
+                                 "\t                    latencies measured over the 's' seconds that follow the warm-up.\n"\
+                                 "\t-e, --warmup=s      Seconds to run before measuring starts (default 0, needs --duration).\n"\
+                                 "\t-o, --cooldown=s    Seconds to keep running after measuring ends (default 0, needs --duration).\n"
+#define ACK_BATCH_STRING         "\t-b, --ack-batch=n[,us] Acknowledge received Guaranteed messages in batches of up to n,\n"\
+                                 "\t                    sending a partial batch once its oldest message has waited 'us'\n"\
+                                 "\t                    microseconds (default 1, every message acknowledged as it arrives).\n"
+#define WORKERS_STRING           "\t-j, --workers=n[,depth] Hand received messages to n worker threads instead of processing\n"\
+                                 "\t                    them on the Context thread (default 0). Repliers queue up to 'depth'\n"\
+                                 "\t                    requests for their workers (default 1024).\n"
+#define FLOWS_STRING             "\t-L, --flows=k[,shared][,sessions] Bind k Flows, to the Queues 'Queue/0' to\n"\
+                                 "\t                    'Queue/k-1', or with 'shared' all to the one non-exclusive Queue.\n"\
+                                 "\t                    With 'sessions' each Flow gets its own Session and Context thread.\n"
+#define LATENCY_STRING           "\t-y, --latency=src   Measure one-way latency from the send time each message carries:\n"\
+                                 "\t                    'stamp' for a nanosecond monotonic clock stamp (publisher and\n"\
+                                 "\t                    subscriber on one host) or 'sender' for the millisecond sender\n"\
+                                 "\t                    and receive timestamps (clocks synchronized across hosts).\n"
+#define RR_BATCH_STRING          "\t-x, --batch=n[,us]  Send up to n operations in each request, sending a partial batch\n"\
+                                 "\t                    once its oldest operation has waited 'us' microseconds (default 1000).\n"
 
 /*@}*/
 
@@ -127,13 +196,41 @@ struct commonOptions
     char            destinationName[SOLCLIENT_BUFINFO_MAX_TOPIC_SIZE + 1];
     char            cacheName[SOLCLIENT_CACHESESSION_MAX_CACHE_NAME_SIZE + 1];
     char            replayStartLocation[250];
+    char            histFile[256];
     BOOL            usingTopic;
     BOOL            usingAD;
     int             numMsgsToSend;
     int             msgRate;
     int             gdWindow;
-    int             requiredFields;
-    int             optionalFields;
+    int             numContexts;
+    int             numSessions;
+    int             arrivalMode;
+    int             spinBudgetUs;
+    BOOL            useTsc;
+    int             sampleIntervalMs;
+    char            sampleFile[256];
+    char            sweepSpec[256];
+    char            sweepFile[256];
+    int             payloadType;
+    char            payloadFile[256];
+    int             ringSize;
+    BOOL            nonBlocking;
+    int             ackEventMode;
+    char            autotuneSpec[256];
+    char            shardSpec[64];
+    int             durationSec;
+    int             warmupSec;
+    int             cooldownSec;
+    int             ackBatchMsgs;
+    int             ackBatchUs;
+    int             numWorkers;
+    int             workerQueueDepth;
+    char            flowSpec[64];
+    int             latencySource;
+    int             rrBatchOps;
+    int             rrBatchUs;
+    unsigned int    requiredFields;
+    unsigned int    optionalFields;
     solClient_log_level_t logLevel;
     BOOL            usingDurable;
     BOOL            enableCompression;
@@ -327,6 +424,53 @@ solClient_rxMsgCallback_returnCode_t
     common_flowMessageReceiveAckCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p );
 
 
+/**
+ * A callback for received messages on a Flow. The callback is registered for 
+ * a Flow and is called whenever a message is received.
+ * This callback acknowledges received messages in batches through the
+ * common_ackCoalescer_t given as the user pointer (see common_ackCoalescerAdd()).
+ * Close the coalescer before the Flow is destroyed, and destroy it only after
+ * the Flow's Context is gone.
+ * @param opaqueFlow_p A pointer to the Flow receiving the message.
+ * This pointer is never NULL.
+ * @param msg_p A pointer to the received message. This pointer is never NULL.
+ * @param user_p A pointer to the common_ackCoalescer_t of the Flow.
+ * @return ::SOLCLIENT_CALLBACK_OK
+ */
+solClient_rxMsgCallback_returnCode_t
+    common_flowMessageReceiveCoalescedAckCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p );
+
+
+/**
+ * A callback for Flow events for a Flow registered with
+ * common_flowMessageReceiveCoalescedAckCallback(). It acknowledges the held
+ * messages of the common_ackCoalescer_t given as the user pointer, then
+ * handles the event as common_flowEventCallback() does.
+ * @param opaqueFlow_p A pointer to the Flow to which the event applies.
+ * This pointer is never NULL.
+ * @param eventInfo_p A pointer to information about the Flow event.
+ * This pointer is never NULL.
+ * @param user_p A pointer to the common_ackCoalescer_t of the Flow.
+ */
+void
+    common_flowCoalescedAckEventCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_flow_eventCallbackInfo_pt eventInfo_p, void *user_p );
+
+
+/**
+ * A callback for received messages on a Flow. The callback is registered for 
+ * a Flow and is called whenever a message is received.
+ * This callback hands the message to the common_handoff_t given as the user
+ * pointer, to be processed, freed and acknowledged on a worker thread.
+ * @param opaqueFlow_p A pointer to the Flow receiving the message.
+ * This pointer is never NULL.
+ * @param msg_p A pointer to the received message. This pointer is never NULL.
+ * @param user_p A pointer to the common_handoff_t of the Flow.
+ * @return ::SOLCLIENT_CALLBACK_TAKE_MSG
+ */
+solClient_rxMsgCallback_returnCode_t
+    common_flowMessageReceiveHandoffCallback ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p );
+
+
 /**
  * Initialze struct commonOptions, used by all examples before parsing 
  * the command line.
@@ -334,8 +478,8 @@ solClient_rxMsgCallback_returnCode_t
  */
 void
     common_initCommandOptions ( struct commonOptions *commonOpt, 
-                            int requiredParams,
-                            int optionals);
+                            unsigned int requiredParams,
+                            unsigned int optionals);
 
 /**
  * A callback for received messages on a Flow. The callback is registered for 
@@ -384,6 +528,22 @@ solClient_rxMsgCallback_returnCode_t
     common_messageReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p );
 
 
+/**
+ * A callback for received messages by a Session. The callback is registered
+ * for a Session and is called whenever a message is received.
+ * This callback hands the message to the common_handoff_t given as the user
+ * pointer, to be processed and freed on a worker thread.
+ * @param opaqueSession_p A pointer to the Session receiving the message.
+ * This pointer is never NULL.
+ * @param msg_p A pointer to the received message. This pointer is never 
+ * NULL.
+ * @param user_p A pointer to the common_handoff_t of the Session.
+ * @return ::SOLCLIENT_CALLBACK_TAKE_MSG
+ */
+solClient_rxMsgCallback_returnCode_t
+    common_messageReceiveHandoffCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p );
+
+
 /**
  * A callback for received messages by a Session. The callback is registered
  * for a Session and is called whenever a message is received.
@@ -418,6 +578,1370 @@ solClient_rxMsgCallback_returnCode_t
     common_messageReceivePerfCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p );
 
 
+/**
+ * @anchor latencyHistogram
+ * @name Latency Histogram
+ * A log-bucketed (HDR style) histogram used to record latencies. Values below
+ * 2^(COMMON_HISTOGRAM_SUB_BUCKET_BITS + 1) are recorded exactly; larger values are
+ * recorded with COMMON_HISTOGRAM_SUB_BUCKET_BITS significant bits, which bounds
+ * the relative error to less than 1%. Any 64-bit value can be recorded.
+ */
+
+/*@{*/
+
+#define COMMON_HISTOGRAM_SUB_BUCKET_BITS 7     /**< Significant bits kept per recorded value. */
+#define COMMON_HISTOGRAM_NUM_BUCKETS     ( ( 64 - COMMON_HISTOGRAM_SUB_BUCKET_BITS + 1 ) << COMMON_HISTOGRAM_SUB_BUCKET_BITS ) /**< Number of counters. */
+
+/*@}*/
+
+/**
+ * @struct common_histogram
+ * A latency histogram. Values are recorded in nanoseconds and reported in
+ * microseconds. A histogram is not thread safe; use one per recording thread
+ * and combine them with common_histogramAdd().
+ */
+typedef struct common_histogram
+{
+
+    UINT64          counts[COMMON_HISTOGRAM_NUM_BUCKETS];   /**< count of values recorded in each bucket */
+
+    UINT64          totalCount;             /**< number of values recorded */
+
+    UINT64          minValue;               /**< smallest value recorded */
+
+    UINT64          maxValue;               /**< largest value recorded */
+
+    long double     sum;                    /**< sum of all values recorded, for the mean */
+} common_histogram_t, *common_histogram_pt;
+
+
+/**
+ * Initialize (or reset) a histogram to hold no values.
+ * @param hist_p A pointer to the histogram.
+ */
+void
+    common_histogramInit ( common_histogram_pt hist_p );
+
+/**
+ * Record one value in a histogram.
+ * @param hist_p A pointer to the histogram.
+ * @param value The value to record, in nanoseconds.
+ */
+void
+    common_histogramRecord ( common_histogram_pt hist_p, UINT64 value );
+
+/**
+ * Add all values recorded in one histogram to another.
+ * @param hist_p A pointer to the histogram to add to.
+ * @param from_p A pointer to the histogram to add from.
+ */
+void
+    common_histogramAdd ( common_histogram_pt hist_p, common_histogram_pt from_p );
+
+/**
+ * Get the value at a given percentile of a histogram. The returned value is
+ * the highest value that is equivalent to the percentile's bucket.
+ * @param hist_p A pointer to the histogram.
+ * @param percentile The percentile, in the range 0.0 to 100.0.
+ * @return The value in nanoseconds, or 0 if the histogram is empty.
+ */
+UINT64
+    common_histogramValueAtPercentile ( common_histogram_pt hist_p, double percentile );
+
+/**
+ * Print the min, mean, p50, p90, p99, p99.9, p99.99 and max of a histogram
+ * to STDOUT, in microseconds.
+ * @param hist_p A pointer to the histogram.
+ * @param title_p A title to print before the values.
+ */
+void
+    common_histogramPrint ( common_histogram_pt hist_p, const char *title_p );
+
+/**
+ * Write the full percentile distribution of a histogram to a file, in the
+ * text format produced by HdrHistogram so it can be plotted by the same tools.
+ * Values are in microseconds.
+ * @param hist_p A pointer to the histogram.
+ * @param fileName_p The name of the file to write.
+ * @return 1 on success, 0 if the file could not be written.
+ */
+int
+    common_histogramDump ( common_histogram_pt hist_p, const char *fileName_p );
+
+
+/**
+ * @anchor openLoopSchedule
+ * @name Open-Loop Send Schedule
+ * An open-loop schedule computes the intended send time of every message up
+ * front, independent of how long earlier sends took. A sender that falls
+ * behind sends the late messages as soon as it can instead of resetting the
+ * schedule, and latency measured from the intended send time then includes
+ * the time a message waited because the sender was behind (coordinated
+ * omission). How far behind each send was is recorded in a histogram.
+ */
+
+/*@{*/
+
+#define COMMON_ARRIVAL_CLOSED   0           /**< No open-loop schedule; the sender paces itself. */
+#define COMMON_ARRIVAL_CONSTANT 1           /**< Constant interval between intended send times. */
+#define COMMON_ARRIVAL_POISSON  2           /**< Exponentially distributed intervals (Poisson arrivals). */
+
+/*@}*/
+
+/**
+ * @struct common_schedule
+ * The state of an open-loop schedule. A schedule is not thread safe; use one
+ * per sending thread.
+ */
+typedef struct common_schedule
+{
+
+    UINT64          nextTimeNs;             /**< intended send time of the next message, from getTimeInNs() */
+
+    double          intervalNs;             /**< mean interval between intended send times */
+
+    double          remainderNs;            /**< fractional nanoseconds carried to the next interval */
+
+    int             arrivalMode;            /**< COMMON_ARRIVAL_CONSTANT or COMMON_ARRIVAL_POISSON */
+
+    UINT64          randState;              /**< random number state for Poisson arrivals */
+
+    common_histogram_t lagHist;             /**< how late each message was sent, in nanoseconds */
+
+    pacer_t         pacer;                  /**< waits for the intended send times */
+} common_schedule_t, *common_schedule_pt;
+
+
+/**
+ * Initialize an open-loop schedule. The first message is intended to be sent
+ * immediately.
+ * @param schedule_p A pointer to the schedule.
+ * @param rate The mean number of messages per second.
+ * @param arrivalMode COMMON_ARRIVAL_CONSTANT or COMMON_ARRIVAL_POISSON.
+ * @param seed The random number seed for Poisson arrivals; use a different
+ * seed for each sending thread.
+ * @param spinBudgetUs The spin budget of the pacer used to wait (see pacerInit()).
+ */
+void
+    common_scheduleInit ( common_schedule_pt schedule_p, unsigned int rate, int arrivalMode, UINT64 seed,
+                          int spinBudgetUs );
+
+/**
+ * Wait until the intended send time of the next message, record how late
+ * the caller is for it and advance the schedule. Returns immediately if the
+ * caller is already behind.
+ * @param schedule_p A pointer to the schedule.
+ * @return The intended send time of the message, from getTimeInNs().
+ */
+UINT64
+    common_scheduleWait ( common_schedule_pt schedule_p );
+
+/**
+ * If the intended send time of the next message has already passed, record
+ * how late the caller is for it and advance the schedule. This never waits,
+ * and is used to gather the messages that are due into one batch.
+ * @param schedule_p A pointer to the schedule.
+ * @param intendedTime_p Set to the intended send time of the message.
+ * @return 1 if a message is due, otherwise 0.
+ */
+int
+    common_scheduleTake ( common_schedule_pt schedule_p, UINT64 *intendedTime_p );
+
+/**
+ * Parse an arrival mode name.
+ * @param mode_p 'constant' or 'poisson'.
+ * @return COMMON_ARRIVAL_CONSTANT, COMMON_ARRIVAL_POISSON, or -1 if the name is not known.
+ */
+int
+    common_scheduleParseArrivalMode ( const char *mode_p );
+
+
+/**
+ * @struct common_statsSampler
+ * A statistics sampler. A repeating Context timer reads the receive and
+ * transmit statistics of a set of Sessions, sums them, and writes the change
+ * of every counter since the previous sample as one CSV or JSON line, with
+ * the message, byte, would-block and socket-full rates first.
+ * Statistics cleared by the application while sampling are handled as a
+ * counter restarting from zero.
+ */
+typedef struct common_statsSampler
+{
+
+    solClient_opaqueContext_pt context_p;   /**< the Context whose timer drives the sampler */
+
+    solClient_context_timerId_t timerId;    /**< the repeating timer */
+
+    solClient_opaqueSession_pt *sessions_p; /**< the Sessions whose statistics are summed */
+
+    int             numSessions;            /**< number of Sessions in sessions_p */
+
+    FILE           *file_p;                 /**< where the samples are written */
+
+    BOOL            json;                   /**< TRUE for JSON lines, FALSE for CSV */
+
+    MUTEX_T         mutex;                  /**< serializes the timer with common_statsSamplerStop() */
+
+    BOOL            initialized;            /**< TRUE from common_statsSamplerStart() until common_statsSamplerDestroy() */
+
+    UINT64          startTimeNs;            /**< getTimeInNs() when sampling started */
+
+    UINT64          lastTimeNs;             /**< getTimeInNs() at the previous sample */
+
+    solClient_stats_t lastRxStats[SOLCLIENT_STATS_RX_NUM_STATS];     /**< receive statistics at the previous sample */
+
+    solClient_stats_t lastTxStats[SOLCLIENT_STATS_TX_NUM_STATS];     /**< transmit statistics at the previous sample */
+} common_statsSampler_t, *common_statsSampler_pt;
+
+
+/**
+ * Start sampling the statistics of a set of Sessions.
+ * @param sampler_p A pointer to the sampler.
+ * @param context_p The Context to run the sampling timer in.
+ * @param sessions_p An array of Sessions, which must remain valid until
+ * common_statsSamplerStop() returns.
+ * @param numSessions The number of Sessions in sessions_p.
+ * @param intervalMs The sampling interval, in milliseconds.
+ * @param fileName_p The file to write to, as JSON lines if the name ends in
+ * '.json' and otherwise as CSV; NULL or empty for CSV to STDOUT.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_statsSamplerStart ( common_statsSampler_pt sampler_p, solClient_opaqueContext_pt context_p,
+                               solClient_opaqueSession_pt * sessions_p, int numSessions, int intervalMs,
+                               const char *fileName_p );
+
+/**
+ * Stop sampling, write a final sample and close the sampler's file. The timer
+ * callback may still be running in the Context thread, so the sampler is not
+ * freed until common_statsSamplerDestroy(). Stopping a sampler that is already
+ * stopped, or that was zeroed and never started, does nothing, so this can be
+ * called both after a measurement and again on the cleanup path.
+ * @param sampler_p A pointer to the sampler.
+ */
+void
+    common_statsSamplerStop ( common_statsSampler_pt sampler_p );
+
+/**
+ * Free the sampler's resources. Call this after the Context that ran the
+ * sampling timer is destroyed, when the timer callback can no longer run.
+ * @param sampler_p A pointer to a stopped sampler, or to a zeroed sampler that
+ * was never started.
+ */
+void
+    common_statsSamplerDestroy ( common_statsSampler_pt sampler_p );
+
+
+/** The number of sequence numbers a common_seqWindow_t remembers. A power of 2. */
+#define COMMON_SEQ_WINDOW_SIZE   (1024)
+
+/**
+ * @struct common_seqWindow
+ * A sliding bitmap over the last COMMON_SEQ_WINDOW_SIZE sequence numbers of
+ * one publisher, used to tell apart messages that were lost, duplicated or
+ * merely reordered. A sequence number that is still missing when it slides
+ * out of the window is counted as lost. Sequence numbers may wrap.
+ * A window is not thread safe; record and report from one thread.
+ */
+typedef struct common_seqWindow
+{
+
+    BOOL            started;                /**< TRUE once the first message was recorded */
+
+    solClient_uint32_t highSeq;             /**< the highest sequence number received */
+
+    solClient_uint32_t lowSeq;              /**< the lowest sequence number received */
+
+    UINT64          bits[COMMON_SEQ_WINDOW_SIZE / 64];  /**< bit (seq % size) is set when seq was received */
+
+    UINT64          numRx;                  /**< messages recorded */
+
+    UINT64          numDup;                 /**< messages received more than once */
+
+    UINT64          numReorder;             /**< messages received after a higher sequence number */
+
+    UINT64          numLate;                /**< messages too far behind to tell reordered from duplicate */
+
+    UINT64          numGaps;                /**< times the sequence number jumped forward by more than one */
+
+    UINT64          numLost;                /**< messages still missing when they left the window */
+
+    UINT64          numBursts;              /**< runs of consecutive lost messages */
+
+    UINT64          maxBurst;               /**< the longest run of consecutive lost messages */
+
+    UINT64          curBurst;               /**< length of the run of lost messages in progress */
+
+    UINT64          numDiscardInd;          /**< messages carrying a discard indication */
+} common_seqWindow_t, *common_seqWindow_pt;
+
+/**
+ * @struct common_seqReport
+ * The counters of a common_seqWindow_t, with the messages still missing inside
+ * the window counted as lost.
+ */
+typedef struct common_seqReport
+{
+
+    UINT64          numRx;                  /**< messages recorded */
+
+    UINT64          numDup;                 /**< messages received more than once */
+
+    UINT64          numReorder;             /**< messages received after a higher sequence number */
+
+    UINT64          numLate;                /**< messages too far behind to classify */
+
+    UINT64          numGaps;                /**< forward jumps in the sequence */
+
+    UINT64          numMissing;             /**< sequence numbers below the highest never received */
+
+    UINT64          numBursts;              /**< runs of consecutive missing messages */
+
+    UINT64          maxBurst;               /**< the longest run of consecutive missing messages */
+
+    UINT64          numDiscardInd;          /**< messages carrying a discard indication */
+} common_seqReport_t, *common_seqReport_pt;
+
+/**
+ * Reset a sequence window. The first sequence number recorded afterwards is
+ * the start of the sequence; nothing before it is counted as missing.
+ * @param window_p A pointer to the window.
+ */
+void
+    common_seqWindowInit ( common_seqWindow_pt window_p );
+
+/**
+ * Record the arrival of a sequence number.
+ * @param window_p A pointer to the window.
+ * @param seqNum The sequence number of the message.
+ * @param discardInd TRUE if the message carried a discard indication
+ * (see solClient_msg_isDiscardIndication()).
+ */
+void
+    common_seqWindowRecord ( common_seqWindow_pt window_p, solClient_uint32_t seqNum, BOOL discardInd );
+
+/**
+ * Summarize a sequence window without changing it.
+ * @param window_p A pointer to the window.
+ * @param report_p Returns the summary.
+ */
+void
+    common_seqWindowReport ( const common_seqWindow_t * window_p, common_seqReport_pt report_p );
+
+
+/** @name Payload types
+ * The content a common_msgRing_t fills its payloads with.
+ */
+/*@{*/
+#define COMMON_PAYLOAD_ZERO     0           /**< All zero bytes. */
+#define COMMON_PAYLOAD_RANDOM   1           /**< Random bytes, which do not compress. */
+#define COMMON_PAYLOAD_TEXT     2           /**< Random words, which compress like text. */
+#define COMMON_PAYLOAD_FILE     3           /**< The contents of a file, repeated as needed. */
+/*@}*/
+
+/**
+ * @struct common_msgRing
+ * A ring of pre-allocated messages for a publisher to cycle through. Each
+ * message points into its own slice of one payload arena, so a publisher
+ * sends messages of varied content with no per-message allocation and can
+ * stamp each payload without affecting the others.
+ */
+typedef struct common_msgRing
+{
+
+    solClient_opaqueMsg_pt *msgs_p;         /**< the messages */
+
+    int             numMsgs;                /**< number of messages in the ring */
+
+    char           *arena_p;                /**< the payloads, payloadSize bytes each */
+
+    int             payloadSize;            /**< size of each binary attachment */
+} common_msgRing_t, *common_msgRing_pt;
+
+/**
+ * Create a ring of messages with binary attachments filled from a payload
+ * generator. The caller sets the destination and delivery mode of each message.
+ * @param ring_p A pointer to the ring.
+ * @param numMsgs The number of messages.
+ * @param payloadSize The size of each binary attachment, in bytes.
+ * @param payloadType One of the COMMON_PAYLOAD_ types.
+ * @param fileName_p The file to read for COMMON_PAYLOAD_FILE.
+ * @param seed Seed for the random generators; rings with different seeds differ.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_msgRingCreate ( common_msgRing_pt ring_p, int numMsgs, int payloadSize, int payloadType,
+                           const char *fileName_p, UINT64 seed );
+
+/**
+ * Free the messages and payloads of a ring.
+ * @param ring_p A pointer to the ring.
+ */
+void
+    common_msgRingDestroy ( common_msgRing_pt ring_p );
+
+/** The payload of message 'index' of a ring. */
+#define common_msgRingPayload(ring_p, index) ((ring_p)->arena_p + (size_t) (index) * (size_t) (ring_p)->payloadSize)
+
+/**
+ * Parse a --payload value.
+ * @param type_p 'zero', 'random', 'text' or 'file:name'.
+ * @param fileName_p Returns the file name for 'file:name'.
+ * @param fileNameSize The size of the fileName_p buffer.
+ * @return One of the COMMON_PAYLOAD_ types, or -1 if type_p is not valid.
+ */
+int
+    common_payloadParseType ( const char *type_p, char *fileName_p, size_t fileNameSize );
+
+
+/** @name Acknowledgement event modes
+ * How a guaranteed publisher asks for SOLCLIENT_SESSION_EVENT_ACKNOWLEDGEMENT
+ * events, set with --ack.
+ */
+/*@{*/
+#define COMMON_ACK_EVENT_OFF      0         /**< Acknowledgement latency is not recorded. */
+#define COMMON_ACK_EVENT_PER_MSG  1         /**< One event per acknowledged message. */
+#define COMMON_ACK_EVENT_WINDOWED 2         /**< One event acknowledges a range of messages. */
+/*@}*/
+
+
+/** @name One-way latency sources
+ * Where the send time of a received message comes from, set with --latency.
+ */
+/*@{*/
+#define COMMON_LATENCY_OFF        0         /**< One-way latency is not measured. */
+#define COMMON_LATENCY_STAMP      1         /**< A getTimeInNs() stamp in the user data of each message. */
+#define COMMON_LATENCY_SENDER     2         /**< The sender and receive timestamps, in milliseconds. */
+/*@}*/
+
+#define COMMON_LATENCY_STAMP_MAGIC 0x4e54414cU  /**< Marks user data holding a common_latencyStamp_t. */
+
+/**
+ * @struct common_latencyStamp
+ * The send time a publisher puts in the user data of a message for
+ * COMMON_LATENCY_STAMP. It is only comparable with getTimeInNs() on the same
+ * host, as the clock is monotonic rather than wall-clock time.
+ */
+typedef struct common_latencyStamp
+{
+
+    solClient_uint32_t magic;               /**< COMMON_LATENCY_STAMP_MAGIC */
+
+    solClient_uint32_t reserved;            /**< zero */
+
+    UINT64          sendTimeNs;             /**< getTimeInNs() when the message was sent */
+} common_latencyStamp_t;
+
+/**
+ * Put the send time in the user data of a message about to be sent.
+ * @param msg_p The message.
+ * @param nowNs The send time, from getTimeInNs().
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_latencyStamp ( solClient_opaqueMsg_pt msg_p, UINT64 nowNs );
+
+/**
+ * Get the one-way latency of a received message.
+ * @param msg_p The received message.
+ * @param latencySource COMMON_LATENCY_STAMP or COMMON_LATENCY_SENDER.
+ * @param nowNs The receive time, from getTimeInNs(), for COMMON_LATENCY_STAMP.
+ * @param latencyNs_p Returns the latency in nanoseconds. A send time later than
+ *        the receive time, from clocks that are not synchronized, gives 0.
+ * @return 1 if the message carries a send time, 0 otherwise.
+ */
+int
+    common_latencyOneWay ( solClient_opaqueMsg_pt msg_p, int latencySource, UINT64 nowNs, UINT64 * latencyNs_p );
+
+
+/** @name Run phases
+ * The phases of a run paced by a common_runControl_t.
+ */
+/*@{*/
+#define COMMON_RUN_WARMUP       0           /**< Running, before measuring starts. */
+#define COMMON_RUN_MEASURE      1           /**< Running and measuring. */
+#define COMMON_RUN_COOLDOWN     2           /**< Running, after measuring ends. */
+#define COMMON_RUN_DONE         3           /**< The run is over. */
+/*@}*/
+
+/**
+ * @struct common_runControl
+ * Splits a timed run into warm-up, measurement and cool-down windows so that
+ * connection ramp-up, TCP slow start and draining are left out of reported
+ * rates and latencies. Senders and receivers ask for the phase at the time of
+ * each message and only count and record messages in the measurement window.
+ * A run without a duration is counted by messages instead, and every message
+ * is in its measurement window.
+ */
+typedef struct common_runControl
+{
+
+    UINT64          durationNs;             /**< length of the measurement window, 0 for a counted run */
+
+    UINT64          warmupNs;               /**< time before the measurement window */
+
+    UINT64          cooldownNs;             /**< time after the measurement window */
+
+    volatile UINT64 startNs;                /**< when the run started, 0 until then; read with common_runControlStartNs() */
+
+    UINT64          measureStartNs;         /**< start of the measurement window */
+
+    UINT64          measureEndNs;           /**< end of the measurement window */
+
+    UINT64          endNs;                  /**< end of the run */
+
+    MUTEX_T         mutex;                  /**< serializes starting the run */
+} common_runControl_t, *common_runControl_pt;
+
+/** Whether a run is timed by common_runControlInit() rather than counted by messages. */
+#define common_runControlTimed(runControl_p) ((runControl_p)->durationNs != 0)
+
+/**
+ * When the run was started, or 0 if it has not started. When this is non-zero
+ * the measurement window of the run can be read from any thread.
+ */
+#define common_runControlStartNs(runControl_p) atomicLoadAcquire ( &( runControl_p )->startNs )
+
+/**
+ * Initialize a run controller. The run does not start until
+ * common_runControlStart() is called.
+ * @param runControl_p A pointer to the run controller.
+ * @param durationSec Length of the measurement window in seconds, or 0 for a
+ * run counted by messages, in which case the warm-up and cool-down are ignored.
+ * @param warmupSec Seconds before the measurement window.
+ * @param cooldownSec Seconds after the measurement window.
+ */
+void
+    common_runControlInit ( common_runControl_pt runControl_p, int durationSec, int warmupSec, int cooldownSec );
+
+/**
+ * Free the resources of a run controller.
+ * @param runControl_p A pointer to the run controller.
+ */
+void
+    common_runControlDestroy ( common_runControl_pt runControl_p );
+
+/**
+ * Start the run, if it has not been started already. Any thread may call this;
+ * only the first call has an effect.
+ * @param runControl_p A pointer to the run controller.
+ * @param nowNs The current getTimeInNs() time.
+ */
+void
+    common_runControlStart ( common_runControl_pt runControl_p, UINT64 nowNs );
+
+/**
+ * Return the phase of the run at a given time. A counted run is always
+ * measuring; a timed run is warming up until it is started.
+ * @param runControl_p A pointer to the run controller.
+ * @param nowNs A getTimeInNs() time.
+ * @return One of the COMMON_RUN_ phases.
+ */
+int
+    common_runControlPhase ( common_runControl_pt runControl_p, UINT64 nowNs );
+
+/**
+ * Return the length of the measurement window so far: for a timed run, the
+ * part of the window before nowNs; for a counted run, the time since the start.
+ * @param runControl_p A pointer to the run controller.
+ * @param nowNs The getTimeInNs() time the run was last active.
+ * @return The length in nanoseconds, or 0 if the run was not started.
+ */
+UINT64
+    common_runControlWindowNs ( common_runControl_pt runControl_p, UINT64 nowNs );
+
+
+/** The most received messages a common_ackCoalescer_t holds before acknowledging them. */
+#define COMMON_ACK_COALESCE_MAX  (1024)
+
+/**
+ * @struct common_ackCoalescer
+ * Collects the message IDs of the messages received on one client
+ * acknowledgement Flow, and acknowledges them with solClient_flow_sendAck()
+ * in one batch once maxMsgs are held, or once the oldest has been held for
+ * maxDelayNs, whichever comes first. A repeating Context timer sends a partial
+ * batch when no more messages arrive. The time spent in solClient_flow_sendAck()
+ * is measured so the cost of acknowledging can be reported.
+ */
+typedef struct common_ackCoalescer
+{
+
+    solClient_opaqueContext_pt context_p;   /**< the Context whose timer sends partial batches */
+
+    solClient_context_timerId_t timerId;    /**< the repeating timer, or SOLCLIENT_CONTEXT_TIMER_ID_INVALID */
+
+    solClient_opaqueFlow_pt flow_p;         /**< the Flow the held messages were received on */
+
+    int             maxMsgs;                /**< batch size */
+
+    UINT64          maxDelayNs;             /**< longest a message is held, 0 to wait for a full batch */
+
+    solClient_msgId_t msgIds[COMMON_ACK_COALESCE_MAX];  /**< the held message IDs */
+
+    int             numMsgs;                /**< number of held message IDs */
+
+    UINT64          oldestNs;               /**< getTimeInNs() when the oldest held message was added */
+
+    MUTEX_T         mutex;                  /**< serializes the Context thread with common_ackCoalescerFlush() */
+
+    UINT64          numAcked;               /**< messages acknowledged */
+
+    UINT64          numFailed;              /**< acknowledgements that failed */
+
+    UINT64          numBatches;             /**< batches sent */
+
+    UINT64          ackNs;                  /**< time spent in solClient_flow_sendAck() */
+} common_ackCoalescer_t, *common_ackCoalescer_pt;
+
+/**
+ * Initialize an acknowledgement coalescer and start its timer.
+ * @param coalescer_p A pointer to the coalescer.
+ * @param context_p The Context of the Flow, for the timer; NULL for no timer.
+ * @param maxMsgs The batch size, 1 to acknowledge every message as it is added.
+ * Larger values are limited to COMMON_ACK_COALESCE_MAX.
+ * @param maxDelayUs The longest a message is held, in microseconds, or 0 to
+ * hold messages until the batch is full. The timer checks at most once per
+ * millisecond.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_ackCoalescerInit ( common_ackCoalescer_pt coalescer_p, solClient_opaqueContext_pt context_p,
+                              int maxMsgs, int maxDelayUs );
+
+/**
+ * Hold a received message for acknowledgement, and acknowledge the batch if
+ * it is full or has been held too long. Called from a Flow's receive callback.
+ * @param coalescer_p A pointer to the coalescer.
+ * @param opaqueFlow_p The Flow the message was received on.
+ * @param msgId The message ID of the received message.
+ */
+void
+    common_ackCoalescerAdd ( common_ackCoalescer_pt coalescer_p, solClient_opaqueFlow_pt opaqueFlow_p,
+                             solClient_msgId_t msgId );
+
+/**
+ * Acknowledge every held message now. Call this on Flow events and before
+ * the Flow is destroyed.
+ * @param coalescer_p A pointer to the coalescer.
+ */
+void
+    common_ackCoalescerFlush ( common_ackCoalescer_pt coalescer_p );
+
+/**
+ * Stop the coalescer's timer and acknowledge every held message. Messages in
+ * transit can still be received, so from then on every message is acknowledged
+ * as it is added. Call this before the Flow is destroyed.
+ * @param coalescer_p A pointer to the coalescer.
+ */
+void
+    common_ackCoalescerClose ( common_ackCoalescer_pt coalescer_p );
+
+/**
+ * Free the coalescer's resources. Call this after the Flow's Context is
+ * destroyed, for example by solClient_cleanup(). Stopping the timer does not
+ * stop a callback that is already dispatched, and that callback locks the
+ * coalescer.
+ * @param coalescer_p A pointer to a closed coalescer.
+ */
+void
+    common_ackCoalescerDestroy ( common_ackCoalescer_pt coalescer_p );
+
+/**
+ * Print how many messages were acknowledged, in how many batches, and the
+ * time spent acknowledging them.
+ * @param coalescer_p A pointer to the coalescer.
+ */
+void
+    common_ackCoalescerPrint ( common_ackCoalescer_pt coalescer_p );
+
+
+/**
+ * @struct common_handoffSlot
+ * One entry of a common_handoffRing_t. The sequence number says whether the
+ * slot is free for the producer of position seq, or holds the item of
+ * position seq - 1 for the consumer.
+ */
+typedef struct common_handoffSlot
+{
+
+    volatile UINT64 seq;                    /**< sequence number */
+
+    void           *item_p;                 /**< the item */
+} common_handoffSlot_t;
+
+/**
+ * @struct common_handoffRing
+ * A bounded lock-free ring of pointers with one consumer and one or more
+ * producers. Each slot carries a sequence number, so producers and the
+ * consumer only read each other's writes through the slots and never share a
+ * head or tail index. With one producer a push is a load and two stores; with
+ * several producers, positions are claimed with a compare-and-swap on the tail.
+ * The tail and the head are on cache lines of their own.
+ */
+typedef struct common_handoffRing
+{
+
+    char            pad0[CACHE_LINE_SIZE];  /**< keeps the tail off the line of preceding data */
+
+    volatile UINT64 tail;                   /**< next position to push, written by producers */
+
+    UINT64          numFull;                /**< pushes that found the ring full */
+
+    char            pad1[CACHE_LINE_SIZE - 2 * sizeof ( UINT64 )];
+
+    UINT64          head;                   /**< next position to pop, written by the consumer */
+
+    char            pad2[CACHE_LINE_SIZE - sizeof ( UINT64 )];
+
+    common_handoffSlot_t *slots_p;          /**< the slots */
+
+    UINT64          mask;                   /**< number of slots - 1 */
+
+    BOOL            multiProducer;          /**< TRUE if more than one thread pushes */
+} common_handoffRing_t, *common_handoffRing_pt;
+
+/**
+ * Initialize a hand-off ring.
+ * @param ring_p A pointer to the ring.
+ * @param size The number of slots, a power of 2.
+ * @param multiProducer TRUE if more than one thread pushes.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL if size is not a power of 2 or
+ * the slots could not be allocated.
+ */
+solClient_returnCode_t
+    common_handoffRingInit ( common_handoffRing_pt ring_p, int size, BOOL multiProducer );
+
+/**
+ * Free the slots of a hand-off ring.
+ * @param ring_p A pointer to the ring.
+ */
+void
+    common_handoffRingDestroy ( common_handoffRing_pt ring_p );
+
+/**
+ * Push an item onto a hand-off ring, without waiting.
+ * @param ring_p A pointer to the ring.
+ * @param item_p The item.
+ * @return TRUE if the item was pushed, FALSE if the ring is full.
+ */
+BOOL
+    common_handoffRingPush ( common_handoffRing_pt ring_p, void *item_p );
+
+/**
+ * Pop up to maxItems items from a hand-off ring, without waiting. Only the
+ * consumer of the ring may call this.
+ * @param ring_p A pointer to the ring.
+ * @param items_p Returns the items, oldest first.
+ * @param maxItems The most items to pop.
+ * @return The number of items popped.
+ */
+int
+    common_handoffRingPop ( common_handoffRing_pt ring_p, void **items_p, int maxItems );
+
+
+/** The most worker threads of a common_handoff_t. */
+#define COMMON_HANDOFF_MAX_WORKERS  (16)
+/** The number of slots in the ring of each worker thread. */
+#define COMMON_HANDOFF_RING_SIZE    (4096)
+/** The most messages a worker thread takes from its ring at once. */
+#define COMMON_HANDOFF_BATCH        (64)
+
+/**
+ * The function a common_handoff_t worker thread calls for each message.
+ * It owns the message and must free it with solClient_msg_free().
+ * @param msg_p The message.
+ * @param opaqueFlow_p The Flow the message was received on, or NULL if it
+ * was received by a Session.
+ * @param user_p The user pointer given to common_handoffStart().
+ */
+typedef void    ( *common_handoffFunc_t ) ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p );
+
+struct common_handoff;
+
+/**
+ * @struct common_handoffWorker
+ * A worker thread of a common_handoff_t and the ring it drains.
+ */
+typedef struct common_handoffWorker
+{
+
+    common_handoffRing_t ring;              /**< messages for this worker */
+
+    struct common_handoff *handoff_p;       /**< the hand-off stage */
+
+    THREAD_HANDLE_T thread;                 /**< the worker thread */
+
+    UINT64          numProcessed;           /**< messages processed */
+
+    UINT64          numBatches;             /**< non-empty batches taken from the ring */
+
+    UINT64          numSleeps;              /**< times the worker slept on an empty ring */
+} common_handoffWorker_t;
+
+/**
+ * @struct common_handoff
+ * A stage that moves received messages off the Context thread. A receive
+ * callback pushes each message onto the ring of one worker thread and returns
+ * ::SOLCLIENT_CALLBACK_TAKE_MSG; the worker takes messages from its ring in
+ * batches and calls the hand-off function for each. An idle worker spins
+ * briefly, then sleeps between polls, so no lock or condition variable is on
+ * the message path. A push onto a full ring waits for the worker, which holds
+ * back the Context thread and so the transport. Messages received once the
+ * stage is stopping are processed on the receiving thread.
+ */
+typedef struct common_handoff
+{
+
+    common_handoffWorker_t worker[COMMON_HANDOFF_MAX_WORKERS];  /**< the workers */
+
+    int             numWorkers;             /**< number of workers */
+
+    common_handoffFunc_t func_p;            /**< called for each message */
+
+    void           *user_p;                 /**< passed to func_p */
+
+    solClient_opaqueFlow_pt flow_p;         /**< the Flow of the messages, set by the Flow receive callback */
+
+    UINT64          nextWorker;             /**< round-robin position, used by the receiving thread */
+
+    volatile UINT64 numPushing;             /**< receiving threads inside common_handoffPush() */
+
+    volatile UINT64 stopping;               /**< non-zero once common_handoffStop() is called */
+
+    volatile UINT64 exiting;                /**< non-zero once no push can reach the rings; the workers exit on an empty ring */
+
+    volatile UINT64 numInline;              /**< messages processed by the receiving threads while stopping */
+} common_handoff_t, *common_handoff_pt;
+
+/**
+ * Start a hand-off stage.
+ * @param handoff_p A pointer to the hand-off stage.
+ * @param numWorkers The number of worker threads, 1 to COMMON_HANDOFF_MAX_WORKERS.
+ * @param multiProducer TRUE if messages are pushed by more than one Context thread.
+ * @param func_p The function to call for each message.
+ * @param user_p A pointer passed to func_p.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_handoffStart ( common_handoff_pt handoff_p, int numWorkers, BOOL multiProducer,
+                          common_handoffFunc_t func_p, void *user_p );
+
+/**
+ * Hand a received message to the next worker, round-robin. The caller gives
+ * up the message, so a receive callback must return ::SOLCLIENT_CALLBACK_TAKE_MSG.
+ * @param handoff_p A pointer to a started hand-off stage.
+ * @param msg_p The message.
+ */
+void
+    common_handoffPush ( common_handoff_pt handoff_p, solClient_opaqueMsg_pt msg_p );
+
+/**
+ * Stop a hand-off stage once every message handed off has been processed, and
+ * free its rings. Messages received afterwards are processed by the receiving
+ * thread, so the hand-off function and its user data must stay valid for as
+ * long as messages can be received.
+ * @param handoff_p A pointer to a started hand-off stage.
+ */
+void
+    common_handoffStop ( common_handoff_pt handoff_p );
+
+/**
+ * Print what each worker of a hand-off stage processed.
+ * @param handoff_p A pointer to a stopped hand-off stage.
+ */
+void
+    common_handoffPrint ( common_handoff_pt handoff_p );
+
+
+/**
+ * @anchor pubTracker
+ * @name Publish Correlation Tracker
+ * Tracks the Guaranteed messages a publisher has sent until the router
+ * acknowledges or rejects them, without allocating per message. Each message
+ * takes the next slot of a fixed ring, indexed by its publish sequence number,
+ * and the slot is passed to the API as the message's correlation pointer. The
+ * Context thread marks slots acknowledged or rejected from the session event
+ * callback, and the publisher releases them, oldest first, to free or resend
+ * their messages.
+ */
+
+/*@{*/
+#define COMMON_PUB_SLOT_FREE      0         /**< The slot holds no message. */
+#define COMMON_PUB_SLOT_PENDING   1         /**< Sent, not yet acknowledged or rejected. */
+#define COMMON_PUB_SLOT_ACCEPTED  2         /**< Acknowledged by the router. */
+#define COMMON_PUB_SLOT_REJECTED  3         /**< Rejected by the router. */
+/*@}*/
+
+/**
+ * @struct common_pubSlot
+ * One tracked message.
+ */
+typedef struct common_pubSlot
+{
+
+    UINT64          seq;                    /**< publish sequence number of the message */
+
+    solClient_opaqueMsg_pt msg_p;           /**< the message, owned by the publisher */
+
+    void           *user_p;                 /**< publisher data */
+
+    volatile UINT64 state;                  /**< one of the COMMON_PUB_SLOT_ states */
+} common_pubSlot_t, *common_pubSlot_pt;
+
+/**
+ * @struct common_pubTracker
+ * A ring of common_pubSlot_t. The publisher thread tracks and releases
+ * messages; the Context thread acknowledges and rejects them.
+ */
+typedef struct common_pubTracker
+{
+
+    common_pubSlot_pt slots_p;              /**< the slots, a power of 2 of them */
+
+    UINT64          mask;                   /**< number of slots - 1 */
+
+    UINT64          nextSeq;                /**< sequence number of the next message tracked */
+
+    UINT64          oldestSeq;              /**< oldest sequence number not released */
+
+    UINT64          ackedSeq;               /**< windowed acknowledgements covered everything below this */
+
+    UINT64          numAccepted;            /**< messages acknowledged */
+
+    UINT64          numRejected;            /**< messages rejected */
+} common_pubTracker_t, *common_pubTracker_pt;
+
+/**
+ * Initialize a tracker. This is its only allocation.
+ * @param tracker_p A pointer to the tracker.
+ * @param capacity The most messages tracked at once, at least the publish
+ *        window size. It is rounded up to a power of 2.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_pubTrackerInit ( common_pubTracker_pt tracker_p, int capacity );
+
+/**
+ * Free a tracker. The messages still tracked are not freed; release them first.
+ * @param tracker_p A pointer to the tracker.
+ */
+void
+    common_pubTrackerDestroy ( common_pubTracker_pt tracker_p );
+
+/**
+ * Track a message about to be sent. Set the returned slot as the message's
+ * correlation pointer before sending it.
+ * @param tracker_p A pointer to the tracker.
+ * @param msg_p The message.
+ * @param user_p Publisher data kept with the message.
+ * @return The slot, or NULL if the tracker is full until the oldest message is
+ *         released.
+ */
+common_pubSlot_pt
+    common_pubTrackerTrack ( common_pubTracker_pt tracker_p, solClient_opaqueMsg_pt msg_p, void *user_p );
+
+/**
+ * Mark a message acknowledged, from SOLCLIENT_SESSION_EVENT_ACKNOWLEDGEMENT.
+ * @param tracker_p A pointer to the tracker.
+ * @param slot_p The correlation pointer of the event.
+ * @param windowed TRUE with SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_WINDOWED, where
+ *        the event also acknowledges every earlier message still pending.
+ */
+void
+    common_pubTrackerAck ( common_pubTracker_pt tracker_p, common_pubSlot_pt slot_p, BOOL windowed );
+
+/**
+ * Mark a message rejected, from SOLCLIENT_SESSION_EVENT_REJECTED_MSG_ERROR.
+ * @param tracker_p A pointer to the tracker.
+ * @param slot_p The correlation pointer of the event.
+ */
+void
+    common_pubTrackerReject ( common_pubTracker_pt tracker_p, common_pubSlot_pt slot_p );
+
+/**
+ * Release the oldest tracked message if it is acknowledged or rejected. The
+ * returned slot stays valid until the next message is tracked.
+ * @param tracker_p A pointer to the tracker.
+ * @param force TRUE to release it even if it is still pending, when giving up.
+ * @return The released slot, or NULL if there is nothing to release.
+ */
+common_pubSlot_pt
+    common_pubTrackerRelease ( common_pubTracker_pt tracker_p, BOOL force );
+
+
+/**
+ * @anchor requester
+ * @name Asynchronous Requester
+ * Keeps many requests in flight on one Session instead of waiting for each
+ * reply in turn. Every request carries a correlation ID made from its request
+ * ID. Direct requests are sent with solClient_session_sendRequest() and a
+ * timeout of zero, and their replies arrive in the Session's receive callback.
+ * Guaranteed requests are sent with solClient_session_sendMsg() to be replied
+ * to on their ReplyTo queue, and their replies arrive on the Flow bound to
+ * that queue; the replier copies the correlation ID. Replies are matched
+ * to requests through an open-addressing hash table of request IDs, and
+ * timeouts are kept in a hierarchical timer wheel advanced by one repeating
+ * Context timer, so neither costs more per request as more are in flight.
+ */
+
+/*@{*/
+#define COMMON_REQUESTER_WHEEL_BITS   6     /**< log2 of the number of slots per timer wheel level. */
+#define COMMON_REQUESTER_WHEEL_SLOTS  ( 1 << COMMON_REQUESTER_WHEEL_BITS ) /**< Slots per timer wheel level. */
+#define COMMON_REQUESTER_WHEEL_LEVELS 4     /**< Timer wheel levels, for timeouts of up to 64^4 ticks. */
+#define COMMON_REQUESTER_TICK_NS      1000000ULL   /**< Timer wheel tick: timeouts are kept to the millisecond. */
+#define COMMON_REQUESTER_TIMER_MS     10    /**< Period of the Context timer that advances the wheel. */
+/*@}*/
+
+/**
+ * Called for each request when its reply arrives or it times out, from the
+ * Context thread with the requester locked; it must not send requests.
+ * @param replyMsg_p The reply, or NULL if the request timed out. It remains
+ *        owned by the API.
+ * @param reqUser_p The data passed to common_requesterSend() with the request.
+ * @param user_p The data passed to common_requesterInit().
+ */
+typedef void    ( *common_requesterFunc_t ) ( solClient_opaqueMsg_pt replyMsg_p, void *reqUser_p, void *user_p );
+
+/**
+ * @struct common_request
+ * One request in flight. Requests are kept in a pool allocated up front, and
+ * are linked into a timer wheel slot while in flight or into the free list.
+ */
+typedef struct common_request
+{
+
+    UINT64          id;                     /**< request ID, carried as the correlation ID; 0 when free */
+
+    UINT64          sendNs;                 /**< getTimeInNs() when sent, or when it was intended to be sent */
+
+    UINT64          expiryTick;             /**< timer wheel tick at which the request times out */
+
+    void           *user_p;                 /**< requester data */
+
+    struct common_request *next_p;          /**< next in the wheel slot or the free list */
+
+    struct common_request *prev_p;          /**< previous in the wheel slot */
+} common_request_t, *common_request_pt;
+
+/**
+ * @struct common_requester
+ * The requests in flight on one Session. The sending thread and the Context
+ * thread share it under its mutex.
+ */
+typedef struct common_requester
+{
+
+    solClient_opaqueSession_pt session_p;   /**< the Session requests are sent on */
+
+    solClient_opaqueContext_pt context_p;   /**< the Context of the Session, for the timer */
+
+    solClient_context_timerId_t timerId;    /**< the repeating timer, or SOLCLIENT_CONTEXT_TIMER_ID_INVALID */
+
+    MUTEX_T         mutex;                  /**< serializes the sending thread and the Context thread */
+
+    CONDITION_T     cond;                   /**< signalled when a request completes and the sender is waiting */
+
+    BOOL            waiting;                /**< the sender is waiting for a request to complete */
+
+    common_requesterFunc_t func_p;          /**< called on each reply or timeout, or NULL */
+
+    void           *user_p;                 /**< passed to func_p */
+
+    common_request_pt requests_p;           /**< the request pool */
+
+    common_request_pt free_p;               /**< free requests */
+
+    BOOL            guaranteed;             /**< requests are Guaranteed messages, sent with solClient_session_sendMsg() */
+
+    int             maxInFlight;            /**< the size of the request pool */
+
+    int             window;                 /**< the most requests in flight at once, up to maxInFlight */
+
+    int             numInFlight;            /**< requests in flight */
+
+    solClient_uint32_t *table_p;            /**< hash table of pool index + 1 by request ID, 0 when empty */
+
+    UINT64          tableMask;              /**< number of table entries - 1 */
+
+    int             tableShift;             /**< 64 - log2 of the number of table entries */
+
+    common_request_pt wheel[COMMON_REQUESTER_WHEEL_LEVELS][COMMON_REQUESTER_WHEEL_SLOTS];  /**< timer wheel slots */
+
+    UINT64          startNs;                /**< getTimeInNs() at tick 0 */
+
+    UINT64          nowTick;                /**< the tick the wheel has been advanced to */
+
+    UINT64          timeoutTicks;           /**< request timeout */
+
+    UINT64          nextId;                 /**< ID of the next request sent */
+
+    UINT64          numSent;                /**< requests sent */
+
+    UINT64          numReplies;             /**< replies matched to a request */
+
+    UINT64          numTimedOut;            /**< requests that timed out */
+
+    UINT64          numUnmatched;           /**< replies for no request in flight, such as late replies */
+
+    UINT64          firstSendNs;            /**< getTimeInNs() of the first send */
+
+    UINT64          lastReplyNs;            /**< getTimeInNs() of the last reply */
+
+    common_histogram_t latency;             /**< round-trip latency of the replies */
+} common_requester_t, *common_requester_pt;
+
+/**
+ * Initialize a requester and start its timer. This allocates its request
+ * pool and hash table.
+ * @param requester_p A pointer to the requester.
+ * @param context_p The Context of the Session.
+ * @param session_p The Session to send requests on.
+ * @param guaranteed TRUE to send Guaranteed requests with solClient_session_sendMsg(),
+ *        FALSE to send direct requests with solClient_session_sendRequest().
+ * @param maxInFlight The most requests in flight at once.
+ * @param timeoutMs How long to wait for each reply, in milliseconds.
+ * @param func_p Called on each reply or timeout, or NULL.
+ * @param user_p Passed to func_p.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_requesterInit ( common_requester_pt requester_p, solClient_opaqueContext_pt context_p,
+                           solClient_opaqueSession_pt session_p, BOOL guaranteed, int maxInFlight, int timeoutMs,
+                           common_requesterFunc_t func_p, void *user_p );
+
+/**
+ * Change how many requests may be in flight at once, and start the counts
+ * and the latency histogram afresh, so several windows can be measured with
+ * one requester. Drain it first.
+ * @param requester_p A pointer to the requester.
+ * @param window The most requests in flight at once, 1 to the maxInFlight
+ *        it was initialized with.
+ */
+void
+    common_requesterSetWindow ( common_requester_pt requester_p, int window );
+
+/**
+ * Send a request, first waiting for one in flight to complete if the window
+ * is full. The message's correlation ID is overwritten, so the same message
+ * can be sent again as the next request.
+ * @param requester_p A pointer to the requester.
+ * @param msg_p The request, with its destination set, and for a Guaranteed
+ *        request its delivery mode and ReplyTo queue.
+ * @param reqUser_p Data passed to the requester's function with the reply.
+ * @return ::SOLCLIENT_OK, or the failure of the send.
+ */
+solClient_returnCode_t
+    common_requesterSend ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p, void *reqUser_p );
+
+/**
+ * Send a request as common_requesterSend() does, but measure its round-trip
+ * latency from the time an open-loop schedule intended it to be sent (see
+ * common_scheduleWait()), so the time it waited for the window or for a late
+ * sender is included.
+ * @param requester_p A pointer to the requester.
+ * @param msg_p The request.
+ * @param reqUser_p Data passed to the requester's function with the reply.
+ * @param intendedNs The intended send time, from getTimeInNs(), or 0 for now.
+ * @return ::SOLCLIENT_OK, or the failure of the send.
+ */
+solClient_returnCode_t
+    common_requesterSendAt ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p, void *reqUser_p,
+                             UINT64 intendedNs );
+
+/**
+ * Match a received message to its request. Call this first from the Session's
+ * receive callback, or for Guaranteed requests from the reply Flow's.
+ * @param requester_p A pointer to the requester.
+ * @param msg_p The received message.
+ * @return TRUE if the message is a reply, whether or not its request was still
+ *         in flight, or FALSE if it is not a reply. Every message received on
+ *         the reply Flow of Guaranteed requests is a reply.
+ */
+BOOL
+    common_requesterReceive ( common_requester_pt requester_p, solClient_opaqueMsg_pt msg_p );
+
+/**
+ * Wait until every request sent has had its reply or timed out.
+ * @param requester_p A pointer to the requester.
+ */
+void
+    common_requesterDrain ( common_requester_pt requester_p );
+
+/**
+ * Free the requester's resources. Call this after its Context is destroyed,
+ * for example by solClient_cleanup(), which also stops the requester's timer
+ * and ends the replies to it. A zeroed requester that was never initialized
+ * is left alone.
+ * @param requester_p A pointer to the requester.
+ */
+void
+    common_requesterDestroy ( common_requester_pt requester_p );
+
+/**
+ * Print the requests sent, replied to and timed out, the completed requests
+ * per second, and the round-trip latency percentiles.
+ * @param requester_p A pointer to the requester.
+ */
+void
+    common_requesterPrint ( common_requester_pt requester_p );
+
+
+/** The most worker threads of a common_replier_t. */
+#define COMMON_REPLIER_MAX_WORKERS  ( COMMON_HANDOFF_MAX_WORKERS )
+/** The default number of requests a common_replier_t queues for its workers. */
+#define COMMON_REPLIER_DEFAULT_DEPTH (1024)
+
+/**
+ * The function a common_replier_t worker thread calls for each request, to
+ * compute and send its reply. It owns the request and must free it with
+ * solClient_msg_free(), after acknowledging it if it came from a client
+ * acknowledgement Flow.
+ * @param msg_p The request.
+ * @param opaqueFlow_p The Flow the request was received on, or NULL if it was
+ * received by a Session.
+ * @param user_p The user pointer given to common_replierStart().
+ */
+typedef void    ( *common_replierFunc_t ) ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p );
+
+/**
+ * @struct common_replierRequest
+ * A request waiting in the queue of a common_replier_t.
+ */
+typedef struct common_replierRequest
+{
+
+    solClient_opaqueMsg_pt msg_p;           /**< the request */
+
+    solClient_opaqueFlow_pt flow_p;         /**< the Flow it was received on, or NULL */
+
+    UINT64          rxNs;                   /**< getTimeInNs() when it was queued */
+} common_replierRequest_t;
+
+struct common_replier;
+
+/**
+ * @struct common_replierWorker
+ * A worker thread of a common_replier_t and what it measured.
+ */
+typedef struct common_replierWorker
+{
+
+    struct common_replier *replier_p;       /**< the replier */
+
+    THREAD_HANDLE_T thread;                 /**< the worker thread */
+
+    UINT64          numReplies;             /**< requests served */
+
+    UINT64          lastReplyNs;            /**< getTimeInNs() when the last request was served */
+
+    common_histogram_pt queueWait_p;        /**< time requests waited in the queue */
+
+    common_histogram_pt service_p;          /**< time the replier function took */
+} common_replierWorker_t;
+
+/**
+ * @struct common_replier
+ * A pool of worker threads that serve requests off the Context thread, so a
+ * slow request does not hold up the others and the work of serving them is
+ * spread over several cores. A receive callback queues each request and
+ * returns ::SOLCLIENT_CALLBACK_TAKE_MSG; the next idle worker takes the
+ * oldest request and replies to it from its own thread. All workers share
+ * one queue, so a long request only delays the worker serving it. The queue
+ * is bounded: a request received when it is full waits for a worker, which
+ * holds back the Context thread and so the requesters. Requests received
+ * once the pool is stopping are served on the receiving thread.
+ */
+typedef struct common_replier
+{
+
+    common_replierWorker_t worker[COMMON_REPLIER_MAX_WORKERS];  /**< the workers */
+
+    int             numWorkers;             /**< number of workers */
+
+    common_replierFunc_t func_p;            /**< called for each request */
+
+    void           *user_p;                 /**< passed to func_p */
+
+    MUTEX_T         mutex;                  /**< protects the queue */
+
+    CONDITION_T     notEmpty;               /**< signalled when a request is queued for an idle worker */
+
+    CONDITION_T     notFull;                /**< signalled when a worker takes a request from a full queue */
+
+    common_replierRequest_t *queue_p;       /**< the queue, a ring of maxDepth requests */
+
+    int             maxDepth;               /**< the most requests queued */
+
+    int             head;                   /**< position of the oldest queued request */
+
+    int             depth;                  /**< requests queued */
+
+    int             numIdle;                /**< workers waiting for a request */
+
+    BOOL            pushWaiting;            /**< the receiving thread is waiting for room in the queue */
+
+    BOOL            stopping;               /**< TRUE once common_replierStop() is called */
+
+    UINT64          numQueued;              /**< requests queued */
+
+    UINT64          numFull;                /**< requests that found the queue full */
+
+    int             deepest;                /**< the most requests queued at once */
+
+    UINT64          firstRxNs;              /**< getTimeInNs() when the first request was queued */
+
+    UINT64          numInline;              /**< requests served by the receiving thread while stopping */
+} common_replier_t, *common_replier_pt;
+
+/**
+ * Start a pool of replier worker threads.
+ * @param replier_p A pointer to the replier.
+ * @param numWorkers The number of worker threads, 1 to COMMON_REPLIER_MAX_WORKERS.
+ * @param maxDepth The most requests queued for the workers, or 0 for
+ * COMMON_REPLIER_DEFAULT_DEPTH.
+ * @param func_p The function to call for each request.
+ * @param user_p A pointer passed to func_p.
+ * @return ::SOLCLIENT_OK, ::SOLCLIENT_FAIL
+ */
+solClient_returnCode_t
+    common_replierStart ( common_replier_pt replier_p, int numWorkers, int maxDepth,
+                          common_replierFunc_t func_p, void *user_p );
+
+/**
+ * Queue a received request for the workers, waiting for room if the queue is
+ * full. The caller gives up the message, so a receive callback must return
+ * ::SOLCLIENT_CALLBACK_TAKE_MSG.
+ * @param replier_p A pointer to a started replier.
+ * @param msg_p The request.
+ * @param opaqueFlow_p The Flow the request was received on, or NULL.
+ */
+void
+    common_replierPush ( common_replier_pt replier_p, solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p );
+
+/**
+ * Stop the workers once every queued request has been served. Requests
+ * received afterwards are served by the receiving thread.
+ * @param replier_p A pointer to a started replier.
+ */
+void
+    common_replierStop ( common_replier_pt replier_p );
+
+/**
+ * Print the requests each worker served, the reply throughput, how often the
+ * queue was full, and the queue wait and service time percentiles.
+ * @param replier_p A pointer to a stopped replier.
+ */
+void
+    common_replierPrint ( common_replier_pt replier_p );
+
+/**
+ * Free the replier's resources, once no more requests can be received.
+ * @param replier_p A pointer to a stopped replier.
+ */
+void
+    common_replierDestroy ( common_replier_pt replier_p );
+
+
 /**
  * @struct contextThreadInfo
  * Holds context information.
@@ -15,9 +15,12 @@
 #include <sys/ioctl.h>
 #include <sys/uio.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #	if defined(DARWIN_OS)
 #include <mach/clock.h>
 #include <mach/mach.h>
+#include <mach/mach_time.h>
 #	endif
 #endif
 #include <errno.h>
@@ -27,10 +30,28 @@
 #include <tpf/tpfapi.h>
 #       endif
 
+/* The time stamp counter fast path for getTimeInNs() is only available on x86. */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define OS_HAVE_TSC
+#   ifdef WIN32
+#include <intrin.h>
+#   else
+#include <x86intrin.h>
+#include <cpuid.h>
+#   endif
+#endif
+
 /* Semaphore that will be posted to when CTRL-C is hit. */
 SEM_T           ctlCSem;
 BOOL            gotCtlC = FALSE;
 
+/* getTimeInNs() time stamp counter calibration, set once by initTimeInNs(). */
+static BOOL     useTsc_s = FALSE;
+static UINT64   tscBase_s = 0;          /* counter value at nsBase_s */
+static UINT64   nsBase_s = 0;           /* clock value at tscBase_s */
+static UINT64   tscMult_s = 0;          /* nanoseconds per tick, shifted left by 32 bits */
+static char     timeSource_s[64] = "";
+
 /* 
  * Signal handler -- posts to ctlCSem 
  * If we already got a CTRL-C, then exit immediately.
@@ -192,6 +213,165 @@ getTimeInUs ( void )
 
 }
 
+/*
+ * fn getClockTimeInNs()
+ * Reads the operating system monotonic clock (in nanoseconds). On Linux this is
+ * CLOCK_MONOTONIC_RAW, which unlike CLOCK_MONOTONIC is not slewed by NTP.
+ */
+static UINT64
+getClockTimeInNs ( void )
+{
+#ifdef WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER   counter;
+
+    if ( frequency.QuadPart == 0 ) {
+        QueryPerformanceFrequency ( &frequency );
+    }
+    QueryPerformanceCounter ( &counter );
+    /* Split the conversion to avoid overflowing the intermediate product. */
+    return ( ( UINT64 ) ( counter.QuadPart / frequency.QuadPart ) * ( UINT64 ) 1000000000 ) +
+            ( ( UINT64 ) ( counter.QuadPart % frequency.QuadPart ) * ( UINT64 ) 1000000000 ) / ( UINT64 ) frequency.QuadPart;
+#elif defined(DARWIN_OS)
+    static mach_timebase_info_data_t timebase = { 0, 0 };
+
+    if ( timebase.denom == 0 ) {
+        mach_timebase_info ( &timebase );
+    }
+    return ( UINT64 ) mach_absolute_time (  ) * timebase.numer / timebase.denom;
+#else
+    struct timespec tv;
+
+#   ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime ( CLOCK_MONOTONIC_RAW, &tv );
+#   else
+    clock_gettime ( CLOCK_MONOTONIC, &tv );
+#   endif
+    return ( ( UINT64 ) tv.tv_sec * ( UINT64 ) 1000000000 ) + ( UINT64 ) tv.tv_nsec;
+#endif
+}
+
+#ifdef OS_HAVE_TSC
+/*
+ * fn hasInvariantTsc()
+ * Returns TRUE if the CPU's time stamp counter runs at a constant rate in all
+ * power states, so it can be used as a clock.
+ */
+static BOOL
+hasInvariantTsc ( void )
+{
+#   ifdef WIN32
+    int             regs[4];
+
+    __cpuid ( regs, 0x80000000 );
+    if ( ( unsigned int ) regs[0] < 0x80000007 ) {
+        return FALSE;
+    }
+    __cpuid ( regs, 0x80000007 );
+    return ( regs[3] & ( 1 << 8 ) ) != 0;
+#   else
+    unsigned int    eax;
+    unsigned int    ebx;
+    unsigned int    ecx;
+    unsigned int    edx;
+
+    if ( !__get_cpuid ( 0x80000007, &eax, &ebx, &ecx, &edx ) ) {
+        return FALSE;
+    }
+    return ( edx & ( 1 << 8 ) ) != 0;
+#   endif
+}
+#endif
+
+BOOL
+initTimeInNs ( BOOL useTsc )
+{
+#ifdef OS_HAVE_TSC
+    UINT64          clockStart;
+    UINT64          clockEnd;
+    UINT64          tscStart;
+    UINT64          tscEnd;
+    UINT64          before;
+#endif
+
+    useTsc_s = FALSE;
+#ifdef WIN32
+    strncpy ( timeSource_s, "QueryPerformanceCounter", sizeof ( timeSource_s ) );
+#elif defined(DARWIN_OS)
+    strncpy ( timeSource_s, "mach_absolute_time", sizeof ( timeSource_s ) );
+#elif defined(CLOCK_MONOTONIC_RAW)
+    strncpy ( timeSource_s, "CLOCK_MONOTONIC_RAW", sizeof ( timeSource_s ) );
+#else
+    strncpy ( timeSource_s, "CLOCK_MONOTONIC", sizeof ( timeSource_s ) );
+#endif
+
+#ifdef OS_HAVE_TSC
+    if ( !useTsc ) {
+        return FALSE;
+    }
+    if ( !hasInvariantTsc (  ) ) {
+        printf ( "Warning: no invariant TSC, using %s\n", timeSource_s );
+        return FALSE;
+    }
+
+    /*
+     * Measure the counter against the clock over 50 ms. Each counter read is
+     * paired with the midpoint of two clock reads.
+     */
+    before = getClockTimeInNs (  );
+    tscStart = __rdtsc (  );
+    clockStart = before + ( getClockTimeInNs (  ) - before ) / 2;
+    sleepInUs ( 50000 );
+    before = getClockTimeInNs (  );
+    tscEnd = __rdtsc (  );
+    clockEnd = before + ( getClockTimeInNs (  ) - before ) / 2;
+
+    /*
+     * The conversion in getTimeInNs() needs a counter of at least 1 GHz to
+     * keep its 32-bit by 32-bit products from overflowing.
+     */
+    if ( ( tscEnd <= tscStart ) || ( ( tscEnd - tscStart ) < ( clockEnd - clockStart ) ) ) {
+        printf ( "Warning: TSC calibration failed, using %s\n", timeSource_s );
+        return FALSE;
+    }
+    tscMult_s = ( ( clockEnd - clockStart ) << 32 ) / ( tscEnd - tscStart );
+    tscBase_s = tscEnd;
+    nsBase_s = clockEnd;
+    useTsc_s = TRUE;
+    snprintf ( timeSource_s, sizeof ( timeSource_s ), "TSC (%.3f GHz)",
+               ( double ) ( tscEnd - tscStart ) / ( double ) ( clockEnd - clockStart ) );
+    return TRUE;
+#else
+    if ( useTsc ) {
+        printf ( "Warning: TSC not supported on this platform, using %s\n", timeSource_s );
+    }
+    return FALSE;
+#endif
+}
+
+const char     *
+getTimeInNsSource ( void )
+{
+    if ( timeSource_s[0] == ( char ) 0 ) {
+        initTimeInNs ( FALSE );
+    }
+    return timeSource_s;
+}
+
+UINT64
+getTimeInNs ( void )
+{
+#ifdef OS_HAVE_TSC
+    UINT64          ticks;
+
+    if ( useTsc_s ) {
+        ticks = __rdtsc (  ) - tscBase_s;
+        return nsBase_s + ( ticks >> 32 ) * tscMult_s + ( ( ( ticks & 0xffffffffULL ) * tscMult_s ) >> 32 );
+    }
+#endif
+    return getClockTimeInNs (  );
+}
+
 void
 _getDateTime ( char *buf_p, int bufSize )
 {
@@ -254,6 +434,54 @@ waitUntil ( UINT64 nexttimeInUs )
     return waitTime;
 }
 
+void
+pacerInit ( pacer_t * pacer_p, int spinBudgetUs )
+{
+    pacer_p->spinNs = ( spinBudgetUs > 0 ) ? ( UINT64 ) spinBudgetUs * ( UINT64 ) 1000 : 0;
+    pacer_p->overshootNs = 0;
+}
+
+UINT64
+pacerWaitUntil ( pacer_t * pacer_p, UINT64 targetTimeInNs )
+{
+    UINT64          currTime = getTimeInNs (  );
+    UINT64          sleepTime;
+    UINT64          wakeTime;
+    UINT64          overshoot;
+
+    if ( currTime >= targetTimeInNs ) {
+        /* We're behind so just return. */
+        return currTime;
+    }
+
+    if ( pacer_p->spinNs == 0 ) {
+        /* Sleep only. */
+        sleepInUs ( ( int ) ( ( targetTimeInNs - currTime + 999 ) / 1000 ) );
+        return getTimeInNs (  );
+    }
+
+    /* Sleep until the spin budget and the expected sleep overshoot are left. */
+    if ( ( targetTimeInNs - currTime ) > ( pacer_p->spinNs + pacer_p->overshootNs + 1000 ) ) {
+        sleepTime = targetTimeInNs - currTime - pacer_p->spinNs - pacer_p->overshootNs;
+        wakeTime = currTime + sleepTime;
+        sleepInUs ( ( int ) ( sleepTime / 1000 ) );
+        currTime = getTimeInNs (  );
+
+        /* Track the overshoot with a 1/8 weight moving average, ignoring outliers beyond 1 ms. */
+        overshoot = ( currTime > wakeTime ) ? currTime - wakeTime : 0;
+        if ( overshoot > 1000000 ) {
+            overshoot = 1000000;
+        }
+        pacer_p->overshootNs = pacer_p->overshootNs - ( pacer_p->overshootNs >> 3 ) + ( overshoot >> 3 );
+    }
+
+    /* Spin for the rest. */
+    while ( currTime < targetTimeInNs ) {
+        currTime = getTimeInNs (  );
+    }
+    return currTime;
+}
+
 UINT64
 getCpuUsageInUs (  )
 {
@@ -306,6 +534,73 @@ getUsageTime ( long long *userTime_p, long long *systemTime_p )
 }
 
 
+void           *
+mapFile ( const char *fileName_p, size_t * size_p )
+{
+#if defined( __VMS) || defined (SOLCLIENT_ZTPF_BUILD)
+    *size_p = 0;
+    return NULL;
+#else
+#ifdef WIN32
+    HANDLE          file;
+    HANDLE          mapping;
+    LARGE_INTEGER   fileSize;
+    void           *addr_p = NULL;
+
+    *size_p = 0;
+    file = CreateFileA ( fileName_p, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( file == INVALID_HANDLE_VALUE ) {
+        return NULL;
+    }
+    if ( GetFileSizeEx ( file, &fileSize ) && ( fileSize.QuadPart > 0 ) ) {
+        mapping = CreateFileMapping ( file, NULL, PAGE_READONLY, 0, 0, NULL );
+        if ( mapping != NULL ) {
+            /* The view keeps the mapping alive once the handles are closed. */
+            addr_p = MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, 0 );
+            CloseHandle ( mapping );
+            if ( addr_p != NULL ) {
+                *size_p = ( size_t ) fileSize.QuadPart;
+            }
+        }
+    }
+    CloseHandle ( file );
+    return addr_p;
+#else
+    int             fd;
+    struct stat     fileStat;
+    void           *addr_p = NULL;
+
+    *size_p = 0;
+    if ( ( fd = open ( fileName_p, O_RDONLY ) ) < 0 ) {
+        return NULL;
+    }
+    if ( ( fstat ( fd, &fileStat ) == 0 ) && ( fileStat.st_size > 0 ) ) {
+        addr_p = mmap ( NULL, ( size_t ) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( addr_p == MAP_FAILED ) {
+            addr_p = NULL;
+        } else {
+            *size_p = ( size_t ) fileStat.st_size;
+        }
+    }
+    close ( fd );
+    return addr_p;
+#endif
+#endif
+}
+
+
+void
+unmapFile ( void *addr_p, size_t size )
+{
+#if !defined( __VMS) && !defined (SOLCLIENT_ZTPF_BUILD)
+#ifdef WIN32
+    UnmapViewOfFile ( addr_p );
+#else
+    munmap ( addr_p, size );
+#endif
+#endif
+}
+
 BOOL
 mutexInit ( MUTEX_T * mutex_p )
 {
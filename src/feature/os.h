@@ -143,6 +143,52 @@ extern          "C"
     typedef pthread_cond_t CONDITION_T;
 #endif
 
+/*
+ * A pacer waits for a target time by sleeping for the coarse part of the wait
+ * and spinning on getTimeInNs() for the rest, so that the wait ends within a
+ * microsecond instead of with the 50-100 us granularity of sleepInUs(). How
+ * late each sleep returns is measured and added to the part that is spun.
+ */
+    typedef struct pacer
+    {
+        UINT64          spinNs;             /* spin budget: the end of each wait that is spun rather than slept */
+        UINT64          overshootNs;        /* running estimate of how late a sleep returns */
+    } pacer_t;
+
+/* Size of a cache line, for keeping data written by different threads apart. */
+#define CACHE_LINE_SIZE (64)
+
+/*
+ * Atomic operations on UINT64 values shared between threads without a lock.
+ * atomicLoadAcquire() and atomicStoreRelease() order the memory accesses around
+ * them, so a value stored with release is seen with everything written before
+ * it. atomicLoad() and atomicAddFetch() are fully ordered. atomicAddFetch()
+ * returns the new value and atomicCompareAndSwap() returns TRUE if *p was
+ * oldVal and is now newVal. cpuRelax() tells the CPU the thread is spinning.
+ */
+#ifdef WIN32
+/* Plain 64-bit loads and stores are not atomic on 32-bit x86; the Interlocked calls are. */
+#define atomicLoad(p)                       ( ( UINT64 ) InterlockedCompareExchange64 ( ( LONGLONG volatile * ) ( p ), 0, 0 ) )
+#define atomicLoadAcquire(p)                atomicLoad ( p )
+#define atomicStoreRelease(p, val)          ( ( void ) InterlockedExchange64 ( ( LONGLONG volatile * ) ( p ), ( LONGLONG ) ( val ) ) )
+#define atomicAddFetch(p, val)              ( ( UINT64 ) InterlockedExchangeAdd64 ( ( LONGLONG volatile * ) ( p ), ( LONGLONG ) ( val ) ) + ( val ) )
+#define atomicCompareAndSwap(p, oldVal, newVal) \
+    ( InterlockedCompareExchange64 ( ( LONGLONG volatile * ) ( p ), ( LONGLONG ) ( newVal ), ( LONGLONG ) ( oldVal ) ) == ( LONGLONG ) ( oldVal ) )
+#define cpuRelax()                          YieldProcessor (  )
+#else
+#define atomicLoad(p)                       __atomic_load_n ( ( p ), __ATOMIC_SEQ_CST )
+#define atomicLoadAcquire(p)                __atomic_load_n ( ( p ), __ATOMIC_ACQUIRE )
+#define atomicStoreRelease(p, val)          __atomic_store_n ( ( p ), ( val ), __ATOMIC_RELEASE )
+#define atomicAddFetch(p, val)              __atomic_add_fetch ( ( p ), ( val ), __ATOMIC_SEQ_CST )
+#define atomicCompareAndSwap(p, oldVal, newVal) \
+    __sync_bool_compare_and_swap ( ( p ), ( oldVal ), ( newVal ) )
+#if defined(__x86_64__) || defined(__i386__)
+#define cpuRelax()                          __builtin_ia32_pause (  )
+#else
+#define cpuRelax()                          ( ( void ) 0 )
+#endif
+#endif
+
 
 /* Semaphore that will be posted to when CTRL-C is hit. */
     extern SEM_T    ctlCSem;
@@ -177,6 +223,33 @@ extern          "C"
  */
     UINT64          getTimeInUs ( void );
 
+/*
+ * fn getTimeInNs()
+ * Gets the current value of a monotonic clock (in nanoseconds).
+ * The value is only meaningful when compared with another value returned by
+ * this function in the same process; it is not affected by system time changes
+ * or NTP adjustments. Use it for all elapsed time, rate and latency measurements.
+ */
+    UINT64          getTimeInNs ( void );
+
+/*
+ * fn initTimeInNs()
+ * One-time calibration of getTimeInNs(); call it at startup before any other
+ * thread uses getTimeInNs(). When useTsc is TRUE and the CPU has an invariant
+ * time stamp counter, the counter is calibrated against the monotonic clock
+ * (taking 50 ms) and getTimeInNs() then reads the counter directly instead of
+ * making a clock call.
+ * param useTsc TRUE to use the time stamp counter when possible.
+ * Returns TRUE if getTimeInNs() uses the time stamp counter.
+ */
+    BOOL            initTimeInNs ( BOOL useTsc );
+
+/*
+ * fn getTimeInNsSource()
+ * Returns a description of the clock used by getTimeInNs().
+ */
+    const char     *getTimeInNsSource ( void );
+
 /*
  * fn _getDateTime()
  * Returns a string representation of current time.
@@ -189,6 +262,25 @@ extern          "C"
  */
     UINT64          waitUntil ( UINT64 nexttimeInUs );
 
+/*
+ * fn pacerInit()
+ * Initialize a pacer.
+ * param pacer_p the pacer to initialize.
+ * param spinBudgetUs number of microseconds at the end of each wait to spin
+ *       rather than sleep; 0 makes the pacer sleep only.
+ */
+    void            pacerInit ( pacer_t * pacer_p, int spinBudgetUs );
+
+/*
+ * fn pacerWaitUntil()
+ * Wait until getTimeInNs() reaches the given time, returning at once if it
+ * already has.
+ * param pacer_p the pacer to use.
+ * param targetTimeInNs time to return at, from getTimeInNs().
+ * Returns the value of getTimeInNs() when the wait ended.
+ */
+    UINT64          pacerWaitUntil ( pacer_t * pacer_p, UINT64 targetTimeInNs );
+
 /*
  * fn getUsageTime()
  *
@@ -197,6 +289,24 @@ extern          "C"
  */
     void            getUsageTime ( long long *userTime_p, long long *systemTime_p );
 
+/*
+ * fn mapFile()
+ * Maps a whole file read-only into memory.
+ * param fileName_p the file to map.
+ * param size_p returns the size of the file.
+ * Returns the address of the mapping, or NULL if the file could not be mapped
+ * or is empty.
+ */
+    void           *mapFile ( const char *fileName_p, size_t * size_p );
+
+/*
+ * fn unmapFile()
+ * Unmaps a file mapped by mapFile().
+ * param addr_p the address returned by mapFile().
+ * param size the size returned by mapFile().
+ */
+    void            unmapFile ( void *addr_p, size_t size );
+
 /*
  * getCpuSpeedInHz()
  * Gets the cpu speed in Hertz.
@@ -6,6 +6,57 @@
  * This sample shows a Guaranteed Messaging throughput publishing example for the 
  * Solace Messaging API for C. 
  *
+ * A single publisher thread sends round-robin over one or more Sessions
+ * ('--sessions'). By default the Sessions send in blocking mode, so the thread
+ * stalls whenever the guaranteed publish window of the Session it is sending
+ * on closes. With '--nonblock' the Sessions are created with
+ * SOLCLIENT_SESSION_PROP_SEND_BLOCKING disabled: a send that returns
+ * SOLCLIENT_WOULD_BLOCK marks its Session window-blocked and the thread moves
+ * on to the next Session. The thread only parks when every Session is
+ * window-blocked, and is woken by the SOLCLIENT_SESSION_EVENT_CAN_SEND event
+ * delivered to this sample's event callback. The time each Session spent
+ * window-blocked, the time the thread spent parked and the number of times
+ * each publish window closed are reported at the end of the run.
+ *
+ * With '--ack=per-msg' or '--ack=windowed' the sample also measures the time
+ * from each send to its SOLCLIENT_SESSION_EVENT_ACKNOWLEDGEMENT, with the
+ * matching SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE. Each send attaches a
+ * correlation pointer to a slot holding the message's sequence number and send
+ * time. A windowed acknowledgement carries the correlation pointer of the last
+ * message it acknowledges, so every message from the previous acknowledgement
+ * up to that one is recorded. The latency percentiles are reported, and the
+ * histogram is written to the '--hist' file if one is given.
+ *
+ * With '--autotune' the sample steps through publish window sizes,
+ * acknowledgement event modes and payload sizes. The publish window size is
+ * fixed when a Session is created, so each step creates new Sessions. Each
+ * step publishes rounds of messages as fast as the publish window allows,
+ * ignoring the Message Rate, until two consecutive rounds agree on the rate
+ * to within 5%, and the last round's rate and acknowledgement latency are
+ * reported for the step. A step also ends when a round's acknowledgements do
+ * not all arrive. For each payload size
+ * the step with the highest rate whose p99 acknowledgement latency fits the
+ * budget is reported as the configuration to use.
+ *
+ * With '--shards=n' messages are spread over n destinations, 'Topic/0' to
+ * 'Topic/n-1', instead of one. Each destination has its own pre-built message.
+ * The destination of each message is chosen round-robin, or with ',hash' by
+ * hashing a synthetic message key drawn from a fixed key space, which spreads
+ * load the way keyed production traffic does. With ',threads' every
+ * destination gets its own Session and publisher thread, each sending its share
+ * of the messages at its share of the Message Rate with blocking sends. The rate
+ * of every destination is reported along with the aggregate.
+ *
+ * With '--duration' the publishers send until the run ends instead of sending
+ * the Number of Messages. Messages sent during the '--warmup' and the
+ * '--cooldown' are not counted in the rates, and only messages sent in the
+ * measurement window are counted in the acknowledgement latency.
+ *
+ * With '--latency=stamp' each message carries its send time in its user data
+ * (see common_latencyStamp()), and with '--latency=sender' the Sessions add a
+ * sender timestamp to each message, so that perfADSub can measure one-way
+ * latency.
+ *
  * Copyright 2007-2018 Solace Corporation. All rights reserved.
  */
 
@@ -18,6 +69,795 @@
 #include "solclient/solClientMsg.h"
 #include "common.h"
 
+#define MAX_SESSIONS (64)
+#define MAX_SHARDS (1024)
+
+#define SHARD_ROUND_ROBIN (0)
+#define SHARD_HASH        (1)
+#define SHARD_KEY_SPACE   (1 << 20)        /* number of distinct synthetic message keys */
+
+/*
+ * The send-time slots of a Session. A publish window holds at most 255
+ * messages, so a slot is never reused while its message is unacknowledged.
+ */
+#define ACK_RING_SIZE (256)
+
+#define MAX_AUTOTUNE_VALUES (16)
+#define AUTOTUNE_MAX_ROUNDS (10)
+
+/**
+ * @struct autotune
+ *
+ * The configurations an autotune run steps through.
+ */
+typedef struct autotune
+{
+    int             window[MAX_AUTOTUNE_VALUES];    /**< publish window sizes */
+
+    int             numWindow;                      /**< number of publish window sizes */
+
+    int             ackMode[MAX_AUTOTUNE_VALUES];   /**< COMMON_ACK_EVENT_PER_MSG or COMMON_ACK_EVENT_WINDOWED */
+
+    int             numAckMode;                     /**< number of acknowledgement event modes */
+
+    int             size[MAX_AUTOTUNE_VALUES];      /**< payload sizes */
+
+    int             numSize;                        /**< number of payload sizes */
+
+    int             budgetUs;                       /**< p99 acknowledgement latency budget, 0 for none */
+
+    int             roundMsgs;                      /**< messages published per round */
+} autotune_t;
+
+/**
+ * @struct publisher
+ *
+ * What one publisher thread sends, and what it measured.
+ */
+typedef struct publisher
+{
+    int             firstSession;                   /**< first Session in pubSessions_s to send on */
+
+    int             numSessions;                    /**< number of Sessions to send on, round-robin */
+
+    solClient_opaqueMsg_pt *msgs_p;                 /**< one message per destination */
+
+    int             numDests;                       /**< number of destinations */
+
+    UINT64         *destSent_p;                     /**< messages sent to each destination */
+
+    int             shardMode;                      /**< SHARD_ROUND_ROBIN or SHARD_HASH */
+
+    UINT64          keyState;                       /**< synthetic key generator state, never 0 */
+
+    int             numMsgs;                        /**< messages to send */
+
+    int             msgRate;                        /**< messages per second, 0 for unpaced */
+
+    int             spinBudgetUs;                   /**< pacer spin budget */
+
+    BOOL            nonBlocking;                    /**< send with sendNonBlocking() */
+
+    common_runControl_t *runControl_p;              /**< times the run, or NULL to send numMsgs */
+
+    int             numSent;                        /**< returns the number of messages sent */
+
+    int             numMeasured;                    /**< returns the number sent in the measurement window */
+
+    long long       elapsedUs;                      /**< returns the time taken, or the measurement window */
+
+    UINT64          parkedNs;                       /**< returns the time parked with every window closed */
+} publisher_t;
+
+/**
+ * @struct ackSlot
+ *
+ * The correlation data attached to a message to time its acknowledgement.
+ */
+typedef struct ackSlot
+{
+    UINT64          seq;                    /**< Sequence number of the send on its Session. */
+    UINT64          sendNs;                 /**< Send time, or 0 if the message was rejected. */
+} ackSlot_t;
+
+/**
+ * @struct pubSession
+ *
+ * The publishing state of one Session. The publisher thread is the only
+ * writer of 'blocked' when setting it, and the Context thread is the only
+ * writer when clearing it on SOLCLIENT_SESSION_EVENT_CAN_SEND, so the
+ * publisher can test it without taking the lock.
+ */
+typedef struct pubSession
+{
+    solClient_opaqueSession_pt session_p;   /**< The Session. */
+    volatile BOOL   blocked;                /**< Publish window closed, waiting for CAN_SEND. */
+    volatile BOOL   down;                   /**< Session went down during the run. */
+    volatile unsigned int canSendEvents;    /**< Number of CAN_SEND events received. */
+    UINT64          blockedSinceNs;         /**< When the Session became window-blocked. */
+    UINT64          blockedNs;              /**< Total time spent window-blocked. */
+    UINT64          numWouldBlock;          /**< Sends that returned SOLCLIENT_WOULD_BLOCK. */
+    UINT64          numSent;                /**< Messages accepted by this Session. */
+    volatile UINT64 numAcked;               /**< Messages acknowledged, the next sequence number to be acknowledged. */
+    UINT64          numRejected;            /**< Messages rejected by the appliance. */
+    ackSlot_t       ackRing[ACK_RING_SIZE]; /**< Send-time slots, indexed by sequence number. */
+} pubSession_t;
+
+static pubSession_t pubSessions_s[MAX_SESSIONS];
+static int      numPubSessions_s = 0;
+static MUTEX_T  pubMutex_s;
+static CONDITION_T pubCond_s;
+static int      ackEventMode_s = COMMON_ACK_EVENT_OFF;
+static int      latencySource_s = COMMON_LATENCY_OFF;
+static common_histogram_t ackHist_s;       /* Only recorded on the Context thread. */
+static solClient_opaqueMsg_pt destMsgs_s[MAX_SHARDS];
+static UINT64   destSent_s[MAX_SHARDS];
+static publisher_t publishers_s[MAX_SESSIONS];
+static common_runControl_t runControl_s;
+
+/*
+ * fn pubEventCallbackFunc()
+ * A solClient_session_eventCallbackFunc_t that wakes the publisher thread
+ * when a window-blocked Session can send again or when a Session goes down.
+ * The user pointer is the pubSession_t of the Session.
+ */
+static void
+pubEventCallbackFunc ( solClient_opaqueSession_pt opaqueSession_p,
+                       solClient_session_eventCallbackInfo_pt eventInfo_p, void *user_p )
+{
+    pubSession_t   *pubSession_p = ( pubSession_t * ) user_p;
+    ackSlot_t      *slot_p = ( ackSlot_t * ) eventInfo_p->correlation_p;
+    UINT64          nowNs;
+    UINT64          seq;
+
+    switch ( eventInfo_p->sessionEvent ) {
+        case SOLCLIENT_SESSION_EVENT_ACKNOWLEDGEMENT:
+            if ( ( ackEventMode_s == COMMON_ACK_EVENT_OFF ) || ( slot_p == NULL ) ) {
+                break;
+            }
+            /*
+             * A windowed acknowledgement also covers every message sent
+             * before this one that has not been acknowledged yet.
+             */
+            nowNs = getTimeInNs (  );
+            for ( seq = pubSession_p->numAcked; seq <= slot_p->seq; seq++ ) {
+                if ( ( pubSession_p->ackRing[seq % ACK_RING_SIZE].sendNs != 0 ) &&
+                     ( common_runControlPhase ( &runControl_s, pubSession_p->ackRing[seq % ACK_RING_SIZE].sendNs ) ==
+                       COMMON_RUN_MEASURE ) ) {
+                    common_histogramRecord ( &ackHist_s, nowNs - pubSession_p->ackRing[seq % ACK_RING_SIZE].sendNs );
+                }
+            }
+            if ( slot_p->seq >= pubSession_p->numAcked ) {
+                pubSession_p->numAcked = slot_p->seq + 1;
+            }
+            break;
+
+        case SOLCLIENT_SESSION_EVENT_REJECTED_MSG_ERROR:
+            common_eventCallback ( opaqueSession_p, eventInfo_p, user_p );
+            if ( ( ackEventMode_s == COMMON_ACK_EVENT_OFF ) || ( slot_p == NULL ) ) {
+                break;
+            }
+            /* Rejections are per message; keep them out of the latency. */
+            pubSession_p->numRejected++;
+            slot_p->sendNs = 0;
+            if ( slot_p->seq == pubSession_p->numAcked ) {
+                pubSession_p->numAcked = slot_p->seq + 1;
+            }
+            break;
+
+        case SOLCLIENT_SESSION_EVENT_CAN_SEND:
+            mutexLock ( &pubMutex_s );
+            pubSession_p->canSendEvents++;
+            if ( pubSession_p->blocked ) {
+                pubSession_p->blockedNs += getTimeInNs (  ) - pubSession_p->blockedSinceNs;
+                pubSession_p->blocked = FALSE;
+            }
+            condSignal ( &pubCond_s );
+            mutexUnlock ( &pubMutex_s );
+            break;
+
+        case SOLCLIENT_SESSION_EVENT_DOWN_ERROR:
+            common_eventCallback ( opaqueSession_p, eventInfo_p, user_p );
+            mutexLock ( &pubMutex_s );
+            pubSession_p->down = TRUE;
+            condSignal ( &pubCond_s );
+            mutexUnlock ( &pubMutex_s );
+            break;
+
+        default:
+            /* Everything else is ignored, as in common_eventPerfCallback(). */
+            break;
+    }
+}
+
+/*
+ * fn sendOnSession()
+ * Send a message on one Session. When acknowledgement latency is being
+ * recorded, the message first gets the correlation pointer of its send-time
+ * slot. With '--latency=stamp' it also gets its send time.
+ */
+static          solClient_returnCode_t
+sendOnSession ( pubSession_t * pubSession_p, solClient_opaqueMsg_pt msg_p )
+{
+    solClient_returnCode_t rc;
+    ackSlot_t      *slot_p;
+    UINT64          nowNs = 0;
+
+    if ( ( ackEventMode_s != COMMON_ACK_EVENT_OFF ) || ( latencySource_s == COMMON_LATENCY_STAMP ) ) {
+        nowNs = getTimeInNs (  );
+    }
+    if ( ackEventMode_s != COMMON_ACK_EVENT_OFF ) {
+        slot_p = &pubSession_p->ackRing[pubSession_p->numSent % ACK_RING_SIZE];
+        slot_p->seq = pubSession_p->numSent;
+        slot_p->sendNs = nowNs;
+        if ( ( rc = solClient_msg_setCorrelationTagPtr ( msg_p, slot_p, sizeof ( *slot_p ) ) ) != SOLCLIENT_OK ) {
+            return rc;
+        }
+    }
+    if ( latencySource_s == COMMON_LATENCY_STAMP ) {
+        if ( ( rc = common_latencyStamp ( msg_p, nowNs ) ) != SOLCLIENT_OK ) {
+            return rc;
+        }
+    }
+
+    rc = solClient_session_sendMsg ( pubSession_p->session_p, msg_p );
+    if ( rc == SOLCLIENT_OK ) {
+        pubSession_p->numSent++;
+    }
+    return rc;
+}
+
+/*
+ * fn acksPending()
+ * Return TRUE if a Session that is still up has messages waiting for an
+ * acknowledgement, which the Context thread can still record.
+ */
+static BOOL
+acksPending ( void )
+{
+    int             sessionIndex;
+
+    for ( sessionIndex = 0; sessionIndex < numPubSessions_s; sessionIndex++ ) {
+        if ( ( pubSessions_s[sessionIndex].numAcked < pubSessions_s[sessionIndex].numSent ) &&
+             !pubSessions_s[sessionIndex].down ) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * fn waitForAcks()
+ * Wait up to timeoutMs for every message sent to be acknowledged or rejected.
+ */
+static void
+waitForAcks ( int timeoutMs )
+{
+    int             sessionIndex;
+    int             waitedMs = 0;
+
+    for ( sessionIndex = 0; sessionIndex < numPubSessions_s; sessionIndex++ ) {
+        while ( ( pubSessions_s[sessionIndex].numAcked < pubSessions_s[sessionIndex].numSent ) &&
+                !pubSessions_s[sessionIndex].down && ( waitedMs < timeoutMs ) ) {
+            sleepInUs ( 10000 );
+            waitedMs += 10;
+        }
+    }
+}
+
+/*
+ * fn nextOpenSession()
+ * Return the index of the first Session, starting at 'first', that is not
+ * window-blocked or has gone down, or -1 if every Session is window-blocked.
+ */
+static int
+nextOpenSession ( int first )
+{
+    int             index = first;
+    int             tried;
+
+    for ( tried = 0; tried < numPubSessions_s; tried++ ) {
+        if ( pubSessions_s[index].down || !pubSessions_s[index].blocked ) {
+            return index;
+        }
+        index = ( index + 1 ) % numPubSessions_s;
+    }
+    return -1;
+}
+
+/*
+ * fn sendNonBlocking()
+ * Send a message on the next Session, starting at *nextSession_p, whose
+ * publish window is open. Sessions that return SOLCLIENT_WOULD_BLOCK are
+ * marked window-blocked and skipped. When every Session is window-blocked the
+ * calling thread parks until a CAN_SEND event arrives, and the parked time
+ * is added to *parkedNs_p.
+ */
+static          solClient_returnCode_t
+sendNonBlocking ( solClient_opaqueMsg_pt msg_p, int *nextSession_p, UINT64 *parkedNs_p )
+{
+    solClient_returnCode_t rc;
+    pubSession_t   *pubSession_p;
+    unsigned int    canSendEvents;
+    UINT64          parkStartNs;
+    int             index;
+
+    for ( ;; ) {
+        if ( ( index = nextOpenSession ( *nextSession_p ) ) < 0 ) {
+            /* Every window is closed, so park until one reopens. */
+            parkStartNs = getTimeInNs (  );
+            mutexLock ( &pubMutex_s );
+            while ( ( index = nextOpenSession ( *nextSession_p ) ) < 0 ) {
+                /* A timed wait covers a signal that arrives before the wait. */
+                condTimedWait ( &pubCond_s, &pubMutex_s, 1 );
+            }
+            mutexUnlock ( &pubMutex_s );
+            *parkedNs_p += getTimeInNs (  ) - parkStartNs;
+        }
+
+        pubSession_p = &pubSessions_s[index];
+        if ( pubSession_p->down ) {
+            return SOLCLIENT_FAIL;
+        }
+        *nextSession_p = ( index + 1 ) % numPubSessions_s;
+        canSendEvents = pubSession_p->canSendEvents;
+
+        rc = sendOnSession ( pubSession_p, msg_p );
+        if ( rc != SOLCLIENT_WOULD_BLOCK ) {
+            return rc;
+        }
+
+        /*
+         * The CAN_SEND event may already have been delivered between the
+         * send returning and the lock being taken, in which case the Session
+         * is not blocked.
+         */
+        mutexLock ( &pubMutex_s );
+        pubSession_p->numWouldBlock++;
+        if ( pubSession_p->canSendEvents == canSendEvents ) {
+            pubSession_p->blocked = TRUE;
+            pubSession_p->blockedSinceNs = getTimeInNs (  );
+        }
+        mutexUnlock ( &pubMutex_s );
+    }
+}
+
+/*
+ * fn connectSessions()
+ * Create and connect numSessions Sessions with the same properties. The
+ * Sessions connected so far are left in pubSessions_s on failure, for
+ * disconnectSessions().
+ */
+static          solClient_returnCode_t
+connectSessions ( const char **sessionProps, solClient_opaqueContext_pt context_p,
+                  solClient_session_createFuncInfo_t * sessionFuncInfo_p, int numSessions )
+{
+    solClient_returnCode_t rc = SOLCLIENT_OK;
+    pubSession_t   *pubSession_p;
+
+    for ( numPubSessions_s = 0; numPubSessions_s < numSessions; numPubSessions_s++ ) {
+        pubSession_p = &pubSessions_s[numPubSessions_s];
+        memset ( pubSession_p, 0, sizeof ( *pubSession_p ) );
+        sessionFuncInfo_p->eventInfo.user_p = pubSession_p;
+
+        solClient_log ( SOLCLIENT_LOG_INFO, "creating solClient session %d", numPubSessions_s );
+        if ( ( rc = solClient_session_create ( ( char ** ) sessionProps,
+                                               context_p, &pubSession_p->session_p,
+                                               sessionFuncInfo_p, sizeof ( *sessionFuncInfo_p ) ) )
+             != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_create()" );
+            break;
+        }
+
+        /* Connect the Session. */
+        solClient_log ( SOLCLIENT_LOG_INFO, "connecting solClient session %d", numPubSessions_s );
+        if ( ( rc = solClient_session_connect ( pubSession_p->session_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_connect()" );
+            solClient_session_destroy ( &pubSession_p->session_p );
+            break;
+        }
+    }
+    return rc;
+}
+
+/*
+ * fn disconnectSessions()
+ * Disconnect and destroy the Sessions created by connectSessions().
+ */
+static void
+disconnectSessions ( void )
+{
+    solClient_returnCode_t rc;
+    int             sessionIndex;
+
+    for ( sessionIndex = 0; sessionIndex < numPubSessions_s; sessionIndex++ ) {
+        if ( ( rc = solClient_session_disconnect ( pubSessions_s[sessionIndex].session_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_disconnect()" );
+        }
+        if ( ( rc = solClient_session_destroy ( &pubSessions_s[sessionIndex].session_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_destroy()" );
+        }
+    }
+    numPubSessions_s = 0;
+}
+
+/*
+ * fn shardForKey()
+ * Draw the next synthetic message key and return the destination it hashes
+ * to. The key is hashed with 64-bit FNV-1a, so a key always maps to the same
+ * destination and the spread over destinations is as uneven as a real keyed
+ * workload's.
+ */
+static int
+shardForKey ( UINT64 * keyState_p, int numDests )
+{
+    UINT64          key;
+    UINT64          hash = 14695981039346656037ULL;
+    int             loop;
+
+    /* xorshift64* */
+    *keyState_p ^= *keyState_p >> 12;
+    *keyState_p ^= *keyState_p << 25;
+    *keyState_p ^= *keyState_p >> 27;
+    key = ( ( *keyState_p * 2685821657736338717ULL ) >> 32 ) % SHARD_KEY_SPACE;
+
+    for ( loop = 0; loop < 8; loop++ ) {
+        hash ^= ( key >> ( loop * 8 ) ) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    return ( int ) ( hash % ( UINT64 ) numDests );
+}
+
+/*
+ * fn publish()
+ * Send publisher_p->numMsgs messages round-robin over the publisher's
+ * Sessions, paced to its msgRate (unpaced if it is 0), choosing the
+ * destination of each one by its shardMode. The number of messages sent,
+ * which is less than numMsgs if a send failed, the time taken and the time
+ * spent parked with every window closed are returned in the publisher. If the publisher has a timed run
+ * controller it sends until the run is done instead, and only the messages
+ * sent in the measurement window and the length of the window are returned
+ * for the rate.
+ */
+static void
+publish ( publisher_t * publisher_p )
+{
+    solClient_returnCode_t rc;
+    int             nextSession = 0;
+    int             dest = 0;
+    UINT64          startTime;
+    long double     targetTime;
+    long double     nsPerMsg;
+    pacer_t         pacer;
+    BOOL            timed;
+    int             phase = COMMON_RUN_MEASURE;
+
+    nsPerMsg = ( publisher_p->msgRate > 0 ) ? ( long double ) 1000000000.0 / ( long double ) publisher_p->msgRate : 0.0;
+    pacerInit ( &pacer, publisher_p->spinBudgetUs );
+    timed = ( publisher_p->runControl_p != NULL ) && common_runControlTimed ( publisher_p->runControl_p );
+
+    startTime = getTimeInNs (  );
+    targetTime = ( long double ) startTime + nsPerMsg;
+    if ( timed ) {
+        /* The first publisher to start starts the run for every publisher. */
+        common_runControlStart ( publisher_p->runControl_p, startTime );
+    }
+
+    publisher_p->numMeasured = 0;
+    for ( publisher_p->numSent = 0;; publisher_p->numSent++ ) {
+        if ( timed ) {
+            if ( ( phase = common_runControlPhase ( publisher_p->runControl_p, getTimeInNs (  ) ) ) == COMMON_RUN_DONE ) {
+                break;
+            }
+        } else if ( publisher_p->numSent >= publisher_p->numMsgs ) {
+            break;
+        }
+        if ( publisher_p->numDests > 1 ) {
+            dest = ( publisher_p->shardMode == SHARD_HASH ) ?
+                    shardForKey ( &publisher_p->keyState, publisher_p->numDests ) :
+                    publisher_p->numSent % publisher_p->numDests;
+        }
+        if ( publisher_p->nonBlocking ) {
+            rc = sendNonBlocking ( publisher_p->msgs_p[dest], &nextSession, &publisher_p->parkedNs );
+        } else {
+            /* Blocking sends stall here while the Session's window is closed. */
+            rc = sendOnSession ( &pubSessions_s[publisher_p->firstSession + nextSession], publisher_p->msgs_p[dest] );
+            nextSession = ( nextSession + 1 ) % publisher_p->numSessions;
+        }
+        if ( rc != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_send" );
+            break;
+        }
+        if ( phase == COMMON_RUN_MEASURE ) {
+            publisher_p->destSent_p[dest]++;
+            publisher_p->numMeasured++;
+        }
+        /* Check message rate every message. */
+        if ( publisher_p->msgRate > 0 ) {
+            pacerWaitUntil ( &pacer, ( UINT64 ) targetTime );
+            targetTime += nsPerMsg;
+        }
+    }
+
+    if ( timed ) {
+        publisher_p->elapsedUs = ( long long ) ( common_runControlWindowNs ( publisher_p->runControl_p, getTimeInNs (  ) ) / 1000 );
+    } else {
+        publisher_p->elapsedUs = ( long long ) ( ( getTimeInNs (  ) - startTime ) / 1000 );
+    }
+}
+
+/*
+ * fn pubThread()
+ * The publisher thread of one shard in '--shards=n,threads' mode.
+ */
+static          threadRetType
+pubThread ( void *user_p )
+{
+    publish ( ( publisher_t * ) user_p );
+    return DEFAULT_THREAD_RETURN_ARG;
+}
+
+/*
+ * fn parseShards()
+ * param spec_p The --shards value, 'n[,hash][,threads]'.
+ *
+ * Returns 1 if the whole spec was understood, 0 otherwise.
+ */
+static int
+parseShards ( const char *spec_p, int *numShards_p, int *shardMode_p, BOOL * threads_p )
+{
+    char            spec[64];
+    char           *value_p;
+    char           *next_p;
+
+    strncpy ( spec, spec_p, sizeof ( spec ) );
+    spec[sizeof ( spec ) - 1] = ( char ) 0;
+    if ( ( next_p = strchr ( spec, ',' ) ) != NULL ) {
+        *next_p++ = ( char ) 0;
+    }
+    *numShards_p = atoi ( spec );
+    if ( ( *numShards_p <= 0 ) || ( *numShards_p > MAX_SHARDS ) ) {
+        printf ( "Error: number of shards \"%s\" must be 1 to %d\n", spec, MAX_SHARDS );
+        return 0;
+    }
+    for ( value_p = next_p; value_p != NULL; value_p = next_p ) {
+        if ( ( next_p = strchr ( value_p, ',' ) ) != NULL ) {
+            *next_p++ = ( char ) 0;
+        }
+        if ( strcasecmp ( value_p, "hash" ) == 0 ) {
+            *shardMode_p = SHARD_HASH;
+        } else if ( strcasecmp ( value_p, "threads" ) == 0 ) {
+            *threads_p = TRUE;
+        } else {
+            printf ( "Error: unknown shards option \"%s\"\n", value_p );
+            return 0;
+        }
+    }
+    if ( *threads_p && ( *numShards_p > MAX_SESSIONS ) ) {
+        printf ( "Error: at most %d shards can have their own threads\n", MAX_SESSIONS );
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * fn parseAutotune()
+ * param spec_p The --autotune value, 'name=value,value...' lists separated by ':'.
+ * param autotune_p The autotune configurations, holding the defaults for the
+ *                  lists not given.
+ *
+ * Returns 1 if the whole spec was understood, 0 otherwise.
+ */
+static int
+parseAutotune ( const char *spec_p, autotune_t * autotune_p )
+{
+    char            spec[256];
+    char           *name_p;
+    char           *next_p;
+    char           *value_p;
+    char           *nextValue_p;
+    int            *values_p;
+    int            *numValues_p;
+    int             value;
+
+    strncpy ( spec, spec_p, sizeof ( spec ) );
+    spec[sizeof ( spec ) - 1] = ( char ) 0;
+    for ( name_p = spec; name_p != NULL; name_p = next_p ) {
+        if ( ( next_p = strchr ( name_p, ':' ) ) != NULL ) {
+            *next_p++ = ( char ) 0;
+        }
+        if ( ( value_p = strchr ( name_p, '=' ) ) == NULL ) {
+            printf ( "Error: autotune list \"%s\" is not 'name=value,value...'\n", name_p );
+            return 0;
+        }
+        *value_p++ = ( char ) 0;
+        if ( strcasecmp ( name_p, "budget" ) == 0 ) {
+            autotune_p->budgetUs = atoi ( value_p );
+            continue;
+        } else if ( strcasecmp ( name_p, "msgs" ) == 0 ) {
+            if ( ( autotune_p->roundMsgs = atoi ( value_p ) ) <= 0 ) {
+                printf ( "Error: bad msgs value \"%s\" in autotune\n", value_p );
+                return 0;
+            }
+            continue;
+        } else if ( strcasecmp ( name_p, "window" ) == 0 ) {
+            values_p = autotune_p->window;
+            numValues_p = &autotune_p->numWindow;
+        } else if ( strcasecmp ( name_p, "ack" ) == 0 ) {
+            values_p = autotune_p->ackMode;
+            numValues_p = &autotune_p->numAckMode;
+        } else if ( strcasecmp ( name_p, "size" ) == 0 ) {
+            values_p = autotune_p->size;
+            numValues_p = &autotune_p->numSize;
+        } else {
+            printf ( "Error: unknown autotune list \"%s\"\n", name_p );
+            return 0;
+        }
+
+        *numValues_p = 0;
+        for ( ; value_p != NULL; value_p = nextValue_p ) {
+            if ( ( nextValue_p = strchr ( value_p, ',' ) ) != NULL ) {
+                *nextValue_p++ = ( char ) 0;
+            }
+            if ( values_p == autotune_p->ackMode ) {
+                value = ( strcasecmp ( value_p, "per-msg" ) == 0 ) ? COMMON_ACK_EVENT_PER_MSG :
+                        ( strcasecmp ( value_p, "windowed" ) == 0 ) ? COMMON_ACK_EVENT_WINDOWED : -1;
+            } else {
+                value = atoi ( value_p );
+                if ( value <= 0 ) {
+                    value = -1;
+                }
+            }
+            if ( ( value < 0 ) || ( ( values_p == autotune_p->window ) && ( value > 255 ) ) ) {
+                printf ( "Error: bad %s value \"%s\" in autotune\n", name_p, value_p );
+                return 0;
+            }
+            if ( *numValues_p == MAX_AUTOTUNE_VALUES ) {
+                printf ( "Error: more than %d %s values in autotune\n", MAX_AUTOTUNE_VALUES, name_p );
+                return 0;
+            }
+            values_p[( *numValues_p )++] = value;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fn runAutotune()
+ * param autotune_p The configurations to step through.
+ * param sessionProps The Session properties. The values at windowIndex and
+ *                    ackIndex are replaced for each step.
+ * param publisher_p The publisher to run each round with; its numMsgs is
+ *                    replaced by the round size, and it runs unpaced.
+ * param payload_p A buffer at least as large as the largest payload size.
+ *
+ * Runs every configuration to a steady rate and reports the fastest one for
+ * each payload size whose p99 acknowledgement latency fits the budget.
+ */
+static void
+runAutotune ( autotune_t * autotune_p, const char **sessionProps, int windowIndex, int ackIndex,
+              solClient_opaqueContext_pt context_p, solClient_session_createFuncInfo_t * sessionFuncInfo_p,
+              int numSessions, publisher_t * publisher_p, char *payload_p )
+{
+    char            windowStr[32];
+    int             sizeIndex;
+    int             windowIndexValue;
+    int             ackModeIndex;
+    int             round;
+    int             dest;
+    double          rate;
+    double          prevRate;
+    double          diff;
+    double          p50Us;
+    double          p99Us;
+    double          bestRate;
+    int             bestWindow;
+    int             bestAckMode;
+    double          bestP99Us;
+    BOOL            steady;
+
+    /* A paced publisher would run every step at the same rate. */
+    publisher_p->msgRate = 0;
+
+    printf ( "\nAutotune over %d window sizes, %d acknowledgement modes and %d payload sizes, "
+             "%d msgs per round unpaced, p99 budget %d usec\n",
+             autotune_p->numWindow, autotune_p->numAckMode, autotune_p->numSize, autotune_p->roundMsgs,
+             autotune_p->budgetUs );
+    printf ( "%8s %8s %8s %8s %14s %12s %12s\n", "size", "window", "ack", "rounds", "msgs/sec", "p50 usec", "p99 usec" );
+
+    for ( sizeIndex = 0; sizeIndex < autotune_p->numSize; sizeIndex++ ) {
+        for ( dest = 0; dest < publisher_p->numDests; dest++ ) {
+            if ( solClient_msg_setBinaryAttachment ( publisher_p->msgs_p[dest], payload_p,
+                                                     autotune_p->size[sizeIndex] ) != SOLCLIENT_OK ) {
+                common_handleError ( SOLCLIENT_FAIL, "solClient_msg_setBinaryAttachment()" );
+                return;
+            }
+        }
+        bestRate = 0.0;
+        bestWindow = 0;
+        bestAckMode = COMMON_ACK_EVENT_OFF;
+        bestP99Us = 0.0;
+
+        for ( windowIndexValue = 0; windowIndexValue < autotune_p->numWindow; windowIndexValue++ ) {
+            for ( ackModeIndex = 0; ackModeIndex < autotune_p->numAckMode; ackModeIndex++ ) {
+                /* The window size is fixed at Session creation, so each step needs new Sessions. */
+                snprintf ( windowStr, sizeof ( windowStr ), "%d", autotune_p->window[windowIndexValue] );
+                sessionProps[windowIndex] = windowStr;
+                ackEventMode_s = autotune_p->ackMode[ackModeIndex];
+                sessionProps[ackIndex] = ( ackEventMode_s == COMMON_ACK_EVENT_WINDOWED ) ?
+                        SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_WINDOWED : SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_PER_MSG;
+                if ( connectSessions ( sessionProps, context_p, sessionFuncInfo_p, numSessions ) != SOLCLIENT_OK ) {
+                    disconnectSessions (  );
+                    return;
+                }
+
+                publisher_p->numSessions = numPubSessions_s;
+
+                /* Publish rounds until the rate settles. */
+                prevRate = 0.0;
+                steady = FALSE;
+                rate = 0.0;
+                p50Us = 0.0;
+                p99Us = 0.0;
+                for ( round = 0; round < AUTOTUNE_MAX_ROUNDS; round++ ) {
+                    /* Every acknowledgement of the previous round has been recorded. */
+                    common_histogramInit ( &ackHist_s );
+                    publisher_p->numMsgs = autotune_p->roundMsgs;
+                    publish ( publisher_p );
+                    waitForAcks ( 10000 );
+                    if ( publisher_p->numSent < autotune_p->roundMsgs ) {
+                        disconnectSessions (  );
+                        return;
+                    }
+                    if ( acksPending (  ) ) {
+                        /*
+                         * Late acknowledgements would still be recorded into
+                         * the histogram, so it cannot be reset for another round.
+                         */
+                        round++;
+                        break;
+                    }
+                    rate = ( publisher_p->elapsedUs > 0 ) ?
+                            ( double ) publisher_p->numSent * 1000000.0 / ( double ) publisher_p->elapsedUs : 0.0;
+                    p50Us = ( double ) common_histogramValueAtPercentile ( &ackHist_s, 50.0 ) / 1000.0;
+                    p99Us = ( double ) common_histogramValueAtPercentile ( &ackHist_s, 99.0 ) / 1000.0;
+                    diff = ( rate > prevRate ) ? rate - prevRate : prevRate - rate;
+                    if ( ( round > 0 ) && ( diff <= prevRate * 0.05 ) ) {
+                        steady = TRUE;
+                        round++;
+                        break;
+                    }
+                    prevRate = rate;
+                }
+                disconnectSessions (  );
+
+                printf ( "%8d %8d %8s %8d %14.0f %12.3f %12.3f%s\n",
+                         autotune_p->size[sizeIndex], autotune_p->window[windowIndexValue],
+                         ( ackEventMode_s == COMMON_ACK_EVENT_WINDOWED ) ? "windowed" : "per-msg", round, rate,
+                         p50Us, p99Us, ( steady ) ? "" : " (not steady)" );
+
+                if ( ( ( autotune_p->budgetUs == 0 ) || ( p99Us <= ( double ) autotune_p->budgetUs ) ) &&
+                     ( rate > bestRate ) ) {
+                    bestRate = rate;
+                    bestWindow = autotune_p->window[windowIndexValue];
+                    bestAckMode = ackEventMode_s;
+                    bestP99Us = p99Us;
+                }
+            }
+        }
+
+        if ( bestWindow == 0 ) {
+            printf ( "Size %d: no configuration meets the p99 budget of %d usec\n",
+                     autotune_p->size[sizeIndex], autotune_p->budgetUs );
+        } else {
+            printf ( "Size %d: best is window %d with %s acknowledgements, %.0f msgs/sec, p99 %.3f usec\n",
+                     autotune_p->size[sizeIndex], bestWindow,
+                     ( bestAckMode == COMMON_ACK_EVENT_WINDOWED ) ? "windowed" : "per-msg", bestRate, bestP99Us );
+        }
+    }
+    printf ( "\n" );
+}
+
 /*
  * fn rxPerfCallbackFunc()
  * A solClient_session_rxCallbackFunc_t that does nothing when called.
@@ -54,25 +894,34 @@ main ( int argc, char *argv[] )
     solClient_opaqueContext_pt context_p;
     solClient_context_createFuncInfo_t contextFuncInfo = SOLCLIENT_CONTEXT_CREATEFUNC_INITIALIZER;
 
-    solClient_opaqueSession_pt session_p;
     solClient_session_createFuncInfo_t sessionFuncInfo = SOLCLIENT_SESSION_CREATEFUNC_INITIALIZER;
 
     const char     *sessionProps[50];
     int             propIndex;
 
-    int             loop;
-    char            binMsg[1024];
-    solClient_opaqueMsg_pt msg_p = NULL;
+    char           *payload_p = NULL;
+    int             payloadSize = 1024;
     solClient_destination_t destination;
+    char            destName[SOLCLIENT_BUFINFO_MAX_TOPIC_SIZE + 1];
+    int             numShards = 1;
+    int             shardMode = SHARD_ROUND_ROBIN;
+    BOOL            shardThreads = FALSE;
+    int             dest;
+    THREAD_HANDLE_T pubThreadHandle[MAX_SESSIONS];
+    int             numPublishers = 1;
+    int             loop;
     solClient_uint32_t deliveryMode;
     char            gdWindowStr[32];
-
-    long long       startTime;
-    long long       targetTime;
-    long long       currentTime;
-    long long       timeDiff;
-    long long       elapsedTime;
-    long double     usPerMsg;
+    int             windowIndex = 0;
+    int             ackIndex = 0;
+    autotune_t      autotune;
+    int             sizeIndex;
+    int             sessionIndex;
+    int             numSent = 0;
+    UINT64          parkedNs = 0;
+    solClient_stats_t windowCloses;
+    long long       elapsedTime = 0;
+    long long       destElapsed;
     char            positionalParms[] = "\t[mode]          Delivery Mode (persistentQ, non-persistentQ, persistentT,\n"\
 "\t                    non-persistentT - default persistentQ.)\n";
 
@@ -91,11 +940,80 @@ main ( int argc, char *argv[] )
                                 WINDOW_SIZE_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                SPIN_BUDGET_MASK |
+                                USE_TSC_MASK |
+                                NUM_SESSIONS_MASK |
+                                NON_BLOCKING_MASK |
+                                ACK_LATENCY_MASK |
+                                HIST_FILE_MASK |
+                                AUTOTUNE_MASK |
+                                SHARDS_MASK |
+                                RUN_CONTROL_MASK |
+                                LATENCY_MASK));                         /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
         exit(1);
     }
 
+    if ( commandOpts.autotuneSpec[0] != ( char ) 0 ) {
+        autotune.window[0] = 1;
+        for ( autotune.numWindow = 1; autotune.window[autotune.numWindow - 1] < 128; autotune.numWindow++ ) {
+            autotune.window[autotune.numWindow] = autotune.window[autotune.numWindow - 1] * 2;
+        }
+        autotune.window[autotune.numWindow++] = 255;
+        autotune.ackMode[0] = COMMON_ACK_EVENT_PER_MSG;
+        autotune.ackMode[1] = COMMON_ACK_EVENT_WINDOWED;
+        autotune.numAckMode = 2;
+        autotune.size[0] = payloadSize;
+        autotune.numSize = 1;
+        autotune.budgetUs = 0;
+        autotune.roundMsgs = 10000;
+        if ( !parseAutotune ( commandOpts.autotuneSpec, &autotune ) ) {
+            exit(1);
+        }
+        for ( sizeIndex = 0; sizeIndex < autotune.numSize; sizeIndex++ ) {
+            if ( autotune.size[sizeIndex] > payloadSize ) {
+                payloadSize = autotune.size[sizeIndex];
+            }
+        }
+        /* Every step records acknowledgement latency. */
+        commandOpts.ackEventMode = COMMON_ACK_EVENT_PER_MSG;
+        if ( commandOpts.durationSec > 0 ) {
+            printf ( "Ignoring --duration, as each autotune step publishes rounds of messages\n" );
+            commandOpts.durationSec = 0;
+        }
+    }
+
+    if ( commandOpts.shardSpec[0] != ( char ) 0 ) {
+        if ( !parseShards ( commandOpts.shardSpec, &numShards, &shardMode, &shardThreads ) ) {
+            exit(1);
+        }
+        if ( shardThreads ) {
+            /* One Session and one blocking publisher thread per shard. */
+            commandOpts.numSessions = numShards;
+            if ( commandOpts.nonBlocking ) {
+                printf ( "Sending with blocking Sessions, as each shard has its own thread\n" );
+                commandOpts.nonBlocking = FALSE;
+            }
+        }
+    }
+
+    if ( commandOpts.numSessions > MAX_SESSIONS ) {
+        printf ( "Number of Sessions %d exceeds the maximum of %d\n", commandOpts.numSessions, MAX_SESSIONS );
+        exit(1);
+    }
+
+    /* Calibrate the clock used for rate measurements. */
+    initTimeInNs ( commandOpts.useTsc );
+    printf ( "Timing with %s\n", getTimeInNsSource (  ) );
+
+    mutexInit ( &pubMutex_s );
+    condInit ( &pubCond_s );
+    ackEventMode_s = commandOpts.ackEventMode;
+    latencySource_s = commandOpts.latencySource;
+    common_histogramInit ( &ackHist_s );
+    common_runControlInit ( &runControl_s, commandOpts.durationSec, commandOpts.warmupSec, commandOpts.cooldownSec );
+
     /*
      * Set the destination and deliveryMode parameters, default to queue
      */
@@ -164,11 +1082,11 @@ main ( int argc, char *argv[] )
     }
 
     /*************************************************************************
-     * Create and connect a Session
+     * Create and connect the Sessions
      *************************************************************************/
 
     sessionFuncInfo.rxMsgInfo.callback_p = rxPerfMsgCallbackFunc;
-    sessionFuncInfo.eventInfo.callback_p = common_eventPerfCallback;
+    sessionFuncInfo.eventInfo.callback_p = pubEventCallbackFunc;
 
     /* Create a Session for sending and receiving messages. */
     propIndex = 0;
@@ -182,18 +1100,33 @@ main ( int argc, char *argv[] )
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_HOST;
         sessionProps[propIndex++] = commandOpts.targetHost;
     }
+    /*
+     * In non-blocking mode a send on a closed publish window returns
+     * SOLCLIENT_WOULD_BLOCK instead of stalling the publisher thread.
+     */
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_SEND_BLOCKING;
-    sessionProps[propIndex++] = SOLCLIENT_PROP_ENABLE_VAL;
+    sessionProps[propIndex++] = ( commandOpts.nonBlocking ) ? SOLCLIENT_PROP_DISABLE_VAL : SOLCLIENT_PROP_ENABLE_VAL;
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_COMPRESSION_LEVEL;
     sessionProps[propIndex++] = ( commandOpts.enableCompression ) ? "9" : "0";
 
     /* If publish window size was specified on the command line, then set it here
-     * in the Session properties. */
-    if ( commandOpts.gdWindow != 0 ) {
+     * in the Session properties. Autotune replaces the value for each step. */
+    if ( ( commandOpts.gdWindow != 0 ) || ( commandOpts.autotuneSpec[0] != ( char ) 0 ) ) {
         snprintf ( gdWindowStr, sizeof ( gdWindowStr ), "%d", commandOpts.gdWindow );
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_PUB_WINDOW_SIZE;
+        windowIndex = propIndex;
         sessionProps[propIndex++] = gdWindowStr;
     }
+    if ( ackEventMode_s != COMMON_ACK_EVENT_OFF ) {
+        sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE;
+        ackIndex = propIndex;
+        sessionProps[propIndex++] = ( ackEventMode_s == COMMON_ACK_EVENT_WINDOWED ) ?
+                SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_WINDOWED : SOLCLIENT_SESSION_PROP_ACK_EVENT_MODE_PER_MSG;
+    }
+    if ( latencySource_s == COMMON_LATENCY_SENDER ) {
+        sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_GENERATE_SEND_TIMESTAMPS;
+        sessionProps[propIndex++] = SOLCLIENT_PROP_ENABLE_VAL;
+    }
     if ( commandOpts.vpn[0] ) {
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_VPN_NAME;
         sessionProps[propIndex++] = commandOpts.vpn;
@@ -217,85 +1150,185 @@ main ( int argc, char *argv[] )
 
     sessionProps[propIndex++] = NULL;
 
-    solClient_log ( SOLCLIENT_LOG_INFO, "creating solClient session" );
-    if ( ( rc = solClient_session_create ( sessionProps,
-                                           context_p, &session_p, &sessionFuncInfo, sizeof ( sessionFuncInfo ) ) )
-         != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_create()" );
-        goto cleanup;
-    }
-
-    /* Connect the Session. */
-    solClient_log ( SOLCLIENT_LOG_INFO, "connecting solClient session" );
-    if ( ( rc = solClient_session_connect ( session_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_connect()" );
-        goto cleanup;
-    }
-
     /*************************************************************************
      * Publish
      *************************************************************************/
 
     /* 
-     * Prepare the message to send. Use the same message for each send
-     * operation.
+     * Prepare the message to send to each destination. Use the same message
+     * for each send operation to a destination.
      */
-    if ( ( rc = solClient_msg_alloc ( &msg_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_alloc()" );
-        goto sessionConnected;
+    if ( ( payload_p = ( char * ) malloc ( payloadSize ) ) == NULL ) {
+        printf ( "Could not allocate a %d byte payload\n", payloadSize );
+        goto cleanup;
     }
-    /* Set the delivery mode for the message. */
-    if ( ( rc = solClient_msg_setDeliveryMode ( msg_p, deliveryMode ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_setDeliveryMode()" );
-        goto sessionConnected;
+    memset ( ( void * ) payload_p, 0xab, payloadSize );
+
+    for ( dest = 0; dest < numShards; dest++ ) {
+        if ( ( rc = solClient_msg_alloc ( &destMsgs_s[dest] ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_alloc()" );
+            goto msgAllocated;
+        }
+        /* Set the delivery mode for the message. */
+        if ( ( rc = solClient_msg_setDeliveryMode ( destMsgs_s[dest], deliveryMode ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setDeliveryMode()" );
+            goto msgAllocated;
+        }
+        /* Initialize a binary attachment, and use it as part of the message */
+        if ( ( rc = solClient_msg_setBinaryAttachment ( destMsgs_s[dest], payload_p, payloadSize ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setBinaryAttachmentPtr()" );
+            goto msgAllocated;
+        }
+
+        if ( numShards > 1 ) {
+            if ( snprintf ( destName, sizeof ( destName ), "%s/%d", commandOpts.destinationName, dest ) >=
+                 ( int ) sizeof ( destName ) ) {
+                printf ( "Destination '%s/%d' is longer than %d characters\n", commandOpts.destinationName, dest,
+                         ( int ) sizeof ( destName ) - 1 );
+                goto msgAllocated;
+            }
+            destination.dest = destName;
+        }
+        if ( ( rc = solClient_msg_setDestination ( destMsgs_s[dest], &destination, sizeof ( destination ) ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setDestination()" );
+            goto msgAllocated;
+        }
     }
-    /* Initialize a binary attachment, and use it as part of the message */
-    memset ( ( void * ) binMsg, 0xab, sizeof ( binMsg ) );
-    if ( ( rc = solClient_msg_setBinaryAttachment ( msg_p, binMsg, sizeof ( binMsg ) ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_setBinaryAttachmentPtr()" );
-        goto sessionConnected;
+
+    /* A single publisher sends to every destination over every Session. */
+    memset ( &publishers_s[0], 0, sizeof ( publishers_s[0] ) );
+    publishers_s[0].msgs_p = destMsgs_s;
+    publishers_s[0].numDests = numShards;
+    publishers_s[0].destSent_p = destSent_s;
+    publishers_s[0].shardMode = shardMode;
+    publishers_s[0].keyState = 0x9E3779B97F4A7C15ULL;
+    publishers_s[0].numMsgs = commandOpts.numMsgsToSend;
+    publishers_s[0].msgRate = commandOpts.msgRate;
+    publishers_s[0].spinBudgetUs = commandOpts.spinBudgetUs;
+    publishers_s[0].nonBlocking = commandOpts.nonBlocking;
+    publishers_s[0].runControl_p = &runControl_s;
+
+    if ( commandOpts.autotuneSpec[0] != ( char ) 0 ) {
+        runAutotune ( &autotune, sessionProps, windowIndex, ackIndex, context_p, &sessionFuncInfo,
+                      commandOpts.numSessions, &publishers_s[0], payload_p );
+        goto msgAllocated;
     }
 
-    if ( ( rc = solClient_msg_setDestination ( msg_p, &destination, sizeof ( destination ) ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_msg_setDestination()" );
+    if ( connectSessions ( sessionProps, context_p, &sessionFuncInfo, commandOpts.numSessions ) != SOLCLIENT_OK ) {
         goto sessionConnected;
     }
+    publishers_s[0].numSessions = numPubSessions_s;
 
     /* Send a group of messages. */
-    usPerMsg = ( long double ) 1000000.0 / ( long double ) commandOpts.msgRate;
-
-    startTime = getTimeInUs (  );
-    targetTime = startTime + ( long long ) usPerMsg;
-
-    for ( loop = 0; loop < commandOpts.numMsgsToSend; loop++ ) {
-        if ( ( rc = solClient_session_sendMsg ( session_p, msg_p ) ) != SOLCLIENT_OK ) {
-            common_handleError ( rc, "solClient_session_send" );
-            break;
+    if ( shardThreads ) {
+        /* Each shard's thread sends its share of the messages on its own Session. */
+        for ( numPublishers = 0; numPublishers < numShards; numPublishers++ ) {
+            publishers_s[numPublishers] = publishers_s[0];
+            publishers_s[numPublishers].firstSession = numPublishers;
+            publishers_s[numPublishers].numSessions = 1;
+            publishers_s[numPublishers].msgs_p = &destMsgs_s[numPublishers];
+            publishers_s[numPublishers].numDests = 1;
+            publishers_s[numPublishers].destSent_p = &destSent_s[numPublishers];
+            publishers_s[numPublishers].numMsgs = commandOpts.numMsgsToSend / numShards +
+                    ( ( numPublishers < commandOpts.numMsgsToSend % numShards ) ? 1 : 0 );
+            publishers_s[numPublishers].msgRate = ( commandOpts.msgRate >= numShards ) ? commandOpts.msgRate / numShards : 1;
+            if ( ( pubThreadHandle[numPublishers] = startThread ( pubThread, &publishers_s[numPublishers] ) ) == _NULL_THREAD_ID ) {
+                printf ( "Could not start publisher thread %d\n", numPublishers );
+                break;
+            }
         }
-        /* Check message rate every message. */
-        currentTime = getTimeInUs (  );
-        timeDiff = targetTime - currentTime;
-        if ( timeDiff > 0 ) {
-            sleepInUs ( ( int ) ( timeDiff ) );
+        for ( loop = 0; loop < numPublishers; loop++ ) {
+            waitOnThread ( pubThreadHandle[loop] );
+        }
+    } else {
+        publish ( &publishers_s[0] );
+    }
+
+    for ( loop = 0; loop < numPublishers; loop++ ) {
+        numSent += publishers_s[loop].numMeasured;
+        parkedNs += publishers_s[loop].parkedNs;
+        if ( publishers_s[loop].elapsedUs > elapsedTime ) {
+            elapsedTime = publishers_s[loop].elapsedUs;
         }
-        targetTime += ( long long ) usPerMsg;
+    }
+    printf ( "Sent %d msgs on %d %s Session(s) in %lld usec%s, rate of %Lf msgs/sec\n",
+             numSent, numPubSessions_s, ( commandOpts.nonBlocking ) ? "non-blocking" : "blocking", elapsedTime,
+             common_runControlTimed ( &runControl_s ) ? " of measurement" : "",
+             ( long double ) numSent / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) );
 
+    /* Report the rate of each shard; a shard thread's rate is over its own run. */
+    if ( numShards > 1 ) {
+        for ( dest = 0; dest < numShards; dest++ ) {
+            destElapsed = ( shardThreads && ( dest < numPublishers ) ) ? publishers_s[dest].elapsedUs : elapsedTime;
+            printf ( "Shard %d (%s/%d): sent %llu msgs, rate of %.0f msgs/sec\n",
+                     dest, commandOpts.destinationName, dest, ( unsigned long long ) destSent_s[dest],
+                     ( destElapsed > 0 ) ? ( double ) destSent_s[dest] * 1000000.0 / ( double ) destElapsed : 0.0 );
+        }
     }
 
-    elapsedTime = getTimeInUs (  ) - startTime;
-    printf ( "Sent %d msgs in %lld usec, rate of %Lf msgs/sec\n",
-             commandOpts.numMsgsToSend, elapsedTime,
-             ( long double ) commandOpts.numMsgsToSend / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) );
+    /*
+     * Report how often each publish window closed and, in non-blocking mode,
+     * how long each Session waited for it to reopen.
+     */
+    for ( sessionIndex = 0; sessionIndex < numPubSessions_s; sessionIndex++ ) {
+        if ( solClient_session_getTxStat ( pubSessions_s[sessionIndex].session_p,
+                                           SOLCLIENT_STATS_TX_WINDOW_CLOSE, &windowCloses ) != SOLCLIENT_OK ) {
+            windowCloses = 0;
+        }
+        if ( commandOpts.nonBlocking ) {
+            printf ( "Session %d: sent %llu msgs, window closed %llu times, %llu would-block sends, "
+                     "window-blocked %llu usec\n",
+                     sessionIndex, ( unsigned long long ) pubSessions_s[sessionIndex].numSent,
+                     ( unsigned long long ) windowCloses,
+                     ( unsigned long long ) pubSessions_s[sessionIndex].numWouldBlock,
+                     ( unsigned long long ) ( pubSessions_s[sessionIndex].blockedNs / 1000 ) );
+        } else {
+            printf ( "Session %d: sent %llu msgs, window closed %llu times\n",
+                     sessionIndex, ( unsigned long long ) pubSessions_s[sessionIndex].numSent,
+                     ( unsigned long long ) windowCloses );
+        }
+    }
+    if ( commandOpts.nonBlocking ) {
+        printf ( "Publisher thread parked with every window closed for %llu usec (%.1f%% of the run)\n",
+                 ( unsigned long long ) ( parkedNs / 1000 ),
+                 ( elapsedTime > 0 ) ? ( double ) parkedNs / 10.0 / ( double ) elapsedTime : 0.0 );
+    }
 
-    solClient_msg_free ( &msg_p );
+    if ( ackEventMode_s != COMMON_ACK_EVENT_OFF ) {
+        /* Let the outstanding acknowledgements arrive before reporting. */
+        waitForAcks ( 10000 );
+        for ( sessionIndex = 0; sessionIndex < numPubSessions_s; sessionIndex++ ) {
+            if ( pubSessions_s[sessionIndex].numAcked < pubSessions_s[sessionIndex].numSent ) {
+                printf ( "Session %d: %llu msgs not acknowledged\n", sessionIndex,
+                         ( unsigned long long ) ( pubSessions_s[sessionIndex].numSent - pubSessions_s[sessionIndex].numAcked ) );
+            }
+            if ( pubSessions_s[sessionIndex].numRejected != 0 ) {
+                printf ( "Session %d: %llu msgs rejected\n", sessionIndex,
+                         ( unsigned long long ) pubSessions_s[sessionIndex].numRejected );
+            }
+        }
+        common_histogramPrint ( &ackHist_s, ( ackEventMode_s == COMMON_ACK_EVENT_WINDOWED ) ?
+                                "Acknowledgement latency (windowed events)" : "Acknowledgement latency (per-msg events)" );
+        if ( ( commandOpts.histFile[0] != ( char ) 0 ) && common_histogramDump ( &ackHist_s, commandOpts.histFile ) ) {
+            printf ( "Acknowledgement latency histogram written to '%s'\n", commandOpts.histFile );
+        }
+    }
 
    /*************************************************************************
     * Cleanup
     *************************************************************************/
   sessionConnected:
-    /* Disconnect the Session. */
-    if ( ( rc = solClient_session_disconnect ( session_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_disconnect()" );
+    /* Disconnect the Sessions. */
+    disconnectSessions (  );
+
+  msgAllocated:
+    for ( dest = 0; dest < numShards; dest++ ) {
+        if ( destMsgs_s[dest] != NULL ) {
+            solClient_msg_free ( &destMsgs_s[dest] );
+        }
+    }
+    if ( payload_p != NULL ) {
+        free ( payload_p );
     }
 
   cleanup:
@@ -306,7 +1339,9 @@ main ( int argc, char *argv[] )
     goto notInitialized;
 
   notInitialized:
-    /* Nothing to do - just exit. */
+    common_runControlDestroy ( &runControl_s );
+    condDestroy ( &pubCond_s );
+    mutexDestroy ( &pubMutex_s );
 
     return 0;
 }                               //End main()
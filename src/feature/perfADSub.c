@@ -6,6 +6,39 @@
  * This sample provides a high throughput Guaranteed Messaging subscribing 
  * example for the Solace Messaging API for C.
  *
+ * With '--duration', the run starts at the first message received and the
+ * receive rate is measured over the duration that follows the '--warmup',
+ * leaving out the messages received during the warm-up and the '--cooldown'.
+ * If no message arrives for as long as the whole run would take, the sample
+ * stops waiting.
+ *
+ * Messages are acknowledged through a common_ackCoalescer_t. With
+ * '--ack-batch=n,us' up to n messages are acknowledged together, and a partial
+ * batch is acknowledged once its oldest message has waited 'us' microseconds.
+ * The messages are also acknowledged on every Flow event and before the Flow is
+ * destroyed. The time spent acknowledging is reported, so the cost of
+ * acknowledging every message (the default, '--ack-batch=1') can be compared.
+ *
+ * With '--workers=n' the receive callbacks only count each message and hand it
+ * to one of n worker threads through a lock-free ring (see common_handoff_t).
+ * The workers acknowledge and free the messages, off the Context thread.
+ *
+ * With '--flows=k' k Flows are bound, to the Queues 'Queue/0' to 'Queue/k-1'
+ * (as published by 'perfADPub --shards=k'), or with 'shared' all to the one
+ * non-exclusive Queue, which the router round-robins over them. With 'sessions'
+ * each Flow gets its own Session and Context thread, so the Flows are processed
+ * in parallel. Each Flow has its own acknowledgement coalescer and, with
+ * '--workers', its own workers. The receive rate of each Flow is reported with
+ * the total and the spread between the slowest and the fastest Flow.
+ *
+ * With '--latency' the one-way latency of each message received in the
+ * measurement window is recorded in a histogram for its delivery mode, so that
+ * persistent, non-persistent and direct delivery can be compared. With 'stamp'
+ * the latency is measured from the send time perfADPub puts in the user data
+ * of each message, which needs both on one host; with 'sender' from the
+ * millisecond sender timestamp to the receive timestamp. The share of messages
+ * that were redelivered is always reported.
+ *
  * Copyright 2007-2018 Solace Corporation. All rights reserved.
  */
 
@@ -17,67 +50,605 @@
 #include "solclient/solClient.h"
 #include "common.h"
 
-static int      msgCount_s = 0;
-static long long firstMsgRecvTime_s = 0;
+#define MAX_FLOWS (64)
+
+/* The delivery modes one-way latency is recorded for. */
+#define MODE_PERSISTENT     (0)
+#define MODE_NONPERSISTENT  (1)
+#define MODE_DIRECT         (2)
+#define NUM_MODES           (3)
+
+static const char *modeNames_s[NUM_MODES] = { "persistent", "non-persistent", "direct" };
+
+/**
+ * @struct subFlow
+ * A bound Flow and what it received. The receive callbacks of a Flow run on the
+ * thread of its Session's Context, which is the only thread to update the
+ * counters; the main thread only reads them.
+ */
+typedef struct subFlow
+{
+    char            bindName[SOLCLIENT_BUFINFO_MAX_QUEUENAME_SIZE + 1]; /**< the Queue bound to */
+
+    BOOL            ownSession;             /**< TRUE if the Flow has its own Session and Context */
+
+    contextThreadInfo_t contextThreadInfo;  /**< the Flow's own Context, if ownSession */
+
+    solClient_opaqueSession_pt session_p;   /**< the Session the Flow is bound on */
+
+    BOOL            sessionConnected;       /**< TRUE once the Flow's own Session is connected */
+
+    solClient_opaqueFlow_pt flow_p;         /**< the Flow, NULL until created */
+
+    const char     *provProps[20];          /**< properties of the endpoint provisioned for the Flow */
+
+    BOOL            endpointCreated;        /**< TRUE if the endpoint was provisioned for the Flow */
+
+    common_ackCoalescer_t ackCoalescer;     /**< acknowledges the Flow's messages */
+
+    BOOL            coalescerStarted;       /**< TRUE once ackCoalescer is initialized */
+
+    common_handoff_t handoff;               /**< the Flow's workers, with --workers */
+
+    volatile UINT64 handoffOn;              /**< set once handoff is started */
+
+    volatile UINT64 numRx;                  /**< messages received */
+
+    volatile UINT64 numRxMeasured;          /**< messages received in the measurement window */
+
+    volatile UINT64 numRedelivered;         /**< messages received with the redelivered flag */
+
+    common_histogram_pt latencyHist_p;      /**< one-way latency per delivery mode, with --latency */
+} subFlow_t, *subFlow_pt;
+
+static subFlow_t flows_s[MAX_FLOWS];
+static int      numFlows_s = 1;
+static common_runControl_t runControl_s;
+static int      latencySource_s = COMMON_LATENCY_OFF;
+
+/*
+ * fn processMsg()
+ * A common_handoffFunc_t that acknowledges a message received on a Flow
+ * through the coalescer of the subFlow_t given as user_p, then frees it.
+ */
+static void
+processMsg ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p )
+{
+    solClient_msgId_t msgId;
+
+    if ( ( opaqueFlow_p != NULL ) && ( solClient_msg_getMsgId ( msg_p, &msgId ) == SOLCLIENT_OK ) ) {
+        common_ackCoalescerAdd ( &( ( subFlow_pt ) user_p )->ackCoalescer, opaqueFlow_p, msgId );
+    }
+    solClient_msg_free ( &msg_p );
+}
+
+/*
+ * fn modeIndex()
+ * Returns the MODE_ index of the delivery mode of a message.
+ */
+static int
+modeIndex ( solClient_opaqueMsg_pt msg_p )
+{
+    solClient_uint32_t deliveryMode;
+
+    if ( solClient_msg_getDeliveryMode ( msg_p, &deliveryMode ) != SOLCLIENT_OK ) {
+        return MODE_DIRECT;
+    }
+    switch ( deliveryMode ) {
+        case SOLCLIENT_DELIVERY_MODE_PERSISTENT:
+            return MODE_PERSISTENT;
+        case SOLCLIENT_DELIVERY_MODE_NONPERSISTENT:
+            return MODE_NONPERSISTENT;
+        default:
+            return MODE_DIRECT;
+    }
+}
+
+/*
+ * fn countMsg()
+ * Count a message received for a Flow, and count it as measured, recording its
+ * one-way latency, when it arrives in the measurement window. The first
+ * message starts the run.
+ */
+static void
+countMsg ( subFlow_pt sub_p, solClient_opaqueMsg_pt msg_p )
+{
+    UINT64          nowNs = getTimeInNs (  );
+    UINT64          latencyNs;
+
+    /* The first message of any Flow starts the run. */
+    common_runControlStart ( &runControl_s, nowNs );
+    if ( common_runControlPhase ( &runControl_s, nowNs ) == COMMON_RUN_MEASURE ) {
+        sub_p->numRxMeasured++;
+        if ( ( sub_p->latencyHist_p != NULL ) &&
+             common_latencyOneWay ( msg_p, latencySource_s, nowNs, &latencyNs ) ) {
+            common_histogramRecord ( &sub_p->latencyHist_p[modeIndex ( msg_p )], latencyNs );
+        }
+    }
+    if ( solClient_msg_isRedelivered ( msg_p ) ) {
+        sub_p->numRedelivered++;
+    }
+    sub_p->numRx++;
+}
+
+/*
+ * fn totalRx()
+ * param measured TRUE to sum the messages received in the measurement window.
+ *
+ * Returns the messages received by all Flows.
+ */
+static UINT64
+totalRx ( BOOL measured )
+{
+    UINT64          total = 0;
+    int             flow;
+
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        total += measured ? flows_s[flow].numRxMeasured : flows_s[flow].numRx;
+    }
+    return total;
+}
 
 
 /*
  * fn rxPerfCallbackFunc()
- * A solClient_session_rxCallbackFunc_t that counts messages when called.
+ * A solClient_session_rxCallbackFunc_t that counts messages when called, for
+ * the subFlow_t given as user_p.
  * This is to be used as part of a solClient_session_createFuncInfo_t
  * passed to a solClient_session_create().
  */
 static          solClient_rxMsgCallback_returnCode_t
 rxPerfMsgCallbackFunc ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
 {
-    /* For the first message, get time of receipt. */
-    if ( msgCount_s == 0 ) {
-        firstMsgRecvTime_s = getTimeInUs (  );
-    }
+    subFlow_pt      sub_p = ( subFlow_pt ) user_p;
 
-    msgCount_s++;
+    countMsg ( sub_p, msg_p );
 
+    if ( atomicLoadAcquire ( &sub_p->handoffOn ) ) {
+        return common_messageReceiveHandoffCallback ( opaqueSession_p, msg_p, &sub_p->handoff );
+    }
     return SOLCLIENT_CALLBACK_OK;
 }
 
 /*
  * fn ADS_flowEventCallbackFunc()
- * A solClient_flow_createEventCallbackFuncInfo_t that is empty.
+ * A solClient_flow_createEventCallbackFuncInfo_t that acknowledges the
+ * messages held for the subFlow_t given as user_p.
  * This is to be used as part of a solClient_flow_createFuncInfo_t
  * passed to a solClient_session_createFlow().
  */
 static void
 ADS_flowEventCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_flow_eventCallbackInfo_pt eventInfo_p, void *user_p )
 {
+    common_ackCoalescerFlush ( &( ( subFlow_pt ) user_p )->ackCoalescer );
 }
 
 
 /*
  * fn ADS_rxFlowCallbackFunc()
- * A solClient_flow_createRxCallbackFuncInfo_t that counts messages when called.
+ * A solClient_flow_createRxCallbackFuncInfo_t that counts messages when called,
+ * and acknowledges them through the coalescer of the subFlow_t given as
+ * user_p, or hands them to the Flow's workers to acknowledge.
  * This is to be used as part of a solClient_flow_createFuncInfo_t
  * passed to a solClient_session_createFlow().
  */
 static          solClient_rxMsgCallback_returnCode_t
 ADS_rxFlowMsgCallbackFunc ( solClient_opaqueFlow_pt opaqueFlow_p, solClient_opaqueMsg_pt msg_p, void *user_p )
 {
+    subFlow_pt      sub_p = ( subFlow_pt ) user_p;
     solClient_msgId_t msgId;
 
-    /* For the first message, get time of receipt. */
-    if ( msgCount_s == 0 ) {
-        firstMsgRecvTime_s = getTimeInUs (  );
+    if ( atomicLoadAcquire ( &sub_p->handoffOn ) ) {
+        countMsg ( sub_p, msg_p );
+        return common_flowMessageReceiveHandoffCallback ( opaqueFlow_p, msg_p, &sub_p->handoff );
     }
 
     /* Acknowledge the message after processing it. */
     if ( solClient_msg_getMsgId ( msg_p, &msgId )  == SOLCLIENT_OK ) {
-        solClient_flow_sendAck ( opaqueFlow_p, msgId );
+        common_ackCoalescerAdd ( &sub_p->ackCoalescer, opaqueFlow_p, msgId );
     }
 
-    msgCount_s++;
+    countMsg ( sub_p, msg_p );
 
     return SOLCLIENT_CALLBACK_OK;
 }
 
+/*
+ * fn parseFlows()
+ * param spec_p The --flows value, 'k[,shared][,sessions]'.
+ *
+ * Returns 1 if the whole spec was understood, 0 otherwise.
+ */
+static int
+parseFlows ( const char *spec_p, int *numFlows_p, BOOL * shared_p, BOOL * sessions_p )
+{
+    char            spec[64];
+    char           *value_p;
+    char           *next_p;
+
+    strncpy ( spec, spec_p, sizeof ( spec ) );
+    spec[sizeof ( spec ) - 1] = ( char ) 0;
+    if ( ( next_p = strchr ( spec, ',' ) ) != NULL ) {
+        *next_p++ = ( char ) 0;
+    }
+    *numFlows_p = atoi ( spec );
+    if ( ( *numFlows_p <= 0 ) || ( *numFlows_p > MAX_FLOWS ) ) {
+        printf ( "Error: number of flows \"%s\" must be 1 to %d\n", spec, MAX_FLOWS );
+        return 0;
+    }
+    for ( value_p = next_p; value_p != NULL; value_p = next_p ) {
+        if ( ( next_p = strchr ( value_p, ',' ) ) != NULL ) {
+            *next_p++ = ( char ) 0;
+        }
+        if ( strcasecmp ( value_p, "shared" ) == 0 ) {
+            *shared_p = TRUE;
+        } else if ( strcasecmp ( value_p, "sessions" ) == 0 ) {
+            *sessions_p = TRUE;
+        } else {
+            printf ( "Error: unknown flows option \"%s\"\n", value_p );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fn createFlowSession()
+ * param sub_p The Flow to create a Session for.
+ * param sessionProps The Session properties, shared by all Sessions.
+ *
+ * Creates a Context, its Context thread and a connected Session for the Flow
+ * alone. On failure, whatever was created is left for destroyFlowSession().
+ */
+static solClient_returnCode_t
+createFlowSession ( subFlow_pt sub_p, const char **sessionProps )
+{
+    solClient_context_createFuncInfo_t contextFuncInfo = SOLCLIENT_CONTEXT_CREATEFUNC_INITIALIZER;
+    solClient_session_createFuncInfo_t sessionFuncInfo = SOLCLIENT_SESSION_CREATEFUNC_INITIALIZER;
+    solClient_returnCode_t rc;
+
+    if ( ( rc = solClient_context_create ( NULL, &sub_p->contextThreadInfo.context_p,
+                                           &contextFuncInfo, sizeof ( contextFuncInfo ) ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_context_create()" );
+        return rc;
+    }
+    if ( !common_startContextThread ( &sub_p->contextThreadInfo ) ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "common_startContextThread() failed" );
+        solClient_context_destroy ( &sub_p->contextThreadInfo.context_p );
+        return SOLCLIENT_FAIL;
+    }
+    sub_p->ownSession = TRUE;
+
+    sessionFuncInfo.rxMsgInfo.callback_p = rxPerfMsgCallbackFunc;
+    sessionFuncInfo.rxMsgInfo.user_p = ( void * ) sub_p;
+    sessionFuncInfo.eventInfo.callback_p = common_eventPerfCallback;
+    if ( ( rc = solClient_session_create ( ( solClient_propertyArray_pt ) sessionProps, sub_p->contextThreadInfo.context_p,
+                                           &sub_p->session_p, &sessionFuncInfo, sizeof ( sessionFuncInfo ) ) )
+         != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_session_create()" );
+        return rc;
+    }
+    if ( ( rc = solClient_session_connect ( sub_p->session_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_session_connect()" );
+        return rc;
+    }
+    sub_p->sessionConnected = TRUE;
+    return SOLCLIENT_OK;
+}
+
+/*
+ * fn destroyFlowSession()
+ * param sub_p The Flow whose own Session to destroy.
+ *
+ * Disconnects and destroys the Flow's own Session, stops its Context thread and
+ * destroys its Context. Call it once the Flow is unbound.
+ */
+static void
+destroyFlowSession ( subFlow_pt sub_p )
+{
+    solClient_returnCode_t rc;
+
+    if ( !sub_p->ownSession ) {
+        return;
+    }
+    if ( sub_p->session_p != NULL ) {
+        if ( sub_p->sessionConnected ) {
+            if ( ( rc = solClient_session_disconnect ( sub_p->session_p ) ) != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_session_disconnect()" );
+            }
+        }
+        if ( ( rc = solClient_session_destroy ( &sub_p->session_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_destroy()" );
+        }
+    }
+    common_stopContextThread ( &sub_p->contextThreadInfo );
+    if ( ( rc = solClient_context_destroy ( &sub_p->contextThreadInfo.context_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_context_destroy()" );
+    }
+    sub_p->ownSession = FALSE;
+}
+
+/*
+ * fn bindFlow()
+ * param sub_p The Flow to bind, with its bindName and session_p set.
+ * param context_p The Context of the Flow's Session.
+ * param commandOpts_p The command options.
+ * param subscribeMode The endpoint to bind to.
+ * param provision TRUE to provision the endpoint if it does not exist.
+ * param shared TRUE to provision a non-exclusive Queue.
+ *
+ * Starts the Flow's acknowledgement coalescer and workers, provisions its
+ * endpoint and creates the Flow. On failure, whatever was started is left for
+ * unbindFlow().
+ */
+static solClient_returnCode_t
+bindFlow ( subFlow_pt sub_p, solClient_opaqueContext_pt context_p, struct commonOptions *commandOpts_p,
+           enum flowMode subscribeMode, BOOL provision, BOOL shared )
+{
+    solClient_returnCode_t rc;
+    solClient_flow_createFuncInfo_t flowFuncInfo = SOLCLIENT_FLOW_CREATEFUNC_INITIALIZER;
+    const char     *flowProps[20];
+    char            gdWindowStr[32];
+    int             propIndex = 0;
+    int             provIndex = 0;
+    solClient_errorInfo_pt errorInfo_p;
+
+    if ( ( rc = common_ackCoalescerInit ( &sub_p->ackCoalescer, context_p, commandOpts_p->ackBatchMsgs,
+                                          commandOpts_p->ackBatchUs ) ) != SOLCLIENT_OK ) {
+        return rc;
+    }
+    sub_p->coalescerStarted = TRUE;
+
+    if ( commandOpts_p->numWorkers > 0 ) {
+        if ( ( rc = common_handoffStart ( &sub_p->handoff, commandOpts_p->numWorkers, FALSE, processMsg,
+                                          sub_p ) ) != SOLCLIENT_OK ) {
+            return rc;
+        }
+        atomicStoreRelease ( &sub_p->handoffOn, 1 );
+    }
+
+    flowFuncInfo.rxMsgInfo.callback_p = ADS_rxFlowMsgCallbackFunc;
+    flowFuncInfo.rxMsgInfo.user_p = sub_p;
+    flowFuncInfo.eventInfo.callback_p = ADS_flowEventCallbackFunc;
+    flowFuncInfo.eventInfo.user_p = sub_p;
+
+    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_BLOCKING;
+    flowProps[propIndex++] = SOLCLIENT_PROP_DISABLE_VAL;
+
+    /* Set Acknowledge mode to CLIENT_ACK */
+    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE;
+    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE_CLIENT;
+
+
+    if ( commandOpts_p->gdWindow != 0 ) {
+        snprintf ( gdWindowStr, sizeof ( gdWindowStr ), "%d", commandOpts_p->gdWindow );
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_WINDOWSIZE;
+        flowProps[propIndex++] = gdWindowStr;
+    }
+
+    if ( subscribeMode == TE ) {
+
+        /* Durable Topic Endpoint */
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_TE;
+
+        if ( commandOpts_p->usingDurable ) {
+            flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_NAME;
+            flowProps[propIndex++] = COMMON_TESTDTE;
+
+            /* Durable Endpoint, set provision properties. */
+            sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ID;
+            sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_TE;
+            sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_NAME;
+            sub_p->provProps[provIndex++] = COMMON_TESTDTE;
+        } else {
+            flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_DURABLE;
+            flowProps[propIndex++] = SOLCLIENT_PROP_DISABLE_VAL;
+        }
+
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_TOPIC;
+        flowProps[propIndex++] = sub_p->bindName;   /* Topic name */
+    } else if ( subscribeMode == QUEUE ) {
+        /* Queue */
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_QUEUE;
+
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ID;
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_QUEUE;
+
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_NAME;
+        flowProps[propIndex++] = sub_p->bindName;   /* Queue name */
+
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_NAME;
+        sub_p->provProps[provIndex++] = sub_p->bindName;
+
+        if ( shared ) {
+            sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ACCESSTYPE;
+            sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ACCESSTYPE_NONEXCLUSIVE;
+        }
+    } else if ( subscribeMode == SUBSCRIBER ) {
+        /* Guaranteed Message Subscriber */
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
+        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_SUB;
+    }
+    flowProps[propIndex++] = NULL;
+
+    /* Does an endpoint need to be provisioned? Check if provision properties are set. */
+    if ( provision && ( provIndex > 0 ) ) {
+
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_PERMISSION;
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PERM_MODIFY_TOPIC;
+        sub_p->provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_QUOTA_MB;
+        sub_p->provProps[provIndex++] = "100";
+        sub_p->provProps[provIndex++] = NULL;
+
+        /* Try to provision the endpoint. */
+        if ( ( rc = solClient_session_endpointProvision ( ( solClient_propertyArray_pt ) sub_p->provProps,
+                                                          sub_p->session_p,
+                                                          SOLCLIENT_PROVISION_FLAGS_WAITFORCONFIRM,
+                                                          NULL, NULL, 0 ) ) != SOLCLIENT_OK ) {
+            errorInfo_p = solClient_getLastErrorInfo (  );
+            if ( errorInfo_p != NULL ) {
+                if ( ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_ENDPOINT_ALREADY_EXISTS ) ||
+                     ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_PERMISSION_NOT_ALLOWED ) ||
+                     ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_ENDPOINT_PROPERTY_MISMATCH ) ) {
+                    solClient_log ( SOLCLIENT_LOG_INFO,
+                                    "solClient_session_endpointProvision() failed subCode (%d:'%s')",
+                                    errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
+                } else {
+                    solClient_log ( SOLCLIENT_LOG_WARNING,
+                                    "solClient_session_endpointProvision() failed subCode (%d:'%s')",
+                                    errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
+                }
+            }
+        } else {
+            sub_p->endpointCreated = TRUE;
+        }
+    }
+
+    if ( ( rc = solClient_session_createFlow ( ( solClient_propertyArray_pt ) flowProps,
+                                               sub_p->session_p,
+                                               &sub_p->flow_p, &flowFuncInfo, sizeof ( flowFuncInfo ) ) ) != SOLCLIENT_IN_PROGRESS ) {
+        common_handleError ( rc, "solClient_session_createFlow() did not return SOLCLIENT_IN_PROGRESS after session create." );
+        return SOLCLIENT_FAIL;
+    }
+    return SOLCLIENT_OK;
+}
+
+/*
+ * fn unbindFlow()
+ * param sub_p The Flow to unbind.
+ *
+ * Lets the Flow's workers finish, acknowledges the messages held for it,
+ * destroys the Flow and deprovisions the endpoint provisioned for it. The
+ * coalescer is destroyed later, once no Context can run its timer.
+ */
+static void
+unbindFlow ( subFlow_pt sub_p )
+{
+    solClient_returnCode_t rc;
+    solClient_errorInfo_pt errorInfo_p;
+
+    if ( numFlows_s > 1 ) {
+        printf ( "Flow %d (%s):\n", ( int ) ( sub_p - flows_s ), sub_p->bindName );
+    }
+    if ( sub_p->handoffOn ) {
+        common_handoffStop ( &sub_p->handoff );
+        common_handoffPrint ( &sub_p->handoff );
+    }
+    if ( sub_p->coalescerStarted ) {
+        common_ackCoalescerClose ( &sub_p->ackCoalescer );
+    }
+    if ( sub_p->flow_p != NULL ) {
+        if ( ( rc = solClient_flow_destroy ( &sub_p->flow_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_flow_destroy()" );
+        }
+    }
+    if ( sub_p->coalescerStarted ) {
+        common_ackCoalescerPrint ( &sub_p->ackCoalescer );
+    }
+    if ( sub_p->endpointCreated ) {
+        if ( ( rc = solClient_session_endpointDeprovision ( ( solClient_propertyArray_pt ) sub_p->provProps,
+                                                            sub_p->session_p,
+                                                            SOLCLIENT_PROVISION_FLAGS_WAITFORCONFIRM, NULL ) ) != SOLCLIENT_OK ) {
+            errorInfo_p = solClient_getLastErrorInfo (  );
+            if ( errorInfo_p != NULL ) {
+                solClient_log ( SOLCLIENT_LOG_WARNING,
+                                "solClient_session_endpointDeprovision() failed subCode (%d:'%s')",
+                                errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
+            }
+        }
+        sub_p->endpointCreated = FALSE;
+    }
+}
+
+/*
+ * fn printFlowStats()
+ * param measured TRUE to report the messages received in the measurement window.
+ * param elapsedUs The time the messages were received in.
+ *
+ * Prints the receive rate of each Flow and the spread between the slowest and
+ * the fastest Flow, as a percentage of the mean. A spread near 0 means the
+ * messages were shared fairly.
+ */
+static void
+printFlowStats ( BOOL measured, long long elapsedUs )
+{
+    long double     seconds = ( long double ) elapsedUs / ( long double ) 1000000.0;
+    long double     rate;
+    long double     minRate = 0;
+    long double     maxRate = 0;
+    long double     totalRate = 0;
+    UINT64          count;
+    int             flow;
+
+    if ( elapsedUs <= 0 ) {
+        return;
+    }
+    printf ( "\nFlow  Queue                            Rx msgs       Rx rate (msgs/sec)\n" );
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        count = measured ? flows_s[flow].numRxMeasured : flows_s[flow].numRx;
+        rate = ( long double ) count / seconds;
+        printf ( "%-4d  %-32s %-12llu  %.0Lf\n", flow, flows_s[flow].bindName, ( unsigned long long ) count, rate );
+        if ( ( flow == 0 ) || ( rate < minRate ) ) {
+            minRate = rate;
+        }
+        if ( ( flow == 0 ) || ( rate > maxRate ) ) {
+            maxRate = rate;
+        }
+        totalRate += rate;
+    }
+    printf ( "Total                                  %-12llu  %.0Lf\n",
+             ( unsigned long long ) totalRx ( measured ), totalRate );
+    printf ( "Fairness: slowest %.0Lf msgs/sec, fastest %.0Lf msgs/sec, spread %.1Lf%% of the mean\n",
+             minRate, maxRate, ( totalRate > 0 ) ? ( maxRate - minRate ) * 100 * numFlows_s / totalRate : 0 );
+}
+
+/*
+ * fn printLatency()
+ * param histFile_p The file to write the histogram of every delivery mode to,
+ *                  or an empty string.
+ *
+ * Prints the one-way latency of each delivery mode, over all Flows. Call it
+ * once the Flows are unbound, so no Context thread is still recording.
+ */
+static void
+printLatency ( const char *histFile_p )
+{
+    common_histogram_pt hist_p;
+    common_histogram_pt all_p;
+    char            title[64];
+    int             mode;
+    int             flow;
+
+    if ( ( hist_p = ( common_histogram_pt ) malloc ( 2 * sizeof ( common_histogram_t ) ) ) == NULL ) {
+        return;
+    }
+    all_p = &hist_p[1];
+    common_histogramInit ( all_p );
+    printf ( "\n" );
+    for ( mode = 0; mode < NUM_MODES; mode++ ) {
+        common_histogramInit ( hist_p );
+        for ( flow = 0; flow < numFlows_s; flow++ ) {
+            common_histogramAdd ( hist_p, &flows_s[flow].latencyHist_p[mode] );
+        }
+        if ( hist_p->totalCount == 0 ) {
+            continue;
+        }
+        snprintf ( title, sizeof ( title ), "One-way latency, %s", modeNames_s[mode] );
+        common_histogramPrint ( hist_p, title );
+        common_histogramAdd ( all_p, hist_p );
+    }
+    if ( all_p->totalCount == 0 ) {
+        printf ( "One-way latency: no messages carried a %s\n",
+                 ( latencySource_s == COMMON_LATENCY_STAMP ) ? "send time stamp (publish with --latency=stamp)" :
+                 "sender and receive timestamp (publish with --latency=sender)" );
+    } else if ( ( histFile_p[0] != ( char ) 0 ) && common_histogramDump ( all_p, histFile_p ) ) {
+        printf ( "One-way latency histogram written to '%s'\n", histFile_p );
+    }
+    free ( hist_p );
+}
+
 /*
  * fn main() 
  * param appliance ip address
@@ -106,28 +677,23 @@ main ( int argc, char *argv[] )
     solClient_opaqueSession_pt session_p;
     solClient_session_createFuncInfo_t sessionFuncInfo = SOLCLIENT_SESSION_CREATEFUNC_INITIALIZER;
 
-    solClient_opaqueFlow_pt flow_p;
-    solClient_flow_createFuncInfo_t flowFuncInfo = SOLCLIENT_FLOW_CREATEFUNC_INITIALIZER;
-
     const char     *sessionProps[50];
     int             propIndex;
 
-    const char     *flowProps[20];
-    const char     *provProps[20];
-    int             provIndex;
-
-    long long       lastMsgRecvTime;
     long long       elapsedTime;
-    int             endpointCreated = 0;
-    solClient_errorInfo_pt errorInfo_p;
+    UINT64          waitStartNs;
+    BOOL            sharedQueue = FALSE;
+    BOOL            flowSessions = FALSE;
+    int             numBound = 0;
+    UINT64          numRedelivered = 0;
+    int             flow;
+    int             mode;
+    subFlow_pt      sub_p;
 
     enum flowMode   subscribeMode;
     char            positionalParms[] = "\tmode         Subscribe Mode (te, queue, sub - default queue).\n";
 
 
-    /* Set message count to 0. */
-    msgCount_s = 0;
-
     printf ( "\nperfADSub.c (Copyright 2007-2018 Solace Corporation. All rights reserved.)\n" );
 
     /*************************************************************************
@@ -143,10 +709,26 @@ main ( int argc, char *argv[] )
                                 WINDOW_SIZE_MASK |
                                 LOG_LEVEL_MASK |
                                 USE_GSS_MASK |
-                                ZIP_LEVEL_MASK));                       /* optional parameters */
+                                ZIP_LEVEL_MASK |
+                                USE_TSC_MASK |
+                                RUN_CONTROL_MASK |
+                                ACK_BATCH_MASK |
+                                WORKERS_MASK |
+                                FLOWS_MASK |
+                                LATENCY_MASK |
+                                HIST_FILE_MASK));                         /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
         exit(1);
     }
+    if ( commandOpts.workerQueueDepth != 0 ) {
+        printf ( "--workers takes no depth here; each worker has a ring of %d messages\n", COMMON_HANDOFF_RING_SIZE );
+        exit(1);
+    }
+
+    /* Calibrate the clock used for rate measurements. */
+    initTimeInNs ( commandOpts.useTsc );
+    printf ( "Timing with %s\n", getTimeInNsSource (  ) );
+    common_runControlInit ( &runControl_s, commandOpts.durationSec, commandOpts.warmupSec, commandOpts.cooldownSec );
 
     /*
      * If the user specified the deliveryMode string, override the 
@@ -166,6 +748,39 @@ main ( int argc, char *argv[] )
     } else {
         subscribeMode = QUEUE;
     }
+    if ( commandOpts.flowSpec[0] != ( char ) 0 ) {
+        if ( !parseFlows ( commandOpts.flowSpec, &numFlows_s, &sharedQueue, &flowSessions ) ) {
+            exit(1);
+        }
+        if ( ( numFlows_s > 1 ) && ( subscribeMode != QUEUE ) ) {
+            printf ( "Error: more than one flow needs the 'queue' mode\n" );
+            exit(1);
+        }
+    }
+    latencySource_s = commandOpts.latencySource;
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        if ( latencySource_s != COMMON_LATENCY_OFF ) {
+            if ( ( flows_s[flow].latencyHist_p =
+                   ( common_histogram_pt ) malloc ( NUM_MODES * sizeof ( common_histogram_t ) ) ) == NULL ) {
+                printf ( "Could not allocate the latency histograms\n" );
+                exit(1);
+            }
+            for ( mode = 0; mode < NUM_MODES; mode++ ) {
+                common_histogramInit ( &flows_s[flow].latencyHist_p[mode] );
+            }
+        }
+        if ( ( numFlows_s == 1 ) || sharedQueue ) {
+            strncpy ( flows_s[flow].bindName, commandOpts.destinationName, sizeof ( flows_s[flow].bindName ) );
+            flows_s[flow].bindName[sizeof ( flows_s[flow].bindName ) - 1] = ( char ) 0;
+        } else {
+            if ( snprintf ( flows_s[flow].bindName, sizeof ( flows_s[flow].bindName ), "%s/%d",
+                            commandOpts.destinationName, flow ) >= ( int ) sizeof ( flows_s[flow].bindName ) ) {
+                printf ( "Queue name '%s/%d' is longer than %d characters\n", commandOpts.destinationName, flow,
+                         ( int ) sizeof ( flows_s[flow].bindName ) - 1 );
+                exit(1);
+            }
+        }
+    }
     initSigHandler (  );
 
     /*************************************************************************
@@ -209,6 +824,7 @@ main ( int argc, char *argv[] )
      *************************************************************************/
 
     sessionFuncInfo.rxMsgInfo.callback_p = rxPerfMsgCallbackFunc;
+    sessionFuncInfo.rxMsgInfo.user_p = &flows_s[0];
     sessionFuncInfo.eventInfo.callback_p = common_eventPerfCallback;
 
     propIndex = 0;
@@ -225,6 +841,10 @@ main ( int argc, char *argv[] )
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_COMPRESSION_LEVEL;
     sessionProps[propIndex++] = ( commandOpts.enableCompression ) ? "9" : "0";
 
+    if ( latencySource_s == COMMON_LATENCY_SENDER ) {
+        sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_GENERATE_RCV_TIMESTAMPS;
+        sessionProps[propIndex++] = SOLCLIENT_PROP_ENABLE_VAL;
+    }
     if ( commandOpts.vpn[0] ) {
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_VPN_NAME;
         sessionProps[propIndex++] = commandOpts.vpn;
@@ -263,121 +883,46 @@ main ( int argc, char *argv[] )
     }
 
     /*************************************************************************
-     * Create a Flow (if needed)
+     * Create the Flows
      *************************************************************************/
 
-    flowFuncInfo.rxMsgInfo.callback_p = ADS_rxFlowMsgCallbackFunc;
-    flowFuncInfo.eventInfo.callback_p = ADS_flowEventCallbackFunc;
-
-    /* Does a Flow need to be created? */
-    propIndex = 0;
-    provIndex = 0;
-
-    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_BLOCKING;
-    flowProps[propIndex++] = SOLCLIENT_PROP_DISABLE_VAL;
-
-    /* Set Acknowledge mode to CLIENT_ACK */
-    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE;
-    flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_ACKMODE_CLIENT;
-
-
-    if ( commandOpts.gdWindow != 0 ) {
-        char            gdWindowStr[32];
-        snprintf ( gdWindowStr, sizeof ( gdWindowStr ), "%d", commandOpts.gdWindow );
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_WINDOWSIZE;
-        flowProps[propIndex++] = gdWindowStr;
-    }
-
-    if ( subscribeMode == TE ) {
-
-        /* Durable Topic Endpoint */
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_TE;
-
-        if ( commandOpts.usingDurable ) {
-            flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_NAME;
-            flowProps[propIndex++] = COMMON_TESTDTE;
-
-            /* Durable Endpoint, set provision properties. */
-            provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ID;
-            provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_TE;
-            provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_NAME;
-            provProps[provIndex++] = COMMON_TESTDTE;
+    /*
+     * The Flows share the Session created above unless each gets its own.
+     * A shared Queue is provisioned once, by the first Flow.
+     */
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        sub_p = &flows_s[flow];
+        numBound = flow + 1;
+        if ( flowSessions ) {
+            if ( createFlowSession ( sub_p, sessionProps ) != SOLCLIENT_OK ) {
+                goto sessionConnected;
+            }
         } else {
-            flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_DURABLE;
-            flowProps[propIndex++] = SOLCLIENT_PROP_DISABLE_VAL;
+            sub_p->session_p = session_p;
+        }
+        if ( bindFlow ( sub_p, flowSessions ? sub_p->contextThreadInfo.context_p : context_p, &commandOpts,
+                        subscribeMode, ( flow == 0 ) || !sharedQueue, sharedQueue ) != SOLCLIENT_OK ) {
+            goto sessionConnected;
         }
-
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_TOPIC;
-        flowProps[propIndex++] = commandOpts.destinationName;       /* Topic name */
-    } else if ( subscribeMode == QUEUE ) {
-        /* Queue */
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_QUEUE;
-
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_ID;
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_QUEUE;
-
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_NAME;
-        flowProps[propIndex++] = commandOpts.destinationName;       /* Queue name */
-
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_NAME;
-        provProps[provIndex++] = commandOpts.destinationName;
-    } else if ( subscribeMode == SUBSCRIBER ) {
-        /* Guaranteed Message Subscriber */
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_ID;
-        flowProps[propIndex++] = SOLCLIENT_FLOW_PROP_BIND_ENTITY_SUB;
     }
-    flowProps[propIndex++] = NULL;
-
-    /* Does an endpoint need to be provisioned? Check if provision properties are set. */
-    if ( provIndex > 0 ) {
-
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_PERMISSION;
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PERM_MODIFY_TOPIC;
-        provProps[provIndex++] = SOLCLIENT_ENDPOINT_PROP_QUOTA_MB;
-        provProps[provIndex++] = "100";
-        provProps[provIndex++] = NULL;
-
-        /* Try to provision the endpoint. */
-        if ( ( rc = solClient_session_endpointProvision ( provProps,
-                                                          session_p,
-                                                          SOLCLIENT_PROVISION_FLAGS_WAITFORCONFIRM,
-                                                          NULL, NULL, 0 ) ) != SOLCLIENT_OK ) {
-            errorInfo_p = solClient_getLastErrorInfo (  );
-            if ( errorInfo_p != NULL ) {
-                if ( ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_ENDPOINT_ALREADY_EXISTS ) ||
-                     ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_PERMISSION_NOT_ALLOWED ) ||
-                     ( errorInfo_p->subCode == SOLCLIENT_SUBCODE_ENDPOINT_PROPERTY_MISMATCH ) ) {
-                    solClient_log ( SOLCLIENT_LOG_INFO,
-                                    "solClient_session_endpointProvision() failed subCode (%d:'%s')",
-                                    errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
-                } else {
-                    solClient_log ( SOLCLIENT_LOG_WARNING,
-                                    "solClient_session_endpointProvision() failed subCode (%d:'%s')",
-                                    errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
-                }
-            }
+    if ( numFlows_s > 1 ) {
+        if ( sharedQueue ) {
+            printf ( "Bound %d flows to the shared queue %s", numFlows_s, flows_s[0].bindName );
         } else {
-            endpointCreated = 1;
+            printf ( "Bound %d flows to the queues %s to %s", numFlows_s, flows_s[0].bindName,
+                     flows_s[numFlows_s - 1].bindName );
         }
-    }
-
-    if ( ( rc = solClient_session_createFlow ( flowProps,
-                                               session_p,
-                                               &flow_p, &flowFuncInfo, sizeof ( flowFuncInfo ) ) ) != SOLCLIENT_IN_PROGRESS ) {
-        common_handleError ( rc, "solClient_session_createFlow() did not return SOLCLIENT_IN_PROGRESS after session create." );
-        goto sessionConnected;
+        printf ( ", %s\n", flowSessions ? "each on its own session" : "all on one session" );
     }
 
     /*************************************************************************
      * Subscribe
      *************************************************************************/
 
-    /* Add the subscription. */
+    /* Add the subscription, on the Session the Flow is bound on. */
     if ( subscribeMode == SUBSCRIBER ) {
         solClient_log ( SOLCLIENT_LOG_INFO, "adding subscription \"%s\"", commandOpts.destinationName );
-        if ( ( rc = solClient_session_topicSubscribe ( session_p, commandOpts.destinationName ) )
+        if ( ( rc = solClient_session_topicSubscribe ( flows_s[0].session_p, commandOpts.destinationName ) )
              != SOLCLIENT_OK ) {
             common_handleError ( rc, "solClient_session_topicSubscribe()" );
             goto sessionConnected;
@@ -390,15 +935,45 @@ main ( int argc, char *argv[] )
 
     printf ( "Waiting for messages....." );
     fflush ( stdout );
-    while ( ( msgCount_s < commandOpts.numMsgsToSend ) && !gotCtlC ) {
-        sleepInUs ( 100 );
-    }
+    if ( common_runControlTimed ( &runControl_s ) ) {
+        /* The first message starts the run; wait for the cool-down to end. */
+        waitStartNs = getTimeInNs (  );
+        while ( ( common_runControlPhase ( &runControl_s, getTimeInNs (  ) ) != COMMON_RUN_DONE ) && !gotCtlC ) {
+            if ( ( common_runControlStartNs ( &runControl_s ) == 0 ) &&
+                 ( getTimeInNs (  ) - waitStartNs >
+                   runControl_s.warmupNs + runControl_s.durationNs + runControl_s.cooldownNs ) ) {
+                printf ( "no messages received, " );
+                break;
+            }
+            sleepInUs ( 100 );
+        }
+        elapsedTime = ( long long ) ( common_runControlWindowNs ( &runControl_s, getTimeInNs (  ) ) / 1000 );
+        printf ( "Recv %llu msgs, %llu in the %lld usec measurement window, rate of %Lf msgs/sec\n",
+                 ( unsigned long long ) totalRx ( FALSE ), ( unsigned long long ) totalRx ( TRUE ), elapsedTime,
+                 ( elapsedTime > 0 ) ?
+                 ( long double ) totalRx ( TRUE ) / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) : 0.0 );
+    } else {
+        while ( ( totalRx ( FALSE ) < ( UINT64 ) commandOpts.numMsgsToSend ) && !gotCtlC ) {
+            sleepInUs ( 100 );
+        }
 
-    lastMsgRecvTime = getTimeInUs (  );
-    elapsedTime = lastMsgRecvTime - firstMsgRecvTime_s;
+        /* The run started at the first message, if one arrived before a Ctrl-C. */
+        elapsedTime = ( long long ) ( common_runControlWindowNs ( &runControl_s, getTimeInNs (  ) ) / 1000 );
 
-    printf ( "Recv %d msgs in %lld usec, rate of %Lf msgs/sec\n",
-             msgCount_s, elapsedTime, ( long double ) msgCount_s / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) );
+        printf ( "Recv %llu msgs in %lld usec, rate of %Lf msgs/sec\n",
+                 ( unsigned long long ) totalRx ( FALSE ), elapsedTime,
+                 ( elapsedTime > 0 ) ?
+                 ( long double ) totalRx ( FALSE ) / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) : 0.0 );
+    }
+    if ( numFlows_s > 1 ) {
+        printFlowStats ( common_runControlTimed ( &runControl_s ), elapsedTime );
+    }
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        numRedelivered += flows_s[flow].numRedelivered;
+    }
+    printf ( "Redelivered %llu of %llu msgs (%.3f%%)\n", ( unsigned long long ) numRedelivered,
+             ( unsigned long long ) totalRx ( FALSE ),
+             ( totalRx ( FALSE ) > 0 ) ? ( double ) numRedelivered * 100.0 / ( double ) totalRx ( FALSE ) : 0.0 );
 
 
     /*************************************************************************
@@ -413,23 +988,17 @@ main ( int argc, char *argv[] )
      * explicit unbind, temporary endpoints linger for 60 seconds. To ensure
      * temporary endpoints are removed immmediately, applications should explicitly
      * destroy Flows and not rely solely on solClient_cleanup().
+     * Unbind in reverse so a shared Queue is deprovisioned by the first Flow
+     * after the others have unbound.
      */
-    if ( flow_p != NULL ) {
-        if ( ( rc = solClient_flow_destroy ( &flow_p ) ) != SOLCLIENT_OK ) {
-            common_handleError ( rc, "solClient_flow_destroy()" );
-        }
+    for ( flow = numBound - 1; flow >= 0; flow-- ) {
+        unbindFlow ( &flows_s[flow] );
     }
-    if ( endpointCreated ) {
-        if ( ( rc = solClient_session_endpointDeprovision ( provProps,
-                                                            session_p,
-                                                            SOLCLIENT_PROVISION_FLAGS_WAITFORCONFIRM, NULL ) ) != SOLCLIENT_OK ) {
-            errorInfo_p = solClient_getLastErrorInfo (  );
-            if ( errorInfo_p != NULL ) {
-                solClient_log ( SOLCLIENT_LOG_WARNING,
-                                "solClient_session_endpointDeprovision() failed subCode (%d:'%s')",
-                                errorInfo_p->subCode, solClient_subCodeToString ( errorInfo_p->subCode ) );
-            }
-        }
+    for ( flow = numBound - 1; flow >= 0; flow-- ) {
+        destroyFlowSession ( &flows_s[flow] );
+    }
+    if ( ( latencySource_s != COMMON_LATENCY_OFF ) && ( totalRx ( TRUE ) > 0 ) ) {
+        printLatency ( commandOpts.histFile );
     }
     /* Disconnect the Session. */
     if ( ( rc = solClient_session_disconnect ( session_p ) ) != SOLCLIENT_OK ) {
@@ -441,10 +1010,22 @@ main ( int argc, char *argv[] )
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );
     }
+    /* Every Context is gone, so no timer callback can reach a coalescer. */
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        if ( flows_s[flow].coalescerStarted ) {
+            common_ackCoalescerDestroy ( &flows_s[flow].ackCoalescer );
+            flows_s[flow].coalescerStarted = FALSE;
+        }
+    }
     goto notInitialized;
 
   notInitialized:
-    /* Nothing to do - just exit. */
+    common_runControlDestroy ( &runControl_s );
+    for ( flow = 0; flow < numFlows_s; flow++ ) {
+        if ( flows_s[flow].latencyHist_p != NULL ) {
+            free ( flows_s[flow].latencyHist_p );
+        }
+    }
 
     return 0;
 }                               //End main()
@@ -0,0 +1,578 @@
+/** @example ex/perfRR.c
+ */
+
+/*
+ * This sample is a Request-Reply benchmark. A requester sends direct requests
+ * with a binary payload of MSG_SIZE bytes to one or more repliers, and each
+ * replier echoes the payload back in its reply. The requester matches every
+ * reply to its request by correlation ID (see common_requesterSend()) and
+ * reports the completed requests per second, the round-trip latency
+ * percentiles, the requests that timed out and the replies that arrived for no
+ * request in flight.
+ *
+ *  |--------------|  ---Topic or Topic/n --> |-------------|
+ *  | perfRR q[n]  |                          | perfRR r[i] |  x n
+ *  |--------------|  <------ReplyTo--------- |-------------|
+ *
+ * The requester runs closed-loop by default: it keeps up to the Window Size
+ * requests in flight (default 1) and sends the next as soon as a reply frees a
+ * slot, so the request rate is whatever the repliers sustain at that window.
+ * With --arrival=constant or --arrival=poisson it runs open-loop instead:
+ * requests are sent at the Message Rate whatever the replies do, up to the
+ * Window Size in flight (default 1024), and each round-trip latency is
+ * measured from the time the schedule intended the request to be sent, so
+ * time spent waiting for the window or for a late sender is not hidden.
+ *
+ * With n repliers ('q<n>'), requests are sent round-robin to 'Topic/0' to
+ * 'Topic/n-1', and replier 'r<i>' serves 'Topic/i'. A single replier ('r')
+ * serves 'Topic' itself. Each replier serves requests on its Context thread,
+ * or with --workers on a pool of worker threads (see common_replierStart()).
+ * Mode 'b' runs the requester and one replier, each with its own Context, in
+ * one process.
+ *
+ * The requests are taken from a ring of pre-built messages (--ring) whose
+ * payloads are filled by --payload. The requester sends the Number of
+ * Messages, or with --duration sends until the run ends; requests sent in the
+ * --warmup and --cooldown are left out of the results. Requests are sent with
+ * no API timeout and time out in the requester, whose count is printed with
+ * the results, so SOLCLIENT_STATS_TX_REQUEST_TIMEOUT never counts and is not
+ * shown. The API's discarded reply statistic
+ * (SOLCLIENT_STATS_RX_REPLY_MSG_DISCARD) for the measurement window is
+ * printed with the results, and the round-trip latency histogram is written
+ * to the --hist file if one is given.
+ *
+ * Copyright 2007-2018 Solace Corporation. All rights reserved.
+ */
+
+/**************************************************************************
+ *  For Windows builds, os.h should always be included first to ensure that
+ *  _WIN32_WINNT is defined before winsock2.h or windows.h get included.
+ **************************************************************************/
+#include "os.h"
+#include "solclient/solClient.h"
+#include "solclient/solClientMsg.h"
+#include "common.h"
+
+/* How long to wait for each reply, in milliseconds. */
+#define REQUEST_TIMEOUT_MS 5000
+
+/* The most repliers requests can be spread over. */
+#define MAX_REPLIERS 64
+
+/* The default number of requests in flight when running open-loop. */
+#define OPEN_LOOP_WINDOW 1024
+
+/* The default binary payload size, in bytes. */
+#define DEFAULT_MSG_SIZE 100
+
+/* The requests in flight. */
+static common_requester_t requester_s;
+
+/* The worker threads serving requests, when there are any (-j). */
+static common_replier_t replier_s;
+static BOOL     useWorkers_s = FALSE;
+
+/* Requests received by the replier, counted on its Context thread. */
+static UINT64   numServed_s = 0;
+
+/* The payload size of each request, and the replies that did not echo it. */
+static solClient_uint32_t payloadSize_s = DEFAULT_MSG_SIZE;
+static int      numBadReplies_s = 0;
+
+
+/*****************************************************************************
+ * echoRequest
+ *
+ * Send a reply carrying the payload of the request. This runs on the
+ * replier's Context thread, or on a worker thread when there are workers.
+ *****************************************************************************/
+static void
+echoRequest ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p )
+{
+    solClient_returnCode_t rc;
+    solClient_opaqueMsg_pt replyMsg_p;
+    void           *payload_p;
+    solClient_uint32_t size;
+
+    if ( ( rc = solClient_msg_alloc ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_alloc()" );
+        return;
+    }
+    if ( ( solClient_msg_getBinaryAttachmentPtr ( msg_p, &payload_p, &size ) == SOLCLIENT_OK ) && ( size > 0 ) ) {
+        if ( ( rc = solClient_msg_setBinaryAttachment ( replyMsg_p, payload_p, size ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setBinaryAttachment()" );
+            goto freeMsg;
+        }
+    }
+    if ( ( rc = solClient_session_sendReply ( opaqueSession_p, msg_p, replyMsg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_session_sendReply()" );
+    }
+
+  freeMsg:
+    if ( ( rc = solClient_msg_free ( &replyMsg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+/*****************************************************************************
+ * workerEchoRequest
+ *
+ * The replier calls this on a worker thread, which owns the request.
+ *****************************************************************************/
+static void
+workerEchoRequest ( solClient_opaqueMsg_pt msg_p, solClient_opaqueFlow_pt opaqueFlow_p, void *user_p )
+{
+    solClient_returnCode_t rc;
+
+    echoRequest ( ( solClient_opaqueSession_pt ) user_p, msg_p );
+    if ( ( rc = solClient_msg_free ( &msg_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_msg_free()" );
+    }
+}
+
+/*****************************************************************************
+ * replierRxCallback
+ *****************************************************************************/
+static          solClient_rxMsgCallback_returnCode_t
+replierRxCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    numServed_s++;
+    if ( useWorkers_s ) {
+        /* The worker replies and frees the request. */
+        common_replierPush ( &replier_s, msg_p, NULL );
+        return SOLCLIENT_CALLBACK_TAKE_MSG;
+    }
+    echoRequest ( opaqueSession_p, msg_p );
+    return SOLCLIENT_CALLBACK_OK;
+}
+
+/*****************************************************************************
+ * replyReceived
+ *
+ * The requester's function, called on the Context thread when a reply arrives
+ * or a request times out. Timeouts are counted by the requester.
+ *****************************************************************************/
+static void
+replyReceived ( solClient_opaqueMsg_pt replyMsg_p, void *reqUser_p, void *user_p )
+{
+    void           *payload_p;
+    solClient_uint32_t size = 0;
+
+    if ( replyMsg_p == NULL ) {
+        return;
+    }
+    if ( solClient_msg_getBinaryAttachmentPtr ( replyMsg_p, &payload_p, &size ) != SOLCLIENT_OK ) {
+        size = 0;
+    }
+    if ( size != payloadSize_s ) {
+        numBadReplies_s++;
+    }
+}
+
+/*****************************************************************************
+ * requesterRxCallback
+ *
+ * Replies are matched to their requests; anything else is ignored.
+ *****************************************************************************/
+static          solClient_rxMsgCallback_returnCode_t
+requesterRxCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
+{
+    common_requesterReceive ( &requester_s, msg_p );
+    return SOLCLIENT_CALLBACK_OK;
+}
+
+/*****************************************************************************
+ * startMeasuring
+ *
+ * Start the counts, the latency histogram and the Session statistics afresh
+ * for the measurement window. Called with no requests in flight.
+ *****************************************************************************/
+static void
+startMeasuring ( solClient_opaqueSession_pt opaqueSession_p, int window, common_schedule_pt schedule_p,
+                 struct commonOptions *commandOpts_p )
+{
+    solClient_returnCode_t rc;
+
+    common_requesterSetWindow ( &requester_s, window );
+    numBadReplies_s = 0;
+    if ( ( rc = solClient_session_clearStats ( opaqueSession_p ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_session_clearStats()" );
+    }
+    /* Restart the schedule too, so the pause to drain is not counted as lag. */
+    if ( schedule_p != NULL ) {
+        common_scheduleInit ( schedule_p, ( unsigned int ) commandOpts_p->msgRate, commandOpts_p->arrivalMode, 1,
+                              commandOpts_p->spinBudgetUs );
+    }
+}
+
+/*****************************************************************************
+ * printResults
+ *
+ * Print the requester's results, how far an open-loop sender fell behind its
+ * schedule and the API's request-reply statistics.
+ *****************************************************************************/
+static void
+printResults ( solClient_opaqueSession_pt opaqueSession_p, common_schedule_pt schedule_p, const char *histFile_p )
+{
+    solClient_stats_t requestsSent = 0;
+    solClient_stats_t repliesReceived = 0;
+    solClient_stats_t repliesDiscarded = 0;
+
+    common_requesterPrint ( &requester_s );
+    if ( numBadReplies_s != 0 ) {
+        printf ( "%d replies did not echo the %u byte payload\n", numBadReplies_s, payloadSize_s );
+    }
+    if ( schedule_p != NULL ) {
+        common_histogramPrint ( &schedule_p->lagHist, "Send schedule lag" );
+    }
+    solClient_session_getTxStat ( opaqueSession_p, SOLCLIENT_STATS_TX_REQUEST_SENT, &requestsSent );
+    solClient_session_getRxStat ( opaqueSession_p, SOLCLIENT_STATS_RX_REPLY_MSG, &repliesReceived );
+    solClient_session_getRxStat ( opaqueSession_p, SOLCLIENT_STATS_RX_REPLY_MSG_DISCARD, &repliesDiscarded );
+    printf ( "Session: %llu requests sent, %llu replies received, %llu replies discarded\n",
+             ( unsigned long long ) requestsSent, ( unsigned long long ) repliesReceived,
+             ( unsigned long long ) repliesDiscarded );
+    if ( ( histFile_p[0] != ( char ) 0 ) && common_histogramDump ( &requester_s.latency, histFile_p ) ) {
+        printf ( "Round-trip latency histogram written to '%s'\n", histFile_p );
+    }
+}
+
+/*****************************************************************************
+ * runRequests
+ *
+ * Send requests round-robin to numRepliers destinations until the run ends,
+ * then wait for the last replies. The results of the measurement window are
+ * printed when it ends.
+ *****************************************************************************/
+static void
+runRequests ( solClient_opaqueContext_pt context_p, solClient_opaqueSession_pt opaqueSession_p,
+              char topics[][SOLCLIENT_BUFINFO_MAX_TOPIC_SIZE + 1], int numRepliers,
+              struct commonOptions *commandOpts_p )
+{
+    solClient_returnCode_t rc;
+    solClient_destination_t destination;
+    common_msgRing_t ring;
+    common_runControl_t runControl;
+    common_schedule_t schedule;
+    common_schedule_pt schedule_p = NULL;
+    BOOL            openLoop = ( commandOpts_p->arrivalMode != COMMON_ARRIVAL_CLOSED );
+    BOOL            reported = FALSE;
+    UINT64          intendedNs = 0;
+    int             window = commandOpts_p->gdWindow;
+    int             ringSize;
+    int             phase;
+    int             lastPhase = -1;
+    int             loop;
+
+    if ( window <= 0 ) {
+        window = openLoop ? OPEN_LOOP_WINDOW : 1;
+    }
+    /* A multiple of the number of repliers, so each message keeps its destination. */
+    ringSize = ( commandOpts_p->ringSize > 0 ) ? commandOpts_p->ringSize : 1;
+    ringSize = ( ( ringSize + numRepliers - 1 ) / numRepliers ) * numRepliers;
+    if ( common_msgRingCreate ( &ring, ringSize, ( int ) payloadSize_s, commandOpts_p->payloadType,
+                                commandOpts_p->payloadFile, 1 ) != SOLCLIENT_OK ) {
+        return;
+    }
+    destination.destType = SOLCLIENT_TOPIC_DESTINATION;
+    for ( loop = 0; loop < ring.numMsgs; loop++ ) {
+        destination.dest = topics[loop % numRepliers];
+        if ( ( rc = solClient_msg_setDestination ( ring.msgs_p[loop], &destination, sizeof ( destination ) ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_msg_setDestination()" );
+            goto freeRing;
+        }
+    }
+
+    if ( common_requesterInit ( &requester_s, context_p, opaqueSession_p, FALSE, window, REQUEST_TIMEOUT_MS,
+                                replyReceived, NULL ) != SOLCLIENT_OK ) {
+        goto freeRing;
+    }
+    if ( openLoop ) {
+        schedule_p = &schedule;
+        common_scheduleInit ( schedule_p, ( unsigned int ) commandOpts_p->msgRate, commandOpts_p->arrivalMode, 1,
+                              commandOpts_p->spinBudgetUs );
+        printf ( "Sending %u byte requests to %d replier(s) open-loop at %d requests/sec, up to %d in flight\n",
+                 payloadSize_s, numRepliers, commandOpts_p->msgRate, window );
+    } else {
+        printf ( "Sending %u byte requests to %d replier(s) closed-loop, %d in flight\n",
+                 payloadSize_s, numRepliers, window );
+    }
+
+    common_runControlInit ( &runControl, commandOpts_p->durationSec, commandOpts_p->warmupSec,
+                            commandOpts_p->cooldownSec );
+    common_runControlStart ( &runControl, getTimeInNs (  ) );
+    for ( loop = 0; !gotCtlC; loop++ ) {
+        if ( !common_runControlTimed ( &runControl ) && ( loop >= commandOpts_p->numMsgsToSend ) ) {
+            break;
+        }
+        phase = common_runControlPhase ( &runControl, getTimeInNs (  ) );
+        if ( phase != lastPhase ) {
+            /* Drain at each edge of the measurement window, so no request straddles it. */
+            if ( phase == COMMON_RUN_MEASURE ) {
+                common_requesterDrain ( &requester_s );
+                startMeasuring ( opaqueSession_p, window, schedule_p, commandOpts_p );
+            } else if ( lastPhase == COMMON_RUN_MEASURE ) {
+                common_requesterDrain ( &requester_s );
+                printResults ( opaqueSession_p, schedule_p, commandOpts_p->histFile );
+                reported = TRUE;
+            }
+            lastPhase = phase;
+        }
+        if ( phase == COMMON_RUN_DONE ) {
+            break;
+        }
+        if ( schedule_p != NULL ) {
+            intendedNs = common_scheduleWait ( schedule_p );
+        }
+        if ( common_requesterSendAt ( &requester_s, ring.msgs_p[loop % ring.numMsgs], NULL, intendedNs ) != SOLCLIENT_OK ) {
+            break;
+        }
+    }
+    common_requesterDrain ( &requester_s );
+    if ( !reported ) {
+        printResults ( opaqueSession_p, schedule_p, commandOpts_p->histFile );
+    }
+    common_runControlDestroy ( &runControl );
+
+  freeRing:
+    common_msgRingDestroy ( &ring );
+}
+
+
+/*
+ * fn main()
+ * param appliance_ip The message backbone IP address.
+ * param appliance_username The client username.
+ * param request topic
+ *
+ * The entry point to the application.
+ */
+int
+main ( int argc, char *argv[] )
+{
+    char            positionalParms[] =
+            "\tMSG_SIZE        the size of the binary payload of each request; default is 100 bytes\n"
+            "\tRR_MODE         (default 'q') is one of \n"
+            "\t\tq[n]: for a requester sending round-robin to 'n' repliers (default 1)\n"
+            "\t\tr[i]: for a replier serving 'Topic/i', or 'Topic' with no 'i'\n"
+            "\t\tb: for a requester and one replier in this process\n";
+    struct commonOptions commandOpts;
+    solClient_returnCode_t rc = SOLCLIENT_OK;
+
+    /***********Context-related variable definitions*********/
+    solClient_opaqueContext_pt context_p = NULL;
+    solClient_opaqueContext_pt replierContext_p = NULL;
+    solClient_context_createFuncInfo_t contextFuncInfo = SOLCLIENT_CONTEXT_CREATEFUNC_INITIALIZER;
+
+    /***********Session-related variable definitions*********/
+    solClient_opaqueSession_pt session_p = NULL;
+    solClient_opaqueSession_pt replierSession_p = NULL;
+
+    char            topics[MAX_REPLIERS][SOLCLIENT_BUFINFO_MAX_TOPIC_SIZE + 1];
+    BOOL            runRequester = TRUE;
+    BOOL            runReplier = FALSE;
+    int             numRepliers = 1;
+    int             replierIndex = -1;
+    long            msgSize;
+    char           *end_p;
+    int             loop;
+
+    printf ( "\nperfRR.c (Copyright 2007-2018 Solace Corporation. All rights reserved.)\n" );
+
+    /* Intialize Control C handling */
+    initSigHandler (  );
+
+    /*************************************************************************
+     * Parse command options
+     *************************************************************************/
+    common_initCommandOptions(&commandOpts,
+                               ( USER_PARAM_MASK |
+                                DEST_PARAM_MASK ),    /* required parameters */
+                               ( HOST_PARAM_MASK |
+                                PASS_PARAM_MASK |
+                                LOG_LEVEL_MASK |
+                                USE_GSS_MASK |
+                                ZIP_LEVEL_MASK |
+                                NUM_MSGS_MASK |
+                                MSG_RATE_MASK |
+                                WINDOW_SIZE_MASK |
+                                ARRIVAL_MASK |
+                                SPIN_BUDGET_MASK |
+                                USE_TSC_MASK |
+                                PAYLOAD_MASK |
+                                HIST_FILE_MASK |
+                                WORKERS_MASK |
+                                RUN_CONTROL_MASK));                     /* optional parameters */
+    /* No default rate, so an open-loop run without --mr is caught below. */
+    commandOpts.msgRate = 0;
+    if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
+        exit (1);
+    }
+
+    /* Binary payload size option. */
+    if ( optind < argc ) {
+        msgSize = strtol ( argv[optind], &end_p, 10 );
+        if ( ( *end_p != ( char ) 0 ) || ( msgSize < 0 ) || ( msgSize > 0x7fffffffL ) ) {
+            printf ( "Error: MSG_SIZE \"%s\" is not a size in bytes\n", argv[optind] );
+            goto notInitialized;
+        }
+        payloadSize_s = ( solClient_uint32_t ) msgSize;
+    }
+    /* Requester, replier, or both. */
+    if ( ( optind + 1 ) < argc ) {
+        if ( *( argv[optind + 1] ) == 'q' ) {
+            if ( *( argv[optind + 1] + 1 ) != ( char ) 0 ) {
+                numRepliers = atoi ( argv[optind + 1] + 1 );
+            }
+        } else if ( *( argv[optind + 1] ) == 'r' ) {
+            runRequester = FALSE;
+            runReplier = TRUE;
+            if ( *( argv[optind + 1] + 1 ) != ( char ) 0 ) {
+                replierIndex = atoi ( argv[optind + 1] + 1 );
+            }
+        } else if ( *( argv[optind + 1] ) == 'b' ) {
+            runReplier = TRUE;
+        } else {
+            printf ( "Error: Unknown RR_MODE value \"%s\"\n", argv[optind + 1] );
+            goto notInitialized;
+        }
+    }
+    if ( ( numRepliers < 1 ) || ( numRepliers > MAX_REPLIERS ) ) {
+        printf ( "Error: the number of repliers must be from 1 to %d\n", MAX_REPLIERS );
+        goto notInitialized;
+    }
+    if ( ( commandOpts.arrivalMode != COMMON_ARRIVAL_CLOSED ) && ( commandOpts.msgRate <= 0 ) ) {
+        printf ( "Error: an open-loop run needs a Message Rate\n" );
+        goto notInitialized;
+    }
+
+    /* One request topic, or one per replier. */
+    for ( loop = 0; loop < numRepliers; loop++ ) {
+        if ( numRepliers == 1 ) {
+            snprintf ( topics[loop], sizeof ( topics[loop] ), "%s", commandOpts.destinationName );
+        } else if ( snprintf ( topics[loop], sizeof ( topics[loop] ), "%s/%d", commandOpts.destinationName, loop ) >=
+                    ( int ) sizeof ( topics[loop] ) ) {
+            printf ( "Error: topic '%s/%d' is longer than %d characters\n", commandOpts.destinationName, loop,
+                     ( int ) sizeof ( topics[loop] ) - 1 );
+            goto notInitialized;
+        }
+    }
+    if ( ( replierIndex >= 0 ) &&
+         ( snprintf ( topics[0], sizeof ( topics[0] ), "%s/%d", commandOpts.destinationName, replierIndex ) >=
+           ( int ) sizeof ( topics[0] ) ) ) {
+        printf ( "Error: topic '%s/%d' is longer than %d characters\n", commandOpts.destinationName, replierIndex,
+                 ( int ) sizeof ( topics[0] ) - 1 );
+        goto notInitialized;
+    }
+
+    /*************************************************************************
+     * Initialize the API and setup logging level
+     *************************************************************************/
+    /* solClient needs to be initialized before any other API calls are made. */
+    if ( ( rc = solClient_initialize ( SOLCLIENT_LOG_DEFAULT_FILTER, NULL ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_initialize()" );
+        goto notInitialized;
+    }
+
+    common_printCCSMPversion (  );
+
+    /*
+     * Standard logging levels can be set independently for the API and the
+     * application. In this case, the ALL category is used to set the log level for
+     * both at the same time.
+     */
+    solClient_log_setFilterLevel ( SOLCLIENT_LOG_CATEGORY_ALL, commandOpts.logLevel );
+
+    /* Calibrate the clock used for all rate and latency measurements. */
+    initTimeInNs ( commandOpts.useTsc );
+    printf ( "Timing with %s\n", getTimeInNsSource (  ) );
+
+    /*************************************************************************
+     * Start the replier
+     *************************************************************************/
+    if ( runReplier ) {
+        /* The replier has its own Context thread, apart from the requester's. */
+        if ( ( rc = solClient_context_create ( SOLCLIENT_CONTEXT_PROPS_DEFAULT_WITH_CREATE_THREAD,
+                                               &replierContext_p, &contextFuncInfo, sizeof ( contextFuncInfo ) ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_create()" );
+            goto cleanup;
+        }
+        if ( ( rc = common_createAndConnectSession ( replierContext_p, &replierSession_p, replierRxCallback,
+                                                     common_eventCallback, NULL, &commandOpts ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "common_createAndConnectSession()" );
+            goto cleanup;
+        }
+        if ( commandOpts.numWorkers > 0 ) {
+            if ( common_replierStart ( &replier_s, commandOpts.numWorkers, commandOpts.workerQueueDepth,
+                                       workerEchoRequest, replierSession_p ) != SOLCLIENT_OK ) {
+                goto sessionConnected;
+            }
+            useWorkers_s = TRUE;
+            printf ( "Serving requests on %d worker threads\n", commandOpts.numWorkers );
+        }
+        if ( ( rc = solClient_session_topicSubscribeExt ( replierSession_p,
+                                                          SOLCLIENT_SUBSCRIBE_FLAGS_WAITFORCONFIRM,
+                                                          topics[0] ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_topicSubscribe()" );
+            goto sessionConnected;
+        }
+        printf ( "Serving requests on topic '%s'\n", topics[0] );
+    }
+
+    /*************************************************************************
+     * Run the requester, or serve requests until CTRL-C
+     *************************************************************************/
+    if ( runRequester ) {
+        if ( ( rc = solClient_context_create ( SOLCLIENT_CONTEXT_PROPS_DEFAULT_WITH_CREATE_THREAD,
+                                               &context_p, &contextFuncInfo, sizeof ( contextFuncInfo ) ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_create()" );
+            goto sessionConnected;
+        }
+        if ( ( rc = common_createAndConnectSession ( context_p, &session_p, requesterRxCallback,
+                                                     common_eventCallback, NULL, &commandOpts ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "common_createAndConnectSession()" );
+            goto sessionConnected;
+        }
+        runRequests ( context_p, session_p, topics, numRepliers, &commandOpts );
+    } else {
+        printf ( "Ctrl-C to stop.....\n" );
+        while ( !gotCtlC ) {
+            sleepInSec ( 1 );
+        }
+        printf ( "Got Ctrl-C, cleaning up\n" );
+    }
+
+    /*************************************************************************
+     * CLEANUP
+     *************************************************************************/
+  sessionConnected:
+    if ( session_p != NULL ) {
+        if ( ( rc = solClient_session_disconnect ( session_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_disconnect()" );
+        }
+    }
+
+    /* Requests still arriving are served on the Context thread. */
+    if ( useWorkers_s ) {
+        common_replierStop ( &replier_s );
+        common_replierPrint ( &replier_s );
+    }
+    if ( replierSession_p != NULL ) {
+        printf ( "Served %llu requests\n", ( unsigned long long ) numServed_s );
+        if ( ( rc = solClient_session_disconnect ( replierSession_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_session_disconnect()" );
+        }
+    }
+
+  cleanup:
+    common_replierDestroy ( &replier_s );
+
+    /* Cleanup solClient. */
+    if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_cleanup()" );
+    }
+    /* The Context is gone, so no reply or timer callback can reach the requester. */
+    common_requesterDestroy ( &requester_s );
+
+  notInitialized:
+    return 0;
+}
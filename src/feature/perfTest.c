@@ -11,8 +11,9 @@
  *           MSG_RATE - publish message rate (per second)
  *           MSG_SIZE - size of binary payload portion of message
  *           PUB_SUB_MODE - must be 'p'
- *           MULTI_SEND_MODE - "true" to send multiple messages per send call.
- *       (see pubThread() and pubThreadSendMultiple()).
+ *           MULTI_SEND_MODE - "true" to send multiple messages per send call, or
+ *                             "adaptive" to also size each batch by the backpressure seen.
+ *       (see pubThread(), pubThreadSendMultiple() and adaptBatchSize()).
  *    2. Subscriber throughput - will subscribe to messages on a Topic
  *       Program arguments of interest:
  *           NUM_MSGS - specify the number of messages expected to receive. The program
@@ -29,6 +30,55 @@
  *           PUB_SUB_MODE - must be 'b'
  *           MULTI_SEND_MODE - "true" to send multiple messages per send call.
  *       (see pubThread(), pubThreadSendMultiple(), and msgRxCallbackFunc()).
+ *    4. Publisher/subscriber latency - as 3., but each publisher stamps a monotonic
+ *       send time and a sequence number into the start of the binary payload, and the
+ *       subscriber records the latency of every message in a histogram.
+ *       Program arguments of interest:
+ *           PUB_SUB_MODE - must be 'l' (or 'L' for persistent messages)
+ *           --hist - the file to write the full latency histogram to
+ *       (see perfTestHeader_t and messageReceiveCallback()).
+ *
+ * By default the publishers pace themselves in groups of 10 messages and reset their
+ * schedule when they fall more than 10 ms behind, which hides the latency of messages
+ * that would have been sent while a publisher was stalled. With --arrival=constant or
+ * --arrival=poisson, every message is instead given an intended send time by an
+ * open-loop schedule (see common_scheduleWait()). A publisher that falls behind sends
+ * the late messages as fast as it can, latency is measured from the intended send time,
+ * and how far the sends fell behind the schedule is reported.
+ *
+ * Any of the tests can be sharded across several Contexts, each with its own Context
+ * thread, and several Sessions per Context with the --contexts and --sessions options.
+ * Publisher threads are spread round-robin across the Contexts and then across the
+ * Sessions of each Context. When more than one Session is used, each Session publishes
+ * and subscribes to its own Topic ('<topic>/<n>'), so each Context only receives the
+ * messages its own Sessions published. Rates are reported per shard and in total
+ * (see perfShard_t and printShardStats()).
+ *
+ * With --sample, the receive and transmit statistics of all Sessions are sampled on a
+ * Context timer while the test runs, and the message, byte, would-block and socket-full
+ * rates of each interval are written as CSV or JSON lines (see common_statsSamplerStart()).
+ * Each Context also prints the sequence check of its publishers at the same interval.
+ *
+ * Whenever MSG_SIZE leaves room for a perfTestHeader_t, each message carries its
+ * publisher's sequence number, and the subscriber reports per publisher the messages
+ * missing, the bursts they were lost in, and the messages reordered, duplicated or
+ * flagged with a discard indication (see printSeqReport()).
+ *
+ * With --sweep, one process runs a test for every combination of lists of MSG_SIZE,
+ * MSG_RATE, publisher thread count, TCP_NO_DELAY and MULTI_SEND_MODE values, with a
+ * warm-up before each, and writes the achieved rates, CPU time per message and Session
+ * statistics of each test as a row of a CSV file (see runSweep()).
+ *
+ * Each publisher cycles through a ring of pre-built messages (--ring), each with its own
+ * payload, so no message is allocated while publishing. With --payload the payloads are
+ * random, text-like or taken from a file rather than all zero, so compression and cache
+ * footprint behave as they would with real data (see createRing()).
+ *
+ * With --duration, the publishers send until the run ends instead of sending NUM_MSGS
+ * each. Messages sent or received during the --warmup and the --cooldown are left out
+ * of the rates and the latency, so connection set-up, cache warming and the drain at
+ * the end do not skew the results (see common_runControlPhase()). In subscriber only
+ * mode the run starts with the first message received.
  *
  * At the end of each test, performance statistics are printed (see printStats()).
  *
@@ -50,18 +100,155 @@ extern          "C"
 {
 #endif                          /* __cplusplus */
 
+#define MAX_CONTEXTS                (16)
+#define MAX_SESSIONS_PER_CONTEXT    (16)
+#define MAX_PUB_THREADS             (100)
+#define MAX_SWEEP_VALUES            (16)
+#define MAX_RING_BYTES              (64 * 1024 * 1024)
+
+/* Values of multiSend_s. */
+#define MULTI_SEND_OFF              (0)
+#define MULTI_SEND_FIXED            (1)
+#define MULTI_SEND_ADAPTIVE         (2)
+
 static int      exitEarly_s = 0;
-static int      rxDone_s = 0;
 static int      rxTimeout_s = 0;
 static int      usePub_s = 1;
 static int      useSub_s = 1;
-static int      multiSend_s = 0;
+static int      multiSend_s = MULTI_SEND_OFF;
 static int      binaryPayloadSize_s = 100;  /* default binary payload size of 100 bytes if not specified */
 static int      sendPersistent_s = 0;
-static unsigned int numRx_s = 0;
+static int      latencyMode_s = 0;
+static int      arrivalMode_s = COMMON_ARRIVAL_CLOSED;
+static int      spinBudgetUs_s = 0;
+static int      payloadType_s = COMMON_PAYLOAD_ZERO;
+static const char *payloadFile_s = NULL;
+static int      ringSize_s = 64;
 static unsigned int msgRate_s;
 static unsigned int msgNum_s;
-static char    *publishTopic_ps;
+static int      numShards_s = 0;
+static common_runControl_t runControl_s;
+
+/**
+ * @struct perfTestHeader
+ * The header stamped at the start of the binary payload whenever MSG_SIZE
+ * leaves room for it. The subscriber checks the per-publisher sequence numbers
+ * for gaps, duplicates and reordering. In latency mode, publisher and subscriber
+ * run on the same host, so the send time is a getTimeInNs() value and is copied
+ * in host byte order.
+ */
+typedef struct perfTestHeader
+{
+    UINT64          sendTimeNs;             /**< getTimeInNs() just before the send call */
+
+    solClient_uint32_t publisherId;         /**< index of the publishing thread */
+
+    solClient_uint32_t seqNum;              /**< per-publisher sequence number, starting at 0 */
+} perfTestHeader_t;
+
+/**
+ * @struct pubThreadInfo
+ * The argument passed to each publisher thread.
+ */
+typedef struct pubThreadInfo
+{
+    solClient_opaqueSession_pt session_p;   /**< the Session to publish on */
+
+    const char     *topic_p;                /**< the Topic to publish to */
+
+    solClient_uint32_t publisherId;         /**< index of this publisher thread */
+
+    unsigned int    txCount;                /**< set by the thread: messages sent */
+
+    long long       elapsedTime;            /**< set by the thread: publishing time in us */
+
+    common_schedule_pt schedule_p;          /**< set by the thread: its open-loop schedule, or NULL */
+} pubThreadInfo_t, *pubThreadInfo_pt;
+
+/**
+ * @struct perfShard
+ * One Context, its Context thread, and the Sessions created in it. All
+ * receive callbacks for a shard run on its Context thread, so the receive
+ * counters and the latency histogram need no locking.
+ */
+typedef struct perfShard
+{
+    contextThreadInfo_t contextThreadInfo;  /**< the Context and its thread */
+
+    solClient_opaqueSession_pt session_p[MAX_SESSIONS_PER_CONTEXT];     /**< the Sessions */
+
+    char            topic[MAX_SESSIONS_PER_CONTEXT][SOLCLIENT_BUFINFO_MAX_TOPIC_SIZE + 1];     /**< publish Topic per Session */
+
+    int             numSessions;            /**< number of Sessions created */
+
+    int             numConnected;           /**< number of Sessions connected */
+
+    int             numPub;                 /**< number of publisher threads using this shard */
+
+    unsigned int    numRx;                  /**< messages received */
+
+    unsigned int    numRxMeasured;          /**< messages received in the measurement window */
+
+    unsigned int    rxExpected;             /**< messages expected before receive is done */
+
+    common_histogram_t latencyHist;         /**< latency of received messages */
+
+    common_seqWindow_t seqWindow[MAX_PUB_THREADS];      /**< sequence checking per publisher */
+
+    solClient_context_timerId_t seqTimerId; /**< timer for periodic sequence samples */
+} perfShard_t, *perfShard_pt;
+
+static perfShard_t shards_s[MAX_CONTEXTS];
+
+/**
+ * @struct perfSweep
+ * The values run by a parameter sweep (see runSweep()). Each list holds
+ * the single value of a normal run unless the --sweep spec replaces it.
+ */
+typedef struct perfSweep
+{
+    int             size[MAX_SWEEP_VALUES];         /**< MSG_SIZE values */
+
+    int             numSize;                        /**< number of MSG_SIZE values */
+
+    int             rate[MAX_SWEEP_VALUES];         /**< MSG_RATE values */
+
+    int             numRate;                        /**< number of MSG_RATE values */
+
+    int             threads[MAX_SWEEP_VALUES];      /**< publisher thread counts */
+
+    int             numThreads;                     /**< number of publisher thread counts */
+
+    int             noDelay[MAX_SWEEP_VALUES];      /**< TCP_NO_DELAY values, 0 or 1 */
+
+    int             numNoDelay;                     /**< number of TCP_NO_DELAY values */
+
+    int             multiSend[MAX_SWEEP_VALUES];    /**< MULTI_SEND_MODE values, as multiSend_s */
+
+    int             numMultiSend;                   /**< number of MULTI_SEND_MODE values */
+
+    unsigned int    warmupMsgs;                     /**< messages each publisher sends before each test */
+} perfSweep_t, *perfSweep_pt;
+
+/*
+ * fn stampHeader()
+ * param binary_p Start of the binary payload.
+ * param publisherId Index of the publishing thread.
+ * param seqNum Sequence number of the message.
+ * param sendTimeNs Intended send time of the message, or 0 to use the current time.
+ *
+ * Writes a perfTestHeader_t at the start of the payload. The send time is only
+ * taken in latency mode.
+ */
+static void     stampHeader ( char *binary_p, solClient_uint32_t publisherId, solClient_uint32_t seqNum, UINT64 sendTimeNs )
+{
+    perfTestHeader_t header;
+
+    header.publisherId = publisherId;
+    header.seqNum = seqNum;
+    header.sendTimeNs = ( !latencyMode_s || ( sendTimeNs != 0 ) ) ? sendTimeNs : getTimeInNs (  );
+    memcpy ( binary_p, &header, sizeof ( header ) );
+}
 
 /*
 * fn printStats()
@@ -113,6 +300,79 @@ static void     printStats ( solClient_opaqueSession_pt session_p )
     }
 }
 
+/**
+* fn printShardStats()
+* param pubThreadInfo_p Array of publisher thread information.
+* param numThread Number of entries in pubThreadInfo_p.
+*
+* This function prints the publish and receive rates of each shard and the
+* total across all shards. A shard's publish rate is the number of messages
+* its publisher threads sent divided by the longest publishing time among them.
+* In a timed run, only the messages of the measurement window are counted.
+*/
+static void     printShardStats ( pubThreadInfo_pt pubThreadInfo_p, int numThread )
+{
+    int             shard;
+    int             loop;
+    unsigned long long txCount;
+    long long       elapsedTime;
+    unsigned long long totalTxCount = 0;
+    long long       totalElapsedTime = 0;
+    unsigned long long totalRxCount = 0;
+
+    printf ( "\nShard  Sessions  Publishers  Tx msgs       Tx rate (msgs/sec)  Rx msgs\n" );
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        txCount = 0;
+        elapsedTime = 0;
+        for ( loop = 0; loop < numThread; loop++ ) {
+            if ( ( loop % numShards_s ) != shard ) {
+                continue;
+            }
+            txCount += pubThreadInfo_p[loop].txCount;
+            if ( pubThreadInfo_p[loop].elapsedTime > elapsedTime ) {
+                elapsedTime = pubThreadInfo_p[loop].elapsedTime;
+            }
+        }
+        printf ( "%5d  %8d  %10d  %-12llu  %-18lu  %u\n",
+                 shard, shards_s[shard].numSessions, shards_s[shard].numPub, txCount,
+                 ( elapsedTime > 0 ) ? ( long unsigned ) ( ( long double ) txCount /
+                                                           ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) ) : 0UL,
+                 shards_s[shard].numRxMeasured );
+        totalTxCount += txCount;
+        totalRxCount += shards_s[shard].numRxMeasured;
+        if ( elapsedTime > totalElapsedTime ) {
+            totalElapsedTime = elapsedTime;
+        }
+    }
+    printf ( "Total  %8d  %10d  %-12llu  %-18lu  %llu\n\n",
+             numShards_s * shards_s[0].numSessions, numThread, totalTxCount,
+             ( totalElapsedTime > 0 ) ? ( long unsigned ) ( ( long double ) totalTxCount /
+                                                            ( ( long double ) totalElapsedTime / ( long double ) 1000000.0 ) ) : 0UL,
+             totalRxCount );
+}
+
+/*
+* fn rxDone()
+*
+* Returns 1 when every shard has received the messages it expects, or in a
+* timed run, when the run has started and ended.
+*/
+static int      rxDone ( void )
+{
+    int             shard;
+
+    if ( common_runControlTimed ( &runControl_s ) ) {
+        return ( common_runControlStartNs ( &runControl_s ) != 0 ) &&
+                ( common_runControlPhase ( &runControl_s, getTimeInNs (  ) ) == COMMON_RUN_DONE );
+    }
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        if ( shards_s[shard].numRx < shards_s[shard].rxExpected ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /*
 * fn waitRxDoneCallbackFunc()
 * param opaqueContext_p Pointer to Context under which the timer was started previously.
@@ -132,87 +392,344 @@ static void waitRxDoneCallbackFunc ( solClient_opaqueContext_pt opaqueContext_p,
 /*****************************************************************************
  * messageReceiveCallback
  *
- * This function is called when a message is received. It increments the received
- * message counter and sets a flag if there are no more messages expected to
- * be received. The number of messages expected to receive is the NUM_MSGS program
- * parameter. 
+ * This function is called when a message is received, with the perfShard_t of the
+ * Session as user_p. It increments the shard's received message counter. The number
+ * of messages expected to receive is derived from the NUM_MSGS program parameter
+ * (see rxDone()).
+ * When the message carries a perfTestHeader_t, its sequence number is checked against
+ * the publisher's window (see common_seqWindowRecord()), and in latency mode the time
+ * since the message was sent is recorded. In a timed run, the first message starts the
+ * run if no publisher has, and only messages received in the measurement window are
+ * counted in numRxMeasured and the latency.
  */
 solClient_rxMsgCallback_returnCode_t
 messageReceiveCallback ( solClient_opaqueSession_pt opaqueSession_p, solClient_opaqueMsg_pt msg_p, void *user_p )
 {
-    numRx_s++;
-    if ( numRx_s >= msgNum_s ) {
-        /* Flag to main loop to stop waiting */
-        rxDone_s = 1;
+    UINT64          rxTime = 0;
+    void           *binary_p;
+    solClient_uint32_t binarySize;
+    perfTestHeader_t header;
+    perfShard_pt    shard_p = ( perfShard_pt ) user_p;
+    int             measure;
+
+    if ( latencyMode_s || common_runControlTimed ( &runControl_s ) ) {
+        rxTime = getTimeInNs (  );
+        common_runControlStart ( &runControl_s, rxTime );
+    }
+    measure = ( common_runControlPhase ( &runControl_s, rxTime ) == COMMON_RUN_MEASURE );
+    if ( ( solClient_msg_getBinaryAttachmentPtr ( msg_p, &binary_p, &binarySize ) == SOLCLIENT_OK ) &&
+         ( binarySize >= sizeof ( header ) ) ) {
+        memcpy ( &header, binary_p, sizeof ( header ) );
+        if ( header.publisherId < MAX_PUB_THREADS ) {
+            common_seqWindowRecord ( &shard_p->seqWindow[header.publisherId], header.seqNum,
+                                     solClient_msg_isDiscardIndication ( msg_p ) );
+        }
+        if ( latencyMode_s && measure ) {
+            common_histogramRecord ( &shard_p->latencyHist, rxTime - header.sendTimeNs );
+        }
+    }
+    shard_p->numRx++;
+    if ( measure ) {
+        shard_p->numRxMeasured++;
     }
     return SOLCLIENT_CALLBACK_OK;
 }
 
+/*
+ * fn totalSeqReport()
+ * param total_p Returns the sequence check summed over every shard and publisher.
+ */
+static void     totalSeqReport ( common_seqReport_pt total_p )
+{
+    common_seqReport_t report;
+    int             shard;
+    int             publisherId;
+
+    memset ( total_p, 0, sizeof ( *total_p ) );
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        for ( publisherId = 0; publisherId < MAX_PUB_THREADS; publisherId++ ) {
+            common_seqWindowReport ( &shards_s[shard].seqWindow[publisherId], &report );
+            total_p->numRx += report.numRx;
+            total_p->numMissing += report.numMissing;
+            total_p->numBursts += report.numBursts;
+            if ( report.maxBurst > total_p->maxBurst ) {
+                total_p->maxBurst = report.maxBurst;
+            }
+            total_p->numReorder += report.numReorder;
+            total_p->numDup += report.numDup;
+            total_p->numLate += report.numLate;
+            total_p->numDiscardInd += report.numDiscardInd;
+        }
+    }
+}
+
+/*
+ * fn printSeqReport()
+ * param title_p What the report is for.
+ *
+ * Prints the sequence check of every publisher that any shard received from,
+ * and the totals. Messages missing with no discard indication were lost without
+ * the router or API reporting it. Called on a shard's Context thread, or once
+ * receiving is over.
+ */
+static void     printSeqReport ( const char *title_p )
+{
+    common_seqReport_t report;
+    common_seqReport_t total;
+    int             shard;
+    int             publisherId;
+
+    printf ( "\n%s:\nShard  Publisher  Rx msgs       Missing     Bursts  Max burst  Reordered  Duplicates  Late  Discard ind\n",
+             title_p );
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        for ( publisherId = 0; publisherId < MAX_PUB_THREADS; publisherId++ ) {
+            if ( !shards_s[shard].seqWindow[publisherId].started ) {
+                continue;
+            }
+            common_seqWindowReport ( &shards_s[shard].seqWindow[publisherId], &report );
+            printf ( "%5d  %9d  %-12llu  %-10llu  %-6llu  %-9llu  %-9llu  %-10llu  %-4llu  %llu\n",
+                     shard, publisherId, report.numRx, report.numMissing, report.numBursts, report.maxBurst,
+                     report.numReorder, report.numDup, report.numLate, report.numDiscardInd );
+        }
+    }
+    totalSeqReport ( &total );
+    printf ( "Total             %-12llu  %-10llu  %-6llu  %-9llu  %-9llu  %-10llu  %-4llu  %llu\n",
+             total.numRx, total.numMissing, total.numBursts, total.maxBurst,
+             total.numReorder, total.numDup, total.numLate, total.numDiscardInd );
+    if ( ( total.numMissing > 0 ) && ( total.numDiscardInd == 0 ) ) {
+        printf ( "Warning: %llu message(s) missing without a discard indication\n", total.numMissing );
+    }
+    printf ( "\n" );
+}
+
+/*
+ * fn seqSampleCallbackFunc()
+ * param opaqueContext_p Pointer to the Context the timer runs in.
+ * param user_p The perfShard_t whose sequence check to print.
+ *
+ * Prints a shard's sequence check periodically. It runs on the shard's Context
+ * thread, so it reads the windows without racing messageReceiveCallback().
+ */
+static void     seqSampleCallbackFunc ( solClient_opaqueContext_pt opaqueContext_p, void *user_p )
+{
+    perfShard_pt    shard_p = ( perfShard_pt ) user_p;
+    common_seqReport_t report;
+    int             publisherId;
+
+    for ( publisherId = 0; publisherId < MAX_PUB_THREADS; publisherId++ ) {
+        if ( !shard_p->seqWindow[publisherId].started ) {
+            continue;
+        }
+        common_seqWindowReport ( &shard_p->seqWindow[publisherId], &report );
+        printf ( "Seq sample: shard %d, publisher %d, rx %llu, missing %llu, bursts %llu, max burst %llu, "
+                 "reordered %llu, duplicates %llu, late %llu, discard ind %llu\n",
+                 ( int ) ( shard_p - shards_s ), publisherId, report.numRx, report.numMissing, report.numBursts,
+                 report.maxBurst, report.numReorder, report.numDup, report.numLate, report.numDiscardInd );
+    }
+}
+
+/*
+ * fn startSeqSamples()
+ * param intervalMs The sampling interval, in milliseconds.
+ *
+ * Starts a repeating timer in every shard's Context to print its sequence check.
+ */
+static void     startSeqSamples ( int intervalMs )
+{
+    solClient_returnCode_t rc;
+    int             shard;
+
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        if ( ( rc = solClient_context_startTimer ( shards_s[shard].contextThreadInfo.context_p,
+                                                   SOLCLIENT_CONTEXT_TIMER_REPEAT, ( solClient_uint32_t ) intervalMs,
+                                                   seqSampleCallbackFunc, ( void * ) &shards_s[shard],
+                                                   &shards_s[shard].seqTimerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_startTimer()" );
+            shards_s[shard].seqTimerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+        }
+    }
+}
+
+/*
+ * fn stopSeqSamples()
+ *
+ * Stops the timers started by startSeqSamples().
+ */
+static void     stopSeqSamples ( void )
+{
+    solClient_returnCode_t rc;
+    int             shard;
+
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        if ( shards_s[shard].seqTimerId == SOLCLIENT_CONTEXT_TIMER_ID_INVALID ) {
+            continue;
+        }
+        if ( ( rc = solClient_context_stopTimer ( shards_s[shard].contextThreadInfo.context_p,
+                                                  &shards_s[shard].seqTimerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_stopTimer()" );
+        }
+        shards_s[shard].seqTimerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+    }
+}
+
+/*
+ * fn createSchedule()
+ * param threadInfo_p The publisher thread's information.
+ *
+ * Creates the open-loop schedule for a publisher thread when an arrival mode
+ * was requested. Returns 0 if the schedule could not be allocated.
+ */
+static int      createSchedule ( pubThreadInfo_pt threadInfo_p )
+{
+    threadInfo_p->schedule_p = NULL;
+    if ( arrivalMode_s == COMMON_ARRIVAL_CLOSED ) {
+        return 1;
+    }
+    threadInfo_p->schedule_p = ( common_schedule_pt ) malloc ( sizeof ( common_schedule_t ) );
+    if ( threadInfo_p->schedule_p == NULL ) {
+        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not malloc %d bytes", ( int ) sizeof ( common_schedule_t ) );
+        return 0;
+    }
+    common_scheduleInit ( threadInfo_p->schedule_p, msgRate_s, arrivalMode_s, threadInfo_p->publisherId + 1,
+                          spinBudgetUs_s );
+    return 1;
+}
+
+/*
+ * fn createRing()
+ * param threadInfo_p The publisher thread's information.
+ * param ring_p The ring to create.
+ * param minMsgs The fewest messages the ring may have, e.g. one batch.
+ * param persistent Whether to send the messages persistent rather than direct.
+ *
+ * Creates the ring of messages a publisher thread cycles through, with payloads
+ * from the --payload generator and the thread's Topic. The ring has --ring
+ * messages, fewer if they would take more than MAX_RING_BYTES, but no fewer than
+ * minMsgs. Returns 0 on failure.
+ */
+static int      createRing ( pubThreadInfo_pt threadInfo_p, common_msgRing_pt ring_p, int minMsgs, int persistent )
+{
+    int             numMsgs = ringSize_s;
+    int             loop;
+
+    if ( ( binaryPayloadSize_s > 0 ) && ( ( long long ) numMsgs * binaryPayloadSize_s > MAX_RING_BYTES ) ) {
+        numMsgs = ( int ) ( MAX_RING_BYTES / binaryPayloadSize_s );
+    }
+    if ( numMsgs < minMsgs ) {
+        numMsgs = minMsgs;
+    }
+    if ( common_msgRingCreate ( ring_p, numMsgs, binaryPayloadSize_s, payloadType_s, payloadFile_s,
+                                threadInfo_p->publisherId + 1 ) != SOLCLIENT_OK ) {
+        return 0;
+    }
+    for ( loop = 0; loop < ring_p->numMsgs; loop++ ) {
+        if ( solClient_msg_setTopicPtr ( ring_p->msgs_p[loop], threadInfo_p->topic_p ) != SOLCLIENT_OK ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set Topic in msg" );
+            common_msgRingDestroy ( ring_p );
+            return 0;
+        }
+        if ( persistent &&
+             ( solClient_msg_setDeliveryMode ( ring_p->msgs_p[loop], SOLCLIENT_DELIVERY_MODE_PERSISTENT ) != SOLCLIENT_OK ) ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set delivery mode in msg" );
+            common_msgRingDestroy ( ring_p );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fn printScheduleLag()
+ * param threadInfo_p The publisher thread's information.
+ *
+ * Prints how far a publisher thread fell behind its open-loop schedule.
+ */
+static void     printScheduleLag ( pubThreadInfo_pt threadInfo_p )
+{
+    if ( threadInfo_p->schedule_p != NULL ) {
+        printf ( "Publisher %u send schedule lag: p99 %.3f usec, max %.3f usec\n", threadInfo_p->publisherId,
+                 ( double ) common_histogramValueAtPercentile ( &threadInfo_p->schedule_p->lagHist, 99.0 ) / 1000.0,
+                 ( double ) threadInfo_p->schedule_p->lagHist.maxValue / 1000.0 );
+    }
+}
+
+/*
+ * fn pubSending()
+ * param txCount Messages the thread has sent.
+ * param phase_p Returns the phase of the run, COMMON_RUN_MEASURE when not timed.
+ *
+ * Returns 1 while a publisher thread should keep sending: until it has sent
+ * NUM_MSGS, or in a timed run until the run is done.
+ */
+static int      pubSending ( unsigned int txCount, int *phase_p )
+{
+    if ( exitEarly_s ) {
+        return 0;
+    }
+    if ( !common_runControlTimed ( &runControl_s ) ) {
+        *phase_p = COMMON_RUN_MEASURE;
+        return ( txCount < msgNum_s );
+    }
+    *phase_p = common_runControlPhase ( &runControl_s, getTimeInNs (  ) );
+    return ( *phase_p != COMMON_RUN_DONE );
+}
+
 /*
  * fn pubThread()
- * param session_p session to use for publishing.
+ * param info_p pubThreadInfo_t with the session to use for publishing.
  *
  * This function does the publishing (in its own thread) of the requested number of 
  * messages at the requested rate and then computes the elapsed time.
+ * Each message is paced individually with a pacer (see pacerWaitUntil()), so the
+ * traffic stays smooth at high rates. With an open-loop schedule, each message waits for its intended send time and
+ * a message that failed to send keeps its intended time when it is retried.
+ * In a timed run the thread sends until the run is done, and reports the messages sent
+ * in the measurement window over the length of the window.
  */
-threadRetType   pubThread ( void *session_p )
+threadRetType   pubThread ( void *info_p )
 {
-    const unsigned int groupSize = 10;
+    pubThreadInfo_pt threadInfo_p = ( pubThreadInfo_pt ) info_p;
+    solClient_opaqueSession_pt session_p = threadInfo_p->session_p;
     unsigned int    txCount = 0;
-    unsigned int    groupCount = 0;
-    char           *binary_p;
+    unsigned int    measuredTx = 0;
+    int             phase = COMMON_RUN_MEASURE;
+    int             stamp = ( binaryPayloadSize_s >= ( int ) sizeof ( perfTestHeader_t ) );
+    common_msgRing_t ring;
+    int             ringIndex = 0;
+    UINT64          intendedTime = 0;
+    int             haveSlot = 0;
     long long       startTime;
-    long long       targetTime;
-    long long       currentTime;
-    long long       timeDiff;
+    long double     targetTime;
+    UINT64          currentTime;
     long long       elapsedTime;
-    long long       usPerGroup;
-    long double     usPerMsg;
+    long double     nsPerMsg;
+    pacer_t         pacer;
     solClient_returnCode_t sendRc;
-    solClient_opaqueMsg_pt msg_p;
     solClient_errorInfo_pt errorInfo_p;
 
-    binary_p = ( char * ) malloc ( binaryPayloadSize_s );
-    if ( binary_p == NULL ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not malloc %d bytes", binaryPayloadSize_s );
-        return DEFAULT_THREAD_RETURN_ARG;
-    }
-    memset ( binary_p, 0, binaryPayloadSize_s );
-
-    if ( solClient_msg_alloc ( &msg_p ) != SOLCLIENT_OK ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate msg" );
-        free (binary_p);
+    if ( !createRing ( threadInfo_p, &ring, 1, sendPersistent_s ) ) {
         return DEFAULT_THREAD_RETURN_ARG;
     }
 
-    usPerMsg = ( long double ) 1000000.0 / ( long double ) msgRate_s;
-    usPerGroup = ( long long ) ( usPerMsg * ( long double ) groupSize );
+    nsPerMsg = ( long double ) 1000000000.0 / ( long double ) msgRate_s;
+    pacerInit ( &pacer, spinBudgetUs_s );
 
-    if ( solClient_msg_setBinaryAttachmentPtr ( msg_p, binary_p, binaryPayloadSize_s ) != SOLCLIENT_OK ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set binary attachment in msg" );
-        solClient_msg_free ( &msg_p );
-        free (binary_p);
+    if ( !createSchedule ( threadInfo_p ) ) {
+        common_msgRingDestroy ( &ring );
         return DEFAULT_THREAD_RETURN_ARG;
     }
-    if ( solClient_msg_setTopicPtr ( msg_p, publishTopic_ps ) != SOLCLIENT_OK ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set Topic in msg" );
-        solClient_msg_free ( &msg_p );
-        free (binary_p);
-        return DEFAULT_THREAD_RETURN_ARG;
-    }
-    if ( sendPersistent_s ) {
-        if ( solClient_msg_setDeliveryMode ( msg_p, SOLCLIENT_DELIVERY_MODE_PERSISTENT ) != SOLCLIENT_OK ) {
-            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set delivery mode in msg" );
-            solClient_msg_free ( &msg_p );
-            free (binary_p);
-            return DEFAULT_THREAD_RETURN_ARG;
-        }
-    }
 
-    startTime = getTimeInUs (  );
-    targetTime = startTime + usPerGroup;
-    while ( ( txCount < msgNum_s ) && ( !exitEarly_s ) ) {
-        sendRc = solClient_session_sendMsg ( session_p, msg_p );
+    startTime = ( long long ) ( getTimeInNs (  ) / 1000 );
+    targetTime = ( long double ) getTimeInNs (  );
+    while ( pubSending ( txCount, &phase ) ) {
+        if ( ( threadInfo_p->schedule_p != NULL ) && !haveSlot ) {
+            intendedTime = common_scheduleWait ( threadInfo_p->schedule_p );
+            haveSlot = 1;
+        }
+        if ( stamp ) {
+            stampHeader ( common_msgRingPayload ( &ring, ringIndex ), threadInfo_p->publisherId, txCount, intendedTime );
+        }
+        sendRc = solClient_session_sendMsg ( session_p, ring.msgs_p[ringIndex] );
         if ( sendRc != SOLCLIENT_OK ) {
             errorInfo_p = solClient_getLastErrorInfo (  );
             if ( errorInfo_p != NULL ) {
@@ -224,39 +741,102 @@ threadRetType   pubThread ( void *session_p )
             }
         } else {
             txCount++;
-            groupCount++;
-            if ( groupCount >= groupSize ) {
-                groupCount = 0;
-                currentTime = getTimeInUs (  );
-                timeDiff = targetTime - currentTime;
-                if ( timeDiff > 1000 ) {
-                    sleepInUs ( ( int ) ( timeDiff + 500 ) );
-                } else if ( timeDiff < ( long long ) ( -10000 ) ) {
-                    /* Fell too far behind; reset time base so we do not burst for too
-                     * long */
-                    targetTime = currentTime;
-                }
-                targetTime += usPerGroup;
+            if ( phase == COMMON_RUN_MEASURE ) {
+                measuredTx++;
+            }
+            if ( ++ringIndex == ring.numMsgs ) {
+                ringIndex = 0;
+            }
+            if ( threadInfo_p->schedule_p != NULL ) {
+                /* Open loop: the schedule does the pacing. */
+                haveSlot = 0;
+                continue;
+            }
+            targetTime += nsPerMsg;
+            currentTime = pacerWaitUntil ( &pacer, ( UINT64 ) targetTime );
+            if ( ( long double ) currentTime > targetTime + ( long double ) 10000000.0 ) {
+                /* Fell too far behind; reset time base so we do not burst for too
+                 * long */
+                targetTime = ( long double ) currentTime;
             }
-
         }
     }
 
-    solClient_msg_free ( &msg_p );
-    free (binary_p);
+    common_msgRingDestroy ( &ring );
 
-    elapsedTime = getTimeInUs (  ) - startTime;
+    if ( common_runControlTimed ( &runControl_s ) ) {
+        elapsedTime = ( long long ) ( common_runControlWindowNs ( &runControl_s, getTimeInNs (  ) ) / 1000 );
+        printf ( "\nSent %d msgs, %d in the measurement window\n", txCount, measuredTx );
+        txCount = measuredTx;
+    } else {
+        elapsedTime = ( long long ) ( getTimeInNs (  ) / 1000 ) - startTime;
+    }
+    threadInfo_p->txCount = txCount;
+    threadInfo_p->elapsedTime = elapsedTime;
     printf ( "\nSent %d msgs in %lld usec; rate of %lu messages/sec\n\n",
              txCount, elapsedTime, ( long unsigned ) ( ( long double ) txCount /
                                                        ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) ) );
+    printScheduleLag ( threadInfo_p );
 
     return DEFAULT_THREAD_RETURN_ARG;
 }
 
 
+/*
+ * fn adaptBatchSize()
+ * param session_p The Session being published on.
+ * param lastTxStats_p The transmit statistics at the previous adjustment, updated.
+ * param partialWrites Number of sends since the previous adjustment that did not write
+ *                     the whole batch.
+ * param batchSize The current batch size.
+ *
+ * Returns the batch size to use next. A send that only wrote part of its batch, or
+ * messages refused with would-block, mean the transport cannot take what is offered, so
+ * the batch is halved. A full socket means data is being buffered in the API, so the
+ * batch shrinks by a quarter. Otherwise the batch grows by a quarter, up to
+ * SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT, so more messages go into each vectored write.
+ * The statistics are per Session, so publishers sharing a Session see each other's
+ * backpressure.
+ */
+static unsigned int adaptBatchSize ( solClient_opaqueSession_pt session_p, solClient_stats_t * lastTxStats_p,
+                                     unsigned int partialWrites, unsigned int batchSize )
+{
+    solClient_stats_t txStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    solClient_stats_t wouldBlock;
+    solClient_stats_t socketFull;
+    solClient_returnCode_t rc;
+
+    if ( ( rc = solClient_session_getTxStats ( session_p, txStats, SOLCLIENT_STATS_TX_NUM_STATS ) ) != SOLCLIENT_OK ) {
+        common_handleError ( rc, "solClient_session_getTxStats()" );
+        return batchSize;
+    }
+    /* A counter that went down was cleared; count from zero. */
+    wouldBlock = ( txStats[SOLCLIENT_STATS_TX_WOULD_BLOCK] >= lastTxStats_p[SOLCLIENT_STATS_TX_WOULD_BLOCK] ) ?
+            txStats[SOLCLIENT_STATS_TX_WOULD_BLOCK] - lastTxStats_p[SOLCLIENT_STATS_TX_WOULD_BLOCK] :
+            txStats[SOLCLIENT_STATS_TX_WOULD_BLOCK];
+    socketFull = ( txStats[SOLCLIENT_STATS_TX_SOCKET_FULL] >= lastTxStats_p[SOLCLIENT_STATS_TX_SOCKET_FULL] ) ?
+            txStats[SOLCLIENT_STATS_TX_SOCKET_FULL] - lastTxStats_p[SOLCLIENT_STATS_TX_SOCKET_FULL] :
+            txStats[SOLCLIENT_STATS_TX_SOCKET_FULL];
+    memcpy ( lastTxStats_p, txStats, sizeof ( txStats ) );
+
+    if ( ( partialWrites > 0 ) || ( wouldBlock > 0 ) ) {
+        batchSize /= 2;
+    } else if ( socketFull > 0 ) {
+        batchSize -= batchSize / 4;
+    } else {
+        batchSize += ( batchSize / 4 > 0 ) ? batchSize / 4 : 1;
+    }
+    if ( batchSize < 1 ) {
+        batchSize = 1;
+    } else if ( batchSize > SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT ) {
+        batchSize = SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT;
+    }
+    return batchSize;
+}
+
 /*
  * fn pubThreadSendMultiple() 
- * param session_p session to use for publishing.
+ * param info_p pubThreadInfo_t with the session to use for publishing.
  *
  * Sends multiple messages on the specified Session, which is more efficient than multiple
  * calls to solClient_session_sendMsg().
@@ -268,96 +848,737 @@ threadRetType   pubThread ( void *session_p )
  * be enabled, since multiple messages are sent at once onto the underlying TCP connection, and
  * so there is no need to have the operating system carry out the TCP delay algorithm to cause
  * fuller packets.
+ * With MULTI_SEND_MODE 'adaptive', N starts at GROUP_SIZE and is adjusted every
+ * ADAPT_INTERVAL sends (see adaptBatchSize()).
+ * When a send writes only part of the batch, the unwritten tail is sent again, so no
+ * message is lost or sent twice.
+ * With an open-loop schedule, each send waits for the next message to be due and
+ * includes every other message that is already due, up to N.
+ * In a timed run the thread sends until the run is done (see pubThread()).
  */
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 #define GROUP_SIZE 10
+#define ADAPT_INTERVAL 64
 #endif
 
-threadRetType   pubThreadSendMultiple ( void *session_p )
+threadRetType   pubThreadSendMultiple ( void *info_p )
 {
+    pubThreadInfo_pt threadInfo_p = ( pubThreadInfo_pt ) info_p;
+    solClient_opaqueSession_pt session_p = threadInfo_p->session_p;
     unsigned int    txCount = 0;
-    char           *binary_p;
+    unsigned int    measuredTx = 0;
+    int             phase = COMMON_RUN_MEASURE;
+    int             stamp = ( binaryPayloadSize_s >= ( int ) sizeof ( perfTestHeader_t ) );
+    common_msgRing_t ring;
+    int             ringIndex = 0;
+    unsigned int    maxBatchSize;
+    unsigned int    batchSize;
     unsigned int    numToSend;
+    unsigned int    numSent;
     unsigned int    numWritten;
+    unsigned int    numSends = 0;
+    unsigned int    partialWrites = 0;
+    solClient_stats_t lastTxStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    UINT64          intendedTime[SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT];
     long long       startTime;
-    long long       targetTime;
-    long long       currentTime;
-    long long       timeDiff;
+    long double     targetTime;
+    UINT64          currentTime;
     long long       elapsedTime;
-    long long       usPerGroup;
-    long double     usPerMsg;
-    solClient_returnCode_t sendRc;
+    long double     nsPerMsg;
+    pacer_t         pacer;
+    solClient_returnCode_t sendRc = SOLCLIENT_OK;
     int             loop;
-    solClient_opaqueMsg_pt msgArray[GROUP_SIZE];
+    solClient_opaqueMsg_pt msgArray[SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT];
 
-    binary_p = ( char * ) malloc ( binaryPayloadSize_s );
-    if ( binary_p == NULL ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "Could not malloc %d bytes", binaryPayloadSize_s );
+    maxBatchSize = ( multiSend_s == MULTI_SEND_ADAPTIVE ) ? SOLCLIENT_SESSION_SEND_MULTIPLE_LIMIT : GROUP_SIZE;
+    batchSize = GROUP_SIZE;
+
+    /* Each message in a batch needs its own payload so it can carry its own header. */
+    if ( !createRing ( threadInfo_p, &ring, ( int ) maxBatchSize, 0 ) ) {
         return DEFAULT_THREAD_RETURN_ARG;
     }
-    memset ( binary_p, 0, binaryPayloadSize_s );
-    memset ( msgArray, 0, sizeof ( msgArray ) );
+    memset ( lastTxStats, 0, sizeof ( lastTxStats ) );
+
+    nsPerMsg = ( long double ) 1000000000.0 / ( long double ) msgRate_s;
+    pacerInit ( &pacer, spinBudgetUs_s );
+
+    if ( !createSchedule ( threadInfo_p ) ) {
+        goto releaseMsg;
+    }
+    memset ( intendedTime, 0, sizeof ( intendedTime ) );
+    if ( multiSend_s == MULTI_SEND_ADAPTIVE ) {
+        adaptBatchSize ( session_p, lastTxStats, 0, batchSize );
+    }
+
+    startTime = ( long long ) ( getTimeInNs (  ) / 1000 );
+    targetTime = ( long double ) getTimeInNs (  );
+    while ( pubSending ( txCount, &phase ) ) {
+        numToSend = common_runControlTimed ( &runControl_s ) ? batchSize : msgNum_s - txCount;
+        if ( numToSend > batchSize ) {
+            numToSend = batchSize;
+        }
+        if ( threadInfo_p->schedule_p != NULL ) {
+            intendedTime[0] = common_scheduleWait ( threadInfo_p->schedule_p );
+            for ( loop = 1; loop < ( int ) numToSend; loop++ ) {
+                if ( !common_scheduleTake ( threadInfo_p->schedule_p, &intendedTime[loop] ) ) {
+                    break;
+                }
+            }
+            numToSend = ( unsigned int ) loop;
+        }
+        for ( loop = 0; loop < ( int ) numToSend; loop++ ) {
+            msgArray[loop] = ring.msgs_p[( ringIndex + loop ) % ring.numMsgs];
+            if ( stamp ) {
+                stampHeader ( common_msgRingPayload ( &ring, ( ringIndex + loop ) % ring.numMsgs ),
+                              threadInfo_p->publisherId, txCount + loop, intendedTime[loop] );
+            }
+        }
 
-    usPerMsg = ( long double ) 1000000.0 / ( long double ) msgRate_s;
-    usPerGroup = ( long long ) ( usPerMsg * ( long double ) GROUP_SIZE );
+        /* Send the batch, then whatever tail of it was not written. */
+        numSent = 0;
+        while ( ( numSent < numToSend ) && ( !exitEarly_s ) ) {
+            numWritten = 0;
+            sendRc = solClient_session_sendMultipleMsg ( session_p, &msgArray[numSent], numToSend - numSent, &numWritten );
+            numSent += numWritten;
+            if ( ( sendRc != SOLCLIENT_OK ) && ( sendRc != SOLCLIENT_WOULD_BLOCK ) ) {
+                break;
+            }
+            if ( numSent < numToSend ) {
+                partialWrites++;
+                if ( numWritten == 0 ) {
+                    /* Nothing was taken; give the transport time to drain. */
+                    sleepInUs ( 100 );
+                }
+            }
+        }
+        txCount += numSent;
+        if ( phase == COMMON_RUN_MEASURE ) {
+            measuredTx += numSent;
+        }
+        ringIndex = ( ringIndex + ( int ) numSent ) % ring.numMsgs;
+        numSends++;
+        if ( ( sendRc != SOLCLIENT_OK ) && ( sendRc != SOLCLIENT_WOULD_BLOCK ) ) {
+            common_handleError ( sendRc, "solClient_session_sendMultipleMsg()" );
+            break;
+        }
 
-    for ( loop = 0; loop < GROUP_SIZE; loop++ ) {
-        if ( solClient_msg_alloc ( &msgArray[loop] ) != SOLCLIENT_OK ) {
-            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not allocate msg # %d", loop );
-            goto releaseMsg;
+        if ( ( multiSend_s == MULTI_SEND_ADAPTIVE ) && ( numSends % ADAPT_INTERVAL == 0 ) ) {
+            batchSize = adaptBatchSize ( session_p, lastTxStats, partialWrites, batchSize );
+            partialWrites = 0;
         }
-        if ( solClient_msg_setBinaryAttachmentPtr ( msgArray[loop], binary_p, binaryPayloadSize_s ) != SOLCLIENT_OK ) {
-            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set binary attachment in msg" );
-            goto releaseMsg;
+
+        if ( threadInfo_p->schedule_p != NULL ) {
+            /* Open loop: the schedule does the pacing. */
+            continue;
         }
-        if ( solClient_msg_setTopicPtr ( msgArray[loop], publishTopic_ps ) != SOLCLIENT_OK ) {
-            solClient_log ( SOLCLIENT_LOG_ERROR, "Could not set topic in msg" );
-            goto releaseMsg;
+        targetTime += nsPerMsg * ( long double ) numSent;
+        currentTime = pacerWaitUntil ( &pacer, ( UINT64 ) targetTime );
+        if ( ( long double ) currentTime > targetTime + ( long double ) 10000000.0 ) {
+            /* Fell too far behind; reset time base so we do not burst for too
+             * long */
+            targetTime = ( long double ) currentTime;
         }
     }
 
-    startTime = getTimeInUs (  );
-    targetTime = startTime + usPerGroup;
-    while ( ( txCount < msgNum_s ) && ( !exitEarly_s ) ) {
-        numToSend = msgNum_s - txCount;
-        if ( numToSend > GROUP_SIZE ) {
-            numToSend = GROUP_SIZE;
+    if ( common_runControlTimed ( &runControl_s ) ) {
+        elapsedTime = ( long long ) ( common_runControlWindowNs ( &runControl_s, getTimeInNs (  ) ) / 1000 );
+        printf ( "\nSent %d msgs, %d in the measurement window\n", txCount, measuredTx );
+        txCount = measuredTx;
+    } else {
+        elapsedTime = ( long long ) ( getTimeInNs (  ) / 1000 ) - startTime;
+    }
+    threadInfo_p->txCount = txCount;
+    threadInfo_p->elapsedTime = elapsedTime;
+    if ( multiSend_s == MULTI_SEND_ADAPTIVE ) {
+        printf ( "\nSent %d msgs in batches of %.1f on average (last %u) in %lld usec; rate of %lu messages/sec\n\n",
+                 txCount, ( numSends > 0 ) ? ( double ) txCount / ( double ) numSends : 0.0, batchSize, elapsedTime,
+                 ( long unsigned ) ( ( long double ) txCount / ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) ) );
+    } else {
+        printf ( "\nSent %d msgs in batches of %d in %lld usec; rate of %lu messages/sec\n\n",
+                 txCount, GROUP_SIZE, elapsedTime, ( long unsigned ) ( ( long double ) txCount /
+                                                           ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) ) );
+    }
+    printScheduleLag ( threadInfo_p );
+
+  releaseMsg:
+    common_msgRingDestroy ( &ring );
+    return DEFAULT_THREAD_RETURN_ARG;
+}
+
+/*
+ * fn createShards()
+ * param sessionProps The Session properties, shared by all Sessions.
+ * param numSessions Number of Sessions per Context.
+ * param pubTopic_p The Topic to publish to.
+ * param subTopic_p The Topic to subscribe to.
+ *
+ * Creates the Context, the Context thread and the connected Sessions of every
+ * shard. On failure, whatever was created is left in shards_s for destroyShards().
+ */
+static solClient_returnCode_t createShards ( solClient_propertyArray_pt sessionProps, int numSessions,
+                                             const char *pubTopic_p, const char *subTopic_p )
+{
+    solClient_context_createFuncInfo_t contextFuncInfo = SOLCLIENT_CONTEXT_CREATEFUNC_INITIALIZER;
+    solClient_session_createFuncInfo_t sessionFuncInfo = SOLCLIENT_SESSION_CREATEFUNC_INITIALIZER;
+    solClient_returnCode_t rc;
+    perfShard_pt    shard_p;
+    int             shard;
+    int             sessionIndex;
+
+    sessionFuncInfo.rxMsgInfo.callback_p = messageReceiveCallback;
+    sessionFuncInfo.eventInfo.callback_p = common_eventCallback;
+    sessionFuncInfo.eventInfo.user_p = ( void * ) NULL;
+
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        shard_p = &shards_s[shard];
+
+        /* Create a Context to use for the Sessions of this shard. */
+        solClient_log ( SOLCLIENT_LOG_DEBUG, "creating solClient context %d", shard );
+        if ( ( rc = solClient_context_create ( NULL, &shard_p->contextThreadInfo.context_p,
+                                               &contextFuncInfo, sizeof ( contextFuncInfo ) ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_create()" );
+            return rc;
         }
-        sendRc = solClient_session_sendMultipleMsg ( session_p, msgArray, numToSend, &numWritten );
-        if ( sendRc != SOLCLIENT_OK ) {
-            printf ( "Could not send multiple\n" );
+
+        /* Start the Context thread. */
+        solClient_log ( SOLCLIENT_LOG_DEBUG, "starting solClient context thread %d", shard );
+        if ( !common_startContextThread ( &shard_p->contextThreadInfo ) ) {
+            solClient_log ( SOLCLIENT_LOG_ERROR, "common_startContextThread() failed" );
+            solClient_context_destroy ( &shard_p->contextThreadInfo.context_p );
+            return SOLCLIENT_FAIL;
+        }
+
+        /* Create Sessions for sending/receiving messages. */
+        sessionFuncInfo.rxMsgInfo.user_p = ( void * ) shard_p;
+        for ( sessionIndex = 0; sessionIndex < numSessions; sessionIndex++ ) {
+            /*
+             * With a single Session the original Topics are used. Otherwise, each
+             * Session gets its own Topic so a shard receives only what it published.
+             */
+            if ( ( numShards_s * numSessions ) == 1 ) {
+                strncpy ( shard_p->topic[sessionIndex], pubTopic_p, sizeof ( shard_p->topic[sessionIndex] ) );
+            } else {
+                snprintf ( shard_p->topic[sessionIndex], sizeof ( shard_p->topic[sessionIndex] ), "%s/%d",
+                          pubTopic_p, shard * numSessions + sessionIndex );
+            }
+
+            solClient_log ( SOLCLIENT_LOG_DEBUG, "creating solClient session %d in context %d", sessionIndex, shard );
+            if ( ( rc = solClient_session_create ( sessionProps,
+                                                   shard_p->contextThreadInfo.context_p,
+                                                   &shard_p->session_p[sessionIndex],
+                                                   &sessionFuncInfo, sizeof ( sessionFuncInfo ) ) )
+                 != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_session_create()" );
+                return rc;
+            }
+            shard_p->numSessions++;
+
+            /*
+             *  We have topic subscription reapply enabled so we can add our subscriptions
+             *  before connecting.  Then we know all will have been re-applied when the 
+             *  blocking connect returns.
+             *
+             *  This is important for peer-to-peer (IPC) connections as we want to
+             *  be sure the subscription is sent to our peer before the peer begins
+             *  publishing.
+             */
+            if ( useSub_s ) {
+                /* Do not Wait for confirmation that the subscription has been applied.
+                 * Setting SOLCLIENT_SUBSCRIBE_FLAGS_WAITFORCONFIRM will cause 
+                 * solClient_session_topicSubscribeExt() to fail when the session is
+                 * not yet established. */
+                if ( (  rc = solClient_session_topicSubscribeExt ( shard_p->session_p[sessionIndex],
+                                                                  0,
+                                                                  ( ( numShards_s * numSessions ) == 1 ) ?
+                                                                  subTopic_p : shard_p->topic[sessionIndex] ) )
+                     != SOLCLIENT_OK ) {
+                    common_handleError ( rc, "solClient_session_topicSubscribeExt()" );
+                    return rc;
+                }
+            }
+            /* Connect the Session. */
+            solClient_log ( SOLCLIENT_LOG_DEBUG, "connecting solClient session %d in context %d", sessionIndex, shard );
+            if ( ( rc = solClient_session_connect ( shard_p->session_p[sessionIndex] ) ) != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_session_connect()" );
+                return rc;
+            }
+            shard_p->numConnected++;
+        }
+    }
+    return SOLCLIENT_OK;
+}
+
+/*
+ * fn destroyShards()
+ *
+ * Disconnects and destroys the Sessions of every shard, stops the Context
+ * threads and destroys the Contexts, so createShards() can be called again.
+ */
+static void     destroyShards ( void )
+{
+    solClient_returnCode_t rc;
+    perfShard_pt    shard_p;
+    int             shard;
+    int             sessionIndex;
+
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        shard_p = &shards_s[shard];
+        if ( shard_p->contextThreadInfo.context_p == NULL ) {
             break;
-        } else {
-            txCount += numToSend;
-            currentTime = getTimeInUs (  );
-            timeDiff = targetTime - currentTime;
-            if ( timeDiff > 1000 ) {
-                sleepInUs ( ( int ) ( timeDiff + 500 ) );
-            } else if ( timeDiff < ( long long ) ( -10000 ) ) {
-                /* Fell too far behind; reset time base so we do not burst for too
-                 * long */
-                targetTime = currentTime;
+        }
+        for ( sessionIndex = 0; sessionIndex < shard_p->numSessions; sessionIndex++ ) {
+            /* Disconnect the Session. */
+            if ( sessionIndex < shard_p->numConnected ) {
+                if ( ( rc = solClient_session_disconnect ( shard_p->session_p[sessionIndex] ) ) != SOLCLIENT_OK ) {
+                    common_handleError ( rc, "solClient_session_disconnect()" );
+                }
+            }
+            /* Destroy the Session. */
+            if ( ( rc = solClient_session_destroy ( &shard_p->session_p[sessionIndex] ) ) != SOLCLIENT_OK ) {
+                common_handleError ( rc, "solClient_session_destroy()" );
             }
-            targetTime += usPerGroup;
         }
+
+        /* Stop the Context thread. */
+        common_stopContextThread ( &shard_p->contextThreadInfo );
+
+        /* Destroy the Context. */
+        if ( ( rc = solClient_context_destroy ( &shard_p->contextThreadInfo.context_p ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_destroy()" );
+        }
+        shard_p->numSessions = 0;
+        shard_p->numConnected = 0;
     }
+}
 
-    elapsedTime = getTimeInUs (  ) - startTime;
-    printf ( "\nSent %d msgs in batches of %d in %lld usec; rate of %lu messages/sec\n\n",
-             txCount, GROUP_SIZE, elapsedTime, ( long unsigned ) ( ( long double ) txCount /
-                                                       ( ( long double ) elapsedTime / ( long double ) 1000000.0 ) ) );
+/*
+ * fn assignPublishers()
+ * param numPubThread Number of publisher threads.
+ * param numSessions Number of Sessions per Context.
+ *
+ * Assigns the publisher threads round-robin across the Contexts, then across the
+ * Sessions of each Context, works out how many messages each shard should
+ * receive, and resets the receive counters. In subscriber only mode, each
+ * Session expects NUM_MSGS.
+ */
+static void     assignPublishers ( int numPubThread, int numSessions )
+{
+    perfShard_pt    shard_p;
+    int             shard;
+    int             loop;
 
-  releaseMsg:
-    for ( loop = 0; loop < GROUP_SIZE; loop++ ) {
-        if ( msgArray[loop] != NULL ) {
-            if ( solClient_msg_free ( &msgArray[loop] ) != SOLCLIENT_OK ) {
-                solClient_log ( SOLCLIENT_LOG_ERROR, "Could not release msg # %d", loop );
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        shards_s[shard].numPub = 0;
+    }
+    for ( loop = 0; loop < numPubThread; loop++ ) {
+        shards_s[loop % numShards_s].numPub++;
+    }
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        shard_p = &shards_s[shard];
+        if ( usePub_s ) {
+            shard_p->rxExpected = msgNum_s * shard_p->numPub;
+        } else {
+            shard_p->rxExpected = msgNum_s * numSessions;
+        }
+        shard_p->numRx = 0;
+        shard_p->numRxMeasured = 0;
+        if ( latencyMode_s ) {
+            common_histogramInit ( &shard_p->latencyHist );
+        }
+        for ( loop = 0; loop < MAX_PUB_THREADS; loop++ ) {
+            common_seqWindowInit ( &shard_p->seqWindow[loop] );
+        }
+        shard_p->seqTimerId = SOLCLIENT_CONTEXT_TIMER_ID_INVALID;
+    }
+}
+
+/*
+ * fn runPublishers()
+ * param pubThreadInfo_p Array of publisher thread information, filled in.
+ * param numPubThread Number of publisher threads to run.
+ * param numSessions Number of Sessions per Context.
+ * param lagHist_p Histogram to add the send schedule lag of every thread to, or NULL.
+ *
+ * Runs the publisher threads on the Sessions chosen by assignPublishers() and
+ * waits for them to finish. A timed run starts as the threads are started.
+ * Returns the number of threads that ran.
+ */
+static int      runPublishers ( pubThreadInfo_pt pubThreadInfo_p, int numPubThread, int numSessions,
+                                common_histogram_t * lagHist_p )
+{
+    THREAD_HANDLE_T pubThreadHandle[MAX_PUB_THREADS];
+    perfShard_pt    shard_p;
+    int             sessionIndex;
+    int             loop;
+
+    for ( loop = 0; loop < numPubThread; loop++ ) {
+        shard_p = &shards_s[loop % numShards_s];
+        sessionIndex = ( loop / numShards_s ) % numSessions;
+        pubThreadInfo_p[loop].session_p = shard_p->session_p[sessionIndex];
+        pubThreadInfo_p[loop].topic_p = shard_p->topic[sessionIndex];
+        pubThreadInfo_p[loop].publisherId = ( solClient_uint32_t ) loop;
+        pubThreadInfo_p[loop].txCount = 0;
+        pubThreadInfo_p[loop].elapsedTime = 0;
+        pubThreadInfo_p[loop].schedule_p = NULL;
+    }
+    if ( common_runControlTimed ( &runControl_s ) ) {
+        common_runControlStart ( &runControl_s, getTimeInNs (  ) );
+    }
+    for ( loop = 0; loop < numPubThread; loop++ ) {
+        if ( multiSend_s != MULTI_SEND_OFF ) {
+            if ( ( pubThreadHandle[loop] = startThread ( pubThreadSendMultiple,
+                                                         ( void * ) &pubThreadInfo_p[loop] ) ) == _NULL_THREAD_ID ) {
+                solClient_log ( SOLCLIENT_LOG_ERROR, "could not create publisher thread" );
+                exitEarly_s = 1;
+                numPubThread = loop;
+                break;
+            }
+        } else {
+            if ( ( pubThreadHandle[loop] = startThread ( pubThread, ( void * ) &pubThreadInfo_p[loop] ) ) == _NULL_THREAD_ID ) {
+                solClient_log ( SOLCLIENT_LOG_ERROR, "could not create publisher thread" );
+                exitEarly_s = 1;
+                numPubThread = loop;
                 break;
             }
         }
     }
-    return DEFAULT_THREAD_RETURN_ARG;
+    for ( loop = 0; loop < numPubThread; loop++ ) {
+        waitOnThread ( pubThreadHandle[loop] );
+        if ( pubThreadInfo_p[loop].schedule_p != NULL ) {
+            if ( lagHist_p != NULL ) {
+                common_histogramAdd ( lagHist_p, &pubThreadInfo_p[loop].schedule_p->lagHist );
+            }
+            free ( pubThreadInfo_p[loop].schedule_p );
+            pubThreadInfo_p[loop].schedule_p = NULL;
+        }
+    }
+    return numPubThread;
+}
+
+/*
+ * fn waitForRx()
+ *
+ * When subscribing, waits until every shard has received the messages it
+ * expects. With publishers, it gives up after 1 second.
+ */
+static solClient_returnCode_t waitForRx ( void )
+{
+    solClient_context_timerId_t timerId;
+    solClient_returnCode_t rc = SOLCLIENT_OK;
+
+    if ( !useSub_s ) {
+        return SOLCLIENT_OK;
+    }
+    rxTimeout_s = 0;
+    if ( usePub_s ) {
+        /* In pubsub mode */
+        printf ( "Waiting up to 1 second for subscriber to receive all messages...\n" );
+        if ( ( rc = solClient_context_startTimer ( shards_s[0].contextThreadInfo.context_p,
+                                                   SOLCLIENT_CONTEXT_TIMER_ONE_SHOT,
+                                                   1000, waitRxDoneCallbackFunc,
+                                                   ( void * ) 0, &timerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_startTimer()" );
+            return rc;
+        }
+    } else if ( common_runControlTimed ( &runControl_s ) ) {
+        /* In sub mode only; the first message starts the run. */
+        printf ( "Waiting for the first message, then until the run ends ... \n" );
+    } else {
+        /* In sub mode only. */
+        printf ( "Waiting to receive %u message(s) or more ... \n", msgNum_s );
+    }
+
+    /*
+     * Now wait for the message receive to finish receiving all messages
+     * if using a subscriber. Simple polling is used here, but some sort
+     * of thread syncrhonization object could be used. 
+     */
+    while ( !rxDone (  ) && !exitEarly_s && !rxTimeout_s ) {
+        sleepInUs ( 100000 );   /* Check every 100 ms. */
+    }
+    if ( !rxTimeout_s && usePub_s ) {
+        if ( ( rc = solClient_context_stopTimer ( shards_s[0].contextThreadInfo.context_p, &timerId ) ) != SOLCLIENT_OK ) {
+            common_handleError ( rc, "solClient_context_stopTimer()" );
+        }
+    }
+    return rc;
+}
+
+/*
+ * fn parseMultiSendMode()
+ * param mode_p A MULTI_SEND_MODE value.
+ *
+ * Returns the multiSend_s value for 'false', 'true' or 'adaptive', or -1.
+ */
+static int      parseMultiSendMode ( const char *mode_p )
+{
+    if ( strcasecmp ( mode_p, "false" ) == 0 ) {
+        return MULTI_SEND_OFF;
+    } else if ( strcasecmp ( mode_p, "true" ) == 0 ) {
+        return MULTI_SEND_FIXED;
+    } else if ( strcasecmp ( mode_p, "adaptive" ) == 0 ) {
+        return MULTI_SEND_ADAPTIVE;
+    }
+    return -1;
+}
+
+/*
+ * fn parseSweep()
+ * param spec_p The --sweep value, 'name=value,value...' lists separated by ':'.
+ * param sweep_p The sweep, holding the single-test values to use for the lists
+ *               not given.
+ *
+ * Returns 1 if the whole spec was understood, 0 otherwise.
+ */
+static int      parseSweep ( const char *spec_p, perfSweep_pt sweep_p )
+{
+    char            spec[256];
+    char           *name_p;
+    char           *next_p;
+    char           *value_p;
+    char           *nextValue_p;
+    int            *values_p;
+    int            *numValues_p;
+    int             value;
+
+    strncpy ( spec, spec_p, sizeof ( spec ) );
+    spec[sizeof ( spec ) - 1] = ( char ) 0;
+    for ( name_p = spec; name_p != NULL; name_p = next_p ) {
+        if ( ( next_p = strchr ( name_p, ':' ) ) != NULL ) {
+            *next_p++ = ( char ) 0;
+        }
+        if ( ( value_p = strchr ( name_p, '=' ) ) == NULL ) {
+            printf ( "Error: sweep list \"%s\" is not 'name=value,value...'\n", name_p );
+            return 0;
+        }
+        *value_p++ = ( char ) 0;
+        if ( strcasecmp ( name_p, "warmup" ) == 0 ) {
+            sweep_p->warmupMsgs = ( unsigned int ) atoi ( value_p );
+            continue;
+        } else if ( strcasecmp ( name_p, "size" ) == 0 ) {
+            values_p = sweep_p->size;
+            numValues_p = &sweep_p->numSize;
+        } else if ( strcasecmp ( name_p, "rate" ) == 0 ) {
+            values_p = sweep_p->rate;
+            numValues_p = &sweep_p->numRate;
+        } else if ( strcasecmp ( name_p, "threads" ) == 0 ) {
+            values_p = sweep_p->threads;
+            numValues_p = &sweep_p->numThreads;
+        } else if ( strcasecmp ( name_p, "nodelay" ) == 0 ) {
+            values_p = sweep_p->noDelay;
+            numValues_p = &sweep_p->numNoDelay;
+        } else if ( strcasecmp ( name_p, "multi" ) == 0 ) {
+            values_p = sweep_p->multiSend;
+            numValues_p = &sweep_p->numMultiSend;
+        } else {
+            printf ( "Error: unknown sweep list \"%s\"\n", name_p );
+            return 0;
+        }
+
+        *numValues_p = 0;
+        for ( ; value_p != NULL; value_p = nextValue_p ) {
+            if ( ( nextValue_p = strchr ( value_p, ',' ) ) != NULL ) {
+                *nextValue_p++ = ( char ) 0;
+            }
+            if ( values_p == sweep_p->noDelay ) {
+                value = ( strcasecmp ( value_p, "true" ) == 0 ) ? 1 : ( strcasecmp ( value_p, "false" ) == 0 ) ? 0 : -1;
+            } else if ( values_p == sweep_p->multiSend ) {
+                value = parseMultiSendMode ( value_p );
+            } else {
+                value = atoi ( value_p );
+                if ( value <= 0 ) {
+                    value = -1;
+                }
+            }
+            if ( ( value < 0 ) || ( ( values_p == sweep_p->threads ) && ( value > MAX_PUB_THREADS ) ) ) {
+                printf ( "Error: bad %s value \"%s\" in sweep\n", name_p, value_p );
+                return 0;
+            }
+            if ( *numValues_p == MAX_SWEEP_VALUES ) {
+                printf ( "Error: more than %d %s values in sweep\n", MAX_SWEEP_VALUES, name_p );
+                return 0;
+            }
+            values_p[( *numValues_p )++] = value;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fn sumShardStats()
+ * param rxStats_p Returns the receive statistics summed over all Sessions.
+ * param txStats_p Returns the transmit statistics summed over all Sessions.
+ * param clear Whether to clear the statistics of every Session afterwards.
+ */
+static void     sumShardStats ( solClient_stats_t * rxStats_p, solClient_stats_t * txStats_p, int clear )
+{
+    solClient_stats_t rxStats[SOLCLIENT_STATS_RX_NUM_STATS];
+    solClient_stats_t txStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    solClient_returnCode_t rc;
+    int             shard;
+    int             sessionIndex;
+    int             loop;
+
+    memset ( rxStats_p, 0, sizeof ( solClient_stats_t ) * SOLCLIENT_STATS_RX_NUM_STATS );
+    memset ( txStats_p, 0, sizeof ( solClient_stats_t ) * SOLCLIENT_STATS_TX_NUM_STATS );
+    for ( shard = 0; shard < numShards_s; shard++ ) {
+        for ( sessionIndex = 0; sessionIndex < shards_s[shard].numConnected; sessionIndex++ ) {
+            if ( ( ( rc = solClient_session_getRxStats ( shards_s[shard].session_p[sessionIndex], rxStats,
+                                                         SOLCLIENT_STATS_RX_NUM_STATS ) ) != SOLCLIENT_OK ) ||
+                 ( ( rc = solClient_session_getTxStats ( shards_s[shard].session_p[sessionIndex], txStats,
+                                                         SOLCLIENT_STATS_TX_NUM_STATS ) ) != SOLCLIENT_OK ) ) {
+                common_handleError ( rc, "solClient_session_getRxStats()/getTxStats()" );
+                continue;
+            }
+            for ( loop = 0; loop < SOLCLIENT_STATS_RX_NUM_STATS; loop++ ) {
+                rxStats_p[loop] += rxStats[loop];
+            }
+            for ( loop = 0; loop < SOLCLIENT_STATS_TX_NUM_STATS; loop++ ) {
+                txStats_p[loop] += txStats[loop];
+            }
+            if ( clear && ( ( rc = solClient_session_clearStats ( shards_s[shard].session_p[sessionIndex] ) )
+                            != SOLCLIENT_OK ) ) {
+                common_handleError ( rc, "solClient_session_clearStats()" );
+            }
+        }
+    }
+}
+
+/*
+ * fn runSweep()
+ * param sweep_p The grid of parameters to run.
+ * param sessionProps The Session properties, shared by all Sessions.
+ * param noDelayIndex Index in sessionProps of the SOLCLIENT_SESSION_PROP_TCP_NODELAY value.
+ * param numSessions Number of Sessions per Context.
+ * param pubTopic_p The Topic to publish to.
+ * param subTopic_p The Topic to subscribe to.
+ * param pubThreadInfo_p Array of MAX_PUB_THREADS publisher thread information.
+ * param file_p Where to write the CSV results.
+ *
+ * Runs one test for every combination of the sweep's values. TCP_NO_DELAY can only be
+ * set when a Session is created, so the shards are created once for each TCP_NO_DELAY
+ * value and reused for every other combination. Each test is preceded by a warm-up
+ * of warmupMsgs messages per publisher, whose statistics are discarded.
+ * Each row of the CSV holds the achieved rates, the process CPU time per message sent
+ * (from getUsageTime()) and the change in the Session statistics over the test.
+ */
+static void     runSweep ( perfSweep_pt sweep_p, solClient_propertyArray_pt sessionProps, int noDelayIndex,
+                           int numSessions, const char *pubTopic_p, const char *subTopic_p,
+                           pubThreadInfo_pt pubThreadInfo_p, FILE * file_p )
+{
+    solClient_stats_t rxStats[SOLCLIENT_STATS_RX_NUM_STATS];
+    solClient_stats_t txStats[SOLCLIENT_STATS_TX_NUM_STATS];
+    common_histogram_t latencyHist;
+    common_seqReport_t seqReport;
+    unsigned int    numMsgs = msgNum_s;
+    unsigned long long txCount;
+    unsigned long long rxCount;
+    long long       pubTime;
+    long long       startTime;
+    long long       elapsedTime;
+    long long       startUserTime;
+    long long       startSysTime;
+    long long       userTime;
+    long long       sysTime;
+    int             numPubThread;
+    int             noDelay;
+    int             size;
+    int             rate;
+    int             threads;
+    int             multiSend;
+    int             shard;
+    int             loop;
+
+    fprintf ( file_p, "tcp_no_delay,multi_send,msg_size,msg_rate,threads,tx_msgs,tx_rate,rx_msgs,rx_rate,elapsed_us,"
+              "cpu_us_per_msg,tx_bytes,rx_bytes,tx_would_block,tx_socket_full,rx_discard_ind,"
+              "latency_p50_us,latency_p99_us,seq_missing,seq_loss_bursts,seq_reordered,seq_duplicates\n" );
+    fflush ( file_p );
+
+    for ( noDelay = 0; ( noDelay < sweep_p->numNoDelay ) && !exitEarly_s; noDelay++ ) {
+        sessionProps[noDelayIndex] = ( sweep_p->noDelay[noDelay] ) ? "1" : "0";
+        if ( createShards ( sessionProps, numSessions, pubTopic_p, subTopic_p ) != SOLCLIENT_OK ) {
+            destroyShards (  );
+            return;
+        }
+        for ( size = 0; ( size < sweep_p->numSize ) && !exitEarly_s; size++ ) {
+            binaryPayloadSize_s = sweep_p->size[size];
+            if ( latencyMode_s && ( binaryPayloadSize_s < ( int ) sizeof ( perfTestHeader_t ) ) ) {
+                binaryPayloadSize_s = ( int ) sizeof ( perfTestHeader_t );
+            }
+            for ( rate = 0; ( rate < sweep_p->numRate ) && !exitEarly_s; rate++ ) {
+                msgRate_s = ( unsigned int ) sweep_p->rate[rate];
+                for ( threads = 0; ( threads < sweep_p->numThreads ) && !exitEarly_s; threads++ ) {
+                    numPubThread = sweep_p->threads[threads];
+                    for ( multiSend = 0; ( multiSend < sweep_p->numMultiSend ) && !exitEarly_s; multiSend++ ) {
+                        multiSend_s = sweep_p->multiSend[multiSend];
+                        printf ( "\nSweep: TCP_NO_DELAY %d, MULTI_SEND_MODE %d, MSG_SIZE %d, MSG_RATE %u, %d publishers\n",
+                                 sweep_p->noDelay[noDelay], multiSend_s, binaryPayloadSize_s, msgRate_s, numPubThread );
+
+                        if ( sweep_p->warmupMsgs > 0 ) {
+                            msgNum_s = sweep_p->warmupMsgs;
+                            assignPublishers ( numPubThread, numSessions );
+                            runPublishers ( pubThreadInfo_p, numPubThread, numSessions, NULL );
+                            waitForRx (  );
+                        }
+
+                        msgNum_s = numMsgs;
+                        assignPublishers ( numPubThread, numSessions );
+                        sumShardStats ( rxStats, txStats, 1 );
+                        getUsageTime ( &startUserTime, &startSysTime );
+                        startTime = ( long long ) ( getTimeInNs (  ) / 1000 );
+                        numPubThread = runPublishers ( pubThreadInfo_p, numPubThread, numSessions, NULL );
+                        waitForRx (  );
+                        elapsedTime = ( long long ) ( getTimeInNs (  ) / 1000 ) - startTime;
+                        getUsageTime ( &userTime, &sysTime );
+                        sumShardStats ( rxStats, txStats, 1 );
+                        if ( exitEarly_s ) {
+                            break;
+                        }
+
+                        txCount = 0;
+                        pubTime = 0;
+                        for ( loop = 0; loop < numPubThread; loop++ ) {
+                            txCount += pubThreadInfo_p[loop].txCount;
+                            if ( pubThreadInfo_p[loop].elapsedTime > pubTime ) {
+                                pubTime = pubThreadInfo_p[loop].elapsedTime;
+                            }
+                        }
+                        rxCount = 0;
+                        common_histogramInit ( &latencyHist );
+                        for ( shard = 0; shard < numShards_s; shard++ ) {
+                            rxCount += shards_s[shard].numRx;
+                            if ( latencyMode_s ) {
+                                common_histogramAdd ( &latencyHist, &shards_s[shard].latencyHist );
+                            }
+                        }
+                        totalSeqReport ( &seqReport );
+                        fprintf ( file_p, "%s,%s,%d,%u,%d,%llu,%.1f,%llu,%.1f,%lld,%.3f,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,"
+                                  "%llu,%llu,%llu,%llu\n",
+                                  ( sweep_p->noDelay[noDelay] ) ? "true" : "false",
+                                  ( multiSend_s == MULTI_SEND_ADAPTIVE ) ? "adaptive" :
+                                  ( multiSend_s == MULTI_SEND_FIXED ) ? "true" : "false",
+                                  binaryPayloadSize_s, msgRate_s, numPubThread,
+                                  txCount, ( pubTime > 0 ) ? ( double ) txCount * 1000000.0 / ( double ) pubTime : 0.0,
+                                  rxCount, ( elapsedTime > 0 ) ? ( double ) rxCount * 1000000.0 / ( double ) elapsedTime : 0.0,
+                                  elapsedTime,
+                                  ( txCount > 0 ) ? ( double ) ( ( userTime - startUserTime ) + ( sysTime - startSysTime ) ) /
+                                  ( double ) txCount : 0.0,
+                                  ( unsigned long long ) txStats[SOLCLIENT_STATS_TX_TOTAL_DATA_BYTES],
+                                  ( unsigned long long ) rxStats[SOLCLIENT_STATS_RX_TOTAL_DATA_BYTES],
+                                  ( unsigned long long ) txStats[SOLCLIENT_STATS_TX_WOULD_BLOCK],
+                                  ( unsigned long long ) txStats[SOLCLIENT_STATS_TX_SOCKET_FULL],
+                                  ( unsigned long long ) rxStats[SOLCLIENT_STATS_RX_DISCARD_IND],
+                                  ( double ) common_histogramValueAtPercentile ( &latencyHist, 50.0 ) / 1000.0,
+                                  ( double ) common_histogramValueAtPercentile ( &latencyHist, 99.0 ) / 1000.0,
+                                  seqReport.numMissing, seqReport.numBursts, seqReport.numReorder, seqReport.numDup );
+                        fflush ( file_p );
+                    }
+                }
+            }
+        }
+        destroyShards (  );
+    }
 }
 
 static void     sigHandler ( int sigNum )
@@ -384,12 +1605,15 @@ int main ( int argc, char *argv[] )
             "\t\tP[n]: for 'n' persistent publishers (default 1)\n"
             "\t\tb[n]: for 'n' publishers (default 1) and 1 subscribers\n"
             "\t\tB[n]: for 'n' persistent publishers (default 1) and 1 subscribers\n"
+            "\t\tl[n]: for 'n' publishers (default 1) and 1 subscriber, measuring latency\n"
+            "\t\tL[n]: for 'n' persistent publishers (default 1) and 1 subscriber, measuring latency\n"
             "\tTCP_NO_DELAY is one of\n"
             "\t\ttrue\n"
             "\t\tfalse (default)\n"
             "\tMULTI_SEND_MODE is whether to use the solClient_session_sendMultipleMsg() function. \n"
             "\t\tNOTE: messages sent in MULTI_SEND_MODE are always sent direct.\n"
-            "\t\ttrue\n" "\t\tfalse (default)\n";
+            "\t\ttrue\n" "\t\tfalse (default)\n"
+            "\t\tadaptive: as true, sizing each batch by the Session's transmit backpressure\n";
     const char     *sessionProps[40];
     char           *noDelayVal_p = "0";
     char           *noDelay_p = "false";
@@ -397,8 +1621,8 @@ int main ( int argc, char *argv[] )
     char            subTopic[] = "level1/level2/level3/level4/>";
     char           *subTopic_p;
     char            pubTopic[] = "level1/level2/level3/level4/level5";
+    char           *pubTopic_p;
     const char     *pubSub_p;
-    solClient_opaqueSession_pt session_p;
     long long       startTime;
     long long       endTime;
     int             propIndex;
@@ -407,14 +1631,21 @@ int main ( int argc, char *argv[] )
     long long       sysTime;
     long long       elapsedTime;
     solClient_version_info_pt versionInfo_p;
-    solClient_context_createFuncInfo_t contextFuncInfo = SOLCLIENT_CONTEXT_CREATEFUNC_INITIALIZER;
-    solClient_session_createFuncInfo_t sessionFuncInfo = SOLCLIENT_SESSION_CREATEFUNC_INITIALIZER;
-    solClient_context_timerId_t timerId;
     solClient_returnCode_t rc = SOLCLIENT_OK;
-    contextThreadInfo_t contextThreadInfo;
-    THREAD_HANDLE_T pubThreadHandle[100];
+    pubThreadInfo_t pubThreadInfo[MAX_PUB_THREADS];
     struct commonOptions commandOpts;
-    int             loop;
+    common_histogram_t latencyHist;
+    common_histogram_t lagHist;
+    common_statsSampler_t sampler;
+    solClient_opaqueSession_pt sampleSessions[MAX_CONTEXTS * MAX_SESSIONS_PER_CONTEXT];
+    int             numSampleSessions = 0;
+    perfSweep_t     sweep;
+    FILE           *sweepFile_p = NULL;
+    int             noDelayIndex = 0;
+    int             numSessions;
+    int             numPubThread = 0;
+    int             shard;
+    int             sessionIndex;
 
     signal ( SIGINT, sigHandler );
 
@@ -439,22 +1670,58 @@ int main ( int argc, char *argv[] )
                             MSG_RATE_MASK  |
                             LOG_LEVEL_MASK |
                             USE_GSS_MASK |
-                            ZIP_LEVEL_MASK));                       /* optional parameters */
+                            ZIP_LEVEL_MASK |
+                            HIST_FILE_MASK |
+                            NUM_CONTEXTS_MASK |
+                            NUM_SESSIONS_MASK |
+                            ARRIVAL_MASK |
+                            SPIN_BUDGET_MASK |
+                            USE_TSC_MASK |
+                            STATS_SAMPLE_MASK |
+                            SWEEP_MASK |
+                            PAYLOAD_MASK |
+                            RUN_CONTROL_MASK));                         /* optional parameters */
     if ( common_parseCommandOptions ( argc, argv, &commandOpts, positionalParms ) == 0 ) {
         exit(1);
     }
 
+    /* Calibrate the clock used for all rate and latency measurements. */
+    initTimeInNs ( commandOpts.useTsc );
+    printf ( "Timing with %s\n", getTimeInNsSource (  ) );
+
     msgNum_s = commandOpts.numMsgsToSend;
     msgRate_s = commandOpts.msgRate;
+    arrivalMode_s = commandOpts.arrivalMode;
+    spinBudgetUs_s = commandOpts.spinBudgetUs;
+    payloadType_s = commandOpts.payloadType;
+    payloadFile_s = commandOpts.payloadFile;
+    ringSize_s = commandOpts.ringSize;
+    if ( ( commandOpts.sweepSpec[0] != ( char ) 0 ) && ( commandOpts.durationSec > 0 ) ) {
+        printf ( "Warning: --duration is ignored with --sweep\n" );
+        commandOpts.durationSec = 0;
+    }
+    common_runControlInit ( &runControl_s, commandOpts.durationSec, commandOpts.warmupSec, commandOpts.cooldownSec );
 
     if ( commandOpts.destinationName[0] == ( char ) 0 ) {
-        publishTopic_ps = pubTopic;
+        pubTopic_p = pubTopic;
         subTopic_p = subTopic;
     } else {
-        publishTopic_ps = commandOpts.destinationName;
+        pubTopic_p = commandOpts.destinationName;
         subTopic_p = commandOpts.destinationName;
     }
 
+    numShards_s = commandOpts.numContexts;
+    if ( numShards_s > MAX_CONTEXTS ) {
+        printf ( "Warning: maximum %d contexts supported, reducing %d to %d\n", MAX_CONTEXTS, numShards_s, MAX_CONTEXTS );
+        numShards_s = MAX_CONTEXTS;
+    }
+    numSessions = commandOpts.numSessions;
+    if ( numSessions > MAX_SESSIONS_PER_CONTEXT ) {
+        printf ( "Warning: maximum %d sessions per context supported, reducing %d to %d\n",
+                 MAX_SESSIONS_PER_CONTEXT, numSessions, MAX_SESSIONS_PER_CONTEXT );
+        numSessions = MAX_SESSIONS_PER_CONTEXT;
+    }
+
     /* Optional parameters. */
 
     /* Binary payload size option.  */
@@ -479,6 +1746,13 @@ int main ( int argc, char *argv[] )
         } else if ( *( argv[optind + 1] ) == 'B' ) {
             pubSub_p = "Pub and Sub";
             sendPersistent_s = 1;
+        } else if ( *( argv[optind + 1] ) == 'l' ) {
+            pubSub_p = "Pub and Sub latency";
+            latencyMode_s = 1;
+        } else if ( *( argv[optind + 1] ) == 'L' ) {
+            pubSub_p = "Pub and Sub latency";
+            latencyMode_s = 1;
+            sendPersistent_s = 1;
         } else {
             printf ( "Error: Unknown PUB_SUB_MODE value \"%s\"\n", argv[optind + 1] );
             goto notInitialized;
@@ -490,9 +1764,10 @@ int main ( int argc, char *argv[] )
                          argv[optind + 1] );
                 goto notInitialized;
             }
-            if ( numThread > 100 ) {
-                printf ( "Warning: maximum 100 publisher threads supported, reducing %d to 100\n", numThread );
-                numThread = 100;
+            if ( numThread > MAX_PUB_THREADS ) {
+                printf ( "Warning: maximum %d publisher threads supported, reducing %d to %d\n",
+                         MAX_PUB_THREADS, numThread, MAX_PUB_THREADS );
+                numThread = MAX_PUB_THREADS;
             }
             if ( usePub_s == 0 ) {
                 printf ( "Warning: %d publishers ignored in subscriber only mode\n", numThread );
@@ -514,11 +1789,7 @@ int main ( int argc, char *argv[] )
     }
     /* Use multi-message send option. */
     if ( ( optind + 3 ) < argc ) {
-        if ( strcasecmp ( argv[optind + 3], "false" ) == 0 ) {
-            multiSend_s = 0;
-            multiSend_p = argv[optind + 3];
-        } else if ( strcasecmp ( argv[optind + 3], "true" ) == 0 ) {
-            multiSend_s = 1;
+        if ( ( multiSend_s = parseMultiSendMode ( argv[optind + 3] ) ) >= 0 ) {
             multiSend_p = argv[optind + 3];
         } else {
             printf ( "Error: Unknown MULTI_SEND_MODE value \"%s\"\n", argv[optind + 3] );
@@ -526,9 +1797,66 @@ int main ( int argc, char *argv[] )
         }
     }
 
-    printf ( "APPLIANCE_IP: %s,  APPLIANCE_USERNAME: %s, NUM_MSGS: %d,  MSG_RATE: %d, MSG_SIZE: %d, PUB_SUB_MODE %d %s threads, TCP_NO_DELAY: %s, MULTI_SEND_MODE: %s\n",
+    if ( latencyMode_s ) {
+        if ( binaryPayloadSize_s < ( int ) sizeof ( perfTestHeader_t ) ) {
+            printf ( "Warning: MSG_SIZE %d is too small for the latency header, increasing to %d\n",
+                     binaryPayloadSize_s, ( int ) sizeof ( perfTestHeader_t ) );
+            binaryPayloadSize_s = ( int ) sizeof ( perfTestHeader_t );
+        }
+        if ( commandOpts.histFile[0] == ( char ) 0 ) {
+            strncpy ( commandOpts.histFile, "perfTest_latency.hgrm", sizeof ( commandOpts.histFile ) );
+        }
+    }
+
+    printf ( "APPLIANCE_IP: %s,  APPLIANCE_USERNAME: %s, NUM_MSGS: %d,  MSG_RATE: %d, MSG_SIZE: %d, PUB_SUB_MODE %d %s threads, TCP_NO_DELAY: %s, MULTI_SEND_MODE: %s, CONTEXTS: %d, SESSIONS: %d, ARRIVAL: %s\n",
              commandOpts.targetHost, commandOpts.username, msgNum_s, msgRate_s, binaryPayloadSize_s, numThread, pubSub_p,
-             noDelay_p, multiSend_p );
+             noDelay_p, multiSend_p, numShards_s, numSessions,
+             ( arrivalMode_s == COMMON_ARRIVAL_POISSON ) ? "poisson" :
+             ( arrivalMode_s == COMMON_ARRIVAL_CONSTANT ) ? "constant" : "closed-loop" );
+    if ( usePub_s && ( numThread < numShards_s * numSessions ) ) {
+        printf ( "Warning: %d publishers for %d sessions, some sessions will not publish\n",
+                 numThread, numShards_s * numSessions );
+    }
+
+    memset ( shards_s, 0, sizeof ( shards_s ) );
+    memset ( &sampler, 0, sizeof ( sampler ) );
+    if ( usePub_s ) {
+        numPubThread = numThread;
+    }
+    assignPublishers ( numPubThread, numSessions );
+
+    if ( commandOpts.sweepSpec[0] != ( char ) 0 ) {
+        if ( !usePub_s ) {
+            printf ( "Error: --sweep needs publishers\n" );
+            goto notInitialized;
+        }
+        sweep.size[0] = binaryPayloadSize_s;
+        sweep.numSize = 1;
+        sweep.rate[0] = ( int ) msgRate_s;
+        sweep.numRate = 1;
+        sweep.threads[0] = numThread;
+        sweep.numThreads = 1;
+        sweep.noDelay[0] = ( strcmp ( noDelayVal_p, "1" ) == 0 );
+        sweep.numNoDelay = 1;
+        sweep.multiSend[0] = multiSend_s;
+        sweep.numMultiSend = 1;
+        sweep.warmupMsgs = msgNum_s / 10;
+        if ( !parseSweep ( commandOpts.sweepSpec, &sweep ) ) {
+            goto notInitialized;
+        }
+        if ( commandOpts.sampleIntervalMs > 0 ) {
+            printf ( "Warning: --sample is ignored with --sweep\n" );
+            commandOpts.sampleIntervalMs = 0;
+        }
+        if ( commandOpts.sweepFile[0] == ( char ) 0 ) {
+            strncpy ( commandOpts.sweepFile, "perfTest_sweep.csv", sizeof ( commandOpts.sweepFile ) );
+        }
+        FOPEN ( sweepFile_p, commandOpts.sweepFile, "w" );
+        if ( sweepFile_p == NULL ) {
+            printf ( "Error: could not open sweep file '%s'\n", commandOpts.sweepFile );
+            goto notInitialized;
+        }
+    }
 
     /* Print version information. */
     if ( ( rc = solClient_version_get ( &versionInfo_p ) ) != SOLCLIENT_OK ) {
@@ -540,24 +1868,9 @@ int main ( int argc, char *argv[] )
     solClient_log_setFilterLevel ( SOLCLIENT_LOG_CATEGORY_ALL, commandOpts.logLevel );
 
 
-    startTime = getTimeInUs (  );
-
-    /* Create a Context to use for the Session. */
-    solClient_log ( SOLCLIENT_LOG_DEBUG, "creating solClient context" );
-    if ( ( rc = solClient_context_create ( NULL, &contextThreadInfo.context_p, &contextFuncInfo, sizeof ( contextFuncInfo ) ) )
-         != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_context_create()" );
-        goto initialized;
-    }
-
-    /* Start the Context thread. */
-    solClient_log ( SOLCLIENT_LOG_DEBUG, "starting solClient context thread" );
-    if ( !common_startContextThread ( &contextThreadInfo ) ) {
-        solClient_log ( SOLCLIENT_LOG_ERROR, "common_startContextThread() failed" );
-        goto contextCreated;
-    }
+    startTime = ( long long ) ( getTimeInNs (  ) / 1000 );
 
-    /* Create Session for sending/receiving messages. */
+    /* Create Session properties, shared by all Sessions. */
     propIndex = 0;
     if ( commandOpts.targetHost[0] != (char) 0 ) {
         sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_HOST;
@@ -569,6 +1882,7 @@ int main ( int argc, char *argv[] )
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_PASSWORD;
     sessionProps[propIndex++] = commandOpts.password;
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_TCP_NODELAY;
+    noDelayIndex = propIndex;
     sessionProps[propIndex++] = noDelayVal_p;
     sessionProps[propIndex++] = SOLCLIENT_SESSION_PROP_REAPPLY_SUBSCRIPTIONS;
     sessionProps[propIndex++] = SOLCLIENT_PROP_ENABLE_VAL;
@@ -615,105 +1929,46 @@ int main ( int argc, char *argv[] )
 
     sessionProps[propIndex] = NULL;
 
-    sessionFuncInfo.rxMsgInfo.callback_p = messageReceiveCallback;
-    sessionFuncInfo.rxMsgInfo.user_p = ( void * ) NULL;
-    sessionFuncInfo.eventInfo.callback_p = common_eventCallback;
-    sessionFuncInfo.eventInfo.user_p = ( void * ) NULL;
-    solClient_log ( SOLCLIENT_LOG_DEBUG, "creating solClient session" );
-    if ( ( rc = solClient_session_create ( sessionProps,
-                                           contextThreadInfo.context_p,
-                                           &session_p, &sessionFuncInfo, sizeof ( sessionFuncInfo ) ) )
-         != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_create()" );
-        goto contextThreadCreated;
+    if ( commandOpts.sweepSpec[0] != ( char ) 0 ) {
+        runSweep ( &sweep, sessionProps, noDelayIndex, numSessions, pubTopic_p, subTopic_p, pubThreadInfo, sweepFile_p );
+        goto shardsCreated;
     }
 
-    /*
-     *  We have topic subscription reapply enabled so we can add our subscriptions
-     *  before connecting.  Then we know all will have been re-applied when the 
-     *  blocking connect returns.
-     *
-     *  This is important for peer-to-peer (IPC) connections as we want to
-     *  be sure the subscription is sent to our peer before the peer begins
-     *  publishing.
-     */
-    if ( useSub_s ) {
-        /* Do not Wait for confirmation that the subscription has been applied.
-         * Setting SOLCLIENT_SUBSCRIBE_FLAGS_WAITFORCONFIRM will cause 
-         * solClient_session_topicSubscribeExt() to fail when the session is
-         * not yet established. */
-        if ( (  rc = solClient_session_topicSubscribeExt ( session_p,
-                                                          0,
-                                                          subTopic_p ) ) != SOLCLIENT_OK ) {
-            common_handleError ( rc, "solClient_session_topicSubscribeExt()" );
-            goto sessionConnected;
-        }
+    if ( createShards ( sessionProps, numSessions, pubTopic_p, subTopic_p ) != SOLCLIENT_OK ) {
+        goto shardsCreated;
     }
-    /* Connect the Session. */
-    solClient_log ( SOLCLIENT_LOG_DEBUG, "connecting solClient session" );
-    if ( ( rc = solClient_session_connect ( session_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_connect()" );
-        goto sessionCreated;
-    }
-
 
-    if ( usePub_s ) {
-        for ( loop = 0; loop < numThread; loop++ ) {
-            if ( multiSend_s ) {
-                if ( ( pubThreadHandle[loop] = startThread ( pubThreadSendMultiple,
-                                                             ( void * ) session_p ) ) == _NULL_THREAD_ID ) {
-                    solClient_log ( SOLCLIENT_LOG_ERROR, "could not create publisher thread" );
-                    goto sessionConnected;
-                }
-            } else {
-                if ( ( pubThreadHandle[loop] = startThread ( pubThread, ( void * ) session_p ) ) == _NULL_THREAD_ID ) {
-                    solClient_log ( SOLCLIENT_LOG_ERROR, "could not create publisher thread" );
-                    goto sessionConnected;
-                }
+    if ( commandOpts.sampleIntervalMs > 0 ) {
+        for ( shard = 0; shard < numShards_s; shard++ ) {
+            for ( sessionIndex = 0; sessionIndex < shards_s[shard].numConnected; sessionIndex++ ) {
+                sampleSessions[numSampleSessions++] = shards_s[shard].session_p[sessionIndex];
             }
         }
-        for ( loop = 0; loop < numThread; loop++ ) {
-            waitOnThread ( pubThreadHandle[loop] );
+        if ( common_statsSamplerStart ( &sampler, shards_s[0].contextThreadInfo.context_p, sampleSessions,
+                                        numSampleSessions, commandOpts.sampleIntervalMs,
+                                        commandOpts.sampleFile ) != SOLCLIENT_OK ) {
+            goto shardsCreated;
+        }
+        if ( useSub_s ) {
+            startSeqSamples ( commandOpts.sampleIntervalMs );
         }
     }
 
+    common_histogramInit ( &lagHist );
+    numPubThread = runPublishers ( pubThreadInfo, numPubThread, numSessions, &lagHist );
+
     if ( exitEarly_s ) {
-        goto sessionConnected;
+        goto shardsCreated;
     }
 
-    if ( useSub_s ) {
-        if ( usePub_s ) {
-            /* In pubsub mode */
-            printf ( "Waiting up to 1 second for subscriber to receive all messages...\n" );
-            if ( ( rc = solClient_context_startTimer ( contextThreadInfo.context_p,
-                                                       SOLCLIENT_CONTEXT_TIMER_ONE_SHOT,
-                                                       1000, waitRxDoneCallbackFunc,
-                                                       ( void * ) 0, &timerId ) ) != SOLCLIENT_OK ) {
-                common_handleError ( rc, "solClient_context_startTimer()" );
-                goto sessionCreated;
-            }
-        } else {
-            /* In sub mode only. */
-            printf ( "Waiting to receive %u message(s) or more ... \n", msgNum_s );
-        }
-
-        /*
-         * Now wait for the message receive to finish receiving all messages
-         * if using a subscriber. Simple polling is used here, but some sort
-         * of thread syncrhonization object could be used. 
-         */
-        while ( !rxDone_s && !exitEarly_s && !rxTimeout_s ) {
-            sleepInUs ( 100000 );   /* Check every 100 ms. */
-        }
-        if ( !rxTimeout_s && usePub_s ) {
-            if ( ( rc = solClient_context_stopTimer ( contextThreadInfo.context_p, &timerId ) ) != SOLCLIENT_OK ) {
-                common_handleError ( rc, "solClient_context_stopTimer()" );
-                goto sessionCreated;
-            }
-        }
+    if ( waitForRx (  ) != SOLCLIENT_OK ) {
+        goto shardsCreated;
     }
 
-    endTime = getTimeInUs (  );
+    endTime = ( long long ) ( getTimeInNs (  ) / 1000 );
+    /* Take the last sample before printStats() clears the statistics. */
+    common_statsSamplerStop ( &sampler );
+    stopSeqSamples (  );
     getUsageTime ( &userTime, &sysTime );
     elapsedTime = endTime - startTime;
     printf ( "\nElasped time: %lld us, user time: %lld us, sys time: %lld us\n"
@@ -721,33 +1976,45 @@ int main ( int argc, char *argv[] )
              ( long double ) 100.0 *
              ( ( ( long double ) userTime + ( long double ) sysTime ) / ( long double ) elapsedTime ) );
 
-    printStats ( session_p );
-
-    /************* Cleanup *************/
+    if ( ( numShards_s * numSessions ) == 1 ) {
+        printStats ( shards_s[0].session_p[0] );
+    }
+    if ( ( ( numShards_s * numSessions ) != 1 ) || common_runControlTimed ( &runControl_s ) ) {
+        /* The Session statistics include the warm-up and cool-down; these do not. */
+        printShardStats ( pubThreadInfo, numPubThread );
+    }
+    if ( useSub_s ) {
+        printSeqReport ( "Sequence check" );
+    }
 
-sessionConnected:
-    /* Disconnect the Session. */
-    if ( ( rc = solClient_session_disconnect ( session_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_disconnect()" );
+    if ( arrivalMode_s != COMMON_ARRIVAL_CLOSED ) {
+        common_histogramPrint ( &lagHist, "Send schedule lag" );
     }
 
-sessionCreated:
-    /* Destroy the Session. */
-    if ( ( rc = solClient_session_destroy ( &session_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_session_destroy()" );
+    if ( latencyMode_s ) {
+        common_histogramInit ( &latencyHist );
+        for ( shard = 0; shard < numShards_s; shard++ ) {
+            common_histogramAdd ( &latencyHist, &shards_s[shard].latencyHist );
+        }
+        common_histogramPrint ( &latencyHist, "Latency" );
+        if ( common_histogramDump ( &latencyHist, commandOpts.histFile ) ) {
+            printf ( "Latency histogram written to '%s'\n\n", commandOpts.histFile );
+        }
     }
 
-contextThreadCreated:
-    /* Stop the Context thread. */
-    common_stopContextThread ( &contextThreadInfo );
+    /************* Cleanup *************/
 
-contextCreated:
-    /* Destroy the Context. */
-    if ( ( rc = solClient_context_destroy ( &contextThreadInfo.context_p ) ) != SOLCLIENT_OK ) {
-        common_handleError ( rc, "solClient_context_destroy()" );
+shardsCreated:
+    common_statsSamplerStop ( &sampler );
+    stopSeqSamples (  );
+    destroyShards (  );
+    /* The Contexts are gone, so the sampling timer can no longer run. */
+    common_statsSamplerDestroy ( &sampler );
+    common_runControlDestroy ( &runControl_s );
+    if ( ( sweepFile_p != NULL ) && ( sweepFile_p != stdout ) ) {
+        fclose ( sweepFile_p );
     }
 
-initialized:
     /* Cleanup solClient. */
     if ( ( rc = solClient_cleanup (  ) ) != SOLCLIENT_OK ) {
         common_handleError ( rc, "solClient_cleanup()" );